@@ -0,0 +1,26 @@
+#include "OperationResult.h"
+
+using namespace PCFile;
+
+OperationResult::OperationResult()
+{
+    mStatus=Failed;
+}
+
+void OperationResult::setCanceled(QString strError)
+{
+    mStatus=Canceled;
+    mStrError=strError;
+}
+
+void OperationResult::setFailed(QString strError)
+{
+    mStatus=Failed;
+    mStrError=strError;
+}
+
+void OperationResult::setSuccess()
+{
+    mStatus=Success;
+    mStrError.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef OPERATIONRESULT_H
+#define OPERATIONRESULT_H
+
+#include "libPointCloudFileManager_global.h"
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+
+#include "Point.h"
+
+namespace PCFile{
+
+// Resultado de una operacion asincrona de PointCloudFileManager
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT OperationResult
+{
+public:
+    enum Status{Success,Failed,Canceled};
+    OperationResult();
+    QString getError() const{return(mStrError);};
+    Status getStatus() const{return(mStatus);};
+    bool isCanceled() const{return(mStatus==Canceled);};
+    bool isSuccess() const{return(mStatus==Success);};
+    void setCanceled(QString strError);
+    void setFailed(QString strError);
+    void setSuccess();
+private:
+    Status mStatus;
+    QString mStrError;
+};
+
+// Resultado de PointCloudFileManager::getPointsFromWktGeometryAsync
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT PointsResult : public OperationResult
+{
+public:
+    QMap<int,QMap<QString,bool> >& getExistsFieldsByFileId(){return(mExistsFieldsByFileId);};
+    QMap<int,QMap<int,QMap<int,QVector<PCFile::Point> > > >& getPointsByTileByFileId(){return(mPointsByTileByFileId);}; //[fileId][tileX][tileY]
+    QMap<int,QMap<int,QString> >& getTilesTableName(){return(mTilesTableName);};
+private:
+    QMap<int,QMap<QString,bool> > mExistsFieldsByFileId;
+    QMap<int,QMap<int,QMap<int,QVector<PCFile::Point> > > > mPointsByTileByFileId;
+    QMap<int,QMap<int,QString> > mTilesTableName;
+};
+}
+#endif // OPERATIONRESULT_H
@@ -6,9 +6,17 @@ using namespace PCFile;
 
 double Point::getGpsTime()
 {
-    quint8 h = ((mGpsDowHourPackit >> 0) & 0x1F);
-    quint8 dow = ((mGpsDowHourPackit >> 3) & 0x07);
-    int ms=mGpsMsb1*256*256*256+mGpsMsb2*256*256+mGpsMsb3*256;
+    return(getGpsTime(mGpsDowHourPackit,mGpsMsb1,mGpsMsb2,mGpsMsb3));
+}
+
+double Point::getGpsTime(quint8 gpsDowHourPackit,
+                         quint8 gpsMsb1,
+                         quint8 gpsMsb2,
+                         quint8 gpsMsb3)
+{
+    quint8 h = ((gpsDowHourPackit >> 0) & 0x1F);
+    quint8 dow = ((gpsDowHourPackit >> 3) & 0x07);
+    int ms=gpsMsb1*256*256*256+gpsMsb2*256*256+gpsMsb3*256;
     double gpsTime=h*60.*60.+dow*24.*60.*60.+ms/pow(10.,6.);
     return(gpsTime);
 }
@@ -19,6 +19,10 @@ public:
     quint16 getIx(){return(mFc);};
     quint16 getIy(){return(mSc);};
     double getGpsTime();
+    static double getGpsTime(quint8 gpsDowHourPackit,
+                             quint8 gpsMsb1,
+                             quint8 gpsMsb2,
+                             quint8 gpsMsb3);
     int getPositionInTile(){return(mPositionInTile);};
     double getZ();
     void get8BitsValues(QMap<QString,quint8>& values){values=m8BitsValues;};
@@ -1,15 +1,27 @@
 #include <QFile>
 #include <QFileInfo>
-#include <QProgressDialog>
-#include <QApplication>
+#include <QThread>
 #include <QDir>
-#include <QMessageBox>
 #include <QDateTime>
 #include <QTextStream>
 #include <QDataStream>
+#include <QtEndian>
+#include <QtMath>
 #include <QtConcurrent>
 #include <qtconcurrentmap.h>
-#include <QProgressDialog>
+#include <QWaitCondition>
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <qt_windows.h>
+#elif defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#endif
 
 #include <ogrsf_frmts.h>
 #include <gdal_utils.h>
@@ -17,6 +29,12 @@
 
 #include "lasreader.hpp"
 #include "laswriter.hpp"
+#include "laswritepoint.hpp"
+#include "arithmeticdecoder.hpp"
+#include "arithmeticencoder.hpp"
+#include "integercompressor.hpp"
+#include "bytestreamin_file.hpp"
+#include "bytestreamout_array.hpp"
 
 //#include "quazip.h"
 //#include "JlCompress.h"
@@ -27,14 +45,18 @@
 
 #include "PointCloudFileManager.h"
 #include "PointCloudFile.h"
+#include "PointsIndex.h"
+#include "PointsQuery.h"
+#include "ProgressCallback.h"
 
-#include "NeighborsSearch.h"
 
 using namespace PCFile;
 
 PointCloudFile::PointCloudFile(libCRS::CRSTools* ptrCrsTools,
                                PointCloudFileManager* ptrPCFManager,
-                               bool useMultiProcess)
+                               bool useMultiProcess):
+    mDataLock(QReadWriteLock::Recursive),
+    mWriteMutex(QMutex::Recursive)
 {
     mPtrCrsTools=ptrCrsTools;
     mPtrPCFManager=ptrPCFManager;
@@ -58,11 +80,11 @@ PointCloudFile::PointCloudFile(libCRS::CRSTools* ptrCrsTools,
     mMinimumSc=POINTCLOUDFILE_NO_DOUBLE_MINIMUM_VALUE;
     mMinimumTc=POINTCLOUDFILE_NO_DOUBLE_MINIMUM_VALUE;
 //    mUseMultiProcess=useMultiProcess;
-    mPtrMpProgressDialog=NULL;
-    mMpPtrGeometry=NULL;
+    mPtrMpProgress=NULL;
     mNumberOfPoints=0;
     mMaximumNumberOfPoints=mPtrPCFManager->getMaximumNumberOfPoints();
     mVerticalCrsEpsgCode=-1;
+    mEditSession=false;
 }
 
 PointCloudFile::~PointCloudFile()
@@ -92,6 +114,14 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
                                        bool updateHeader,
                                        QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    if(isEditing()) // la incorporacion reescribe los ficheros de clases
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFile");
+        strError+=QObject::tr("\nNot allowed while there is an edit session in progress");
+        return(false);
+    }
     if(mMaximumNumberOfPoints!=POINTCLOUDFILE_WITHOUT_MAXIMUM_NUMBER_OF_POINTS_LIMITS
             &&mNumberOfPoints>mMaximumNumberOfPoints)
     {
@@ -114,7 +144,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         strError+=QObject::tr("\nTemporal path is empty");
         return(false);
     }
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
 //    if(mFilePtrGeometryByIndex.contains(inputFileName))
 //    {
 //        strError=QObject::tr("PointCloudFile::addPointCloudFile");
@@ -143,7 +173,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFile");
             strError+=QObject::tr("\nError adding tiles from ROIs for file:\n%1\nError:\n%2")
@@ -201,6 +231,40 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             return(false);
         }
     }
+    // el indice de vecinos y los niveles de detalle de la version anterior del fichero dejan de ser validos
+    QString pointsIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCI_SUFFIX;
+    if(QFile::exists(pointsIndexFileName))
+    {
+        if(!QFile::remove(pointsIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(pointsIndexFileName);
+            return(false);
+        }
+    }
+    QString levelsOfDetailFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCL_SUFFIX;
+    if(QFile::exists(levelsOfDetailFileName))
+    {
+        if(!QFile::remove(levelsOfDetailFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(levelsOfDetailFileName);
+            return(false);
+        }
+    }
+    QString originalIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCO_SUFFIX;
+    if(QFile::exists(originalIndexFileName))
+    {
+        if(!QFile::remove(originalIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(originalIndexFileName);
+            return(false);
+        }
+    }
 //    QuaZip* ptrTilesPointsFileZip= new QuaZip(tilesPointsFileZipFileName);
 //    if(!ptrTilesPointsFileZip->open(QuaZip::mdCreate))
 //    {
@@ -351,7 +415,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFile");
             strError+=QObject::tr("\nError adding tiles from file:\n%1\nError:\n%2")
@@ -363,24 +427,20 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             return(true);
         }
     }
-    QProgressDialog* ptrProgress=NULL;
+    Progress* ptrProgress=NULL;
     int pointsByStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_PROCESS_BY_STEP;
     int numberOfSteps=ceil((double)numberOfPoints/(double)pointsByStep);
     if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+            &&ptrProgressCallback!=NULL)
     {
         QString title=QObject::tr("Adding Point Cloud File:");
         QString msgGlobal=inputFileName;
         msgGlobal+="\n";
         msgGlobal+=QString::number(numberOfPoints,10);
         msgGlobal+=" points";
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfSteps);
     }
-    int pointPosition=-1;
+    qint64 pointPosition=-1;
     int step=0;
     int numberOfProcessedPoints=0;
     int numberOfProcessedPointsInStep=0;
@@ -392,6 +452,8 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     QMap<int,QMap<int,QFile*> > tilesPtrPointsFiles;
     QMap<int,QMap<int,QDataStream*> > tilesPtrPointsDataStreams;
     QMap<int,QMap<int,int> > tilesNop;
+    QMap<int,QMap<int,QVector<double> > > tilesStatistics;
+    QMap<int,QMap<int,QVector<qint64> > > tilesOriginalIndexRanges; // por tramo, primer indice en el fichero y numero de puntos
     while(lasreader->read_point())
     {
         double x=lasreader->point.get_X()*lasheader->x_scale_factor+lasheader->x_offset;
@@ -404,10 +466,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             step++;
             numberOfProcessedPointsInStep=0;
             if(numberOfSteps>1
-                    &&ptrWidget!=NULL)
+                    &&ptrProgress!=NULL)
             {
                 ptrProgress->setValue(step);
-                qApp->processEvents();
             }
         }
         bool includedPoint=true;
@@ -510,12 +571,16 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             QVector<quint8> auxClasses;
             tilesPointsClass[tileX][tileY]=auxClasses;
             tilesNop[tileX][tileY]=0;
+            tilesStatistics[tileX][tileY]=getEmptyTileStatistics();
         }
         else
         {
             tilePtrPointsDataStream=tilesPtrPointsDataStreams[tileX][tileY];
         }
         (*tilePtrPointsDataStream)<<ix<<iy<<z_pa<<z_pb<<z_pc;
+        QVector<double>& tileStatistics=tilesStatistics[tileX][tileY];
+        updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_Z_MIN,
+                             (z_pa*256+z_pb)*100+z_pc);
         if(existsColor)
         {
             quint16 color_r=lasreader->point.get_R();
@@ -560,6 +625,8 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             (*tilePtrPointsDataStream)<<msb1;
             (*tilePtrPointsDataStream)<<msb2;
             (*tilePtrPointsDataStream)<<msb3;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MIN,
+                                 Point::getGpsTime(gpsDowHourPackit,msb1,msb2,msb3));
         }
         if(existsUserData)
         {
@@ -570,6 +637,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         {
             quint16 intensity=lasreader->point.get_intensity();
             (*tilePtrPointsDataStream)<<intensity;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MIN,intensity);
         }
         if(existsSourceId)
         {
@@ -594,6 +662,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         {
             quint8 returnNumber=lasreader->point.get_return_number();
             (*tilePtrPointsDataStream)<<returnNumber;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_RETURN_MIN,returnNumber);
         }
         if(existsReturns)
         {
@@ -607,6 +676,18 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(minY<mMinimumSc) mMinimumSc=minY;
         if(minZ<mMinimumTc) mMinimumTc=minZ;
         tilesPointsClass[tileX][tileY].push_back(pointClass);
+        QVector<qint64>& tileOriginalIndexRanges=tilesOriginalIndexRanges[tileX][tileY];
+        int numberOfRangesValues=tileOriginalIndexRanges.size();
+        if(numberOfRangesValues>0
+                &&tileOriginalIndexRanges[numberOfRangesValues-2]+tileOriginalIndexRanges[numberOfRangesValues-1]==pointPosition)
+        {
+            tileOriginalIndexRanges[numberOfRangesValues-1]++;
+        }
+        else
+        {
+            tileOriginalIndexRanges.push_back(pointPosition);
+            tileOriginalIndexRanges.push_back(1);
+        }
         tilesNumberOfPoints[tileX][tileY]=tilesNumberOfPoints[tileX][tileY]+1;
         tilesNop[tileX][tileY]=tilesNop[tileX][tileY]+1;
         mNumberOfPoints++;
@@ -617,11 +698,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         }
     }
     if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+            &&ptrProgress!=NULL)
     {
         ptrProgress->setValue(numberOfSteps);
-        qApp->processEvents();
-        ptrProgress->close();
         delete(ptrProgress);
     }
     lasreader->close();
@@ -758,7 +837,16 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     outPointsClass<<exitsFields;
     outPointsClass<<tilesPointsClass;
     outPointsClass<<tilesPointsClassNewByPos;
+    outPointsClass<<tilesStatistics;
     pointsClassFile.close();
+    if(!writeOriginalIndexFile(originalIndexFileName,
+                               tilesOriginalIndexRanges,
+                               strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
     QMap<int,QMap<int,int> >::const_iterator iterTileX=tilesNumberOfPoints.begin();
     while(iterTileX!=tilesNumberOfPoints.end())
     {
@@ -821,6 +909,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     mZipFilePathPointsByIndex[fileIndex]=tilesPointsFileZipFilePath;
     mZipFilePointsByIndex[fileIndex]=tilesPointsFileZipFileName;
     mClassesFileByIndex[fileIndex]=pointsClassFileName;
+    mPointsIndexFileByIndex[fileIndex]=pointsIndexFileName;
+    mLevelsOfDetailFileByIndex[fileIndex]=levelsOfDetailFileName;
+    mOriginalIndexFileByIndex[fileIndex]=originalIndexFileName;
     if(updateHeader)
     {
         if(!writeHeader(strAuxError))
@@ -840,6 +931,14 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
                                        bool updateHeader,
                                        QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    if(isEditing()) // la incorporacion reescribe los ficheros de clases
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFile");
+        strError+=QObject::tr("\nNot allowed while there is an edit session in progress");
+        return(false);
+    }
     if(mMaximumNumberOfPoints!=POINTCLOUDFILE_WITHOUT_MAXIMUM_NUMBER_OF_POINTS_LIMITS
             &&mNumberOfPoints>mMaximumNumberOfPoints)
     {
@@ -859,7 +958,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         strError+=QObject::tr("\nTemporal path is empty");
         return(false);
     }
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
 //    if(mFilePtrGeometryByIndex.contains(inputFileName))
 //    {
 //        strError=QObject::tr("PointCloudFile::addPointCloudFile");
@@ -888,7 +987,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFile");
             strError+=QObject::tr("\nError adding tiles from ROIs for file:\n%1\nError:\n%2")
@@ -946,6 +1045,40 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             return(false);
         }
     }
+    // el indice de vecinos y los niveles de detalle de la version anterior del fichero dejan de ser validos
+    QString pointsIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCI_SUFFIX;
+    if(QFile::exists(pointsIndexFileName))
+    {
+        if(!QFile::remove(pointsIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(pointsIndexFileName);
+            return(false);
+        }
+    }
+    QString levelsOfDetailFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCL_SUFFIX;
+    if(QFile::exists(levelsOfDetailFileName))
+    {
+        if(!QFile::remove(levelsOfDetailFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(levelsOfDetailFileName);
+            return(false);
+        }
+    }
+    QString originalIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCO_SUFFIX;
+    if(QFile::exists(originalIndexFileName))
+    {
+        if(!QFile::remove(originalIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::addPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(originalIndexFileName);
+            return(false);
+        }
+    }
 //    QuaZip* ptrTilesPointsFileZip= new QuaZip(tilesPointsFileZipFileName);
 //    if(!ptrTilesPointsFileZip->open(QuaZip::mdCreate))
 //    {
@@ -1096,7 +1229,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFile");
             strError+=QObject::tr("\nError adding tiles from file:\n%1\nError:\n%2")
@@ -1108,24 +1241,20 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             return(true);
         }
     }
-    QProgressDialog* ptrProgress=NULL;
+    Progress* ptrProgress=NULL;
     int pointsByStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_PROCESS_BY_STEP;
     int numberOfSteps=ceil((double)numberOfPoints/(double)pointsByStep);
     if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+            &&ptrProgressCallback!=NULL)
     {
         QString title=QObject::tr("Adding Point Cloud File:");
         QString msgGlobal=inputFileName;
         msgGlobal+="\n";
         msgGlobal+=QString::number(numberOfPoints,10);
         msgGlobal+=" points";
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfSteps);
     }
-    int pointPosition=-1;
+    qint64 pointPosition=-1;
     int step=0;
     int numberOfProcessedPoints=0;
     int numberOfProcessedPointsInStep=0;
@@ -1137,6 +1266,8 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     QMap<int,QMap<int,QFile*> > tilesPtrPointsFiles;
     QMap<int,QMap<int,QDataStream*> > tilesPtrPointsDataStreams;
     QMap<int,QMap<int,int> > tilesNop;
+    QMap<int,QMap<int,QVector<double> > > tilesStatistics;
+    QMap<int,QMap<int,QVector<qint64> > > tilesOriginalIndexRanges; // por tramo, primer indice en el fichero y numero de puntos
     while(lasreader->read_point())
     {
         double x=lasreader->point.get_X()*lasheader->x_scale_factor+lasheader->x_offset;
@@ -1149,10 +1280,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             step++;
             numberOfProcessedPointsInStep=0;
             if(numberOfSteps>1
-                    &&ptrWidget!=NULL)
+                    &&ptrProgress!=NULL)
             {
                 ptrProgress->setValue(step);
-                qApp->processEvents();
             }
         }
         bool includedPoint=true;
@@ -1255,12 +1385,16 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             QVector<quint8> auxClasses;
             tilesPointsClass[tileX][tileY]=auxClasses;
             tilesNop[tileX][tileY]=0;
+            tilesStatistics[tileX][tileY]=getEmptyTileStatistics();
         }
         else
         {
             tilePtrPointsDataStream=tilesPtrPointsDataStreams[tileX][tileY];
         }
         (*tilePtrPointsDataStream)<<ix<<iy<<z_pa<<z_pb<<z_pc;
+        QVector<double>& tileStatistics=tilesStatistics[tileX][tileY];
+        updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_Z_MIN,
+                             (z_pa*256+z_pb)*100+z_pc);
         if(existsColor)
         {
             quint16 color_r=lasreader->point.get_R();
@@ -1305,6 +1439,8 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
             (*tilePtrPointsDataStream)<<msb1;
             (*tilePtrPointsDataStream)<<msb2;
             (*tilePtrPointsDataStream)<<msb3;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MIN,
+                                 Point::getGpsTime(gpsDowHourPackit,msb1,msb2,msb3));
         }
         if(existsUserData)
         {
@@ -1315,6 +1451,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         {
             quint16 intensity=lasreader->point.get_intensity();
             (*tilePtrPointsDataStream)<<intensity;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MIN,intensity);
         }
         if(existsSourceId)
         {
@@ -1339,6 +1476,7 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         {
             quint8 returnNumber=lasreader->point.get_return_number();
             (*tilePtrPointsDataStream)<<returnNumber;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_RETURN_MIN,returnNumber);
         }
         if(existsReturns)
         {
@@ -1352,6 +1490,18 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         if(minY<mMinimumSc) mMinimumSc=minY;
         if(minZ<mMinimumTc) mMinimumTc=minZ;
         tilesPointsClass[tileX][tileY].push_back(pointClass);
+        QVector<qint64>& tileOriginalIndexRanges=tilesOriginalIndexRanges[tileX][tileY];
+        int numberOfRangesValues=tileOriginalIndexRanges.size();
+        if(numberOfRangesValues>0
+                &&tileOriginalIndexRanges[numberOfRangesValues-2]+tileOriginalIndexRanges[numberOfRangesValues-1]==pointPosition)
+        {
+            tileOriginalIndexRanges[numberOfRangesValues-1]++;
+        }
+        else
+        {
+            tileOriginalIndexRanges.push_back(pointPosition);
+            tileOriginalIndexRanges.push_back(1);
+        }
         tilesNumberOfPoints[tileX][tileY]=tilesNumberOfPoints[tileX][tileY]+1;
         tilesNop[tileX][tileY]=tilesNop[tileX][tileY]+1;
         mNumberOfPoints++;
@@ -1362,11 +1512,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
         }
     }
     if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+            &&ptrProgress!=NULL)
     {
         ptrProgress->setValue(numberOfSteps);
-        qApp->processEvents();
-        ptrProgress->close();
         delete(ptrProgress);
     }
     lasreader->close();
@@ -1503,7 +1651,16 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     outPointsClass<<exitsFields;
     outPointsClass<<tilesPointsClass;
     outPointsClass<<tilesPointsClassNewByPos;
+    outPointsClass<<tilesStatistics;
     pointsClassFile.close();
+    if(!writeOriginalIndexFile(originalIndexFileName,
+                               tilesOriginalIndexRanges,
+                               strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
     QMap<int,QMap<int,int> >::const_iterator iterTileX=tilesNumberOfPoints.begin();
     while(iterTileX!=tilesNumberOfPoints.end())
     {
@@ -1566,6 +1723,9 @@ bool PointCloudFile::addPointCloudFile(QString inputFileName,
     mZipFilePathPointsByIndex[fileIndex]=tilesPointsFileZipFilePath;
     mZipFilePointsByIndex[fileIndex]=tilesPointsFileZipFileName;
     mClassesFileByIndex[fileIndex]=pointsClassFileName;
+    mPointsIndexFileByIndex[fileIndex]=pointsIndexFileName;
+    mLevelsOfDetailFileByIndex[fileIndex]=levelsOfDetailFileName;
+    mOriginalIndexFileByIndex[fileIndex]=originalIndexFileName;
     if(updateHeader)
     {
         if(!writeHeader(strAuxError))
@@ -1585,6 +1745,14 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
                                         bool updateHeader,
                                         QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    if(isEditing()) // la incorporacion reescribe los ficheros de clases
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFiles");
+        strError+=QObject::tr("\nNot allowed while there is an edit session in progress");
+        return(false);
+    }
     QString strAuxError;
     bool useMultiProcess=mPtrPCFManager->getMultiProcess();
     if(!useMultiProcess)
@@ -1592,6 +1760,13 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         for(int nf=0;nf<inputFileNames.size();nf++)
         {
             QString inputFileName=inputFileNames[nf];
+            if(mPtrPCFManager->getCancellationToken().isCanceled()) // los ficheros ya anadidos se conservan
+            {
+                strError=QObject::tr("PointCloudFile::addPointCloudFiles");
+                strError+=QObject::tr("\nProcess canceled by user before adding file:\n%1")
+                        .arg(inputFileName);
+                return(false);
+            }
             if(!addPointCloudFile(inputFileName,
                                   pointCloudCrsDescription,
                                   pointCloudCrsEpsgCode,
@@ -1624,7 +1799,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         strError+=QObject::tr("\nTemporal path is empty");
         return(false);
     }
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
 //    if(mFilePtrGeometryByIndex.contains(inputFileName))
 //    {
 //        strError=QObject::tr("PointCloudFile::addPointCloudFiles");
@@ -1653,7 +1828,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFiles");
             strError+=QObject::tr("\nError adding tiles from ROIs:\n%1")
@@ -1697,7 +1872,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
             if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                        inputFileName,
                                         tilesNumberOfPoints,
-                                        ptrWidget,strAuxError))
+                                        ptrProgressCallback,strAuxError))
             {
                 strError=QObject::tr("PointCloudFile::addPointCloudFile");
                 strError+=QObject::tr("\nError adding tiles from file:\n%1\nError:\n%2")
@@ -1712,20 +1887,16 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
     }
 
     mUpdateHeader=updateHeader;
-    if(mPtrMpProgressDialog!=NULL)
+    if(mPtrMpProgress!=NULL)
     {
-        delete(mPtrMpProgressDialog);
+        delete(mPtrMpProgress);
     }
-    if(ptrWidget!=NULL)
-        mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-    else
-        mPtrMpProgressDialog=new QProgressDialog();
     //        mNumberOfSqlsInTransaction=0;
     mNumberOfFilesToProcess=inputFileNames.size();
     QString dialogText=QObject::tr("Adding point cloud files");
     dialogText+=QObject::tr("\nNumber of point cloud files to process:%1").arg(mNumberOfFilesToProcess);
     dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-    //                mPtrMpProgressDialog->setWindowTitle(title);
+    //                mPtrMpProgress->setWindowTitle(title);
     mNumberOfPointsToProcessByFileName.clear();
     for(int nf=0;nf<mNumberOfFilesToProcess;nf++)
     {
@@ -1734,28 +1905,24 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
                 .arg("All").arg(inputFileName);
         mNumberOfPointsToProcessByFileName[inputFileName]=-1;
     }
-    mPtrMpProgressDialog->setLabelText(dialogText);
-    mPtrMpProgressDialog->setModal(true);
-    QFutureWatcher<void> futureWatcher;
-    QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-    QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-    QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-    QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-    //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-    futureWatcher.setFuture(QtConcurrent::map(inputFileNames,
-                                              [this](QString& data)
-    {mpAddPointCloudFile(data);}));
-    // Display the dialog and start the event loop.
-    mStrErrorMpProgressDialog="";
-    mPtrMpProgressDialog->exec();
-    futureWatcher.waitForFinished();
-    delete(mPtrMpProgressDialog);
-    mPtrMpProgressDialog=NULL;
-    if(!mStrErrorMpProgressDialog.isEmpty())
+    mPtrMpProgress=mPtrPCFManager->getProgressCallback()->createProgress(QObject::tr("Adding point cloud files"),
+                                                                         dialogText,inputFileNames.size());
+    QFuture<void> future=QtConcurrent::map(inputFileNames,
+                                           [this](QString& data)
+    {mpAddPointCloudFile(data);});
+    bool finished=mPtrMpProgress->waitForFinished(future);
+    QString strMpError=mPtrMpProgress->getError();
+    if(!finished&&strMpError.isEmpty())
+    {
+        strMpError=QObject::tr("Process canceled by user");
+    }
+    delete(mPtrMpProgress);
+    mPtrMpProgress=NULL;
+    if(!finished)
     {
         strError=QObject::tr("PointCloudFile::addPointCloudFiles");
         strError+=QObject::tr("\nError adding point cloud files");
-        strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
+        strError+=QObject::tr("\nError:\n%1").arg(strMpError);
         return(false);
     }
     QVector<int> numberOfTilesToRemoveTileXs;
@@ -1817,6 +1984,14 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
                                         bool updateHeader,
                                         QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    if(isEditing()) // la incorporacion reescribe los ficheros de clases
+    {
+        strError=QObject::tr("PointCloudFile::addPointCloudFiles");
+        strError+=QObject::tr("\nNot allowed while there is an edit session in progress");
+        return(false);
+    }
     QString strAuxError;
     bool useMultiProcess=mPtrPCFManager->getMultiProcess();
     if(!useMultiProcess)
@@ -1824,6 +1999,13 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         for(int nf=0;nf<inputFileNames.size();nf++)
         {
             QString inputFileName=inputFileNames[nf];
+            if(mPtrPCFManager->getCancellationToken().isCanceled()) // los ficheros ya anadidos se conservan
+            {
+                strError=QObject::tr("PointCloudFile::addPointCloudFiles");
+                strError+=QObject::tr("\nProcess canceled by user before adding file:\n%1")
+                        .arg(inputFileName);
+                return(false);
+            }
             if(!addPointCloudFile(inputFileName,
                                   pointCloudCrsDescription,
                                   pointCloudCrsProj4String,
@@ -1853,7 +2035,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         strError+=QObject::tr("\nTemporal path is empty");
         return(false);
     }
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
 //    if(mFilePtrGeometryByIndex.contains(inputFileName))
 //    {
 //        strError=QObject::tr("PointCloudFile::addPointCloudFiles");
@@ -1882,7 +2064,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
         if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                    inputFileName,
                                     tilesNumberOfPoints,
-                                    ptrWidget,strAuxError))
+                                    ptrProgressCallback,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::addPointCloudFiles");
             strError+=QObject::tr("\nError adding tiles from ROIs:\n%1")
@@ -1926,7 +2108,7 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
             if(!addTilesFromBoundingBox(minX,minY,maxX,maxY,
 //                                        inputFileName,
                                         tilesNumberOfPoints,
-                                        ptrWidget,strAuxError))
+                                        ptrProgressCallback,strAuxError))
             {
                 strError=QObject::tr("PointCloudFile::addPointCloudFile");
                 strError+=QObject::tr("\nError adding tiles from file:\n%1\nError:\n%2")
@@ -1941,20 +2123,16 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
     }
 
     mUpdateHeader=updateHeader;
-    if(mPtrMpProgressDialog!=NULL)
+    if(mPtrMpProgress!=NULL)
     {
-        delete(mPtrMpProgressDialog);
+        delete(mPtrMpProgress);
     }
-    if(ptrWidget!=NULL)
-        mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-    else
-        mPtrMpProgressDialog=new QProgressDialog();
     //        mNumberOfSqlsInTransaction=0;
     mNumberOfFilesToProcess=inputFileNames.size();
     QString dialogText=QObject::tr("Adding point cloud files");
     dialogText+=QObject::tr("\nNumber of point cloud files to process:%1").arg(mNumberOfFilesToProcess);
     dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-    //                mPtrMpProgressDialog->setWindowTitle(title);
+    //                mPtrMpProgress->setWindowTitle(title);
     mNumberOfPointsToProcessByFileName.clear();
     for(int nf=0;nf<mNumberOfFilesToProcess;nf++)
     {
@@ -1963,28 +2141,24 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
                 .arg("All").arg(inputFileName);
         mNumberOfPointsToProcessByFileName[inputFileName]=-1;
     }
-    mPtrMpProgressDialog->setLabelText(dialogText);
-    mPtrMpProgressDialog->setModal(true);
-    QFutureWatcher<void> futureWatcher;
-    QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-    QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-    QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-    QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-    //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-    futureWatcher.setFuture(QtConcurrent::map(inputFileNames,
-                                              [this](QString& data)
-    {mpAddPointCloudFile(data);}));
-    // Display the dialog and start the event loop.
-    mStrErrorMpProgressDialog="";
-    mPtrMpProgressDialog->exec();
-    futureWatcher.waitForFinished();
-    delete(mPtrMpProgressDialog);
-    mPtrMpProgressDialog=NULL;
-    if(!mStrErrorMpProgressDialog.isEmpty())
+    mPtrMpProgress=mPtrPCFManager->getProgressCallback()->createProgress(QObject::tr("Adding point cloud files"),
+                                                                         dialogText,inputFileNames.size());
+    QFuture<void> future=QtConcurrent::map(inputFileNames,
+                                           [this](QString& data)
+    {mpAddPointCloudFile(data);});
+    bool finished=mPtrMpProgress->waitForFinished(future);
+    QString strMpError=mPtrMpProgress->getError();
+    if(!finished&&strMpError.isEmpty())
+    {
+        strMpError=QObject::tr("Process canceled by user");
+    }
+    delete(mPtrMpProgress);
+    mPtrMpProgress=NULL;
+    if(!finished)
     {
         strError=QObject::tr("PointCloudFile::addPointCloudFiles");
         strError+=QObject::tr("\nError adding point cloud files");
-        strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
+        strError+=QObject::tr("\nError:\n%1").arg(strMpError);
         return(false);
     }
     QVector<int> numberOfTilesToRemoveTileXs;
@@ -2039,9 +2213,25 @@ bool PointCloudFile::addPointCloudFiles(QVector<QString> &inputFileNames,
     return(true);
 }
 
+bool PointCloudFile::addEditLogCheckpoint(QString name,
+                                          QString &strError)
+{
+    QString strAuxError;
+    QMutexLocker locker(&mEditLogMutex);
+    if(!mEditLog.addCheckpoint(name,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::addEditLogCheckpoint");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
 bool PointCloudFile::addROIs(QMap<QString, OGRGeometry *> ptrROIsGeometryByRoiId,
                              QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
     QMap<QString, OGRGeometry *>::const_iterator iter=ptrROIsGeometryByRoiId.begin();
     while(iter!=ptrROIsGeometryByRoiId.end())
     {
@@ -2100,310 +2290,481 @@ bool PointCloudFile::addROIs(QMap<QString, OGRGeometry *> ptrROIsGeometryByRoiId
     return(true);
 }
 
-bool PointCloudFile::create(QString path,
-                            int crsEpsgCode,
-                            int verticalCrsEpsgCode,
-                            double gridSize,
-                            QString projectType,
-                            QString projectParametersString,
-                            QString &strError)
+bool PointCloudFile::beginEdit(QString &strError)
 {
-    QDir currentDir=QDir::currentPath();
-    if(currentDir.exists(path)
-            &&QDir(path).entryInfoList(QDir::NoDotAndDotDot|QDir::AllEntries).count() != 0)
-    {
-        strError=QObject::tr("PointCloudFile::create");
-        strError+=QObject::tr("\nYou must select an empty path:\n%1").arg(path);
-        return(false);
-    }
-    if(!currentDir.mkpath(path))
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditSessionMutex);
+    if(mEditSession)
     {
-        strError=QObject::tr("PointCloudFile::create");
-        strError+=QObject::tr("\nError making path:\n%1").arg(path);
+        strError=QObject::tr("PointCloudFile::beginEdit");
+        strError+=QObject::tr("\nThere is an edit session in progress");
         return(false);
     }
-    mPath=path;
-    mSRID=crsEpsgCode;
-    QString crsId=CRS_EPSG_AUTHORITY;
-    crsId+=":";
-    crsId+=QString::number(crsEpsgCode);
-    if(verticalCrsEpsgCode!=-1)
+    mEditSessionClassesFileByIndex.clear();
+    mEditSessionModifiedFileByIndex.clear();
+    mEditSession=true;
+    return(true);
+}
+
+bool PointCloudFile::buildLevelsOfDetail(bool rebuild,
+                                         QString &strError)
+{
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    // Un fichero .pcl por fichero de puntos con el submuestreo por voxel de cada tile en
+    // cada nivel y, en la entrada levels, el numero de puntos por nivel de cada tile para
+    // elegir el nivel de una consulta sin leer los tiles
+    QString strAuxError;
+    QVector<double> spacings=getLevelsOfDetailSpacings();
+    QVector<int> filesIndex;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+    while(iterFiles!=mTilesByFileIndex.end())
     {
-        crsId+="+";
-        crsId+=QString::number(verticalCrsEpsgCode);
+        int fileIndex=iterFiles.key();
+        iterFiles++;
+        QString levelsOfDetailFileName=mLevelsOfDetailFileByIndex.value(fileIndex);
+        if(levelsOfDetailFileName.isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::buildLevelsOfDetail");
+            strError+=QObject::tr("\nThere is no levels of detail file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        if(!rebuild&&QFile::exists(levelsOfDetailFileName)) continue;
+        filesIndex.push_back(fileIndex);
     }
-    QString strAuxError;
-    if(!mPtrCrsTools->isValidCrs(crsId,strAuxError))
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
+    Progress* ptrProgress=NULL;
+    int numberOfFiles=filesIndex.size();
+    if(ptrProgressCallback!=NULL&&numberOfFiles>1)
     {
-        strError=QObject::tr("PointCloudFile::create");
-        strError+=QObject::tr("\nInvalid CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
-        return(false);
+        QString title=QObject::tr("Building levels of detail for point cloud: ");
+        QString msgGlobal=mPath;
+        msgGlobal+="\n";
+        msgGlobal+=QString::number(numberOfFiles,10);
+        msgGlobal+=" number of files";
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfFiles);
     }
-    mCrsDescription=crsId;
-    if(verticalCrsEpsgCode!=-1)
+    for(int nf=0;nf<numberOfFiles;nf++)
     {
-        QString crsWkt;
-        if(!mPtrCrsTools->getWkt(crsId,crsWkt,strAuxError))
+        if(ptrProgress!=NULL)
         {
-            strError=QObject::tr("PointCloudFile::create");
-            strError+=QObject::tr("\nGetting WKT for CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
+            ptrProgress->setValue(nf+1);
+            if(ptrProgress->wasCanceled()) // los ficheros ya procesados conservan sus niveles
+            {
+                delete(ptrProgress);
+                strError=QObject::tr("PointCloudFile::buildLevelsOfDetail");
+                strError+=QObject::tr("\nProcess canceled by user");
+                return(false);
+            }
+        }
+        if(!buildFileLevelsOfDetail(filesIndex[nf],spacings,strAuxError))
+        {
+            if(ptrProgress!=NULL)
+            {
+                delete(ptrProgress);
+            }
+            strError=QObject::tr("PointCloudFile::buildLevelsOfDetail");
+            strError+=QObject::tr("\nError building levels of detail for file:\n%1\nError:\n%2")
+                    .arg(mZipFilePointsByIndex.value(filesIndex[nf])).arg(strAuxError);
             return(false);
         }
-        mCrsProj4String=crsWkt;
     }
-    else
+    if(ptrProgress!=NULL)
     {
-        QString crsProj4String;
-        if(!mPtrCrsTools->getProj4String(crsId,crsProj4String,strAuxError))
+        delete(ptrProgress);
+    }
+    return(true);
+}
+
+bool PointCloudFile::buildFileLevelsOfDetail(int fileIndex,
+                                             const QVector<double> &spacings,
+                                             QString &strError)
+{
+    QString strAuxError;
+    QString levelsOfDetailFileName=mLevelsOfDetailFileByIndex.value(fileIndex);
+    if(QFile::exists(levelsOfDetailFileName))
+    {
+        if(!QFile::remove(levelsOfDetailFileName))
         {
-            strError=QObject::tr("PointCloudFile::create");
-            strError+=QObject::tr("\nGetting proj4 string for CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
+            strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(levelsOfDetailFileName);
             return(false);
         }
-        mCrsProj4String=crsProj4String;
     }
-    mHeightType=QString::number(verticalCrsEpsgCode);
-    mVerticalCrsEpsgCode=verticalCrsEpsgCode;
-    mGridSize=gridSize;
-    mProjectType=projectType;
-    mParameterValueByCode.clear();
-    QStringList projectParametersList=projectParametersString.split(POINTCLOUDFILE_PROJECT_PARAMETERS_FILE_PARAMETERS_STRING_SEPARATOR);
-    for(int np=0;np<projectParametersList.size();np++)
+    const QMap<int,QVector<int> > tiles=mTilesByFileIndex.value(fileIndex);
+    PointsQuery pointsQuery;
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    QMap<QString,bool> existsFields;
+    if(!readQueryClassesFile(pointsQuery,
+                             fileIndex,
+                             tiles,
+                             existsFields,
+                             strAuxError))
     {
-        QString projectParameterString=projectParametersList.at(np);
-        QStringList projectParameterList=projectParameterString.split(POINTCLOUDFILE_PROJECT_PARAMETERS_FILE_PARAMETER_VALUE_STRING_SEPARATOR);
-        if(projectParameterList.size()!=2)
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+        return(false);
+    }
+    // las entradas se escriben en un directorio temporal que se comprime, como los tiles
+    QString levelsOfDetailPath=mZipFilePathPointsByIndex.value(fileIndex)+"_"+POINTCLOUDFILE_PCL_SUFFIX;
+    QDir currentDir=QDir::currentPath();
+    if(currentDir.exists(levelsOfDetailPath))
+    {
+        if(!removeDir(levelsOfDetailPath))
         {
-            strError=QObject::tr("PointCloudFile::create");
-            strError+=QObject::tr("\nInvalid parameters string:\n%1")
-                    .arg(projectParameterString);
+            strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+            strError+=QObject::tr("\nError removing existing dir:\n%1")
+                    .arg(levelsOfDetailPath);
             return(false);
         }
-        QString parameterCode=projectParameterList.at(0).trimmed();
-        QString parameterValue=projectParameterList.at(1).trimmed().toLower();
-        mParameterValueByCode[parameterCode]=parameterValue;
-        if(parameterCode.compare(POINTCLOUDFILE_PARAMETER_COLOR_BYTES,Qt::CaseInsensitive)==0)
-        {
-            bool okToInt=false;
-            int intValue=parameterValue.toInt(&okToInt);
-            if(!okToInt)
-            {
-                strError=QObject::tr("PointCloudFile::create");
-                strError+=QObject::tr("\nParameter %1 value is not an integer: %2")
-                        .arg(parameterCode).arg(parameterValue);
+    }
+    if(!currentDir.mkpath(levelsOfDetailPath))
+    {
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError making dir:\n%1")
+                .arg(levelsOfDetailPath);
+        return(false);
+    }
+    QVector<int> voxelSizes(spacings.size());
+    for(int level=0;level<spacings.size();level++)
+    {
+        voxelSizes[level]=qRound(spacings[level]*1000.);
+    }
+    QuaZip zipFilePoints(mZipFilePointsByIndex.value(fileIndex));
+    if(!zipFilePoints.open(QuaZip::mdUnzip))
+    {
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
+                .arg(mZipFilePointsByIndex.value(fileIndex))
+                .arg(QString::number(zipFilePoints.getZipError()));
+        removeDir(levelsOfDetailPath);
+        return(false);
+    }
+    QMap<int,QMap<int,QVector<int> > > tilesLevelsNumberOfPoints;
+    QMap<int,QVector<int> >::const_iterator iterTileX=tiles.begin();
+    while(iterTileX!=tiles.end())
+    {
+        int tileX=iterTileX.key();
+        for(int i=0;i<iterTileX.value().size();i++)
+        {
+            int tileY=iterTileX.value()[i];
+            QVector<QByteArray> levelsData;
+            QVector<int> levelsNumberOfPoints;
+            if(!pointsQuery.getTileLevelsOfDetail(zipFilePoints,
+                                                  fileIndex,
+                                                  tileX,
+                                                  tileY,
+                                                  voxelSizes,
+                                                  levelsData,
+                                                  levelsNumberOfPoints,
+                                                  strAuxError))
+            {
+                zipFilePoints.close();
+                removeDir(levelsOfDetailPath);
+                strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+                strError+=QObject::tr("\nError subsampling tile X: %1 tile Y: %2\nError:\n%3")
+                        .arg(QString::number(tileX)).arg(QString::number(tileY)).arg(strAuxError);
                 return(false);
             }
-            mNumberOfColorBytes=intValue;
-            continue;
-        }
-        QMap<QString,bool>::const_iterator iterStoredFields=mStoredFields.begin();
-        while(iterStoredFields!=mStoredFields.end())
-        {
-            QString storeField=iterStoredFields.key();
-            if(parameterCode.compare(storeField,Qt::CaseInsensitive)==0)
+            for(int level=0;level<levelsData.size();level++)
             {
-                if(parameterValue.compare("false",Qt::CaseInsensitive)==0
-                    ||parameterValue.compare("falso",Qt::CaseInsensitive)==0)
-                {
-                    mStoredFields[storeField]=false;
-                }
-                else if(parameterValue.compare("true",Qt::CaseInsensitive)==0
-                        ||parameterValue.compare("verdadero",Qt::CaseInsensitive)==0)
+                QString levelFileName=levelsOfDetailPath+"/"+PointsQuery::getTileLevelOfDetailEntryName(tileX,tileY,level);
+                QFile levelFile(levelFileName);
+                if(!levelFile.open(QIODevice::WriteOnly)
+                        ||levelFile.write(levelsData[level])!=levelsData[level].size())
                 {
-                    mStoredFields[storeField]=true;
+                    zipFilePoints.close();
+                    removeDir(levelsOfDetailPath);
+                    strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+                    strError+=QObject::tr("\nError writing file:\n%1").arg(levelFileName);
+                    return(false);
                 }
-                break;
+                levelFile.close();
             }
-            iterStoredFields++;
+            tilesLevelsNumberOfPoints[tileX][tileY]=levelsNumberOfPoints;
         }
+        iterTileX++;
     }
-    if(!writeHeader(strAuxError))
+    zipFilePoints.close();
+    QString levelsFileName=levelsOfDetailPath+"/"+POINTCLOUDFILE_LOD_LEVELS_ENTRY_NAME;
+    QFile levelsFile(levelsFileName);
+    if(!levelsFile.open(QIODevice::WriteOnly))
     {
-        strError=QObject::tr("PointCloudFile::create");
-        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        removeDir(levelsOfDetailPath);
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(levelsFileName);
+        return(false);
+    }
+    QDataStream out(&levelsFile);
+    out<<spacings;
+    out<<tilesLevelsNumberOfPoints;
+    levelsFile.close();
+    if(!JlCompress::compressDir(levelsOfDetailFileName,
+                                levelsOfDetailPath))
+    {
+        removeDir(levelsOfDetailPath);
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError compressing directory:\n%1")
+                .arg(levelsOfDetailPath);
+        return(false);
+    }
+    if(!removeDir(levelsOfDetailPath))
+    {
+        strError=QObject::tr("PointCloudFile::buildFileLevelsOfDetail");
+        strError+=QObject::tr("\nError removing directory:\n%1")
+                .arg(levelsOfDetailPath);
         return(false);
     }
     return(true);
 }
 
-bool PointCloudFile::addTilesFromBoundingBox(int minX,
-                                             int minY,
-                                             int maxX,
-                                             int maxY,
-//                                             QString inputFileName,
-                                             QMap<int, QMap<int, int> > &tilesNumberOfPoints,
-                                             QWidget *ptrWidget,
-                                             QString &strError)
+bool PointCloudFile::buildPointsIndex(bool rebuild,
+                                      QString &strError)
 {
-    tilesNumberOfPoints.clear();
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    // Un fichero .pci por fichero de puntos con la permutacion del kd-tree 2D de cada tile,
+    // que getNeighbors lee en lugar de construirlo en cada consulta
     QString strAuxError;
-    QProgressDialog* ptrProgress=NULL;
-    int tilesByStep=POINTCLOUDFILE_NUMBER_OF_TILES_TO_PROCESS_BY_STEP;
-    int numberOfTiles=(floor((maxX-minX)/mGridSize)+1)*(floor((maxY-minY)/mGridSize)+1);
-    int numberOfSteps=ceil((double)numberOfTiles/(double)tilesByStep);
-    if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+    QVector<int> filesIndex;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+    while(iterFiles!=mTilesByFileIndex.end())
     {
-        QString title=QObject::tr("Adding tiles:");
-//        QString msgGlobal=inputFileName;
-//        msgGlobal+="\n";
-        QString msgGlobal=QString::number(numberOfTiles,10);
-        msgGlobal+=" number of tiles";
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        int fileIndex=iterFiles.key();
+        iterFiles++;
+        QString pointsIndexFileName=mPointsIndexFileByIndex.value(fileIndex);
+        if(pointsIndexFileName.isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::buildPointsIndex");
+            strError+=QObject::tr("\nThere is no points index file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        if(!rebuild&&QFile::exists(pointsIndexFileName)) continue;
+        filesIndex.push_back(fileIndex);
     }
-    int step=0;
-    int numberOfProcessedTiless=0;
-    int numberOfProcessedTilesInStep=0;
-    int tileX=qRound(floor(floor(minX)/mGridSize)*mGridSize);
-    while(tileX<=(maxX+mGridSize))
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
+    Progress* ptrProgress=NULL;
+    int numberOfFiles=filesIndex.size();
+    if(ptrProgressCallback!=NULL&&numberOfFiles>1)
     {
-        int tileY=qRound(floor(floor(minY)/mGridSize)*mGridSize);
-        while(tileY<=(maxY+mGridSize))
+        QString title=QObject::tr("Building points index for point cloud: ");
+        QString msgGlobal=mPath;
+        msgGlobal+="\n";
+        msgGlobal+=QString::number(numberOfFiles,10);
+        msgGlobal+=" number of files";
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfFiles);
+    }
+    for(int nf=0;nf<numberOfFiles;nf++)
+    {
+        if(ptrProgress!=NULL)
         {
-            bool existsTile=false;
-            if(mTilesName.contains(tileX))
-            {
-                if(mTilesName[tileX].contains(tileY))
-                {
-                    existsTile=true;
-                }
-            }
-            if(!existsTile)
+            ptrProgress->setValue(nf+1);
+            if(ptrProgress->wasCanceled()) // los ficheros ya procesados conservan su indice
             {
-                bool addedTile=false;
-                if(!addTileTable(tileX,tileY,addedTile,strAuxError))
-                {
-                    strError=QObject::tr("PointCloudFile::addTilesFromBoundingBox");
-                    strError+=QObject::tr("Error creating Tile table: %1 % 2\nError:\n%3")
-                            .arg(QString::number(tileX)).arg(QString::number(tileY)).arg(strAuxError);
-                    return(false);
-                }
-                if(addedTile)
-                {
-                    tilesNumberOfPoints[tileX][tileY]=0;
-                }
+                delete(ptrProgress);
+                strError=QObject::tr("PointCloudFile::buildPointsIndex");
+                strError+=QObject::tr("\nProcess canceled by user");
+                return(false);
             }
-            tileY+=mGridSize;
-            numberOfProcessedTilesInStep++;
-            numberOfProcessedTiless++;
-            if(numberOfProcessedTilesInStep==POINTCLOUDFILE_NUMBER_OF_TILES_TO_PROCESS_BY_STEP)
+        }
+        if(!buildFilePointsIndex(filesIndex[nf],strAuxError))
+        {
+            if(ptrProgress!=NULL)
             {
-                step++;
-                if(numberOfSteps>1
-                        &&ptrWidget!=NULL)
-                {
-                    ptrProgress->setValue(step);
-                    qApp->processEvents();
-                }
-                numberOfProcessedTilesInStep=0;
+                delete(ptrProgress);
             }
+            strError=QObject::tr("PointCloudFile::buildPointsIndex");
+            strError+=QObject::tr("\nError building points index for file:\n%1\nError:\n%2")
+                    .arg(mZipFilePointsByIndex.value(filesIndex[nf])).arg(strAuxError);
+            return(false);
         }
-        tileX+=mGridSize;
     }
-    if(numberOfSteps>1
-            &&ptrWidget!=NULL)
+    if(ptrProgress!=NULL)
     {
-        ptrProgress->setValue(numberOfSteps);
-        qApp->processEvents();
-        ptrProgress->close();
         delete(ptrProgress);
     }
     return(true);
 }
 
-bool PointCloudFile::addTileTable(int tileX,
-                                  int tileY,
-                                  bool& added,
-                                  QString &strError)
+bool PointCloudFile::buildFilePointsIndex(int fileIndex,
+                                          QString &strError)
 {
-    bool existsTile=false;
-    if(mTilesName.contains(tileX))
+    QString strAuxError;
+    QString pointsIndexFileName=mPointsIndexFileByIndex.value(fileIndex);
+    if(QFile::exists(pointsIndexFileName))
     {
-        if(mTilesName[tileX].contains(tileY))
+        if(!QFile::remove(pointsIndexFileName))
         {
-            existsTile=true;
+            strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(pointsIndexFileName);
+            return(false);
         }
     }
-    if(existsTile)
+    const QMap<int,QVector<int> > tiles=mTilesByFileIndex.value(fileIndex);
+    PointsQuery pointsQuery;
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    QMap<QString,bool> existsFields;
+    if(!readQueryClassesFile(pointsQuery,
+                             fileIndex,
+                             tiles,
+                             existsFields,
+                             strAuxError))
     {
-        return(true);
+        strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+        strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+        return(false);
     }
-
-    QString tileTableName="tile_"+QString::number(tileX)+"_"+QString::number(tileY);
-    QString wktGeometry="POLYGON((";
-    wktGeometry+=QString::number(tileX);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(tileY);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(tileX);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(qRound(tileY+mGridSize),'f',0);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(qRound(tileX+mGridSize),'f',0);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(qRound(tileY+mGridSize),'f',0);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(qRound(tileX+mGridSize),'f',0);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(tileY);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(tileX);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(tileY);
-    wktGeometry+="))";
-    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
-    char *charsWktGeometry = byteArrayWktGeometry.data();
-    OGRGeometry* ptrGeometry;
-    ptrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
-    if(OGRERR_NONE!=ptrGeometry->importFromWkt(&charsWktGeometry))
+    QuaZip zipFilePoints(mZipFilePointsByIndex.value(fileIndex));
+    if(!zipFilePoints.open(QuaZip::mdUnzip))
     {
-        strError=QObject::tr("PointCloudFile::addTileTable");
-        strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
+        strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+        strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
+                .arg(mZipFilePointsByIndex.value(fileIndex))
+                .arg(QString::number(zipFilePoints.getZipError()));
         return(false);
     }
-    added=true;
-    if(mPtrROIsUnion!=NULL)
+    QMap<int,QMap<int,QVector<int> > > tilesPositions;
+    QMap<int,QVector<int> >::const_iterator iterTileX=tiles.begin();
+    while(iterTileX!=tiles.end())
     {
-        added=false;
-        if(mPtrROIsUnion->Contains(ptrGeometry))
-        {
-            added=true;
-            mTilesContainedInROIs[tileX][tileY]=true;
-            mTilesOverlapsWithROIs[tileX][tileY]=false;
-        }
-        else if(mPtrROIsUnion->Overlaps(ptrGeometry))
-        {
-            added=true;
-            mTilesContainedInROIs[tileX][tileY]=false;
-            mTilesOverlapsWithROIs[tileX][tileY]=true;
+        int tileX=iterTileX.key();
+        for(int i=0;i<iterTileX.value().size();i++)
+        {
+            int tileY=iterTileX.value()[i];
+            QVector<Point> pointsInTile;
+            if(!pointsQuery.readTilePoints(zipFilePoints,
+                                           fileIndex,
+                                           tileX,
+                                           tileY,
+                                           pointsInTile,
+                                           strAuxError))
+            {
+                zipFilePoints.close();
+                strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+                strError+=QObject::tr("\nError reading tile X: %1 tile Y: %2\nError:\n%3")
+                        .arg(QString::number(tileX)).arg(QString::number(tileY)).arg(strAuxError);
+                return(false);
+            }
+            // mismas coordenadas que las celdas de getNeighbors
+            QVector<double> coordinates(2*pointsInTile.size());
+            for(int np=0;np<pointsInTile.size();np++)
+            {
+                coordinates[2*np]=tileX+pointsInTile[np].getIx()/1000.;
+                coordinates[2*np+1]=tileY+pointsInTile[np].getIy()/1000.;
+            }
+            PointsIndex pointsIndex;
+            if(!pointsIndex.build(coordinates,2,strAuxError))
+            {
+                zipFilePoints.close();
+                strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+                strError+=QObject::tr("\nError building index for tile X: %1 tile Y: %2\nError:\n%3")
+                        .arg(QString::number(tileX)).arg(QString::number(tileY)).arg(strAuxError);
+                return(false);
+            }
+            tilesPositions[tileX][tileY]=pointsIndex.getPositions();
         }
+        iterTileX++;
     }
-    if(!added)
+    zipFilePoints.close();
+    if(!writePointsIndexFile(fileIndex,tilesPositions,strAuxError))
     {
-        OGRGeometryFactory::destroyGeometry(ptrGeometry);
-        ptrGeometry=NULL;
-        return(true);
+        strError=QObject::tr("PointCloudFile::buildFilePointsIndex");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::checkpoint(QString &strError)
+{
+    QString strAuxError;
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditSessionMutex);
+    if(!mEditSession)
+    {
+        strError=QObject::tr("PointCloudFile::checkpoint");
+        strError+=QObject::tr("\nThere is not an edit session in progress");
+        return(false);
+    }
+    if(!writeEditSessionClassesFiles(strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::checkpoint");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::commit(QString &strError)
+{
+    // las consultas leen las copias de la sesion hasta que se cierra y despues los ficheros,
+    // con el mismo contenido
+    QString strAuxError;
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditSessionMutex);
+    if(!mEditSession)
+    {
+        strError=QObject::tr("PointCloudFile::commit");
+        strError+=QObject::tr("\nThere is not an edit session in progress");
+        return(false);
+    }
+    // si falla la sesion sigue abierta y los cambios no escritos se pueden reintentar
+    if(!writeEditSessionClassesFiles(strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::commit");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    mEditSessionClassesFileByIndex.clear();
+    mEditSessionModifiedFileByIndex.clear();
+    mEditSession=false;
+    return(true);
+}
+
+void PointCloudFile::clearEditLog()
+{
+    QMutexLocker locker(&mEditLogMutex);
+    mEditLog.clear();
+}
+
+bool PointCloudFile::countPointsInGeometry(QString wktGeometry,
+                                           int geometryCrsEpsgCode,
+                                           QString geometryCrsProj4String,
+                                           QVector<QString> &ignoreTilesTableName,
+                                           qint64 &numberOfPoints,
+                                           QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    QString strAuxError;
+    if(!getNumberOfPointsInGeometry(wktGeometry,
+                                    geometryCrsEpsgCode,
+                                    geometryCrsProj4String,
+                                    ignoreTilesTableName,
+                                    true,
+                                    numberOfPoints,
+                                    strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::countPointsInGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
-    mTilesName[tileX][tileY]=tileTableName;
-    mTilesGeometry[tileX][tileY]=ptrGeometry;
-    mTilesNumberOfPoints[tileX][tileY]=0;
     return(true);
 }
 
 bool PointCloudFile::create(QString path,
-                            QString dbCrsDescription,
-                            QString dbCrsProj4String,
-                            int dbCrsEpsgCode,
-                            QString heightType,
+                            int crsEpsgCode,
+                            int verticalCrsEpsgCode,
                             double gridSize,
                             QString projectType,
                             QString projectParametersString,
                             QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
     QDir currentDir=QDir::currentPath();
     if(currentDir.exists(path)
             &&QDir(path).entryInfoList(QDir::NoDotAndDotDot|QDir::AllEntries).count() != 0)
@@ -2419,10 +2780,47 @@ bool PointCloudFile::create(QString path,
         return(false);
     }
     mPath=path;
-    mSRID=dbCrsEpsgCode;
-    mCrsDescription=dbCrsDescription;
-    mCrsProj4String=dbCrsProj4String;
-    mHeightType=heightType;
+    mSRID=crsEpsgCode;
+    QString crsId=CRS_EPSG_AUTHORITY;
+    crsId+=":";
+    crsId+=QString::number(crsEpsgCode);
+    if(verticalCrsEpsgCode!=-1)
+    {
+        crsId+="+";
+        crsId+=QString::number(verticalCrsEpsgCode);
+    }
+    QString strAuxError;
+    if(!mPtrCrsTools->isValidCrs(crsId,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::create");
+        strError+=QObject::tr("\nInvalid CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
+        return(false);
+    }
+    mCrsDescription=crsId;
+    if(verticalCrsEpsgCode!=-1)
+    {
+        QString crsWkt;
+        if(!mPtrCrsTools->getWkt(crsId,crsWkt,strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::create");
+            strError+=QObject::tr("\nGetting WKT for CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
+            return(false);
+        }
+        mCrsProj4String=crsWkt;
+    }
+    else
+    {
+        QString crsProj4String;
+        if(!mPtrCrsTools->getProj4String(crsId,crsProj4String,strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::create");
+            strError+=QObject::tr("\nGetting proj4 string for CRS: %1\nError:\n%2").arg(crsId).arg(strAuxError);
+            return(false);
+        }
+        mCrsProj4String=crsProj4String;
+    }
+    mHeightType=QString::number(verticalCrsEpsgCode);
+    mVerticalCrsEpsgCode=verticalCrsEpsgCode;
     mGridSize=gridSize;
     mProjectType=projectType;
     mParameterValueByCode.clear();
@@ -2476,7 +2874,6 @@ bool PointCloudFile::create(QString path,
             iterStoredFields++;
         }
     }
-    QString strAuxError;
     if(!writeHeader(strAuxError))
     {
         strError=QObject::tr("PointCloudFile::create");
@@ -2486,17 +2883,377 @@ bool PointCloudFile::create(QString path,
     return(true);
 }
 
-bool PointCloudFile::exportLasFileFromWktGeometry(QString outputFileName,
-                                                  QString wktGeometry,
-                                                  int geometryCrsEpsgCode,
-                                                  QString geometryCrsProj4String,
-                                                  bool tilesFullGeometry,
-                                                  QString &strError)
+void PointCloudFile::addEditOperation(PointsEditOperation &editOperation)
 {
-    QString functionName="PointCloudFile::exportLasFileFromWktGeometry";
+    QMutexLocker locker(&mEditLogMutex);
+    mEditLog.addOperation(editOperation);
+}
+
+bool PointCloudFile::applyEditOperation(const PointsEditOperation &editOperation,
+                                        bool undo,
+                                        QString &strError)
+{
+    // Deshacer recorre los tramos al reves y deja la clase anterior, rehacer al derecho y deja
+    // la nueva; en los dos casos se elimina la clase editada si no existia en ese estado.
+    // Se escribe como updatePoints, en memoria si hay sesion de edicion
     QString strAuxError;
-    QString outputFileExtension=QFileInfo(outputFileName).suffix();
-//    outputFileExtension=outputFileExtension.toLower();
+    QMap<int,QVector<int> > runsByFileIndex;
+    for(int run=0;run<editOperation.getNumberOfRuns();run++)
+    {
+        runsByFileIndex[editOperation.getRunFileIndex(run)].push_back(run);
+    }
+    QVector<int> filesIndex=runsByFileIndex.keys().toVector();
+    const QMap<int,QVector<int> >& constRunsByFileIndex=runsByFileIndex;
+    auto updateFile=[&](int fileIndex,
+                        PointsClassesFile& classesFile,
+                        PointsEditOperation& fileEditOperation,
+                        bool& existsChanges,
+                        QString& strFileError)->bool
+    {
+        Q_UNUSED(fileEditOperation);
+        const QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+        const QVector<int> runs=constRunsByFileIndex.value(fileIndex);
+        for(int nr=0;nr<runs.size();nr++)
+        {
+            int run=undo?runs[runs.size()-1-nr]:runs[nr];
+            int tileX=editOperation.getRunTileX(run);
+            int tileY=editOperation.getRunTileY(run);
+            int firstPosition=editOperation.getRunFirstPosition(run);
+            int numberOfPoints=editOperation.getRunNumberOfPoints(run);
+            quint8 pointClassNew=undo?editOperation.getRunOldClass(run):editOperation.getRunNewClass(run);
+            bool removeClassNew=undo?!editOperation.getRunExistsOldClassNew(run):!editOperation.getRunExistsNewClassNew(run);
+            if(firstPosition+numberOfPoints>tilesPointsClass.value(tileX).value(tileY).size())
+            {
+                strFileError=QObject::tr("For file index: %1, not exists tile X: %2 tile Y: %3 position: %4")
+                        .arg(QString::number(fileIndex)).arg(QString::number(tileX))
+                        .arg(QString::number(tileY)).arg(QString::number(firstPosition+numberOfPoints-1));
+                return(false);
+            }
+            QMap<int,quint8>& tilePointsClassNewByPos=tilesPointsClassNewByPos[tileX][tileY];
+            for(int pos=firstPosition;pos<firstPosition+numberOfPoints;pos++)
+            {
+                if(removeClassNew)
+                {
+                    tilePointsClassNewByPos.remove(pos);
+                }
+                else
+                {
+                    tilePointsClassNewByPos[pos]=pointClassNew;
+                }
+            }
+        }
+        existsChanges=!runs.isEmpty();
+        return(true);
+    };
+    PointsEditOperation appliedEditOperation; // no se registra, el historial lo mueve el llamante
+    if(!updateClassesFiles(undo?QObject::tr("PointCloudFile::undo"):QObject::tr("PointCloudFile::redo"),
+                           filesIndex,
+                           updateFile,
+                           appliedEditOperation,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::applyEditOperation");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::addTilesFromBoundingBox(int minX,
+                                             int minY,
+                                             int maxX,
+                                             int maxY,
+//                                             QString inputFileName,
+                                             QMap<int, QMap<int, int> > &tilesNumberOfPoints,
+                                             ProgressCallback* ptrProgressCallback,
+                                             QString &strError)
+{
+    tilesNumberOfPoints.clear();
+    QString strAuxError;
+    Progress* ptrProgress=NULL;
+    int tilesByStep=POINTCLOUDFILE_NUMBER_OF_TILES_TO_PROCESS_BY_STEP;
+    int numberOfTiles=(floor((maxX-minX)/mGridSize)+1)*(floor((maxY-minY)/mGridSize)+1);
+    int numberOfSteps=ceil((double)numberOfTiles/(double)tilesByStep);
+    if(numberOfSteps>1
+            &&ptrProgressCallback!=NULL)
+    {
+        QString title=QObject::tr("Adding tiles:");
+//        QString msgGlobal=inputFileName;
+//        msgGlobal+="\n";
+        QString msgGlobal=QString::number(numberOfTiles,10);
+        msgGlobal+=" number of tiles";
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfSteps);
+    }
+    int step=0;
+    int numberOfProcessedTiless=0;
+    int numberOfProcessedTilesInStep=0;
+    int tileX=qRound(floor(floor(minX)/mGridSize)*mGridSize);
+    while(tileX<=(maxX+mGridSize))
+    {
+        int tileY=qRound(floor(floor(minY)/mGridSize)*mGridSize);
+        while(tileY<=(maxY+mGridSize))
+        {
+            bool existsTile=false;
+            if(mTilesName.contains(tileX))
+            {
+                if(mTilesName[tileX].contains(tileY))
+                {
+                    existsTile=true;
+                }
+            }
+            if(!existsTile)
+            {
+                bool addedTile=false;
+                if(!addTileTable(tileX,tileY,addedTile,strAuxError))
+                {
+                    strError=QObject::tr("PointCloudFile::addTilesFromBoundingBox");
+                    strError+=QObject::tr("Error creating Tile table: %1 % 2\nError:\n%3")
+                            .arg(QString::number(tileX)).arg(QString::number(tileY)).arg(strAuxError);
+                    return(false);
+                }
+                if(addedTile)
+                {
+                    tilesNumberOfPoints[tileX][tileY]=0;
+                }
+            }
+            tileY+=mGridSize;
+            numberOfProcessedTilesInStep++;
+            numberOfProcessedTiless++;
+            if(numberOfProcessedTilesInStep==POINTCLOUDFILE_NUMBER_OF_TILES_TO_PROCESS_BY_STEP)
+            {
+                step++;
+                if(numberOfSteps>1
+                        &&ptrProgress!=NULL)
+                {
+                    ptrProgress->setValue(step);
+                }
+                numberOfProcessedTilesInStep=0;
+            }
+        }
+        tileX+=mGridSize;
+    }
+    if(numberOfSteps>1
+            &&ptrProgress!=NULL)
+    {
+        ptrProgress->setValue(numberOfSteps);
+        delete(ptrProgress);
+    }
+    return(true);
+}
+
+bool PointCloudFile::addTileTable(int tileX,
+                                  int tileY,
+                                  bool& added,
+                                  QString &strError)
+{
+    bool existsTile=false;
+    if(mTilesName.contains(tileX))
+    {
+        if(mTilesName[tileX].contains(tileY))
+        {
+            existsTile=true;
+        }
+    }
+    if(existsTile)
+    {
+        return(true);
+    }
+
+    QString tileTableName="tile_"+QString::number(tileX)+"_"+QString::number(tileY);
+    QString wktGeometry="POLYGON((";
+    wktGeometry+=QString::number(tileX);
+    wktGeometry+=" ";
+    wktGeometry+=QString::number(tileY);
+    wktGeometry+=",";
+    wktGeometry+=QString::number(tileX);
+    wktGeometry+=" ";
+    wktGeometry+=QString::number(qRound(tileY+mGridSize),'f',0);
+    wktGeometry+=",";
+    wktGeometry+=QString::number(qRound(tileX+mGridSize),'f',0);
+    wktGeometry+=" ";
+    wktGeometry+=QString::number(qRound(tileY+mGridSize),'f',0);
+    wktGeometry+=",";
+    wktGeometry+=QString::number(qRound(tileX+mGridSize),'f',0);
+    wktGeometry+=" ";
+    wktGeometry+=QString::number(tileY);
+    wktGeometry+=",";
+    wktGeometry+=QString::number(tileX);
+    wktGeometry+=" ";
+    wktGeometry+=QString::number(tileY);
+    wktGeometry+="))";
+    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
+    char *charsWktGeometry = byteArrayWktGeometry.data();
+    OGRGeometry* ptrGeometry;
+    ptrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
+    if(OGRERR_NONE!=ptrGeometry->importFromWkt(&charsWktGeometry))
+    {
+        strError=QObject::tr("PointCloudFile::addTileTable");
+        strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
+        return(false);
+    }
+    added=true;
+    if(mPtrROIsUnion!=NULL)
+    {
+        added=false;
+        if(mPtrROIsUnion->Contains(ptrGeometry))
+        {
+            added=true;
+            mTilesContainedInROIs[tileX][tileY]=true;
+            mTilesOverlapsWithROIs[tileX][tileY]=false;
+        }
+        else if(mPtrROIsUnion->Overlaps(ptrGeometry))
+        {
+            added=true;
+            mTilesContainedInROIs[tileX][tileY]=false;
+            mTilesOverlapsWithROIs[tileX][tileY]=true;
+        }
+    }
+    if(!added)
+    {
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        ptrGeometry=NULL;
+        return(true);
+    }
+    mTilesName[tileX][tileY]=tileTableName;
+    mTilesGeometry[tileX][tileY]=ptrGeometry;
+    mTilesNumberOfPoints[tileX][tileY]=0;
+    return(true);
+}
+
+bool PointCloudFile::create(QString path,
+                            QString dbCrsDescription,
+                            QString dbCrsProj4String,
+                            int dbCrsEpsgCode,
+                            QString heightType,
+                            double gridSize,
+                            QString projectType,
+                            QString projectParametersString,
+                            QString &strError)
+{
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    QDir currentDir=QDir::currentPath();
+    if(currentDir.exists(path)
+            &&QDir(path).entryInfoList(QDir::NoDotAndDotDot|QDir::AllEntries).count() != 0)
+    {
+        strError=QObject::tr("PointCloudFile::create");
+        strError+=QObject::tr("\nYou must select an empty path:\n%1").arg(path);
+        return(false);
+    }
+    if(!currentDir.mkpath(path))
+    {
+        strError=QObject::tr("PointCloudFile::create");
+        strError+=QObject::tr("\nError making path:\n%1").arg(path);
+        return(false);
+    }
+    mPath=path;
+    mSRID=dbCrsEpsgCode;
+    mCrsDescription=dbCrsDescription;
+    mCrsProj4String=dbCrsProj4String;
+    mHeightType=heightType;
+    mGridSize=gridSize;
+    mProjectType=projectType;
+    mParameterValueByCode.clear();
+    QStringList projectParametersList=projectParametersString.split(POINTCLOUDFILE_PROJECT_PARAMETERS_FILE_PARAMETERS_STRING_SEPARATOR);
+    for(int np=0;np<projectParametersList.size();np++)
+    {
+        QString projectParameterString=projectParametersList.at(np);
+        QStringList projectParameterList=projectParameterString.split(POINTCLOUDFILE_PROJECT_PARAMETERS_FILE_PARAMETER_VALUE_STRING_SEPARATOR);
+        if(projectParameterList.size()!=2)
+        {
+            strError=QObject::tr("PointCloudFile::create");
+            strError+=QObject::tr("\nInvalid parameters string:\n%1")
+                    .arg(projectParameterString);
+            return(false);
+        }
+        QString parameterCode=projectParameterList.at(0).trimmed();
+        QString parameterValue=projectParameterList.at(1).trimmed().toLower();
+        mParameterValueByCode[parameterCode]=parameterValue;
+        if(parameterCode.compare(POINTCLOUDFILE_PARAMETER_COLOR_BYTES,Qt::CaseInsensitive)==0)
+        {
+            bool okToInt=false;
+            int intValue=parameterValue.toInt(&okToInt);
+            if(!okToInt)
+            {
+                strError=QObject::tr("PointCloudFile::create");
+                strError+=QObject::tr("\nParameter %1 value is not an integer: %2")
+                        .arg(parameterCode).arg(parameterValue);
+                return(false);
+            }
+            mNumberOfColorBytes=intValue;
+            continue;
+        }
+        QMap<QString,bool>::const_iterator iterStoredFields=mStoredFields.begin();
+        while(iterStoredFields!=mStoredFields.end())
+        {
+            QString storeField=iterStoredFields.key();
+            if(parameterCode.compare(storeField,Qt::CaseInsensitive)==0)
+            {
+                if(parameterValue.compare("false",Qt::CaseInsensitive)==0
+                    ||parameterValue.compare("falso",Qt::CaseInsensitive)==0)
+                {
+                    mStoredFields[storeField]=false;
+                }
+                else if(parameterValue.compare("true",Qt::CaseInsensitive)==0
+                        ||parameterValue.compare("verdadero",Qt::CaseInsensitive)==0)
+                {
+                    mStoredFields[storeField]=true;
+                }
+                break;
+            }
+            iterStoredFields++;
+        }
+    }
+    QString strAuxError;
+    if(!writeHeader(strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::create");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::estimatePointsInGeometry(QString wktGeometry,
+                                              int geometryCrsEpsgCode,
+                                              QString geometryCrsProj4String,
+                                              QVector<QString> &ignoreTilesTableName,
+                                              qint64 &numberOfPoints,
+                                              QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    QString strAuxError;
+    if(!getNumberOfPointsInGeometry(wktGeometry,
+                                    geometryCrsEpsgCode,
+                                    geometryCrsProj4String,
+                                    ignoreTilesTableName,
+                                    false,
+                                    numberOfPoints,
+                                    strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::estimatePointsInGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::exportLasFileFromWktGeometry(QString outputFileName,
+                                                  QString wktGeometry,
+                                                  int geometryCrsEpsgCode,
+                                                  QString geometryCrsProj4String,
+                                                  bool tilesFullGeometry,
+                                                  QString &strError)
+{
+    // Los tiles se leen en paralelo y se escriben en orden desde el hilo llamante, que tambien
+    // lee el siguiente tile si ningun hilo lo ha tomado. Los hilos no pasan de numberOfQueuedTiles
+    // tiles por delante del que se escribe, de modo que la memoria no depende de la geometria
+    QReadLocker dataLocker(&mDataLock);
+    QString functionName="PointCloudFile::exportLasFileFromWktGeometry";
+    QString strAuxError;
+    QString outputFileExtension=QFileInfo(outputFileName).suffix();
+//    outputFileExtension=outputFileExtension.toLower();
     if(outputFileExtension.compare("las",Qt::CaseInsensitive)!=0
             &&outputFileExtension.compare("laz",Qt::CaseInsensitive)!=0)
     {
@@ -2516,61 +3273,106 @@ bool PointCloudFile::exportLasFileFromWktGeometry(QString outputFileName,
         }
     }
     QMap<int,QMap<int,QString> > tilesTableName;
-    QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > pointsByTileByFileId;
-    QMap<int,QMap<QString,bool> > existsFieldsByFileId;
+    QMap<int,QMap<int,QVector<float> > > tilesPolygonEdges;
     QVector<QString> ignoreTilesTableName;
-    if(!getPointsFromWktGeometry(wktGeometry,
-                                 geometryCrsEpsgCode,
-                                 geometryCrsProj4String,
-                                 tilesTableName,
-                                 pointsByTileByFileId, //[fileId][tileX][tileY]
-                                 existsFieldsByFileId,
-                                 ignoreTilesTableName,
-                                 tilesFullGeometry,
-                                 strAuxError))
+    if(!getTilesPolygonEdgesFromWktGeometry(wktGeometry,
+                                            geometryCrsEpsgCode,
+                                            geometryCrsProj4String,
+                                            ignoreTilesTableName,
+                                            tilesFullGeometry,
+                                            tilesTableName,
+                                            tilesPolygonEdges,
+                                            strAuxError))
     {
         strError=functionName;
-//        strError+=QObject::tr("\nGetting points for geometry:\n%1\nError:\n%2")
-//                .arg(wktGeometry).arg(strAuxError);
-        strError+=QObject::tr("\nGetting points for geometry:\nError:\n%1")
+        strError+=QObject::tr("\nGetting tiles for geometry:\nError:\n%1")
                 .arg(strAuxError);
         return(false);
     }
+    PointsQuery pointsQuery;
+    pointsQuery.setTilesPolygonEdges(tilesPolygonEdges);
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    QMap<int,QMap<int,QVector<int> > > tilesByFileIndex;
+    QMap<int,QMap<int,QString> >::const_iterator iterX=tilesTableName.begin();
+    while(iterX!=tilesTableName.end())
+    {
+        int tileX=iterX.key();
+        QMap<int,QString>::const_iterator iterY=iterX.value().begin();
+        while(iterY!=iterX.value().end())
+        {
+            int tileY=iterY.key();
+            QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+            while(iterFiles!=mTilesByFileIndex.end())
+            {
+                int fileIndex=iterFiles.key();
+                const QMap<int,QVector<int> >& tilesInFile=iterFiles.value();
+                if(tilesInFile.contains(tileX))
+                {
+                    if(tilesInFile[tileX].indexOf(tileY)!=-1)
+                    {
+                        tilesByFileIndex[fileIndex][tileX].push_back(tileY);
+                    }
+                }
+                iterFiles++;
+            }
+            iterY++;
+        }
+        iterX++;
+    }
+    // tareas (fichero, tile) en el orden de escritura
+    bool existsRGB=false;
+    QVector<int> tasksFileIndex;
+    QVector<int> tasksTileX;
+    QVector<int> tasksTileY;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
+    while(iterFiles!=tilesByFileIndex.end())
+    {
+        int fileIndex=iterFiles.key();
+        if(!mClassesFileByIndex.contains(fileIndex))
+        {
+            strError=functionName;
+            strError+=QObject::tr("\nThere is no classes file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        if(!mZipFilePointsByIndex.contains(fileIndex))
+        {
+            strError=functionName;
+            strError+=QObject::tr("\nThere is no points file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        QMap<QString,bool> existsFields;
+        if(!readQueryClassesFile(pointsQuery,
+                                 fileIndex,
+                                 iterFiles.value(),
+                                 existsFields,
+                                 strAuxError))
+        {
+            strError=functionName;
+            strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+            return(false);
+        }
+        if(!existsRGB
+                &&existsFields.value(POINTCLOUDFILE_PARAMETER_COLOR))
+            existsRGB=true;
+        QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
+        while(iterTileX!=iterFiles.value().end())
+        {
+            int tileX=iterTileX.key();
+            for(int i=0;i<iterTileX.value().size();i++)
+            {
+                tasksFileIndex.push_back(fileIndex);
+                tasksTileX.push_back(tileX);
+                tasksTileY.push_back(iterTileX.value()[i]);
+            }
+            iterTileX++;
+        }
+        iterFiles++;
+    }
     double minFc=1000000000.0;
     double minSc=1000000000.0;
     double minTc=mMinimumTc;
-//    QMap<int,QMap<int,QMap<int,QVector<PCFile::Point> > > >::const_iterator iterFileId=pointsByTileByFileId.begin(); //[fileId][tileX][tileY]
-//    while(iterFileId!=pointsByTileByFileId.end())
-//    {
-//        int fileId=iterFileId.key();
-//        QMap<int,QMap<int,QVector<PCFile::Point> > > pointsByTileX=pointsByTileByFileId[fileId];
-//        QMap<int,QMap<int,QVector<PCFile::Point> > >::const_iterator iterPointsByTileX=pointsByTileX.begin();
-//        while(iterPointsByTileX!=pointsByTileX.end())
-//        {
-//            int tileX=iterPointsByTileX.key();
-//            QMap<int,QVector<PCFile::Point> > pointsByTileY=pointsByTileX[tileX];
-//            QMap<int,QVector<PCFile::Point> >::const_iterator iterPointsByTileY=pointsByTileY.begin();
-//            while(iterPointsByTileY!=pointsByTileY.end())
-//            {
-//                int tileY=iterPointsByTileY.key();
-//                QVector<PCFile::Point> pcFilePoints=pointsByTileY[tileY];
-//                for(int np=0;np<pcFilePoints.size();np++)
-//                {
-//                    int ix=pcFilePoints[np].getIx();
-//                    double fcDbl=tileX+ix/1000.;
-//                    if(fcDbl<minFc) minFc=fcDbl;
-//                    int iy=pcFilePoints[np].getIy();
-//                    double scDbl=tileY+iy/1000.;
-//                    if(scDbl<minSc) minSc=scDbl;
-//                    double altitude=pcFilePoints[np].getZ();
-//                    if(altitude<minTc) minTc=altitude;
-//                }
-//                iterPointsByTileY++;
-//            }
-//            iterPointsByTileX++;
-//        }
-//        iterFileId++;
-//    }
     QMap<int,QMap<int,QString> >::const_iterator iterTileX=tilesTableName.begin();
     while(iterTileX!=tilesTableName.end())
     {
@@ -2585,37 +3387,7 @@ bool PointCloudFile::exportLasFileFromWktGeometry(QString outputFileName,
         }
         iterTileX++;
     }
-    bool existsClassification=false;
-    bool existsRGB=false;
-    bool existsIntensity=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_COLOR]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_GPS_TIME]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_INTENSITY]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_NIR]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_RETURN]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_RETURNS]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_SOURCE_ID]=false;
-    //    existsFields[POINTCLOUDFILE_PARAMETER_USER_DATA]=false;
-    QMap<int,QMap<QString,bool> >::const_iterator iterExistsFields=existsFieldsByFileId.begin();
-    while(iterExistsFields!=existsFieldsByFileId.end())
-    {
-        int fileId=iterExistsFields.key();
-        QMap<QString,bool> existsFields=iterExistsFields.value();
-        if(!existsRGB
-                &&existsFields[POINTCLOUDFILE_PARAMETER_COLOR])
-            existsRGB=true;
-        if(!existsIntensity
-                &&existsIntensity[POINTCLOUDFILE_PARAMETER_INTENSITY])
-            existsIntensity=true;
-        iterExistsFields++;
-    }
-    float rGBColorToUnit=1.0;
     int colorNumberOfBytes=mNumberOfColorBytes;
-    if(existsRGB)
-    {
-        if(colorNumberOfBytes==1) rGBColorToUnit=1.0/255.0;
-        else if(colorNumberOfBytes==1) rGBColorToUnit=1.0/65535.0;
-    }
     LASwriteOpener laswriteopener;
     std::string ssLasFileName=outputFileName.toStdString();
     const char* ptrCClasFileName=ssLasFileName.c_str();
@@ -2647,112 +3419,264 @@ bool PointCloudFile::exportLasFileFromWktGeometry(QString outputFileName,
     LASwriter* laswriter = laswriteopener.open(&lasheader);
     if (laswriter == 0)
     {
-        strError=functionName;
-        strError+=QObject::tr("Error could not open laswriter for file:\n%1").arg(outputFileName);
+        strError=functionName;
+        strError+=QObject::tr("Error could not open laswriter for file:\n%1").arg(outputFileName);
+        return(false);
+    }
+    // lectura de un tile: coordenadas enteras del fichero de salida y colores, 3 valores por punto
+    auto readTile=[&](int task,
+                      QMap<int,QuaZip*>& ptrZipFilesByFileIndex, // un QuaZip por fichero y por hilo
+                      QVector<qint32>& coordinates,
+                      QVector<quint16>& colors,
+                      QString& strTaskError)
+    {
+        int fileIndex=tasksFileIndex[task];
+        int tileX=tasksTileX[task];
+        int tileY=tasksTileY[task];
+        if(!ptrZipFilesByFileIndex.contains(fileIndex))
+        {
+            QuaZip* ptrZipFile=new QuaZip(mZipFilePointsByIndex.value(fileIndex));
+            ptrZipFilesByFileIndex[fileIndex]=ptrZipFile;
+            if(!ptrZipFile->open(QuaZip::mdUnzip))
+            {
+                strTaskError=QObject::tr("Error opening file:\n%1\nError:\n%2")
+                        .arg(mZipFilePointsByIndex.value(fileIndex))
+                        .arg(QString::number(ptrZipFile->getZipError()));
+                return(false);
+            }
+        }
+        QVector<PCFile::Point> ptos;
+        if(!pointsQuery.readTilePoints(*ptrZipFilesByFileIndex.value(fileIndex),
+                                       fileIndex,
+                                       tileX,
+                                       tileY,
+                                       ptos,
+                                       strTaskError))
+        {
+            return(false);
+        }
+        coordinates.resize(3*ptos.size());
+        if(useRGBs)
+        {
+            colors.fill(0,3*ptos.size());
+        }
+        for(int np=0;np<ptos.size();np++)
+        {
+            PCFile::Point& pto=ptos[np];
+            int ix=pto.getIx();
+            double fcDbl=tileX+ix/1000.;
+            int iy=pto.getIy();
+            double scDbl=tileY+iy/1000.;
+            double tcDbl=pto.getZ();
+            coordinates[3*np]=(fcDbl-minFc)*1000;
+            coordinates[3*np+1]=(scDbl-minSc)*1000;
+            coordinates[3*np+2]=(tcDbl-minTc)*1000;
+            if(useRGBs)
+            {
+                if(colorNumberOfBytes==1)
+                {
+                    QMap<QString,quint8> values8bits;
+                    pto.get8BitsValues(values8bits);
+                    colors[3*np]=values8bits.value(POINTCLOUDFILE_PARAMETER_COLOR_RED)*256;
+                    colors[3*np+1]=values8bits.value(POINTCLOUDFILE_PARAMETER_COLOR_GREEN)*256;
+                    colors[3*np+2]=values8bits.value(POINTCLOUDFILE_PARAMETER_COLOR_BLUE)*256;
+                }
+                if(colorNumberOfBytes==2)
+                {
+                    QMap<QString,quint16> values16bits;
+                    pto.get16BitsValues(values16bits);
+                    colors[3*np]=values16bits.value(POINTCLOUDFILE_PARAMETER_COLOR_RED);
+                    colors[3*np+1]=values16bits.value(POINTCLOUDFILE_PARAMETER_COLOR_GREEN);
+                    colors[3*np+2]=values16bits.value(POINTCLOUDFILE_PARAMETER_COLOR_BLUE);
+                }
+            }
+        }
+        return(true);
+    };
+    auto closeZipFiles=[](QMap<int,QuaZip*>& ptrZipFilesByFileIndex)
+    {
+        QMap<int,QuaZip*>::iterator iterZipFiles=ptrZipFilesByFileIndex.begin();
+        while(iterZipFiles!=ptrZipFilesByFileIndex.end())
+        {
+            if(iterZipFiles.value()->isOpen()) iterZipFiles.value()->close();
+            delete(iterZipFiles.value());
+            iterZipFiles++;
+        }
+        ptrZipFilesByFileIndex.clear();
+    };
+    int numberOfTasks=tasksFileIndex.size();
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMax(1,qMin(QThread::idealThreadCount(),numberOfTasks));
+    }
+    int numberOfQueuedTiles=numberOfThreads*POINTCLOUDFILE_EXPORT_QUEUED_TILES_BY_THREAD;
+    QMutex queueMutex; // protege todo lo que sigue hasta los resultados
+    QWaitCondition tileReadCondition;
+    QWaitCondition tileWrittenCondition;
+    int nextTask=0;
+    int nextTaskToWrite=0;
+    bool canceled=false;
+    QString readError;
+    QMap<int,QVector<qint32> > coordinatesByTask;
+    QMap<int,QVector<quint16> > colorsByTask;
+    auto setReadError=[&](int task,QString strTaskError) // con queueMutex bloqueado
+    {
+        if(readError.isEmpty())
+        {
+            readError=QObject::tr("\nError recovering points from tile X: %1 tile Y: %2 in file:\n%3\nError:\n%4")
+                    .arg(QString::number(tasksTileX[task]))
+                    .arg(QString::number(tasksTileY[task]))
+                    .arg(mZipFilePointsByIndex.value(tasksFileIndex[task]))
+                    .arg(strTaskError);
+        }
+        canceled=true;
+        tileReadCondition.wakeAll();
+        tileWrittenCondition.wakeAll();
+    };
+    auto processTasks=[&]()
+    {
+        QMap<int,QuaZip*> ptrZipFilesByFileIndex;
+        while(true)
+        {
+            int task=-1;
+            {
+                QMutexLocker locker(&queueMutex);
+                while(!canceled
+                      &&nextTask<numberOfTasks
+                      &&nextTask>=nextTaskToWrite+numberOfQueuedTiles)
+                {
+                    tileWrittenCondition.wait(&queueMutex);
+                }
+                if(canceled||nextTask>=numberOfTasks) break;
+                task=nextTask;
+                nextTask++;
+            }
+            QVector<qint32> coordinates;
+            QVector<quint16> colors;
+            QString strTaskError;
+            bool success=readTile(task,ptrZipFilesByFileIndex,coordinates,colors,strTaskError);
+            QMutexLocker locker(&queueMutex);
+            if(!success)
+            {
+                setReadError(task,strTaskError);
+                break;
+            }
+            coordinatesByTask[task]=coordinates;
+            colorsByTask[task]=colors;
+            tileReadCondition.wakeAll();
+        }
+        closeZipFiles(ptrZipFilesByFileIndex);
+    };
+    Progress* ptrProgress=NULL;
+    if(numberOfTasks>1)
+    {
+        QString msgGlobal=QObject::tr("Writting points from %1 files and tiles")
+                .arg(QString::number(numberOfTasks));
+        ptrProgress=mPtrPCFManager->getProgressCallback()->createProgress(functionName,msgGlobal,numberOfTasks);
+    }
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
+    {
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks();}));
     }
-    QMap<int,QMap<int,QMap<int,QVector<PCFile::Point> > > >::const_iterator iterPtf=pointsByTileByFileId.begin(); //[fileId][tileX][tileY]
-    while(iterPtf!=pointsByTileByFileId.end())
+    QMap<int,QuaZip*> ptrZipFilesByFileIndex;
+    unsigned short rgb[3];
+    for(int task=0;task<numberOfTasks;task++)
     {
-        int fileId=iterPtf.key();
-        QMap<int,QMap<int,QVector<PCFile::Point> > >::const_iterator iterTileX=iterPtf.value().begin();
-        while(iterTileX!=iterPtf.value().end())
+        QVector<qint32> coordinates;
+        QVector<quint16> colors;
+        bool readByWriter=false;
         {
-            int tileX=iterTileX.key();
-            QMap<int,QVector<PCFile::Point> >::const_iterator iterTileY=iterTileX.value().begin();
-            while(iterTileY!=iterTileX.value().end())
+            QMutexLocker locker(&queueMutex);
+            while(!canceled
+                  &&!coordinatesByTask.contains(task)
+                  &&nextTask!=task)
             {
-                int tileY=iterTileY.key();
-                QVector<PCFile::Point> ptos=iterTileY.value();
-                for(int np=0;np<ptos.size();np++)
-                {
-                    PCFile::Point pto=ptos[np];
-                    int posInTile=pto.getPositionInTile();
-                    int ix=pto.getIx();
-                    double fcDbl=tileX+ix/1000.;
-                    int iy=pto.getIy();
-                    double scDbl=tileY+iy/1000.;
-                    double tcDbl=pto.getZ();
-                    int ptoClass=pto.getClass();
-                    if(!existsClassification&&ptoClass>0) existsClassification=true;
-                    int ptoNewClass=pto.getClassNew();
-                    QMap<QString,quint8> values8bits;
-                    pto.get8BitsValues(values8bits);
-                    QMap<QString,quint16> values16bits;
-                    pto.get16BitsValues(values16bits);
-                    double gpsTime=-1.;
-                    quint16 intensity=0.;
-                    if(existsFieldsByFileId[fileId][POINTCLOUDFILE_PARAMETER_GPS_TIME])
-                    {
-                        gpsTime=pto.getGpsTime();
-                    }
-                    unsigned short rgb[3];
-                    if(existsRGB)
-                    {
-                        if(colorNumberOfBytes==1)
-                        {
-                            if(values8bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_RED))
-                            {
-                                rgb[0]=values8bits[POINTCLOUDFILE_PARAMETER_COLOR_RED]*256;
-                            }
-                            if(values8bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_GREEN))
-                            {
-                                rgb[1]=values8bits[POINTCLOUDFILE_PARAMETER_COLOR_GREEN]*256;
-                            }
-                            if(values8bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_BLUE))
-                            {
-                                rgb[2]=values8bits[POINTCLOUDFILE_PARAMETER_COLOR_BLUE]*256;
-                            }
-                        }
-                        if(colorNumberOfBytes==2)
-                        {
-                            if(values16bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_RED))
-                            {
-                                rgb[0]=values16bits[POINTCLOUDFILE_PARAMETER_COLOR_RED];
-                            }
-                            if(values16bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_GREEN))
-                            {
-                                rgb[1]=values16bits[POINTCLOUDFILE_PARAMETER_COLOR_GREEN];
-                            }
-                            if(values16bits.contains(POINTCLOUDFILE_PARAMETER_COLOR_BLUE))
-                            {
-                                rgb[2]=values16bits[POINTCLOUDFILE_PARAMETER_COLOR_BLUE];
-                            }
-                        }
-                    }
-                    if(existsIntensity)
-                    {
-                        if(values16bits.contains(POINTCLOUDFILE_PARAMETER_INTENSITY))
-                        {
-                            intensity=values16bits[POINTCLOUDFILE_PARAMETER_INTENSITY];
-                        }
-                    }
-                    int x=(fcDbl-minFc)*1000;
-                    int y=(scDbl-minSc)*1000;
-                    int z=(tcDbl-minTc)*1000;
-                    laspoint.set_X(x);
-                    laspoint.set_Y(y);
-                    laspoint.set_Z(z);
-                    if(useRGBs)
-                    {
-                        laspoint.set_RGB(rgb);
-                    }
-            //        laspoint.set_intensity((U16)i);
-            //        laspoint.set_gps_time(0.0006*i);
-                    // write the point
-                    laswriter->write_point(&laspoint);
-                    // add it to the inventory
-                    laswriter->update_inventory(&laspoint);
-                }
-                iterTileY++;
+                tileReadCondition.wait(&queueMutex);
+            }
+            if(canceled) break;
+            if(coordinatesByTask.contains(task))
+            {
+                coordinates=coordinatesByTask.take(task);
+                colors=colorsByTask.take(task);
+            }
+            else
+            {
+                nextTask++;
+                readByWriter=true;
+            }
+        }
+        if(readByWriter)
+        {
+            QString strTaskError;
+            if(!readTile(task,ptrZipFilesByFileIndex,coordinates,colors,strTaskError))
+            {
+                QMutexLocker locker(&queueMutex);
+                setReadError(task,strTaskError);
+                break;
+            }
+        }
+        int numberOfPoints=coordinates.size()/3;
+        for(int np=0;np<numberOfPoints;np++)
+        {
+            laspoint.set_X(coordinates[3*np]);
+            laspoint.set_Y(coordinates[3*np+1]);
+            laspoint.set_Z(coordinates[3*np+2]);
+            if(useRGBs)
+            {
+                rgb[0]=colors[3*np];
+                rgb[1]=colors[3*np+1];
+                rgb[2]=colors[3*np+2];
+                laspoint.set_RGB(rgb);
+            }
+            // write the point
+            laswriter->write_point(&laspoint);
+            // add it to the inventory
+            laswriter->update_inventory(&laspoint);
+        }
+        QMutexLocker locker(&queueMutex);
+        nextTaskToWrite=task+1;
+        tileWrittenCondition.wakeAll();
+        if(ptrProgress!=NULL)
+        {
+            ptrProgress->setValue(task+1);
+            if(ptrProgress->wasCanceled())
+            {
+                readError=QObject::tr("\nProcess canceled by user");
+                canceled=true;
+                tileWrittenCondition.wakeAll();
+                break;
             }
-            iterTileX++;
         }
-        iterPtf++;
+    }
+    {
+        QMutexLocker locker(&queueMutex);
+        canceled=true;
+        tileWrittenCondition.wakeAll();
+    }
+    for(int nt=0;nt<futures.size();nt++)
+    {
+        futures[nt].waitForFinished();
+    }
+    closeZipFiles(ptrZipFilesByFileIndex);
+    if(ptrProgress!=NULL)
+    {
+        delete(ptrProgress);
+    }
+    if(!readError.isEmpty())
+    {
+        laswriter->close();
+        delete laswriter;
+        QFile::remove(outputFileName);
+        strError=functionName;
+        strError+=readError;
+        return(false);
     }
     // update the header
     laswriter->update_header(&lasheader, TRUE);
     // close the writer
-    I64 total_bytes = laswriter->close();
+    laswriter->close();
     delete laswriter;
     return(true);
 }
@@ -2770,6 +3694,9 @@ bool PointCloudFile::getNeighbors(QVector<double> point,
                                   QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
                                   QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
+    // Solo se decodifican los puntos de la caja de busqueda; para un unico punto la seleccion
+    // lineal de los mas cercanos cuesta menos que construir un kd-tree sobre ellos
     QString functionName="PointCloudFile::getNeighbors";
     QString strAuxError;
     points.clear();
@@ -2784,396 +3711,693 @@ bool PointCloudFile::getNeighbors(QVector<double> point,
         strError+=QObject::tr("\nPoint must be two or three coordinates");
         return(false);
     }
-    bool useAltitude=false;
-    if(point.size()==3) useAltitude=true;
-    if(pointCrsEpsgCode!=-1)
+    bool useAltitude=false;
+    if(point.size()==3) useAltitude=true;
+    QVector<QVector<double> > auxPoints;
+    auxPoints.push_back(point);
+    if(!transformPointsToProjectCrs(auxPoints,
+                                    pointCrsEpsgCode,
+                                    pointCrsProj4String,
+                                    strAuxError))
+    {
+        strError=functionName;
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    point=auxPoints[0];
+    if(searchRadius2d<=0)
+    {
+        searchRadius2d=1.0/sqrt(mMaximumDensity)*POINTCLOUDFILE_SEARCHRADIUS_SQRT_MAXIMUM_DENSITY_FACTOR;
+    }
+    // supongo que el CRS del punto es proyectado
+    QMap<int, QMap<int, QString> > tilesTableName;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > > pointsByTileByFileId;
+    if(!getPointsInBox(point[0]-searchRadius2d,
+                       point[1]-searchRadius2d,
+                       point[0]+searchRadius2d,
+                       point[1]+searchRadius2d,
+                       tilesTableName,
+                       pointsByTileByFileId,
+                       existsFieldsByFileId,
+                       strAuxError))
+    {
+        strError=functionName;
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    QVector<QPair<double,int> > candidates; // distancia al cuadrado, posicion en los vectores siguientes
+    QVector<Point> candidatesPoints;
+    QVector<int> candidatesTileX;
+    QVector<int> candidatesTileY;
+    QVector<int> candidatesFileId;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > >::const_iterator iterFiles=pointsByTileByFileId.begin(); //[fileId][tileX][tileY]
+    while(iterFiles!=pointsByTileByFileId.end())
+    {
+        int fileId=iterFiles.key();
+        QMap<int, QMap<int, QVector<Point> > >::const_iterator iterX=iterFiles.value().begin();
+        while(iterX!=iterFiles.value().end())
+        {
+            int tileX=iterX.key();
+            QMap<int, QVector<Point> >::const_iterator iterY=iterX.value().begin();
+            while(iterY!=iterX.value().end())
+            {
+                int tileY=iterY.key();
+                QVector<Point> vPoints=iterY.value();
+                for(int np=0;np<vPoints.size();np++)
+                {
+                    double dx=tileX+vPoints[np].getIx()/1000.-point[0];
+                    double dy=tileY+vPoints[np].getIy()/1000.-point[1];
+                    double squaredDistance=dx*dx+dy*dy;
+                    if(useAltitude)
+                    {
+                        double dz=vPoints[np].getZ()-point[2];
+                        squaredDistance+=dz*dz;
+                    }
+                    candidates.push_back(qMakePair(squaredDistance,candidatesPoints.size()));
+                    candidatesPoints.push_back(vPoints[np]);
+                    candidatesTileX.push_back(tileX);
+                    candidatesTileY.push_back(tileY);
+                    candidatesFileId.push_back(fileId);
+                }
+                iterY++;
+            }
+            iterX++;
+        }
+        iterFiles++;
+    }
+    int k=numberOfNeighbors;
+    if(k<=0||k>candidates.size()) k=candidates.size();
+    std::partial_sort(candidates.begin(),candidates.begin()+k,candidates.end());
+    for(int nn=0;nn<k;nn++)
+    {
+        int position=candidates[nn].second;
+        points.push_back(candidatesPoints[position]);
+        tilesX.push_back(candidatesTileX[position]);
+        tilesY.push_back(candidatesTileY[position]);
+        distances.push_back(sqrt(candidates[nn].first));
+        fileIdPoints.push_back(candidatesFileId[position]);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getNeighbors(QVector<QVector<double> > pointsToSearch,
+                                  int pointCrsEpsgCode,
+                                  QString pointCrsProj4String,
+                                  double searchRadius2d,
+                                  int numberOfNeighbors,
+                                  QVector<QVector<Point> > &pointsByPointToSearch,
+                                  QVector<QVector<int> > &tilesXByPointToSearch,
+                                  QVector<QVector<int> > &tilesYByPointToSearch,
+                                  QVector<QVector<double> > &distancesByPointToSearch,
+                                  QVector<QVector<int> > &fileIdPointsByPointToSearch,
+                                  QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                  QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    // Una sola transformacion de CRS y una sola lectura de cada tile para todos los puntos,
+    // un kd-tree 2D por tile y las busquedas de los puntos en paralelo
+    QString functionName="PointCloudFile::getNeighbors";
+    QString strAuxError;
+    pointsByPointToSearch.clear();
+    tilesXByPointToSearch.clear();
+    tilesYByPointToSearch.clear();
+    distancesByPointToSearch.clear();
+    fileIdPointsByPointToSearch.clear();
+    existsFieldsByFileId.clear();
+    int numberOfPointsToSearch=pointsToSearch.size();
+    if(numberOfPointsToSearch==0)
+    {
+        return(true);
+    }
+    int dimension=pointsToSearch[0].size();
+    for(int np=0;np<numberOfPointsToSearch;np++)
+    {
+        if(pointsToSearch[np].size()<2||pointsToSearch[np].size()>3
+                ||pointsToSearch[np].size()!=dimension)
+        {
+            strError=functionName;
+            strError+=QObject::tr("\nAll points must be two or three coordinates, and the same for all of them");
+            return(false);
+        }
+    }
+    bool useAltitude=false;
+    if(dimension==3) useAltitude=true;
+    if(!transformPointsToProjectCrs(pointsToSearch,
+                                    pointCrsEpsgCode,
+                                    pointCrsProj4String,
+                                    strAuxError))
+    {
+        strError=functionName;
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(searchRadius2d<=0)
+    {
+        searchRadius2d=1.0/sqrt(mMaximumDensity)*POINTCLOUDFILE_SEARCHRADIUS_SQRT_MAXIMUM_DENSITY_FACTOR;
+    }
+    // tiles de cada punto. Se leen completos porque el kd-tree de cada fichero y tile guardado
+    // con buildPointsIndex es sobre todos sus puntos; sin el se construye solo para la consulta
+    int gridSize=qRound(mGridSize);
+    QMap<int,QMap<int,QString> > tilesTableName;
+    QVector<QVector<QPair<int,int> > > tilesByPointToSearch(numberOfPointsToSearch);
+    for(int np=0;np<numberOfPointsToSearch;np++)
+    {
+        int minTileX=getTileCoordinate(pointsToSearch[np][0]-searchRadius2d);
+        int maxTileX=getTileCoordinate(pointsToSearch[np][0]+searchRadius2d);
+        int minTileY=getTileCoordinate(pointsToSearch[np][1]-searchRadius2d);
+        int maxTileY=getTileCoordinate(pointsToSearch[np][1]+searchRadius2d);
+        for(int tileX=minTileX;tileX<=maxTileX;tileX+=gridSize)
+        {
+            if(!mTilesName.contains(tileX)) continue;
+            for(int tileY=minTileY;tileY<=maxTileY;tileY+=gridSize)
+            {
+                if(!mTilesName[tileX].contains(tileY)) continue;
+                tilesByPointToSearch[np].push_back(qMakePair(tileX,tileY));
+                tilesTableName[tileX][tileY]=mTilesName[tileX][tileY];
+            }
+        }
+    }
+    PointsQuery pointsQuery;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > > pointsByTileByFileId;
+    if(!getPointsFromTiles(tilesTableName,
+                           pointsQuery,
+                           pointsByTileByFileId,
+                           existsFieldsByFileId,
+                           strAuxError))
+    {
+        strError=functionName;
+        strError+=QObject::tr("\nError recovering points from tiles:\n%1").arg(strAuxError);
+        return(false);
+    }
+    // una celda por fichero y tile, con su kd-tree
+    QVector<int> cellsFileId;
+    QVector<int> cellsTileX;
+    QVector<int> cellsTileY;
+    QVector<QVector<Point> > cellsPoints;
+    QVector<QVector<double> > cellsCoordinates;
+    QVector<QVector<double> > cellsHeights;
+    QMap<int,QMap<int,QVector<int> > > cellsByTile;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > >::const_iterator iterFiles=pointsByTileByFileId.begin();
+    while(iterFiles!=pointsByTileByFileId.end())
+    {
+        int fileId=iterFiles.key();
+        QMap<int,QMap<int,QVector<Point> > >::const_iterator iterX=iterFiles.value().begin();
+        while(iterX!=iterFiles.value().end())
+        {
+            int tileX=iterX.key();
+            QMap<int,QVector<Point> >::const_iterator iterY=iterX.value().begin();
+            while(iterY!=iterX.value().end())
+            {
+                int tileY=iterY.key();
+                QVector<Point> vPoints=iterY.value();
+                QVector<double> coordinates(2*vPoints.size());
+                QVector<double> heights;
+                if(useAltitude) heights.resize(vPoints.size());
+                for(int np=0;np<vPoints.size();np++)
+                {
+                    coordinates[2*np]=tileX+vPoints[np].getIx()/1000.;
+                    coordinates[2*np+1]=tileY+vPoints[np].getIy()/1000.;
+                    if(useAltitude) heights[np]=vPoints[np].getZ();
+                }
+                cellsByTile[tileX][tileY].push_back(cellsFileId.size());
+                cellsFileId.push_back(fileId);
+                cellsTileX.push_back(tileX);
+                cellsTileY.push_back(tileY);
+                cellsPoints.push_back(vPoints);
+                cellsCoordinates.push_back(coordinates);
+                cellsHeights.push_back(heights);
+                iterY++;
+            }
+            iterX++;
+        }
+        iterFiles++;
+    }
+    pointsByTileByFileId.clear();
+    int numberOfCells=cellsFileId.size();
+    QMap<int,QMap<int,QMap<int,QVector<int> > > > storedPositionsByFileId;
+    QMap<int,QMap<QString,bool> >::const_iterator iterExistsFields=existsFieldsByFileId.begin();
+    while(iterExistsFields!=existsFieldsByFileId.end())
+    {
+        int fileId=iterExistsFields.key();
+        if(!readPointsIndexFile(fileId,
+                                storedPositionsByFileId[fileId],
+                                strAuxError))
+        {
+            storedPositionsByFileId[fileId].clear(); // se reconstruye
+        }
+        iterExistsFields++;
+    }
+    QVector<PointsIndex> cellsIndex(numberOfCells);
+    QVector<int> cellsToBuild(numberOfCells);
+    for(int nc=0;nc<numberOfCells;nc++) cellsToBuild[nc]=nc;
+    auto buildCellIndex=[&](int cell)
+    {
+        QString strCellError;
+        QVector<int> positions=storedPositionsByFileId.value(cellsFileId[cell]).value(cellsTileX[cell]).value(cellsTileY[cell]);
+        if(!positions.isEmpty())
+        {
+            if(cellsIndex[cell].build(cellsCoordinates[cell],2,positions,strCellError))
+            {
+                return;
+            }
+        }
+        cellsIndex[cell].build(cellsCoordinates[cell],2,strCellError);
+    };
+    pointsByPointToSearch.resize(numberOfPointsToSearch);
+    tilesXByPointToSearch.resize(numberOfPointsToSearch);
+    tilesYByPointToSearch.resize(numberOfPointsToSearch);
+    distancesByPointToSearch.resize(numberOfPointsToSearch);
+    fileIdPointsByPointToSearch.resize(numberOfPointsToSearch);
+    QVector<int> pointsToProcess(numberOfPointsToSearch);
+    for(int np=0;np<numberOfPointsToSearch;np++) pointsToProcess[np]=np;
+    auto searchNeighbors=[&](int np)
+    {
+        const QVector<double>& point=pointsToSearch[np];
+        QVector<double> minimumCoordinates(2),maximumCoordinates(2);
+        minimumCoordinates[0]=point[0]-searchRadius2d;
+        minimumCoordinates[1]=point[1]-searchRadius2d;
+        maximumCoordinates[0]=point[0]+searchRadius2d;
+        maximumCoordinates[1]=point[1]+searchRadius2d;
+        QVector<QPair<double,QPair<int,int> > > candidates; // distancia, celda, posicion en la celda
+        for(int nt=0;nt<tilesByPointToSearch[np].size();nt++)
+        {
+            QVector<int> cells=cellsByTile.value(tilesByPointToSearch[np][nt].first).value(tilesByPointToSearch[np][nt].second);
+            for(int nc=0;nc<cells.size();nc++)
+            {
+                int cell=cells[nc];
+                QVector<int> positions;
+                cellsIndex.at(cell).getPointsInBox(minimumCoordinates,
+                                                   maximumCoordinates,
+                                                   positions);
+                const QVector<double>& coordinates=cellsCoordinates.at(cell);
+                for(int i=0;i<positions.size();i++)
+                {
+                    int position=positions[i];
+                    double dx=coordinates[2*position]-point[0];
+                    double dy=coordinates[2*position+1]-point[1];
+                    double squaredDistance=dx*dx+dy*dy;
+                    if(useAltitude)
+                    {
+                        double dz=cellsHeights.at(cell)[position]-point[2];
+                        squaredDistance+=dz*dz;
+                    }
+                    candidates.push_back(qMakePair(squaredDistance,qMakePair(cell,position)));
+                }
+            }
+        }
+        int k=numberOfNeighbors;
+        if(k<=0||k>candidates.size()) k=candidates.size();
+        std::partial_sort(candidates.begin(),candidates.begin()+k,candidates.end());
+        for(int nn=0;nn<k;nn++)
+        {
+            int cell=candidates[nn].second.first;
+            int position=candidates[nn].second.second;
+            pointsByPointToSearch[np].push_back(cellsPoints.at(cell)[position]);
+            tilesXByPointToSearch[np].push_back(cellsTileX[cell]);
+            tilesYByPointToSearch[np].push_back(cellsTileY[cell]);
+            distancesByPointToSearch[np].push_back(sqrt(candidates[nn].first));
+            fileIdPointsByPointToSearch[np].push_back(cellsFileId[cell]);
+        }
+    };
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        QtConcurrent::blockingMap(cellsToBuild,buildCellIndex);
+        QtConcurrent::blockingMap(pointsToProcess,searchNeighbors);
+    }
+    else
+    {
+        for(int nc=0;nc<numberOfCells;nc++) buildCellIndex(nc);
+        for(int np=0;np<numberOfPointsToSearch;np++) searchNeighbors(np);
+    }
+    return(true);
+}
+
+
+bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
+                                              int geometryCrsEpsgCode,
+                                              QString geometryCrsProj4String,
+                                              QMap<int, QMap<int, QString> > &tilesTableName,
+                                              QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                              QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                              QVector<QString> &ignoreTilesTableName,
+                                              bool tilesFullGeometry,
+                                              QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    PointsFilter pointsFilter;
+    return(getPointsFromWktGeometry(wktGeometry,
+                                    geometryCrsEpsgCode,
+                                    geometryCrsProj4String,
+                                    tilesTableName,
+                                    pointsByTileByFileId,
+                                    existsFieldsByFileId,
+                                    ignoreTilesTableName,
+                                    tilesFullGeometry,
+                                    pointsFilter,
+                                    strError));
+}
+
+bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
+                                              int geometryCrsEpsgCode,
+                                              QString geometryCrsProj4String,
+                                              QMap<int, QMap<int, QString> > &tilesTableName,
+                                              QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                              QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                              QVector<QString> &ignoreTilesTableName,
+                                              bool tilesFullGeometry,
+                                              PointsFilter &pointsFilter,
+                                              QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    tilesTableName.clear();
+    pointsByTileByFileId.clear();
+    existsFieldsByFileId.clear();
+    QString strAuxError;
+    QMap<int,QMap<int,QVector<float> > > tilesPolygonEdges;
+    if(!getTilesPolygonEdgesFromWktGeometry(wktGeometry,
+                                            geometryCrsEpsgCode,
+                                            geometryCrsProj4String,
+                                            ignoreTilesTableName,
+                                            tilesFullGeometry,
+                                            tilesTableName,
+                                            tilesPolygonEdges,
+                                            strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    PointsQuery pointsQuery;
+    pointsQuery.setPointsFilter(pointsFilter);
+    pointsQuery.setTilesPolygonEdges(tilesPolygonEdges);
+    if(!getPointsFromTiles(tilesTableName,
+                           pointsQuery,
+                           pointsByTileByFileId,
+                           existsFieldsByFileId,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
+        strError+=QObject::tr("\nError recovering points from tiles:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getPointsFromWktGeometryByLevelOfDetail(QString wktGeometry,
+                                                             int geometryCrsEpsgCode,
+                                                             QString geometryCrsProj4String,
+                                                             qint64 pointsBudget,
+                                                             double spacing,
+                                                             QMap<int, QMap<int, QString> > &tilesTableName,
+                                                             QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                                             QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                                             QVector<QString> &ignoreTilesTableName,
+                                                             int &level,
+                                                             QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    // Con espaciado se elige el nivel mas grueso que lo alcanza, con limite de puntos el mas fino
+    // que no lo supera; con ambos, el limite de puntos prevalece. El numero de puntos de cada nivel
+    // se obtiene de la entrada levels de los .pcl, contando completos los tiles de borde
+    tilesTableName.clear();
+    pointsByTileByFileId.clear();
+    existsFieldsByFileId.clear();
+    level=POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;
+    QString strAuxError;
+    QMap<int,QMap<int,bool> > tilesOverlaps;
+    OGRGeometry* ptrGeometry=NULL;
+    if(!getTilesNamesFromWktGeometry(wktGeometry,
+                                     geometryCrsEpsgCode,
+                                     geometryCrsProj4String,
+                                     tilesTableName,
+                                     ignoreTilesTableName,
+                                     false,
+                                     &ptrGeometry,
+                                     tilesOverlaps,
+                                     strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+        strError+=QObject::tr("\nError recovering tiles from wkt:\n%1\nError:\n%2")
+                .arg(wktGeometry).arg(strAuxError);
+        if(ptrGeometry!=NULL)
+        {
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        }
+        return(false);
+    }
+    QVector<qint64> levelsNumberOfPoints(POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS+1,0);
+    QMap<int,QMap<int,QVector<int> > > tilesByFileIndex;
+    QMap<int,QMap<int,QString> >::const_iterator iterX=tilesTableName.begin();
+    while(iterX!=tilesTableName.end())
     {
-        if(pointCrsEpsgCode!=mSRID)
+        int tileX=iterX.key();
+        QMap<int,QString>::const_iterator iterY=iterX.value().begin();
+        while(iterY!=iterX.value().end())
         {
-            QString pointCrsDescription;
-            if(!mPtrCrsTools->appendUserCrs(pointCrsEpsgCode,
-                                            pointCrsDescription,
-                                            strAuxError))
+            int tileY=iterY.key();
+            levelsNumberOfPoints[POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS]+=mTilesNumberOfPoints.value(tileX).value(tileY,0);
+            QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+            while(iterFiles!=mTilesByFileIndex.end())
             {
-                if(!mPtrCrsTools->appendUserCrs(pointCrsProj4String,//proj4
-                                                pointCrsDescription,
-                                                strAuxError))
+                if(iterFiles.value().value(tileX).indexOf(tileY)!=-1)
                 {
-                    strError=functionName;
-                    strError+=QObject::tr("\nInvalid CRS From EPSG code: %1 and PROJ4:\n%2")
-                            .arg(QString::number(pointCrsEpsgCode)).arg(pointCrsProj4String);
-                    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                    mMpPtrGeometry=NULL;
-                    return(false);
+                    tilesByFileIndex[iterFiles.key()][tileX].push_back(tileY);
                 }
+                iterFiles++;
             }
-            QVector<QVector<double> > auxPoints;
-            auxPoints.push_back(point);
-            if(!mPtrCrsTools->crsOperation(pointCrsDescription,
-                                           mCrsDescription,
-                                           auxPoints,
-                                           strAuxError))
-            {
-                strError=functionName;
-                strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-                OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                mMpPtrGeometry=NULL;
-                return(false);
-            }
-            double fc=auxPoints[0][0];
-            double sc=auxPoints[0][1];
-            point[0]=fc;
-            point[1]=sc;
-            if(useAltitude)
-            {
-                double tc=auxPoints[0][1];
-                point[2]=tc;
-            }
+            iterY++;
         }
+        iterX++;
     }
-    else
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
+    while(iterFiles!=tilesByFileIndex.end())
     {
-        QString pointCrsDescription;
-        if(!mPtrCrsTools->appendUserCrs(pointCrsProj4String,//proj4
-                                        pointCrsDescription,
-                                        strAuxError))
-        {
-            strError=functionName;
-            strError+=QObject::tr("\nInvalid CRS From PROJ4:\n%1").arg(pointCrsProj4String);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
-        }
-        QVector<QVector<double> > auxPoints;
-        auxPoints.push_back(point);
-        if(!mPtrCrsTools->crsOperation(pointCrsDescription,
-                                       mCrsDescription,
-                                       auxPoints,
-                                       strAuxError))
+        int fileIndex=iterFiles.key();
+        QMap<int,QMap<int,QVector<int> > > tilesLevelsNumberOfPoints;
+        if(!readLevelsOfDetailFile(fileIndex,
+                                   tilesLevelsNumberOfPoints,
+                                   strAuxError))
         {
-            strError=functionName;
-            strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
+            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+            strError+=QObject::tr("\nError reading levels of detail, use buildLevelsOfDetail:\n%1")
+                    .arg(strAuxError);
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
             return(false);
         }
-        double fc=auxPoints[0][0];
-        double sc=auxPoints[0][1];
-        point[0]=fc;
-        point[1]=sc;
-        if(useAltitude)
-        {
-            double tc=auxPoints[0][1];
-            point[2]=tc;
-        }
-    }
-    pointCrsEpsgCode=mSRID;
-    pointCrsProj4String=mCrsProj4String;
-    QString pointCrsDescription=mCrsDescription;
-    if(searchRadius2d<=0)
-    {
-        searchRadius2d=1.0/sqrt(mMaximumDensity)*POINTCLOUDFILE_SEARCHRADIUS_SQRT_MAXIMUM_DENSITY_FACTOR;
-    }
-    // supongo que el CRS del punto es proyectado
-    // creo un polygon de la zona
-    double nwFc,nwSc,neFc,neSc,seFc,seSc,swFc,swSc;
-    nwFc=point[0]-searchRadius2d;
-    nwSc=point[1]+searchRadius2d;
-    neFc=point[0]+searchRadius2d;
-    neSc=point[1]+searchRadius2d;
-    seFc=point[0]+searchRadius2d;
-    seSc=point[1]-searchRadius2d;
-    swFc=point[0]-searchRadius2d;
-    swSc=point[1]-searchRadius2d;
-    QString wktGeometry="POLYGON((";
-    wktGeometry+=QString::number(nwFc,'f',4);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(nwSc,'f',4);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(neFc,'f',4);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(neSc,'f',4);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(seFc,'f',4);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(seSc,'f',4);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(swFc,'f',4);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(swSc,'f',4);
-    wktGeometry+=",";
-    wktGeometry+=QString::number(nwFc,'f',4);
-    wktGeometry+=" ";
-    wktGeometry+=QString::number(nwSc,'f',4);
-    wktGeometry+="))";
-    QMap<int, QMap<int, QString> > tilesTableName;
-    QMap<int, QMap<int, QMap<int, QVector<Point> > > > pointsByTileByFileId;
-    QVector<QString> ignoreTilesTableName;
-    bool tilesFullGeometry=false;
-    if(!getPointsFromWktGeometry(wktGeometry,pointCrsEpsgCode,pointCrsProj4String,
-                                 tilesTableName,pointsByTileByFileId,existsFieldsByFileId,
-                                 ignoreTilesTableName,tilesFullGeometry,strAuxError))
-    {
-        strError=functionName;
-        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
-        return(false);
-    }
-    QVector<int> fileIdByPosition;
-    QVector<QVector<double> > pointCoordinatesByPosition;
-    QVector<Point> initialPoints;
-    QVector<int> initialTilesX;
-    QVector<int> initialTilesY;
-    QMap<int, QMap<int, QMap<int, QVector<Point> > > >::ConstIterator iterPointsByFileId=pointsByTileByFileId.begin(); //[fileId][tileX][tileY]
-    while(iterPointsByFileId!=pointsByTileByFileId.end())
-    {
-        int fileId=iterPointsByFileId.key();
-        QMap<int, QMap<int, QVector<Point> > >::const_iterator iterPointsByTileX=iterPointsByFileId.value().begin();
-        while(iterPointsByTileX!=iterPointsByFileId.value().end())
+        QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
+        while(iterTileX!=iterFiles.value().end())
         {
-            int tileX=iterPointsByTileX.key();
-            QMap<int, QVector<Point> >::const_iterator iterPointsByTileY=iterPointsByTileX.value().begin();
-            while(iterPointsByTileY!=iterPointsByTileX.value().end())
+            int tileX=iterTileX.key();
+            for(int i=0;i<iterTileX.value().size();i++)
             {
-                int tileY=iterPointsByTileY.key();
-                QVector<Point> vPoints=iterPointsByTileY.value();
-                for(int np=0;np<vPoints.size();np++)
+                QVector<int> tileLevelsNumberOfPoints=tilesLevelsNumberOfPoints.value(tileX).value(iterTileX.value()[i]);
+                for(int nl=0;nl<tileLevelsNumberOfPoints.size()&&nl<POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;nl++)
                 {
-                    QVector<double> vPoint(2);
-                    int ix=vPoints[np].getIx();
-                    double fc=tileX+ix/1000.;
-                    int iy=vPoints[np].getIy();
-                    double sc=tileY+iy/1000.;
-                    vPoint[0]=fc;
-                    vPoint[1]=sc;
-                    double altitude=vPoints[np].getZ();
-                    if(useAltitude)
-                    {
-                        vPoint.push_back(altitude);
-                    }
-                    pointCoordinatesByPosition.push_back(vPoint);
-                    initialTilesX.push_back(tileX);
-                    initialTilesY.push_back(tileY);
-                    initialPoints.push_back(vPoints[np]);
-                    fileIdByPosition.push_back(fileId);
+                    levelsNumberOfPoints[nl]+=tileLevelsNumberOfPoints[nl];
                 }
-                iterPointsByTileY++;
             }
-            iterPointsByTileX++;
+            iterTileX++;
         }
-        iterPointsByFileId++;
-    }
-    int k=numberOfNeighbors;
-    if(k<=0) k=pointCoordinatesByPosition.size();
-    QVector<QVector<double> > neighbors;
-    ICGAL::NeighborsSearch* ptrNeighborsSearh=new ICGAL::NeighborsSearch(mPtrCrsTools);
-    if(!ptrNeighborsSearh->getNeighbors(k,
-                                        point,
-                                        pointCoordinatesByPosition,
-                                        mCrsDescription,
-                                        neighbors,
-                                        strAuxError))
-    {
-        strError=functionName;
-        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
-        return(false);
+        iterFiles++;
     }
-    for(int nn=0;nn<neighbors.size();nn++)
+    QVector<double> spacings=getLevelsOfDetailSpacings();
+    int spacingLevel=POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;
+    if(spacing>0.)
     {
-        double fc=neighbors[nn][0];
-        double sc=neighbors[nn][1];
-        double distance,tc;
-        if(!useAltitude)
-        {
-            distance=neighbors[nn][2];
-        }
-        else
-        {
-            tc=neighbors[nn][2];
-            distance=neighbors[nn][3];
-        }
-        int posFind=-1;
-        for(int nip=0;nip<pointCoordinatesByPosition.size();nip++)
+        for(int nl=0;nl<POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;nl++)
         {
-            double ipFc=pointCoordinatesByPosition[nip][0];
-            double ipSc=pointCoordinatesByPosition[nip][1];
-            double dis=10000000.;
-            if(!useAltitude)
-            {
-                dis=sqrt(pow(fc-ipFc,2.0)+pow(sc-ipSc,2.0));
-            }
-            else
-            {
-                double ipTc=pointCoordinatesByPosition[nip][2];
-                dis=sqrt(pow(fc-ipFc,2.0)+pow(sc-ipSc,2.0)+pow(tc-ipTc,2.0));
-            }
-            if(dis<0.0001)
+            if(spacings[nl]<=spacing)
             {
-                posFind=nip;
+                spacingLevel=nl;
                 break;
             }
         }
-        if(posFind==-1) continue;
-        int fileId=fileIdByPosition[posFind];
-        Point pto=initialPoints[posFind];
-        int tileX=initialTilesX[posFind];
-        int tileY=initialTilesY[posFind];
-        fileIdByPosition.remove(posFind);
-        initialPoints.remove(posFind);
-        initialTilesX.remove(posFind);
-        initialTilesY.remove(posFind);
-        pointCoordinatesByPosition.remove(posFind);
-        if(!existsFieldsByFileId.contains(fileId)) continue;
-        points.push_back(pto);
-        tilesX.push_back(tileX);
-        tilesY.push_back(tileY);
-        distances.push_back(distance);
-        fileIdPoints.push_back(fileId);
-//        QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
     }
-    return(true);
-}
-
-bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
-                                              int geometryCrsEpsgCode,
-                                              QString geometryCrsProj4String,
-                                              QMap<int,QMap<int,QString> >& tilesTableName,
-                                              QMap<int,QMap<int,QMap<int,QVector<PCFile::Point> > > >& pointsByTileByFileId,
-                                              QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
-                                              QVector<QString> &ignoreTilesTableName,
-                                              bool tilesFullGeometry,
-                                              QString &strError)
-{
-    QWidget* ptrWidget=new QWidget();
-    QProgressDialog* ptrProgress=NULL;
-    mTilesFullGeometry=tilesFullGeometry;
-    tilesTableName.clear();
-    pointsByTileByFileId.clear();
-    existsFieldsByFileId.clear();
-    mMpIgnoreTilesTableName.clear();
-    mMpIgnoreTilesTableName=ignoreTilesTableName;
-//    QVector<QString> tilesTableNames;
-    QString strAuxError;
-    QMap<int,QMap<int,bool> > tilesOverlaps;
-    if(mMpPtrGeometry!=NULL)
-    {
-        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-        mMpPtrGeometry=NULL;
-    }
-    wktGeometry=wktGeometry.toLower();
-    bool validGeometry=false;
-    if(wktGeometry.toLower().contains("multipolygon"))
+    int budgetLevel=POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;
+    if(pointsBudget>0)
     {
-        mMpPtrGeometry=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
-        validGeometry=true;
+        budgetLevel=0;
+        for(int nl=POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;nl>=0;nl--)
+        {
+            if(levelsNumberOfPoints[nl]<=pointsBudget)
+            {
+                budgetLevel=nl;
+                break;
+            }
+        }
     }
-    else if(wktGeometry.toLower().contains("polygon"))
+    level=qMin(spacingLevel,budgetLevel);
+    if(level==POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS)
     {
-        mMpPtrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
-        validGeometry=true;
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        if(!getPointsFromWktGeometry(wktGeometry,
+                                     geometryCrsEpsgCode,
+                                     geometryCrsProj4String,
+                                     tilesTableName,
+                                     pointsByTileByFileId,
+                                     existsFieldsByFileId,
+                                     ignoreTilesTableName,
+                                     false,
+                                     strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+            strError+=QObject::tr("\nError recovering points:\n%1").arg(strAuxError);
+            return(false);
+        }
+        return(true);
     }
-    wktGeometry=wktGeometry.toUpper();
-//    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
-//    char *charsWktGeometry = byteArrayWktGeometry.data();
-//    if(!validGeometry)
-//    {
-//        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-//        strError+=QObject::tr("\nNot valid geometry from WKT: %1").arg(wktGeometry);
-//        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-//        mMpPtrGeometry=NULL;
-//        return(false);
-//    }
-//    if(OGRERR_NONE!=mMpPtrGeometry->importFromWkt(&charsWktGeometry))
-//    {
-//        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-//        strError+=QObject::tr("\nError making geometry from WKT:\n%1").arg(wktGeometry);
-//        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-//        mMpPtrGeometry=NULL;
-//        return(false);
-//    }
-    std::string stdStringWktGeometry=wktGeometry.toStdString();
-    const char* constCharWktGeometry = stdStringWktGeometry.c_str();
-    if(OGRERR_NONE!=mMpPtrGeometry->importFromWkt(&constCharWktGeometry))
+    QMap<int,QMap<int,QVector<float> > > tilesPolygonEdges;
+    if(!setTilesPolygonEdges(ptrGeometry,
+                             tilesOverlaps,
+                             tilesPolygonEdges,
+                             strAuxError))
     {
-        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-        strError+=QObject::tr("\nError making geometry from WKT:\n%1").arg(wktGeometry);
-        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-        mMpPtrGeometry=NULL;
+        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+        strError+=QObject::tr("\nError clipping geometry to tiles:\n%1").arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
         return(false);
     }
-    if(geometryCrsEpsgCode!=-1)
+    OGRGeometryFactory::destroyGeometry(ptrGeometry);
+    PointsQuery pointsQuery;
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    pointsQuery.setTilesPolygonEdges(tilesPolygonEdges);
+    QVector<int> filesIndex;
+    iterFiles=tilesByFileIndex.begin();
+    while(iterFiles!=tilesByFileIndex.end())
     {
-        if(geometryCrsEpsgCode!=mSRID)
+        int fileIndex=iterFiles.key();
+        QMap<QString,bool> existsFields;
+        if(!readQueryClassesFile(pointsQuery,
+                                 fileIndex,
+                                 iterFiles.value(),
+                                 existsFields,
+                                 strAuxError))
         {
-            QString geometryCrsDescription;
-            if(!mPtrCrsTools->appendUserCrs(geometryCrsEpsgCode,
-                                            geometryCrsDescription,
-                                            strAuxError))
+            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+            strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+            return(false);
+        }
+        existsFieldsByFileId[fileIndex]=existsFields;
+        filesIndex.push_back(fileIndex);
+        iterFiles++;
+    }
+    // un fichero por tarea, cada una con su QuaZip
+    int numberOfFiles=filesIndex.size();
+    QVector<QMap<int,QMap<int,QVector<PCFile::Point> > > > filesPoints(numberOfFiles);
+    QVector<QString> filesError(numberOfFiles);
+    QVector<int> filesPosition(numberOfFiles);
+    for(int nf=0;nf<numberOfFiles;nf++) filesPosition[nf]=nf;
+    auto readFileLevel=[&](int nf)
+    {
+        int fileIndex=filesIndex[nf];
+        QString levelsOfDetailFileName=mLevelsOfDetailFileByIndex.value(fileIndex);
+        QuaZip zipFileLevels(levelsOfDetailFileName);
+        if(!zipFileLevels.open(QuaZip::mdUnzip))
+        {
+            filesError[nf]=QObject::tr("Error opening file:\n%1\nError:\n%2")
+                    .arg(levelsOfDetailFileName)
+                    .arg(QString::number(zipFileLevels.getZipError()));
+            return;
+        }
+        const QMap<int,QVector<int> > tiles=tilesByFileIndex.value(fileIndex);
+        QMap<int,QVector<int> >::const_iterator iterTileX=tiles.begin();
+        while(iterTileX!=tiles.end())
+        {
+            int tileX=iterTileX.key();
+            for(int i=0;i<iterTileX.value().size();i++)
             {
-                if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                                geometryCrsDescription,
-                                                strAuxError))
+                int tileY=iterTileX.value()[i];
+                QVector<PCFile::Point> pointsInTile;
+                QString strFileError;
+                if(!pointsQuery.readTileLevelOfDetailPoints(zipFileLevels,
+                                                            fileIndex,
+                                                            tileX,
+                                                            tileY,
+                                                            level,
+                                                            pointsInTile,
+                                                            strFileError))
                 {
-                    strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                    strError+=QObject::tr("\nInvalid CRS From EPSG code: %1 and PROJ4:\n%2")
-                            .arg(QString::number(geometryCrsEpsgCode)).arg(geometryCrsProj4String);
-                    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                    mMpPtrGeometry=NULL;
-                    return(false);
+                    filesError[nf]=strFileError;
+                    zipFileLevels.close();
+                    return;
+                }
+                if(!pointsInTile.isEmpty())
+                {
+                    filesPoints[nf][tileX][tileY]=pointsInTile;
                 }
             }
-            if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                           mCrsDescription,
-                                           &mMpPtrGeometry,
-                                           strAuxError))
-            {
-                strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-                OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                mMpPtrGeometry=NULL;
-                return(false);
-            }
+            iterTileX++;
         }
+        zipFileLevels.close();
+    };
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        QtConcurrent::blockingMap(filesPosition,readFileLevel);
     }
     else
     {
-        QString geometryCrsDescription;
-        if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                        geometryCrsDescription,
-                                        strAuxError))
+        for(int nf=0;nf<numberOfFiles;nf++) readFileLevel(nf);
+    }
+    QMap<int,QMap<int,bool> > tilesWithPoints;
+    for(int nf=0;nf<numberOfFiles;nf++)
+    {
+        if(!filesError[nf].isEmpty())
         {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nInvalid CRS From PROJ4:\n%1").arg(geometryCrsProj4String);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
+            pointsByTileByFileId.clear();
+            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometryByLevelOfDetail");
+            strError+=QObject::tr("\nError recovering points of level: %1 in file:\n%2\nError:\n%3")
+                    .arg(QString::number(level))
+                    .arg(mZipFilePointsByIndex.value(filesIndex[nf]))
+                    .arg(filesError[nf]);
             return(false);
         }
-        if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                       mCrsDescription,
-                                       &mMpPtrGeometry,
-                                       strAuxError))
+        if(filesPoints[nf].isEmpty()) continue;
+        pointsByTileByFileId[filesIndex[nf]]=filesPoints[nf];
+        QMap<int,QMap<int,QVector<PCFile::Point> > >::const_iterator iterTileX=filesPoints[nf].begin();
+        while(iterTileX!=filesPoints[nf].end())
         {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
+            QMap<int,QVector<PCFile::Point> >::const_iterator iterTileY=iterTileX.value().begin();
+            while(iterTileY!=iterTileX.value().end())
+            {
+                tilesWithPoints[iterTileX.key()][iterTileY.key()]=true;
+                iterTileY++;
+            }
+            iterTileX++;
         }
     }
-    if(!getTilesNamesFromGeometry(tilesTableName,
-                                  ignoreTilesTableName,
-                                  mMpPtrGeometry,
-                                  tilesOverlaps,
-                                  strAuxError))
+    QMap<int,QMap<int,QString> > tilesTableNameWithPoints;
+    iterX=tilesTableName.begin();
+    while(iterX!=tilesTableName.end())
     {
-        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-        strError+=QObject::tr("\nError recovering tiles from wkt:\n%1\nError:\n%2")
-                .arg(wktGeometry).arg(strAuxError);
-        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-        mMpPtrGeometry=NULL;
-        return(false);
+        int tileX=iterX.key();
+        QMap<int,QString>::const_iterator iterY=iterX.value().begin();
+        while(iterY!=iterX.value().end())
+        {
+            if(tilesWithPoints.value(tileX).contains(iterY.key()))
+            {
+                tilesTableNameWithPoints[tileX][iterY.key()]=iterY.value();
+            }
+            iterY++;
+        }
+        iterX++;
     }
+    tilesTableName=tilesTableNameWithPoints;
+    return(true);
+}
 
-    int numberOfFilesAndTileToProcess=0;
+bool PointCloudFile::getPointsFromTiles(QMap<int, QMap<int, QString> > &tilesTableName,
+                                        PointsQuery &pointsQuery,
+                                        QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                        QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                        QString &strError)
+{
+    // Tareas (fichero, tile) ordenadas de mayor a menor numero de puntos. Cada hilo toma
+    // la siguiente de un contador atomico y deja el resultado en la posicion de la tarea,
+    // la union se hace al terminar sin bloqueos. El estado de la consulta esta en
+    // pointsQuery y no se modifica el objeto, por lo que admite consultas simultaneas
+    pointsByTileByFileId.clear();
+    existsFieldsByFileId.clear();
+    QString strAuxError;
     QMap<int,QMap<int,QVector<int> > > tilesByFileIndex;
     QMap<int,QMap<int,int> > tilesNumberOfPoints;
     QMap<int,QMap<int,QString> >::const_iterator iterX=tilesTableName.begin();
@@ -3185,31 +4409,16 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
         {
             int tileY=iterY.key();
             tilesNumberOfPoints[tileX][tileY]=0;
-            QString tileTableName=iterY.value();
             QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
             while(iterFiles!=mTilesByFileIndex.end())
             {
                 int fileIndex=iterFiles.key();
-                QMap<int,QVector<int> > tilesInFile=iterFiles.value();
+                const QMap<int,QVector<int> >& tilesInFile=iterFiles.value();
                 if(tilesInFile.contains(tileX))
                 {
                     if(tilesInFile[tileX].indexOf(tileY)!=-1)
                     {
-                        numberOfFilesAndTileToProcess++;
-                        if(!tilesByFileIndex.contains(fileIndex))
-                        {
-                            QMap<int,QVector<int> > aux;
-                            tilesByFileIndex[fileIndex]=aux;
-                        }
-                        if(!tilesByFileIndex[fileIndex].contains(tileX))
-                        {
-                            QVector<int> aux;
-                            tilesByFileIndex[fileIndex][tileX]=aux;
-                        }
-                        if(tilesByFileIndex[fileIndex][tileX].indexOf(tileY)==-1)
-                        {
-                            tilesByFileIndex[fileIndex][tileX].push_back(tileY);
-                        }
+                        tilesByFileIndex[fileIndex][tileX].push_back(tileY);
                     }
                 }
                 iterFiles++;
@@ -3218,511 +4427,597 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
         }
         iterX++;
     }
-    int numberOfSteps=numberOfFilesAndTileToProcess;
-    QDir auxDir=QDir::currentPath();
-    if(ptrWidget!=NULL)
-    {
-        QString title=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-        QString msgGlobal=QObject::tr("Recovering points from %1 files and tiles")
-                .arg(QString::number(numberOfSteps));
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
-    }
-    int step=0;
-    QMap<int,QMap<int,QVector<int> > >::Iterator iterFiles=tilesByFileIndex.begin();
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    QVector<int> tasksFileIndex;
+    QVector<int> tasksTileX;
+    QVector<int> tasksTileY;
+    QVector<int> tasksNumberOfPoints;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
     while(iterFiles!=tilesByFileIndex.end())
-    {
-        mPointsByTile.clear();
-        int fileIndex=iterFiles.key();
-        if(!mClassesFileByIndex.contains(fileIndex))
-        {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nThere is no classes file for index: %1")
-                    .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
-        }
-        mClassesFileName=mClassesFileByIndex[fileIndex];
-        QFile pointsClassFile(mClassesFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
+    {
+        int fileIndex=iterFiles.key();
+        if(!mClassesFileByIndex.contains(fileIndex))
         {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(mClassesFileName);
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
+            strError=QObject::tr("PointCloudFile::getPointsFromTiles");
+            strError+=QObject::tr("\nThere is no classes file for index: %1")
+                    .arg(QString::number(fileIndex));
             return(false);
         }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        mTilesPointsClass.clear();
-        mTilesPointsClassNewByPos.clear(); // se guarda vacío
-        mTilesNop.clear();
-        inPointsClass>>mTilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>mTilesPointsClass;
-        inPointsClass>>mTilesPointsClassNewByPos;
-        pointsClassFile.close();
-        mExistsColor=existsFields[POINTCLOUDFILE_PARAMETER_COLOR];
-        mExistsGpsTime=existsFields[POINTCLOUDFILE_PARAMETER_GPS_TIME];
-        mExistsUserData=existsFields[POINTCLOUDFILE_PARAMETER_USER_DATA];
-        mExistsIntensity=existsFields[POINTCLOUDFILE_PARAMETER_INTENSITY];
-        mExistsSourceId=existsFields[POINTCLOUDFILE_PARAMETER_SOURCE_ID];
-        mExistsNir=existsFields[POINTCLOUDFILE_PARAMETER_NIR];
-        mExistsReturn=existsFields[POINTCLOUDFILE_PARAMETER_RETURN];
-        mExistsReturns=existsFields[POINTCLOUDFILE_PARAMETER_RETURNS];
-        existsFieldsByFileId[fileIndex]=existsFields;
         if(!mZipFilePointsByIndex.contains(fileIndex))
         {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
+            strError=QObject::tr("PointCloudFile::getPointsFromTiles");
             strError+=QObject::tr("\nThere is no points file for index: %1")
                     .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
             return(false);
         }
-        mZipFileNamePoints=mZipFilePointsByIndex[fileIndex];
-        QString zipFilePointsPath=mZipFilePathPointsByIndex[fileIndex];
-        mZipFilePoints.setZipName(mZipFileNamePoints);
-//        QuaZip mZipFilePoints(zipFileNamePoints);
-        if(!mZipFilePoints.open(QuaZip::mdUnzip))
+        QMap<QString,bool> existsFields;
+        if(!readQueryClassesFile(pointsQuery,
+                                 fileIndex,
+                                 iterFiles.value(),
+                                 existsFields,
+                                 strAuxError))
         {
-            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
-                    .arg(mZipFileNamePoints).arg(QString::number(mZipFilePoints.getZipError()));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
+            strError=QObject::tr("PointCloudFile::getPointsFromTiles");
+            strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
             return(false);
         }
-        bool useMultiProcess=mPtrPCFManager->getMultiProcess();
-//        useMultiProcess=false;
-        if(!useMultiProcess)
+        existsFieldsByFileId[fileIndex]=existsFields;
+        QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
+        while(iterTileX!=iterFiles.value().end())
         {
-            QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
-            while(iterTileX!=iterFiles.value().end())
+            int tileX=iterTileX.key();
+            for(int i=0;i<iterTileX.value().size();i++)
             {
-                int tileX=iterTileX.key();
-                if(!mTilesPointsClass.contains(tileX))
-                {
-                    strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                    strError+=QObject::tr("\nNot exists tile x: %1 in classes  file:\n%2")
-                            .arg(QString::number(tileX)).arg(mClassesFileName);
-                    if(ptrWidget!=NULL)
-                    {
-                        ptrProgress->close();
-                        delete(ptrProgress);
-                    }
-                    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                    mMpPtrGeometry=NULL;
-                    mZipFilePoints.close();
-                    return(false);
-                }
-                for(int i=0;i<iterTileX.value().size();i++)
-                {
-                    int tileY=iterTileX.value()[i];
-                    if(!mTilesPointsClass[tileX].contains(tileY))
-                    {
-                        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                        strError+=QObject::tr("\nNot exists tile y: %1 for tile x: %2 in classes  file:\n%3")
-                                .arg(QString::number(tileY))
-                                .arg(QString::number(tileX)).arg(mClassesFileName);
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->close();
-                            delete(ptrProgress);
-                        }
-                        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                        mMpPtrGeometry=NULL;
-                        mZipFilePoints.close();
-                        return(false);
-                    }
-                    step++;
-                    if(ptrWidget!=NULL)
-                    {
-                        ptrProgress->setValue(step);
-                        qApp->processEvents();
-                    }
-                    int numberOfPoints=mTilesNop[tileX][tileY];
-                    QString tileTableName=mTilesName[tileX][tileY];
-                    if(!mZipFilePoints.setCurrentFile(tileTableName))
-                    {
-                        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                        strError+=QObject::tr("\nNot exists: %1 in file:\n%2\nError:\n%3")
-                                .arg(tileTableName).arg(mZipFileNamePoints)
-                                .arg(QString::number(mZipFilePoints.getZipError()));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->close();
-                            delete(ptrProgress);
-                        }
-                        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                        mMpPtrGeometry=NULL;
-                        mZipFilePoints.close();
-                        return(false);
-                    }
-                    QuaZipFile inPointsFile(&mZipFilePoints);
-                    if (!inPointsFile.open(QIODevice::ReadOnly))
-                    {
-                        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                        strError+=QObject::tr("\nError opening: %1 in file:\n%2\nError:\n%3")
-                                .arg(tileTableName).arg(mZipFileNamePoints)
-                                .arg(QString::number(mZipFilePoints.getZipError()));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->close();
-                            delete(ptrProgress);
-                        }
-                        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                        mMpPtrGeometry=NULL;
-                        mZipFilePoints.close();
-                        return(false);
-                    }
-                    QDataStream inPoints(&inPointsFile);
-                    int pos=0;
-                    QVector<PCFile::Point> pointsInTile(numberOfPoints);
-                    int numberOfRealPoints=0; // porque puede haber puntos fuera del wkt
-                    while(!inPoints.atEnd())
-                    {
-                        quint16 ix,iy;
-                        quint8 z_pc,z_pa,z_pb;
-                        inPoints>>ix>>iy>>z_pa>>z_pb>>z_pc;
-                        PCFile::Point pto;
-                        pto.setPositionInTile(pos);
-                        if(pos>mTilesPointsClass[tileX][tileY].size())
-                        {
-                            strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                            strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes  file:\n%4")
-                                    .arg(QString::number(pos)).arg(QString::number(tileX))
-                                    .arg(QString::number(tileY)).arg(mClassesFileName);
-                            if(ptrWidget!=NULL)
-                            {
-                                ptrProgress->close();
-                                delete(ptrProgress);
-                            }
-                            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                            mMpPtrGeometry=NULL;
-                            mZipFilePoints.close();
-                            return(false);
-                        }
-                        quint8 ptoClass=mTilesPointsClass[tileX][tileY][pos];
-                        pto.setClass(ptoClass);
-                        quint8 ptoClassNew=ptoClass;
-                        if(mTilesPointsClassNewByPos.contains(tileX))
-                        {
-                            if(mTilesPointsClassNewByPos[tileX].contains(tileY))
-                            {
-                                if(mTilesPointsClassNewByPos[tileX][tileY].contains(pos))
-                                {
-                                    ptoClassNew=mTilesPointsClassNewByPos[tileX][tileY][pos];
-                                }
-                            }
-                        }
-                        pto.setClassNew(ptoClassNew);
-                        pto.setCoordinates(ix,iy,z_pa,z_pb,z_pc);
-                        if(mExistsColor)
-                        {
-                            if(mNumberOfColorBytes==1)
-                            {
-                                quint8 color_r,color_g,color_b;
-                                inPoints>>color_r>>color_g>>color_b;
-                                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,color_r);
-                                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,color_g);
-                                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,color_b);
-                            }
-                            else
-                            {
-                                quint16 color_r,color_g,color_b;
-                                inPoints>>color_r>>color_g>>color_b;
-                                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,color_r);
-                                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,color_g);
-                                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,color_b);
-                            }
-                        }
-                        if(mExistsGpsTime)
-                        {
-                            quint8 gpsDowHourPackit;
-                            quint8 msb1,msb2,msb3;
-                            inPoints>>gpsDowHourPackit>>msb1>>msb2>>msb3;
-                            pto.setGpsTime(gpsDowHourPackit,msb1,msb2,msb3);
-                        }
-                        if(mExistsUserData)
-                        {
-                            quint8 userData;
-                            inPoints>>userData;
-                            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_USER_DATA,userData);
-                        }
-                        if(mExistsIntensity)
-                        {
-                            quint16 intensity;
-                            inPoints>>intensity;
-                            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_INTENSITY,intensity);
-                        }
-                        if(mExistsSourceId)
-                        {
-                            quint16 sourceId;
-                            inPoints>>sourceId;
-                            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_SOURCE_ID,sourceId);
-                        }
-                        if(mExistsNir)
-                        {
-                            if(mNumberOfColorBytes==1)
-                            {
-                                quint8 nir;
-                                inPoints>>nir;
-                                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_NIR,nir);
-                            }
-                            else
-                            {
-                                quint16 nir;
-                                inPoints>>nir;
-                                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_NIR,nir);
-                            }
-                        }
-                        if(mExistsReturn)
-                        {
-                            quint8 returnNumber;
-                            inPoints>>returnNumber;
-                            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURN,returnNumber);
-                        }
-                        if(mExistsReturns)
-                        {
-                            quint8 numberOfReturns;
-                            inPoints>>numberOfReturns;
-                            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURNS,numberOfReturns);
-                        }
-                        pos++;
-                        if(!tilesFullGeometry)
-                        {
-                            if(tilesOverlaps[tileX][tileY])
-                            {
-                                OGRGeometry* ptrPoint=NULL;
-                                ptrPoint=OGRGeometryFactory::createGeometry(wkbPoint);
-                                double x=tileX+ix/1000.;
-                                double y=tileY+iy/1000.;
-                                ((OGRPoint*)ptrPoint)->setX(x);
-                                ((OGRPoint*)ptrPoint)->setY(y);
-                                if(!mMpPtrGeometry->Contains(ptrPoint))
-                                {
-                                    OGRGeometryFactory::destroyGeometry(ptrPoint);
-                                    continue;
-                                }
-                                OGRGeometryFactory::destroyGeometry(ptrPoint);
-                            }
-                        }
-                        pointsInTile[numberOfRealPoints]=pto;
-                        numberOfRealPoints++;
-                    }
-                    inPointsFile.close();
-                    if(numberOfRealPoints<numberOfPoints)
-                    {
-                        pointsInTile.resize(numberOfRealPoints);
-                    }
-                    if(pointsInTile.size()>0)
-                    {
-                        mPointsByTile[tileX][tileY]=pointsInTile;
-                    }
-                    if(numberOfRealPoints>0)
-                    {
-                        tilesNumberOfPoints[tileX][tileY]=tilesNumberOfPoints[tileX][tileY]+numberOfRealPoints;
-                    }
-                }
-                iterTileX++;
+                int tileY=iterTileX.value()[i];
+                tasksFileIndex.push_back(fileIndex);
+                tasksTileX.push_back(tileX);
+                tasksTileY.push_back(tileY);
+                tasksNumberOfPoints.push_back(pointsQuery.getTileNumberOfPoints(fileIndex,tileX,tileY));
             }
+            iterTileX++;
         }
-        else
+        iterFiles++;
+    }
+    if(!prepareQueryThinning(pointsQuery,tilesByFileIndex,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsFromTiles");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    int numberOfTasks=tasksFileIndex.size();
+    QVector<int> tasksOrder(numberOfTasks);
+    for(int i=0;i<numberOfTasks;i++) tasksOrder[i]=i;
+    std::stable_sort(tasksOrder.begin(),tasksOrder.end(),
+                     [&tasksNumberOfPoints](int a,int b)
+    {return(tasksNumberOfPoints[a]>tasksNumberOfPoints[b]);});
+    QVector<QVector<PCFile::Point> > tasksPoints(numberOfTasks);
+    QVector<QString> tasksError(numberOfTasks);
+    QAtomicInt nextTask(0);
+    QAtomicInt numberOfProcessedTasks(0);
+    QAtomicInt canceled(0);
+    Progress* ptrProgress=NULL;
+    if(numberOfTasks>1)
+    {
+        QString title=QObject::tr("PointCloudFile::getPointsFromTiles");
+        QString msgGlobal=QObject::tr("Recovering points from %1 files and tiles")
+                .arg(QString::number(numberOfTasks));
+        ptrProgress=mPtrPCFManager->getProgressCallback()->createProgress(title,msgGlobal,numberOfTasks);
+    }
+    auto processTasks=[&](bool isCallerThread)
+    {
+        // un QuaZip por fichero y por hilo, se abre una vez y se reutiliza para sus tiles
+        QMap<int,QuaZip*> ptrZipFilesByFileIndex;
+        while(canceled.loadAcquire()==0)
         {
-            QWidget* ptrWidget=new QWidget();
-            mTilesXToProcess.clear();
-            mTilesYToProcess.clear();
-            QVector<int> tilesPosition;
-            QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
-            while(iterTileX!=iterFiles.value().end())
+            int taskPos=nextTask.fetchAndAddOrdered(1);
+            if(taskPos>=numberOfTasks) break;
+            int task=tasksOrder[taskPos];
+            int fileIndex=tasksFileIndex[task];
+            if(!ptrZipFilesByFileIndex.contains(fileIndex))
             {
-                int tileX=iterTileX.key();
-                if(!mTilesPointsClass.contains(tileX))
-                {
-                    strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                    strError+=QObject::tr("\nNot exists tile x: %1 in classes  file:\n%2")
-                            .arg(QString::number(tileX)).arg(mClassesFileName);
-                    if(ptrWidget!=NULL)
-                    {
-                        ptrProgress->close();
-                        delete(ptrProgress);
-                    }
-                    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                    mMpPtrGeometry=NULL;
-                    return(false);
-                }
-                for(int i=0;i<iterTileX.value().size();i++)
+                QuaZip* ptrZipFile=new QuaZip(mZipFilePointsByIndex.value(fileIndex));
+                ptrZipFilesByFileIndex[fileIndex]=ptrZipFile;
+                if(!ptrZipFile->open(QuaZip::mdUnzip))
                 {
-                    int tileY=iterTileX.value()[i];
-                    if(!mTilesPointsClass[tileX].contains(tileY))
-                    {
-                        strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                        strError+=QObject::tr("\nNot exists tile y: %1 for tile x: %2 in classes  file:\n%3")
-                                .arg(QString::number(tileY))
-                                .arg(QString::number(tileX)).arg(mClassesFileName);
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->close();
-                            delete(ptrProgress);
-                        }
-                        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                        mMpPtrGeometry=NULL;
-                        return(false);
-                    }
-                    mTilesXToProcess.push_back(tileX);
-                    mTilesYToProcess.push_back(tileY);
-                    tilesPosition.push_back(tilesPosition.size());
+                    tasksError[task]=QObject::tr("Error opening file:\n%1\nError:\n%2")
+                            .arg(mZipFilePointsByIndex.value(fileIndex))
+                            .arg(QString::number(ptrZipFile->getZipError()));
+                    canceled.storeRelease(1);
+                    break;
                 }
-                iterTileX++;
             }
-            mMpTilesNumberOfPointsInFile.clear();
-
-            if(mPtrMpProgressDialog!=NULL)
+            QString strTaskError;
+            if(!pointsQuery.readTilePoints(*ptrZipFilesByFileIndex[fileIndex],
+                                           fileIndex,
+                                           tasksTileX[task],
+                                           tasksTileY[task],
+                                           tasksPoints[task],
+                                           strTaskError))
             {
-                delete(mPtrMpProgressDialog);
+                tasksError[task]=strTaskError;
+                canceled.storeRelease(1);
+                break;
             }
-            if(ptrWidget!=NULL)
-                mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-            else
-                mPtrMpProgressDialog=new QProgressDialog();
-            QString dialogText=QObject::tr("Getting points from tiles in classes file:\n%1")
-                    .arg(mClassesFileName);
-            dialogText+=QObject::tr("\nNumber of tiles to process:%1").arg(tilesPosition.size());
-            dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-            mPtrMpProgressDialog->setLabelText(dialogText);
-            mPtrMpProgressDialog->setModal(true);
-            QFutureWatcher<void> futureWatcher;
-            QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-            QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-            QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-            QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-            //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-            futureWatcher.setFuture(QtConcurrent::map(tilesPosition,
-                                                      [this](int& data)
-            {mpGetPointsFromWktGeometryByTilePosition(data);}));
-            mStrErrorMpProgressDialog="";
-            mPtrMpProgressDialog->exec();
-            futureWatcher.waitForFinished();
-            delete(mPtrMpProgressDialog);
-            mPtrMpProgressDialog=NULL;
-            if(!mStrErrorMpProgressDialog.isEmpty())
+            int numberOfProcessed=numberOfProcessedTasks.fetchAndAddOrdered(1)+1;
+            if(ptrProgress!=NULL)
             {
-                strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-                strError+=QObject::tr("\nError adding tiles geometry");
-                strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
-                OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                mMpPtrGeometry=NULL;
-                return(false);
+                if(isCallerThread)
+                {
+                    ptrProgress->setValue(numberOfProcessed);
+                }
+                if(ptrProgress->wasCanceled())
+                {
+                    tasksError[task]=QObject::tr("Process canceled by user");
+                    canceled.storeRelease(1);
+                }
             }
-            mTilesXToProcess.clear();
-            mTilesYToProcess.clear();
-//            pointsByTileByFileId[fileIndex]=mPointsByTile;
-//            {
-//                QMap<int,QMap<int,int> >::iterator iterX=mMpTilesNumberOfPointsInFile.begin();
-//                while(iterX!=mMpTilesNumberOfPointsInFile.end())
-//                {
-//                    int tileX=iterX.key();
-//                    QMap<int,int>::iterator iterY=iterX.value().begin();
-//                    while(iterY!=iterX.value().end())
-//                    {
-//                        int tileY=iterY.key();
-//                        int numberOfPreviousPoints=0;
-//                        if(tilesNumberOfPoints.contains(tileX))
-//                        {
-//                            if(tilesNumberOfPoints[tileX].contains(tileY))
-//                            {
-//                                numberOfPreviousPoints=tilesNumberOfPoints[tileX][tileY];
-//                            }
-//                        }
-//                        int numberOfPoints=mMpTilesNumberOfPointsInFile[tileX][tileY];
-//                        tilesNumberOfPoints[tileX][tileY]=numberOfPreviousPoints+numberOfPoints;
-//                        iterY++;
-//                    }
-//                    iterX++;
-//                }
-//            }
         }
-        pointsByTileByFileId[fileIndex]=mPointsByTile;
+        QMap<int,QuaZip*>::iterator iterZipFiles=ptrZipFilesByFileIndex.begin();
+        while(iterZipFiles!=ptrZipFilesByFileIndex.end())
+        {
+            if(iterZipFiles.value()->isOpen()) iterZipFiles.value()->close();
+            delete(iterZipFiles.value());
+            iterZipFiles++;
+        }
+    };
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMin(QThread::idealThreadCount(),numberOfTasks);
+    }
+    // el hilo llamante tambien procesa tareas: la consulta avanza aunque el pool este ocupado
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
+    {
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks(false);}));
+    }
+    processTasks(true);
+    for(int nt=0;nt<futures.size();nt++)
+    {
+        futures[nt].waitForFinished();
+    }
+    if(ptrProgress!=NULL)
+    {
+        delete(ptrProgress);
+    }
+    for(int task=0;task<numberOfTasks;task++)
+    {
+        if(!tasksError[task].isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::getPointsFromTiles");
+            strError+=QObject::tr("\nError recovering points from tile X: %1 tile Y: %2 in file:\n%3\nError:\n%4")
+                    .arg(QString::number(tasksTileX[task]))
+                    .arg(QString::number(tasksTileY[task]))
+                    .arg(mZipFilePointsByIndex.value(tasksFileIndex[task]))
+                    .arg(tasksError[task]);
+            return(false);
+        }
+    }
+    for(int task=0;task<numberOfTasks;task++)
+    {
+        int numberOfPoints=tasksPoints[task].size();
+        if(numberOfPoints==0) continue;
+        int fileIndex=tasksFileIndex[task];
+        int tileX=tasksTileX[task];
+        int tileY=tasksTileY[task];
+        pointsByTileByFileId[fileIndex][tileX][tileY]=tasksPoints[task];
+        tilesNumberOfPoints[tileX][tileY]=tilesNumberOfPoints[tileX][tileY]+numberOfPoints;
+    }
+    {
+        QMap<int,QMap<int,int> >::iterator iterX=tilesNumberOfPoints.begin();
+        while(iterX!=tilesNumberOfPoints.end())
         {
-            QMap<int,QMap<int,int> >::iterator iterX=mMpTilesNumberOfPointsInFile.begin();
-            while(iterX!=mMpTilesNumberOfPointsInFile.end())
+            int tileX=iterX.key();
+            QMap<int,int>::iterator iterY=iterX.value().begin();
+            while(iterY!=iterX.value().end())
             {
-                int tileX=iterX.key();
-                QMap<int,int>::iterator iterY=iterX.value().begin();
-                while(iterY!=iterX.value().end())
+                int tileY=iterY.key();
+                if(iterY.value()==0)
                 {
-                    int tileY=iterY.key();
-                    int numberOfPreviousPoints=0;
-                    if(tilesNumberOfPoints.contains(tileX))
+                    tilesTableName[tileX].remove(tileY);
+                    if(tilesTableName[tileX].size()==0)
                     {
-                        if(tilesNumberOfPoints[tileX].contains(tileY))
-                        {
-                            numberOfPreviousPoints=tilesNumberOfPoints[tileX][tileY];
-                        }
+                        tilesTableName.remove(tileX);
                     }
-                    int numberOfPoints=mMpTilesNumberOfPointsInFile[tileX][tileY];
-                    tilesNumberOfPoints[tileX][tileY]=numberOfPreviousPoints+numberOfPoints;
-                    iterY++;
                 }
-                iterX++;
+                iterY++;
             }
+            iterX++;
         }
-        mZipFilePoints.close();
-        iterFiles++;
     }
-    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-    mMpPtrGeometry=NULL;
-    if(ptrWidget!=NULL)
+    return(true);
+}
+
+bool PointCloudFile::getPointsInBox(double minX,
+                                    double minY,
+                                    double maxX,
+                                    double maxY,
+                                    QMap<int, QMap<int, QString> > &tilesTableName,
+                                    QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                    QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                    QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    return(getPointsInBox(minX,minY,maxX,maxY,
+                          POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE,
+                          (POINTCLOUDFILE_HEIGHT_MAXIMUM_VALID_VALUE),
+                          tilesTableName,
+                          pointsByTileByFileId,
+                          existsFieldsByFileId,
+                          strError));
+}
+
+bool PointCloudFile::getPointsInBox(double minX,
+                                    double minY,
+                                    double maxX,
+                                    double maxY,
+                                    double minZ,
+                                    double maxZ,
+                                    QMap<int, QMap<int, QString> > &tilesTableName,
+                                    QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                    QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                    QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    PointsFilter pointsFilter;
+    return(getPointsInBox(minX,minY,maxX,maxY,minZ,maxZ,
+                          tilesTableName,
+                          pointsByTileByFileId,
+                          existsFieldsByFileId,
+                          pointsFilter,
+                          strError));
+}
+
+bool PointCloudFile::getPointsInBox(double minX,
+                                    double minY,
+                                    double maxX,
+                                    double maxY,
+                                    double minZ,
+                                    double maxZ,
+                                    QMap<int, QMap<int, QString> > &tilesTableName,
+                                    QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                    QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                    PointsFilter &pointsFilter,
+                                    QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    tilesTableName.clear();
+    pointsByTileByFileId.clear();
+    existsFieldsByFileId.clear();
+    QString strAuxError;
+    QMap<int,QMap<int,QVector<int> > > tilesBoxBounds;
+    if(!getTilesBoxBounds(minX,
+                          minY,
+                          maxX,
+                          maxY,
+                          minZ,
+                          maxZ,
+                          tilesTableName,
+                          tilesBoxBounds,
+                          strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInBox");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    PointsQuery pointsQuery;
+    pointsQuery.setPointsFilter(pointsFilter);
+    pointsQuery.setTilesBoxBounds(tilesBoxBounds);
+    if(!getPointsFromTiles(tilesTableName,
+                           pointsQuery,
+                           pointsByTileByFileId,
+                           existsFieldsByFileId,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInBox");
+        strError+=QObject::tr("\nError recovering points from tiles:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getPointsInCapsule(QVector<double> firstPoint,
+                                        QVector<double> secondPoint,
+                                        int pointCrsEpsgCode,
+                                        QString pointCrsProj4String,
+                                        double radius,
+                                        int numberOfPoints,
+                                        QVector<Point> &points,
+                                        QVector<int> &tilesX,
+                                        QVector<int> &tilesY,
+                                        QVector<double> &distances,
+                                        QVector<int> &fileIdPoints,
+                                        QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                        QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    QString strAuxError;
+    if(firstPoint.size()!=3||secondPoint.size()!=3)
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCapsule");
+        strError+=QObject::tr("\nSegment points must be three coordinates");
+        return(false);
+    }
+    QVector<QVector<double> > auxPoints;
+    auxPoints.push_back(firstPoint);
+    auxPoints.push_back(secondPoint);
+    if(!transformPointsToProjectCrs(auxPoints,
+                                    pointCrsEpsgCode,
+                                    pointCrsProj4String,
+                                    strAuxError))
     {
-        ptrProgress->close();
-        delete(ptrProgress);
+        strError=QObject::tr("PointCloudFile::getPointsInCapsule");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(!getPointsInShape(auxPoints[0],
+                         auxPoints[1],
+                         radius,
+                         false,
+                         numberOfPoints,
+                         points,
+                         tilesX,
+                         tilesY,
+                         distances,
+                         fileIdPoints,
+                         existsFieldsByFileId,
+                         strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCapsule");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getPointsInCylinder(QVector<double> center,
+                                         int pointCrsEpsgCode,
+                                         QString pointCrsProj4String,
+                                         double radius,
+                                         double minZ,
+                                         double maxZ,
+                                         int numberOfPoints,
+                                         QVector<Point> &points,
+                                         QVector<int> &tilesX,
+                                         QVector<int> &tilesY,
+                                         QVector<double> &distances,
+                                         QVector<int> &fileIdPoints,
+                                         QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                         QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    QString strAuxError;
+    if(center.size()!=2)
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCylinder");
+        strError+=QObject::tr("\nCenter must be two coordinates");
+        return(false);
+    }
+    if(minZ>maxZ)
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCylinder");
+        strError+=QObject::tr("\nMinimum height: %1 is greater than maximum height: %2")
+                .arg(QString::number(minZ,'f',3)).arg(QString::number(maxZ,'f',3));
+        return(false);
+    }
+    QVector<QVector<double> > auxPoints(2);
+    auxPoints[0]<<center[0]<<center[1]<<minZ;
+    auxPoints[1]<<center[0]<<center[1]<<maxZ;
+    if(!transformPointsToProjectCrs(auxPoints,
+                                    pointCrsEpsgCode,
+                                    pointCrsProj4String,
+                                    strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCylinder");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    // eje vertical por el centro transformado
+    auxPoints[1][0]=auxPoints[0][0];
+    auxPoints[1][1]=auxPoints[0][1];
+    if(!getPointsInShape(auxPoints[0],
+                         auxPoints[1],
+                         radius,
+                         true,
+                         numberOfPoints,
+                         points,
+                         tilesX,
+                         tilesY,
+                         distances,
+                         fileIdPoints,
+                         existsFieldsByFileId,
+                         strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInCylinder");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getPointsInShape(QVector<double> firstPoint,
+                                      QVector<double> secondPoint,
+                                      double radius,
+                                      bool verticalCylinder,
+                                      int numberOfPoints,
+                                      QVector<Point> &points,
+                                      QVector<int> &tilesX,
+                                      QVector<int> &tilesY,
+                                      QVector<double> &distances,
+                                      QVector<int> &fileIdPoints,
+                                      QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                      QString &strError)
+{
+    // Caja envolvente con z: el rango de alturas descarta tiles completos con sus estadisticas
+    // y la caja descarta puntos con los valores cuantizados. Despues, distancia exacta al
+    // segmento, o en planta al eje si es un cilindro vertical
+    QString strAuxError;
+    points.clear();
+    tilesX.clear();
+    tilesY.clear();
+    distances.clear();
+    fileIdPoints.clear();
+    existsFieldsByFileId.clear();
+    if(radius<=0.)
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInShape");
+        strError+=QObject::tr("\nRadius must be greater than zero");
+        return(false);
+    }
+    double minX=qMin(firstPoint[0],secondPoint[0])-radius;
+    double maxX=qMax(firstPoint[0],secondPoint[0])+radius;
+    double minY=qMin(firstPoint[1],secondPoint[1])-radius;
+    double maxY=qMax(firstPoint[1],secondPoint[1])+radius;
+    double minZ=qMin(firstPoint[2],secondPoint[2]);
+    double maxZ=qMax(firstPoint[2],secondPoint[2]);
+    if(!verticalCylinder)
+    {
+        minZ-=radius;
+        maxZ+=radius;
+    }
+    PointsFilter pointsFilter;
+    pointsFilter.setHeightRange(minZ,maxZ);
+    QMap<int, QMap<int, QString> > tilesTableName;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > > pointsByTileByFileId;
+    if(!getPointsInBox(minX,minY,maxX,maxY,minZ,maxZ,
+                       tilesTableName,
+                       pointsByTileByFileId,
+                       existsFieldsByFileId,
+                       pointsFilter,
+                       strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInShape");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
-    {
-        QMap<int,QMap<int,int> >::iterator iterX=tilesNumberOfPoints.begin();
-        while(iterX!=tilesNumberOfPoints.end())
+    double ax=firstPoint[0],ay=firstPoint[1],az=firstPoint[2];
+    double abx=secondPoint[0]-ax,aby=secondPoint[1]-ay,abz=secondPoint[2]-az;
+    double squaredLength=abx*abx+aby*aby+abz*abz;
+    double squaredRadius=radius*radius;
+    QVector<QPair<double,int> > candidates; // distancia al cuadrado, posicion
+    QVector<Point> candidatesPoints;
+    QVector<int> candidatesTilesX;
+    QVector<int> candidatesTilesY;
+    QVector<int> candidatesFileIds;
+    QMap<int, QMap<int, QMap<int, QVector<Point> > > >::const_iterator iterFiles=pointsByTileByFileId.begin();
+    while(iterFiles!=pointsByTileByFileId.end())
+    {
+        int fileId=iterFiles.key();
+        QMap<int,QMap<int,QVector<Point> > >::const_iterator iterX=iterFiles.value().begin();
+        while(iterX!=iterFiles.value().end())
         {
             int tileX=iterX.key();
-            QMap<int,int>::iterator iterY=iterX.value().begin();
+            QMap<int,QVector<Point> >::const_iterator iterY=iterX.value().begin();
             while(iterY!=iterX.value().end())
             {
                 int tileY=iterY.key();
-                if(iterY.value()==0)
+                QVector<Point> vPoints=iterY.value();
+                for(int np=0;np<vPoints.size();np++)
                 {
-                    tilesTableName[tileX].remove(tileY);
-                    if(tilesTableName[tileX].size()==0)
+                    double dx=tileX+vPoints[np].getIx()/1000.-ax;
+                    double dy=tileY+vPoints[np].getIy()/1000.-ay;
+                    double dz=vPoints[np].getZ()-az;
+                    double squaredDistance;
+                    if(verticalCylinder)
                     {
-                        tilesTableName.remove(tileX);
+                        squaredDistance=dx*dx+dy*dy;
+                    }
+                    else
+                    {
+                        double t=0.;
+                        if(squaredLength>0.)
+                        {
+                            t=(dx*abx+dy*aby+dz*abz)/squaredLength;
+                            if(t<0.) t=0.;
+                            else if(t>1.) t=1.;
+                        }
+                        dx-=t*abx;
+                        dy-=t*aby;
+                        dz-=t*abz;
+                        squaredDistance=dx*dx+dy*dy+dz*dz;
                     }
+                    if(squaredDistance>squaredRadius) continue;
+                    candidates.push_back(qMakePair(squaredDistance,candidatesPoints.size()));
+                    candidatesPoints.push_back(vPoints[np]);
+                    candidatesTilesX.push_back(tileX);
+                    candidatesTilesY.push_back(tileY);
+                    candidatesFileIds.push_back(fileId);
                 }
                 iterY++;
             }
             iterX++;
         }
+        iterFiles++;
+    }
+    int k=numberOfPoints;
+    if(k<=0||k>candidates.size()) k=candidates.size();
+    std::partial_sort(candidates.begin(),candidates.begin()+k,candidates.end());
+    points.resize(k);
+    tilesX.resize(k);
+    tilesY.resize(k);
+    distances.resize(k);
+    fileIdPoints.resize(k);
+    for(int nc=0;nc<k;nc++)
+    {
+        int position=candidates[nc].second;
+        points[nc]=candidatesPoints[position];
+        tilesX[nc]=candidatesTilesX[position];
+        tilesY[nc]=candidatesTilesY[position];
+        distances[nc]=sqrt(candidates[nc].first);
+        fileIdPoints[nc]=candidatesFileIds[position];
+    }
+    return(true);
+}
+
+bool PointCloudFile::getPointsInSphere(QVector<double> center,
+                                       int pointCrsEpsgCode,
+                                       QString pointCrsProj4String,
+                                       double radius,
+                                       int numberOfPoints,
+                                       QVector<Point> &points,
+                                       QVector<int> &tilesX,
+                                       QVector<int> &tilesY,
+                                       QVector<double> &distances,
+                                       QVector<int> &fileIdPoints,
+                                       QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                       QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    QString strAuxError;
+    if(center.size()!=3)
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInSphere");
+        strError+=QObject::tr("\nCenter must be three coordinates");
+        return(false);
+    }
+    QVector<QVector<double> > auxPoints;
+    auxPoints.push_back(center);
+    if(!transformPointsToProjectCrs(auxPoints,
+                                    pointCrsEpsgCode,
+                                    pointCrsProj4String,
+                                    strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInSphere");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    // esfera: capsula de segmento degenerado
+    if(!getPointsInShape(auxPoints[0],
+                         auxPoints[0],
+                         radius,
+                         false,
+                         numberOfPoints,
+                         points,
+                         tilesX,
+                         tilesY,
+                         distances,
+                         fileIdPoints,
+                         existsFieldsByFileId,
+                         strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getPointsInSphere");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
     return(true);
 }
@@ -3730,6 +5025,7 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
 bool PointCloudFile::getReachedMaximumNumberOfPoints(bool &reachedMaximumNumberOfPoints,
                                                      QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
     reachedMaximumNumberOfPoints=false;
     if(mMaximumNumberOfPoints!=POINTCLOUDFILE_WITHOUT_MAXIMUM_NUMBER_OF_POINTS_LIMITS
             &&mNumberOfPoints>mMaximumNumberOfPoints)
@@ -3750,8 +5046,9 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                                               bool tilesFullGeometry,
                                               QString &strError)
 {
-    QWidget* ptrWidget=new QWidget();
-    QProgressDialog* ptrProgress=NULL;
+    QReadLocker dataLocker(&mDataLock);
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
+    Progress* ptrProgress=NULL;
     tilesTableName.clear();
     pointsByTileByFileId.clear();
     existsFieldsByFileId.clear();
@@ -3819,16 +5116,12 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
     }
     int numberOfSteps=numberOfFilesAndTileToProcess;
     QDir auxDir=QDir::currentPath();
-    if(ptrWidget!=NULL)
+    if(ptrProgressCallback!=NULL)
     {
         QString title=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
         QString msgGlobal=QObject::tr("Recovering points from %1 files and tiles")
                 .arg(QString::number(numberOfSteps));
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfSteps);
     }
     int step=0;
     QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
@@ -3841,36 +5134,28 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
             strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
             strError+=QObject::tr("\nThere is no classes file for index: %1")
                     .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
+            if(ptrProgress!=NULL)
             {
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
         }
         QString classesFileName=mClassesFileByIndex[fileIndex];
-        QFile pointsClassFile(classesFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
+        PointsClassesFile classesFile;
+        if(!readClassesFile(fileIndex,classesFile,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(classesFileName);
-            if(ptrWidget!=NULL)
+            strError+=QObject::tr("\nError reading classes file:\n%1\nError:\n%2").arg(classesFileName).arg(strAuxError);
+            if(ptrProgress!=NULL)
             {
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
         }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        QMap<int,QMap<int,QVector<quint8> > > tilesPointsClass;
-        QMap<int,QMap<int,QMap<int,quint8> > > tilesPointsClassNewByPos; // se guarda vacío
-        QMap<int,QMap<int,int> > tilesNop;
-        inPointsClass>>tilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>tilesPointsClass;
-        inPointsClass>>tilesPointsClassNewByPos;
-        pointsClassFile.close();
+        QMap<QString,bool>& existsFields=classesFile.getExistsFields();
+        QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+        QMap<int,QMap<int,int> >& tilesNop=classesFile.getTilesNop();
         bool existsColor=existsFields[POINTCLOUDFILE_PARAMETER_COLOR];
         bool existsGpsTime=existsFields[POINTCLOUDFILE_PARAMETER_GPS_TIME];
         bool existsUserData=existsFields[POINTCLOUDFILE_PARAMETER_USER_DATA];
@@ -3884,9 +5169,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
             strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
             strError+=QObject::tr("\nThere is no points file for index: %1")
                     .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
+            if(ptrProgress!=NULL)
             {
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
@@ -3899,9 +5183,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
             strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
             strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
                     .arg(zipFileNamePoints).arg(QString::number(zipFilePoints.getZipError()));
-            if(ptrWidget!=NULL)
+            if(ptrProgress!=NULL)
             {
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
@@ -3915,9 +5198,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                 strError=QObject::tr("PointCloudFile::getPointsFromWktGeometry");
                 strError+=QObject::tr("\nNot exists tile x: %1 in classes  file:\n%2")
                         .arg(QString::number(tileX)).arg(classesFileName);
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
@@ -3931,18 +5213,16 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                     strError+=QObject::tr("\nNot exists tile y: %1 for tile x: %2 in classes  file:\n%3")
                             .arg(QString::number(tileY))
                             .arg(QString::number(tileX)).arg(classesFileName);
-                    if(ptrWidget!=NULL)
+                    if(ptrProgress!=NULL)
                     {
-                        ptrProgress->close();
                         delete(ptrProgress);
                     }
                     return(false);
                 }
                 step++;
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(step);
-                    qApp->processEvents();
                 }
                 int numberOfPoints=tilesNop[tileX][tileY];
                 QString tileTableName=mTilesName[tileX][tileY];
@@ -3952,9 +5232,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                     strError+=QObject::tr("\nNot exists: %1 in file:\n%2\nError:\n%3")
                             .arg(tileTableName).arg(zipFileNamePoints)
                             .arg(QString::number(zipFilePoints.getZipError()));
-                    if(ptrWidget!=NULL)
+                    if(ptrProgress!=NULL)
                     {
-                        ptrProgress->close();
                         delete(ptrProgress);
                     }
                     return(false);
@@ -3966,9 +5245,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                     strError+=QObject::tr("\nError opening: %1 in file:\n%2\nError:\n%3")
                             .arg(tileTableName).arg(zipFileNamePoints)
                             .arg(QString::number(zipFilePoints.getZipError()));
-                    if(ptrWidget!=NULL)
+                    if(ptrProgress!=NULL)
                     {
-                        ptrProgress->close();
                         delete(ptrProgress);
                     }
                     return(false);
@@ -4008,9 +5286,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
                         strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes  file:\n%4")
                                 .arg(QString::number(pos)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY)).arg(classesFileName);
-                        if(ptrWidget!=NULL)
+                        if(ptrProgress!=NULL)
                         {
-                            ptrProgress->close();
                             delete(ptrProgress);
                         }
                         return(false);
@@ -4129,9 +5406,8 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
     {
         OGRGeometryFactory::destroyGeometry(ptrGeometry);
     }
-    if(ptrWidget!=NULL)
+    if(ptrProgress!=NULL)
     {
-        ptrProgress->close();
         delete(ptrProgress);
     }
     return(true);
@@ -4141,6 +5417,7 @@ bool PointCloudFile::getPointsFromWktGeometry(QString wktGeometry,
 bool PointCloudFile::getROIsWktGeometry(QMap<QString,QString> &values,
                                         QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
     values.clear();
     if(mPtrROIs.size()>0
             &&(mROIsWkt.size()!=mPtrROIs.size()))
@@ -4159,311 +5436,891 @@ bool PointCloudFile::getROIsWktGeometry(QMap<QString,QString> &values,
                     strError+=QObject::tr("\nError exporting geometry to wkt for ROI id:\n%1").arg(roiId);
                     return(false);
                 }
-                QString roiWkt=QString::fromLatin1(ptrWKT);
-                mROIsWkt[roiId]=roiWkt;
+                QString roiWkt=QString::fromLatin1(ptrWKT);
+                mROIsWkt[roiId]=roiWkt;
+            }
+            iterPtrRois++;
+        }
+    }
+    values=mROIsWkt;
+    return(true);
+}
+
+bool PointCloudFile::getTilesBoxBounds(double minX,
+                                       double minY,
+                                       double maxX,
+                                       double maxY,
+                                       double minZ,
+                                       double maxZ,
+                                       QMap<int, QMap<int, QString> > &tilesTableName,
+                                       QMap<int, QMap<int, QVector<int> > > &tilesBoxBounds,
+                                       QString &strError)
+{
+    // Caja en el CRS del proyecto, sin OGR: tiles por aritmetica de malla y
+    // recorte de puntos comparando ix, iy, z cuantizados con limites enteros
+    tilesTableName.clear();
+    tilesBoxBounds.clear();
+    if(minX>maxX||minY>maxY||minZ>maxZ)
+    {
+        strError=QObject::tr("PointCloudFile::getTilesBoxBounds");
+        strError+=QObject::tr("\nInvalid box, minimum values must be lower than maximum values");
+        return(false);
+    }
+    double epsilon=POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE;
+    bool filterByZ=false;
+    int izMin=0;
+    int izMax=POINTCLOUDFILE_QUANTIZED_Z_MAXIMUM_VALUE;
+    if(minZ>POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)
+    {
+        izMin=qCeil((minZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.-epsilon);
+        filterByZ=true;
+    }
+    if(maxZ<(POINTCLOUDFILE_HEIGHT_MAXIMUM_VALID_VALUE))
+    {
+        izMax=qFloor((maxZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.+epsilon);
+        filterByZ=true;
+    }
+    int gridSize=qRound(mGridSize);
+    int tileSize=gridSize*1000;
+    int minTileX=getTileCoordinate(minX);
+    int maxTileX=getTileCoordinate(maxX);
+    int minTileY=getTileCoordinate(minY);
+    int maxTileY=getTileCoordinate(maxY);
+    for(int tileX=minTileX;tileX<=maxTileX;tileX+=gridSize)
+    {
+        if(!mTilesName.contains(tileX)) continue;
+        int ixMin=qCeil((minX-tileX)*1000.-epsilon);
+        int ixMax=qFloor((maxX-tileX)*1000.+epsilon);
+        for(int tileY=minTileY;tileY<=maxTileY;tileY+=gridSize)
+        {
+            if(!mTilesName[tileX].contains(tileY)) continue;
+            int iyMin=qCeil((minY-tileY)*1000.-epsilon);
+            int iyMax=qFloor((maxY-tileY)*1000.+epsilon);
+            tilesTableName[tileX][tileY]=mTilesName[tileX][tileY];
+            if(!filterByZ
+                    &&ixMin<=0&&iyMin<=0
+                    &&ixMax>=tileSize&&iyMax>=tileSize)
+            {
+                continue;
+            }
+            QVector<int> boxBounds(6);
+            boxBounds[0]=ixMin;
+            boxBounds[1]=ixMax;
+            boxBounds[2]=iyMin;
+            boxBounds[3]=iyMax;
+            boxBounds[4]=izMin;
+            boxBounds[5]=izMax;
+            tilesBoxBounds[tileX][tileY]=boxBounds;
+        }
+    }
+    return(true);
+}
+
+bool PointCloudFile::getTilesPolygonEdgesFromWktGeometry(QString wktGeometry,
+                                                         int geometryCrsEpsgCode,
+                                                         QString geometryCrsProj4String,
+                                                         QVector<QString> &ignoreTilesTableName,
+                                                         bool tilesFullGeometry,
+                                                         QMap<int, QMap<int, QString> > &tilesTableName,
+                                                         QMap<int, QMap<int, QVector<float> > > &tilesPolygonEdges,
+                                                         QString &strError)
+{
+    tilesTableName.clear();
+    tilesPolygonEdges.clear();
+    QString strAuxError;
+    QMap<int,QMap<int,bool> > tilesOverlaps;
+    OGRGeometry* ptrGeometry=NULL;
+    wktGeometry=wktGeometry.toLower();
+    if(wktGeometry.contains("multipolygon"))
+    {
+        ptrGeometry=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
+    }
+    else if(wktGeometry.contains("polygon"))
+    {
+        ptrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
+    }
+    wktGeometry=wktGeometry.toUpper();
+    if(ptrGeometry==NULL)
+    {
+        strError=QObject::tr("PointCloudFile::getTilesPolygonEdgesFromWktGeometry");
+        strError+=QObject::tr("\nNot valid geometry from WKT: %1").arg(wktGeometry);
+        return(false);
+    }
+    std::string stdStringWktGeometry=wktGeometry.toStdString();
+    const char* constCharWktGeometry = stdStringWktGeometry.c_str();
+    if(OGRERR_NONE!=ptrGeometry->importFromWkt(&constCharWktGeometry))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesPolygonEdgesFromWktGeometry");
+        strError+=QObject::tr("\nError making geometry from WKT:\n%1").arg(wktGeometry);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
+    }
+    if(!transformGeometryToProjectCrs(&ptrGeometry,
+                                      geometryCrsEpsgCode,
+                                      geometryCrsProj4String,
+                                      strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesPolygonEdgesFromWktGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
+    }
+    if(!getTilesNamesFromGeometry(tilesTableName,
+                                  ignoreTilesTableName,
+                                  ptrGeometry,
+                                  tilesOverlaps,
+                                  strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesPolygonEdgesFromWktGeometry");
+        strError+=QObject::tr("\nError recovering tiles from wkt:\n%1\nError:\n%2")
+                .arg(wktGeometry).arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
+    }
+    if(!tilesFullGeometry)
+    {
+        if(!setTilesPolygonEdges(ptrGeometry,
+                                 tilesOverlaps,
+                                 tilesPolygonEdges,
+                                 strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::getTilesPolygonEdgesFromWktGeometry");
+            strError+=QObject::tr("\nError clipping geometry to tiles:\n%1").arg(strAuxError);
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
+            return(false);
+        }
+    }
+    OGRGeometryFactory::destroyGeometry(ptrGeometry);
+    return(true);
+}
+
+bool PointCloudFile::getUserCrsDescription(int crsEpsgCode,
+                                           QString crsProj4String,
+                                           QString &crsDescription,
+                                           QString &strError)
+{
+    // CRS de usuario resueltos por codigo EPSG y PROJ4, para no repetir appendUserCrs en cada consulta
+    crsDescription.clear();
+    if(crsEpsgCode!=-1&&crsEpsgCode==mSRID)
+    {
+        crsDescription=mCrsDescription;
+        return(true);
+    }
+    QString strAuxError;
+    QString key=QString::number(crsEpsgCode)+POINTCLOUDFILE_PROJECT_STRING_SEPARATOR+crsProj4String;
+    QMutexLocker locker(&mCrsMutex);
+    if(mCrsDescriptionByUserCrs.contains(key))
+    {
+        crsDescription=mCrsDescriptionByUserCrs[key];
+        return(true);
+    }
+    if(crsEpsgCode!=-1)
+    {
+        if(!mPtrCrsTools->appendUserCrs(crsEpsgCode,
+                                        crsDescription,
+                                        strAuxError))
+        {
+            if(!mPtrCrsTools->appendUserCrs(crsProj4String,//proj4
+                                            crsDescription,
+                                            strAuxError))
+            {
+                strError=QObject::tr("PointCloudFile::getUserCrsDescription");
+                strError+=QObject::tr("\nInvalid CRS From EPSG code: %1 and PROJ4:\n%2")
+                        .arg(QString::number(crsEpsgCode)).arg(crsProj4String);
+                return(false);
+            }
+        }
+    }
+    else
+    {
+        if(!mPtrCrsTools->appendUserCrs(crsProj4String,//proj4
+                                        crsDescription,
+                                        strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::getUserCrsDescription");
+            strError+=QObject::tr("\nInvalid CRS From PROJ4:\n%1").arg(crsProj4String);
+            return(false);
+        }
+    }
+    mCrsDescriptionByUserCrs[key]=crsDescription;
+    return(true);
+}
+
+bool PointCloudFile::getTilesNamesFromWktGeometry(QString wktGeometry,
+                                                       int geometryCrsEpsgCode,
+                                                       QString geometryCrsProj4String,
+                                                       QMap<int, QMap<int, QString> > &tilesTableName,
+                                                       QVector<QString> &ignoreTilesTableName,
+                                                       bool tilesFullGeometry,
+                                                       OGRGeometry** ptrGeometry,
+                                                       QMap<int, QMap<int, bool> > &tilesOverlaps,
+                                                       QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    tilesTableName.clear();
+    tilesOverlaps.clear();
+//    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
+//    char *charsWktGeometry = byteArrayWktGeometry.data();
+//    OGRGeometry* ptrGeometry;
+    bool validGeometry=false;
+    QString strAuxError;
+    wktGeometry=wktGeometry.toLower();
+    if(wktGeometry.toLower().contains("multipolygon"))
+    {
+        (*ptrGeometry)=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
+        validGeometry=true;
+    }
+    else if(wktGeometry.toLower().contains("polygon"))
+    {
+        (*ptrGeometry)=OGRGeometryFactory::createGeometry(wkbPolygon);
+        validGeometry=true;
+    }
+    wktGeometry=wktGeometry.toUpper();
+    if(!validGeometry)
+    {
+        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
+        strError+=QObject::tr("\nNot valid geometry from WKT: %1").arg(wktGeometry);
+        return(false);
+    }
+    std::string stdStringWktGeometry=wktGeometry.toStdString();
+    const char* constCharWktGeometry = stdStringWktGeometry.c_str();
+    if(OGRERR_NONE!=(*ptrGeometry)->importFromWkt(&constCharWktGeometry))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
+        strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
+        return(false);
+    }
+    if(!transformGeometryToProjectCrs(ptrGeometry,
+                                      geometryCrsEpsgCode,
+                                      geometryCrsProj4String,
+                                      strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(!getTilesFromGeometryByGrid((*ptrGeometry),
+                                   ignoreTilesTableName,
+                                   tilesTableName,
+                                   tilesOverlaps,
+                                   strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
+        strError+=QObject::tr("\nError recovering tiles from geometry:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(tilesFullGeometry)
+    {
+        OGRGeometryFactory::destroyGeometry((*ptrGeometry));
+        (*ptrGeometry)=NULL;
+    }
+//    else
+//    {
+//        ptrPtrGeometry=&ptrGeometry;
+//    }
+    return(true);
+}
+
+bool PointCloudFile::getTilesNamesFromGeometry(QMap<int, QMap<int, QString> > &tilesTableName,
+                                               QVector<QString> &ignoreTilesTableName,
+                                               OGRGeometry* ptrGeometry,
+                                               QMap<int, QMap<int, bool> > &tilesOverlaps,
+                                               QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    tilesTableName.clear();
+    tilesOverlaps.clear();
+    QString strAuxError;
+    if(!getTilesFromGeometryByGrid(ptrGeometry,
+                                   ignoreTilesTableName,
+                                   tilesTableName,
+                                   tilesOverlaps,
+                                   strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesNamesFromGeometry");
+        strError+=QObject::tr("\nError recovering tiles from geometry:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::getTilesFromGeometryByGrid(OGRGeometry *ptrGeometry,
+                                                QVector<QString> &ignoreTilesTableName,
+                                                QMap<int, QMap<int, QString> > &tilesTableName,
+                                                QMap<int, QMap<int, bool> > &tilesOverlaps,
+                                                QString &strError)
+{
+    // Los tiles candidatos se obtienen por aritmetica de malla a partir de la envolvente,
+    // los interiores por barrido de filas y solo los de borde se evaluan con la geometria preparada
+    tilesTableName.clear();
+    tilesOverlaps.clear();
+    QString strAuxError;
+    QVector<QVector<double> > ringsCoordinates;
+    if(!getGeometryRingsCoordinates(ptrGeometry,ringsCoordinates,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getTilesFromGeometryByGrid");
+        strError+=QObject::tr("\nError recovering rings from geometry:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(mTilesName.isEmpty()||ringsCoordinates.isEmpty())
+    {
+        return(true);
+    }
+    int gridSize=qRound(mGridSize);
+    OGREnvelope envelope;
+    ptrGeometry->getEnvelope(&envelope);
+    int minTileX=getTileCoordinate(envelope.MinX);
+    int maxTileX=getTileCoordinate(envelope.MaxX);
+    int minTileY=getTileCoordinate(envelope.MinY);
+    int maxTileY=getTileCoordinate(envelope.MaxY);
+    // Tiles atravesados por algun lado de los anillos
+    QMap<int,QMap<int,bool> > boundaryTiles;
+    for(int nr=0;nr<ringsCoordinates.size();nr++)
+    {
+        const QVector<double>& ringCoordinates=ringsCoordinates[nr];
+        int numberOfRingPoints=ringCoordinates.size()/2;
+        for(int np=0;np<numberOfRingPoints-1;np++)
+        {
+            double x1=ringCoordinates[2*np];
+            double y1=ringCoordinates[2*np+1];
+            double x2=ringCoordinates[2*np+2];
+            double y2=ringCoordinates[2*np+3];
+            double segmentMinX=qMin(x1,x2);
+            double segmentMaxX=qMax(x1,x2);
+            int firstTileX=getTileCoordinate(segmentMinX);
+            int lastTileX=getTileCoordinate(segmentMaxX);
+            for(int tileX=firstTileX;tileX<=lastTileX;tileX+=gridSize)
+            {
+                double ya=y1;
+                double yb=y2;
+                if(qAbs(x2-x1)>0.)
+                {
+                    double xa=qMax(segmentMinX,(double)tileX);
+                    double xb=qMin(segmentMaxX,(double)(tileX+gridSize));
+                    ya=y1+(xa-x1)*(y2-y1)/(x2-x1);
+                    yb=y1+(xb-x1)*(y2-y1)/(x2-x1);
+                }
+                int firstTileY=getTileCoordinate(qMin(ya,yb));
+                int lastTileY=getTileCoordinate(qMax(ya,yb));
+                for(int tileY=firstTileY;tileY<=lastTileY;tileY+=gridSize)
+                {
+                    boundaryTiles[tileX][tileY]=true;
+                }
+            }
+        }
+    }
+    // Tiles interiores: no los corta ningun lado, basta con el centro por regla par-impar
+    for(int tileY=minTileY;tileY<=maxTileY;tileY+=gridSize)
+    {
+        double yc=tileY+mGridSize/2.;
+        QVector<double> crossings;
+        for(int nr=0;nr<ringsCoordinates.size();nr++)
+        {
+            const QVector<double>& ringCoordinates=ringsCoordinates[nr];
+            int numberOfRingPoints=ringCoordinates.size()/2;
+            for(int np=0;np<numberOfRingPoints-1;np++)
+            {
+                double x1=ringCoordinates[2*np];
+                double y1=ringCoordinates[2*np+1];
+                double x2=ringCoordinates[2*np+2];
+                double y2=ringCoordinates[2*np+3];
+                if((y1>yc)!=(y2>yc))
+                {
+                    crossings.push_back(x1+(yc-y1)*(x2-x1)/(y2-y1));
+                }
+            }
+        }
+        std::sort(crossings.begin(),crossings.end());
+        for(int nc=0;nc+1<crossings.size();nc+=2)
+        {
+            int firstTileX=qRound(ceil((crossings[nc]-mGridSize/2.)/mGridSize)*mGridSize);
+            int lastTileX=qRound(floor((crossings[nc+1]-mGridSize/2.)/mGridSize)*mGridSize);
+            firstTileX=qMax(firstTileX,minTileX);
+            lastTileX=qMin(lastTileX,maxTileX);
+            for(int tileX=firstTileX;tileX<=lastTileX;tileX+=gridSize)
+            {
+                if(!mTilesName.contains(tileX)) continue;
+                if(!mTilesName[tileX].contains(tileY)) continue;
+                if(boundaryTiles.contains(tileX))
+                {
+                    if(boundaryTiles[tileX].contains(tileY)) continue;
+                }
+                QString tileTableName=mTilesName[tileX][tileY];
+                if(ignoreTilesTableName.indexOf(tileTableName)!=-1) continue;
+                tilesTableName[tileX][tileY]=tileTableName;
+                tilesOverlaps[tileX][tileY]=false;
+            }
+        }
+    }
+    // Tiles de borde
+    OGRPreparedGeometry* ptrPreparedGeometry=OGRCreatePreparedGeometry(ptrGeometry);
+    QMap<int,QMap<int,bool> >::const_iterator iterTileX=boundaryTiles.begin();
+    while(iterTileX!=boundaryTiles.end())
+    {
+        int tileX=iterTileX.key();
+        if(!mTilesName.contains(tileX))
+        {
+            iterTileX++;
+            continue;
+        }
+        QMap<int,bool>::const_iterator iterTileY=iterTileX.value().begin();
+        while(iterTileY!=iterTileX.value().end())
+        {
+            int tileY=iterTileY.key();
+            iterTileY++;
+            if(!mTilesName[tileX].contains(tileY)) continue;
+            QString tileTableName=mTilesName[tileX][tileY];
+            if(ignoreTilesTableName.indexOf(tileTableName)!=-1) continue;
+            bool intersects=true;
+            bool contained=false;
+            if(mTilesGeometry.contains(tileX))
+            {
+                if(mTilesGeometry[tileX].contains(tileY))
+                {
+                    OGRGeometry* ptrTileGeometry=mTilesGeometry[tileX][tileY];
+                    if(ptrPreparedGeometry!=NULL)
+                    {
+                        contained=OGRPreparedGeometryContains(ptrPreparedGeometry,ptrTileGeometry);
+                        if(!contained)
+                            intersects=OGRPreparedGeometryIntersects(ptrPreparedGeometry,ptrTileGeometry);
+                    }
+                    else
+                    {
+                        contained=ptrGeometry->Contains(ptrTileGeometry);
+                        if(!contained)
+                            intersects=ptrGeometry->Intersects(ptrTileGeometry);
+                    }
+                }
             }
-            iterPtrRois++;
+            if(!intersects) continue;
+            tilesTableName[tileX][tileY]=tileTableName;
+            tilesOverlaps[tileX][tileY]=!contained;
         }
+        iterTileX++;
+    }
+    if(ptrPreparedGeometry!=NULL)
+    {
+        OGRDestroyPreparedGeometry(ptrPreparedGeometry);
     }
-    values=mROIsWkt;
     return(true);
 }
 
-bool PointCloudFile::getTilesNamesFromWktGeometry(QString wktGeometry,
-                                                       int geometryCrsEpsgCode,
-                                                       QString geometryCrsProj4String,
-                                                       QMap<int, QMap<int, QString> > &tilesTableName,
-                                                       QVector<QString> &ignoreTilesTableName,
-                                                       bool tilesFullGeometry,
-                                                       OGRGeometry** ptrGeometry,
-                                                       QMap<int, QMap<int, bool> > &tilesOverlaps,
-                                                       QString &strError)
+double PointCloudFile::getGeometryArea(OGRGeometry *ptrGeometry)
 {
-    tilesTableName.clear();
-    tilesOverlaps.clear();
-//    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
-//    char *charsWktGeometry = byteArrayWktGeometry.data();
-//    OGRGeometry* ptrGeometry;
-    bool validGeometry=false;
-    QString strAuxError;
-    wktGeometry=wktGeometry.toLower();
-    if(wktGeometry.toLower().contains("multipolygon"))
+    if(ptrGeometry==NULL)
     {
-        (*ptrGeometry)=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
-        validGeometry=true;
+        return(0.);
     }
-    else if(wktGeometry.toLower().contains("polygon"))
+    OGRwkbGeometryType geometryType=wkbFlatten(ptrGeometry->getGeometryType());
+    if(geometryType==wkbPolygon)
     {
-        (*ptrGeometry)=OGRGeometryFactory::createGeometry(wkbPolygon);
-        validGeometry=true;
+        return(((OGRSurface*)ptrGeometry)->get_Area());
     }
-    wktGeometry=wktGeometry.toUpper();
-    if(!validGeometry)
+    if(geometryType==wkbMultiPolygon
+            ||geometryType==wkbGeometryCollection)
     {
-        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-        strError+=QObject::tr("\nNot valid geometry from WKT: %1").arg(wktGeometry);
-        return(false);
+        return(((OGRGeometryCollection*)ptrGeometry)->get_Area());
     }
-    std::string stdStringWktGeometry=wktGeometry.toStdString();
-    const char* constCharWktGeometry = stdStringWktGeometry.c_str();
-    if(OGRERR_NONE!=(*ptrGeometry)->importFromWkt(&constCharWktGeometry))
+    return(0.);
+}
+
+bool PointCloudFile::getNumberOfPointsInGeometry(QString wktGeometry,
+                                                 int geometryCrsEpsgCode,
+                                                 QString geometryCrsProj4String,
+                                                 QVector<QString> &ignoreTilesTableName,
+                                                 bool exactCount,
+                                                 qint64 &numberOfPoints,
+                                                 QString &strError)
+{
+    // Los tiles contenidos se resuelven con el numero de puntos de la cabecera. En los de borde
+    // se estima por la fraccion de area del tile dentro de la geometria o, si exactCount,
+    // se cuentan los puntos decodificando solo las columnas ix, iy
+    numberOfPoints=0;
+    QString strAuxError;
+    QMap<int,QMap<int,QString> > tilesTableName;
+    QMap<int,QMap<int,bool> > tilesOverlaps;
+    OGRGeometry* ptrGeometry=NULL;
+    if(!getTilesNamesFromWktGeometry(wktGeometry,
+                                     geometryCrsEpsgCode,
+                                     geometryCrsProj4String,
+                                     tilesTableName,
+                                     ignoreTilesTableName,
+                                     false,
+                                     &ptrGeometry,
+                                     tilesOverlaps,
+                                     strAuxError))
     {
-        strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-        strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
+        strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+        strError+=QObject::tr("\nError recovering tiles from wkt:\n%1\nError:\n%2")
+                .arg(wktGeometry).arg(strAuxError);
+        if(ptrGeometry!=NULL)
+        {
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        }
         return(false);
     }
-    if(geometryCrsEpsgCode!=-1)
+    QMap<int,QVector<int> > boundaryTiles;
+    QMap<int,QMap<int,bool> >::const_iterator iterTileX=tilesOverlaps.begin();
+    while(iterTileX!=tilesOverlaps.end())
     {
-        if(geometryCrsEpsgCode!=mSRID)
+        int tileX=iterTileX.key();
+        QMap<int,bool>::const_iterator iterTileY=iterTileX.value().begin();
+        while(iterTileY!=iterTileX.value().end())
         {
-            QString geometryCrsDescription;
-            if(!mPtrCrsTools->appendUserCrs(geometryCrsEpsgCode,
-                                            geometryCrsDescription,
-                                            strAuxError))
+            int tileY=iterTileY.key();
+            qint64 tileNumberOfPoints=mTilesNumberOfPoints.value(tileX).value(tileY,0);
+            if(!iterTileY.value())
             {
-                if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                                geometryCrsDescription,
-                                                strAuxError))
-                {
-                    strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-                    strError+=QObject::tr("\nInvalid CRS From EPSG code: %1 and PROJ4:\n%2")
-                            .arg(QString::number(geometryCrsEpsgCode)).arg(geometryCrsProj4String);
-                    return(false);
-                }
+                numberOfPoints+=tileNumberOfPoints;
             }
-            if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                           mCrsDescription,
-                                           ptrGeometry,
-                                           strAuxError))
+            else if(tileNumberOfPoints>0)
             {
-                strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-                strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-                return(false);
+                boundaryTiles[tileX].push_back(tileY);
             }
+            iterTileY++;
         }
+        iterTileX++;
     }
-    else
+    if(boundaryTiles.isEmpty())
     {
-        QString geometryCrsDescription;
-        if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                        geometryCrsDescription,
-                                        strAuxError))
-        {
-            strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-            strError+=QObject::tr("\nInvalid CRS From PROJ4:\n%1").arg(geometryCrsProj4String);
-            return(false);
-        }
-        if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                       mCrsDescription,
-                                       ptrGeometry,
-                                       strAuxError))
-        {
-            strError=QObject::tr("PointCloudFile::getTilesTableNamesFromWktGeometry");
-            strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-            return(false);
-        }
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(true);
     }
-    OGRwkbGeometryType geometryType=(*ptrGeometry)->getGeometryType();
-    QMap<int,QMap<int,OGRGeometry*> >::const_iterator iter1=mTilesGeometry.begin();
-    while(iter1!=mTilesGeometry.end())
+    if(!exactCount)
     {
-        int tileX=iter1.key();
-        QMap<int,OGRGeometry*>::const_iterator iter2=iter1.value().begin();
-        while(iter2!=iter1.value().end())
+        QMap<int,QVector<int> >::const_iterator iterBoundaryTileX=boundaryTiles.begin();
+        while(iterBoundaryTileX!=boundaryTiles.end())
         {
-            if(geometryType==wkbPolygon
-                    ||geometryType==wkbMultiPolygon
-                    ||geometryType==wkbPolygon25D
-                    ||geometryType==wkbMultiPolygon25D
-                    ||geometryType==wkbPolygonM
-                    ||geometryType==wkbMultiPolygonM
-                    ||geometryType==wkbPolygonZM
-                    ||geometryType==wkbMultiPolygonZM)
+            int tileX=iterBoundaryTileX.key();
+            for(int i=0;i<iterBoundaryTileX.value().size();i++)
             {
-                int tileY=iter2.key();
-                QString tileTableName=mTilesName[tileX][tileY];
-                if(ignoreTilesTableName.indexOf(tileTableName)!=-1)
-                {
-                    iter2++;
-                    continue;
-                }
-                if((*ptrGeometry)->Overlaps(iter2.value()))
+                int tileY=iterBoundaryTileX.value()[i];
+                qint64 tileNumberOfPoints=mTilesNumberOfPoints[tileX][tileY];
+                double areaFraction=1.;
+                OGRGeometry* ptrTileGeometry=mTilesGeometry.value(tileX).value(tileY,NULL);
+                double tileArea=getGeometryArea(ptrTileGeometry);
+                if(tileArea>0.)
                 {
-                    tilesTableName[tileX][tileY]=tileTableName;
-                    tilesOverlaps[tileX][tileY]=true;
+                    OGRGeometry* ptrClippedGeometry=ptrGeometry->Intersection(ptrTileGeometry);
+                    if(ptrClippedGeometry!=NULL)
+                    {
+                        areaFraction=qBound(0.,getGeometryArea(ptrClippedGeometry)/tileArea,1.);
+                        OGRGeometryFactory::destroyGeometry(ptrClippedGeometry);
+                    }
                 }
-                else if((*ptrGeometry)->Contains(iter2.value()))
+                numberOfPoints+=qRound64(tileNumberOfPoints*areaFraction);
+            }
+            iterBoundaryTileX++;
+        }
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(true);
+    }
+    QMap<int,QMap<int,QVector<float> > > tilesPolygonEdges;
+    if(!setTilesPolygonEdges(ptrGeometry,
+                             tilesOverlaps,
+                             tilesPolygonEdges,
+                             strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+        strError+=QObject::tr("\nError clipping geometry to tiles:\n%1").arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
+    }
+    OGRGeometryFactory::destroyGeometry(ptrGeometry);
+    PointsQuery pointsQuery;
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    pointsQuery.setTilesPolygonEdges(tilesPolygonEdges);
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+    while(iterFiles!=mTilesByFileIndex.end())
+    {
+        int fileIndex=iterFiles.key();
+        const QMap<int,QVector<int> >& tilesInFile=iterFiles.value();
+        QMap<int,QVector<int> > boundaryTilesInFile;
+        QMap<int,QVector<int> >::const_iterator iterBoundaryTileX=boundaryTiles.begin();
+        while(iterBoundaryTileX!=boundaryTiles.end())
+        {
+            int tileX=iterBoundaryTileX.key();
+            if(tilesInFile.contains(tileX))
+            {
+                for(int i=0;i<iterBoundaryTileX.value().size();i++)
                 {
-                    tilesTableName[tileX][tileY]=tileTableName;
-                    tilesOverlaps[tileX][tileY]=false;
+                    int tileY=iterBoundaryTileX.value()[i];
+                    if(tilesInFile[tileX].indexOf(tileY)!=-1)
+                    {
+                        boundaryTilesInFile[tileX].push_back(tileY);
+                    }
                 }
-                else if((*ptrGeometry)->Within(iter2.value()))
+            }
+            iterBoundaryTileX++;
+        }
+        iterFiles++;
+        if(boundaryTilesInFile.isEmpty())
+        {
+            continue;
+        }
+        if(!mClassesFileByIndex.contains(fileIndex)
+                ||!mZipFilePointsByIndex.contains(fileIndex))
+        {
+            strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+            strError+=QObject::tr("\nThere is no classes or points file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        QMap<QString,bool> existsFields;
+        if(!readQueryClassesFile(pointsQuery,
+                                 fileIndex,
+                                 boundaryTilesInFile,
+                                 existsFields,
+                                 strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+            strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+            return(false);
+        }
+        QuaZip zipFilePoints(mZipFilePointsByIndex[fileIndex]);
+        if(!zipFilePoints.open(QuaZip::mdUnzip))
+        {
+            strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+            strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
+                    .arg(mZipFilePointsByIndex[fileIndex])
+                    .arg(QString::number(zipFilePoints.getZipError()));
+            return(false);
+        }
+        QMap<int,QVector<int> >::const_iterator iterTileXInFile=boundaryTilesInFile.begin();
+        while(iterTileXInFile!=boundaryTilesInFile.end())
+        {
+            int tileX=iterTileXInFile.key();
+            for(int i=0;i<iterTileXInFile.value().size();i++)
+            {
+                int tileY=iterTileXInFile.value()[i];
+                int tileNumberOfPoints=0;
+                if(!pointsQuery.countTilePoints(zipFilePoints,
+                                                fileIndex,
+                                                tileX,
+                                                tileY,
+                                                tileNumberOfPoints,
+                                                strAuxError))
                 {
-                    tilesTableName[tileX][tileY]=tileTableName;
-                    tilesOverlaps[tileX][tileY]=false;
+                    zipFilePoints.close();
+                    strError=QObject::tr("PointCloudFile::getNumberOfPointsInGeometry");
+                    strError+=QObject::tr("\nError counting points in tile:\n%1").arg(strAuxError);
+                    return(false);
                 }
+                numberOfPoints+=tileNumberOfPoints;
             }
-            iter2++;
+            iterTileXInFile++;
         }
-        iter1++;
+        zipFilePoints.close();
     }
-    if(tilesFullGeometry)
+    return(true);
+}
+
+void PointCloudFile::getEditLogCheckpoints(QVector<QString> &checkpoints)
+{
+    QMutexLocker locker(&mEditLogMutex);
+    checkpoints=mEditLog.getCheckpoints();
+}
+
+void PointCloudFile::getEditLogNumberOfOperations(int &numberOfUndoOperations,
+                                                  int &numberOfRedoOperations)
+{
+    QMutexLocker locker(&mEditLogMutex);
+    numberOfUndoOperations=mEditLog.getNumberOfUndoOperations();
+    numberOfRedoOperations=mEditLog.getNumberOfRedoOperations();
+}
+
+bool PointCloudFile::getEditSessionClassesFile(int fileIndex,
+                                               PointsClassesFile **ptrPtrClassesFile,
+                                               QString &strError)
+{
+    if(!mEditSessionClassesFileByIndex.contains(fileIndex))
     {
-        OGRGeometryFactory::destroyGeometry((*ptrGeometry));
-        (*ptrGeometry)=NULL;
+        QString strAuxError;
+        PointsClassesFile classesFile;
+        if(!classesFile.read(mClassesFileByIndex.value(fileIndex),strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::getEditSessionClassesFile");
+            strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+            return(false);
+        }
+        mEditSessionClassesFileByIndex[fileIndex]=classesFile;
     }
-//    else
-//    {
-//        ptrPtrGeometry=&ptrGeometry;
-//    }
+    *ptrPtrClassesFile=&mEditSessionClassesFileByIndex[fileIndex];
     return(true);
 }
 
-bool PointCloudFile::getTilesNamesFromGeometry(QMap<int, QMap<int, QString> > &tilesTableName,
-                                               QVector<QString> &ignoreTilesTableName,
-                                               OGRGeometry* ptrGeometry,
-                                               QMap<int, QMap<int, bool> > &tilesOverlaps,
-                                               QString &strError)
+bool PointCloudFile::getGeometryRingsCoordinates(OGRGeometry *ptrGeometry,
+                                                 QVector<QVector<double> > &ringsCoordinates,
+                                                 QString &strError)
 {
-    tilesTableName.clear();
-    tilesOverlaps.clear();
-    bool useMultiProcess=mPtrPCFManager->getMultiProcess();
-    if(!useMultiProcess)
+    ringsCoordinates.clear();
+    if(ptrGeometry==NULL)
     {
-        OGRwkbGeometryType geometryType=ptrGeometry->getGeometryType();
-        QMap<int,QMap<int,OGRGeometry*> >::const_iterator iter1=mTilesGeometry.begin();
-        while(iter1!=mTilesGeometry.end())
-        {
-            int tileX=iter1.key();
-            QMap<int,OGRGeometry*>::const_iterator iter2=iter1.value().begin();
-            while(iter2!=iter1.value().end())
-            {
-                if(geometryType==wkbPolygon
-                        ||geometryType==wkbMultiPolygon
-                        ||geometryType==wkbPolygon25D
-                        ||geometryType==wkbMultiPolygon25D
-                        ||geometryType==wkbPolygonM
-                        ||geometryType==wkbMultiPolygonM
-                        ||geometryType==wkbPolygonZM
-                        ||geometryType==wkbMultiPolygonZM)
-                {
-                    int tileY=iter2.key();
-                    QString tileTableName=mTilesName[tileX][tileY];
-                    if(ignoreTilesTableName.indexOf(tileTableName)!=-1)
-                    {
-                        iter2++;
-                        continue;
-                    }
-                    if(ptrGeometry->Overlaps(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                        tilesOverlaps[tileX][tileY]=true;
-                    }
-                    else if(ptrGeometry->Contains(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                        tilesOverlaps[tileX][tileY]=false;
-                    }
-                    else if(ptrGeometry->Within(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                        tilesOverlaps[tileX][tileY]=false;
-                    }
-                }
-                iter2++;
-            }
-            iter1++;
+        strError=QObject::tr("PointCloudFile::getGeometryRingsCoordinates");
+        strError+=QObject::tr("\nNull geometry");
+        return(false);
+    }
+    QVector<OGRPolygon*> ptrPolygons;
+    OGRwkbGeometryType geometryType=wkbFlatten(ptrGeometry->getGeometryType());
+    if(geometryType==wkbPolygon)
+    {
+        ptrPolygons.push_back((OGRPolygon*)ptrGeometry);
+    }
+    else if(geometryType==wkbMultiPolygon)
+    {
+        OGRMultiPolygon* ptrMultiPolygon=(OGRMultiPolygon*)ptrGeometry;
+        for(int ng=0;ng<ptrMultiPolygon->getNumGeometries();ng++)
+        {
+            ptrPolygons.push_back((OGRPolygon*)ptrMultiPolygon->getGeometryRef(ng));
         }
     }
-    else
+    else if(geometryType==wkbGeometryCollection)
     {
-        QWidget* ptrWidget=new QWidget();
-        mMpTilesTableName.clear();
-        mTilesOverlaps.clear();
-        mTilesXToProcess.clear();
-        mTilesYToProcess.clear();
-        QVector<int> tilesPosition;
-        QMap<int,QMap<int,OGRGeometry*> >::const_iterator  iterTilesX=mTilesGeometry.begin();
-        while(iterTilesX!=mTilesGeometry.end())
+        // resultado de recortes que degeneran en lineas o puntos
+        OGRGeometryCollection* ptrCollection=(OGRGeometryCollection*)ptrGeometry;
+        for(int ng=0;ng<ptrCollection->getNumGeometries();ng++)
         {
-            int tileX=iterTilesX.key();
-            QMap<int,OGRGeometry*>::const_iterator iterTilesY=iterTilesX.value().begin();
-            while(iterTilesY!=iterTilesX.value().end())
+            OGRGeometry* ptrPart=ptrCollection->getGeometryRef(ng);
+            if(wkbFlatten(ptrPart->getGeometryType())==wkbPolygon)
             {
-                int tileY=iterTilesY.key();
-                mTilesXToProcess.push_back(tileX);
-                mTilesYToProcess.push_back(tileY);
-                tilesPosition.push_back(tilesPosition.size());
-                iterTilesY++;
+                ptrPolygons.push_back((OGRPolygon*)ptrPart);
             }
-            iterTilesX++;
-        }
-        if(mPtrMpProgressDialog!=NULL)
-        {
-            delete(mPtrMpProgressDialog);
-        }
-        if(ptrWidget!=NULL)
-            mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-        else
-            mPtrMpProgressDialog=new QProgressDialog();
-        QString dialogText=QObject::tr("Getting tiles names from WKT geometry");
-        dialogText+=QObject::tr("\nNumber of tiles to process:%1").arg(tilesPosition.size());
-        dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-        mPtrMpProgressDialog->setLabelText(dialogText);
-        mPtrMpProgressDialog->setModal(true);
-        QFutureWatcher<void> futureWatcher;
-        QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-        QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-        QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-        QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-        //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-        futureWatcher.setFuture(QtConcurrent::map(tilesPosition,
-                                                  [this](int& data)
-        {mpGetTilesNamesFromWktGeometry(data);}));
-        mStrErrorMpProgressDialog="";
-        mPtrMpProgressDialog->exec();
-        futureWatcher.waitForFinished();
-        delete(mPtrMpProgressDialog);
-        mPtrMpProgressDialog=NULL;
-        if(!mStrErrorMpProgressDialog.isEmpty())
-        {
-            strError=QObject::tr("PointCloudFile::getTilesNamesFromGeometry");
-            strError+=QObject::tr("\nError adding tiles geometry");
-            strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
-            return(false);
         }
+    }
+    else
+    {
+        strError=QObject::tr("PointCloudFile::getGeometryRingsCoordinates");
+        strError+=QObject::tr("\nNot valid geometry type, must be polygon or multipolygon");
+        return(false);
+    }
+    for(int npol=0;npol<ptrPolygons.size();npol++)
+    {
+        OGRPolygon* ptrPolygon=ptrPolygons[npol];
+        if(ptrPolygon->IsEmpty()) continue;
+        int numberOfRings=ptrPolygon->getNumInteriorRings()+1;
+        for(int nr=0;nr<numberOfRings;nr++)
         {
-            QMap<int, QMap<int, QString> >::iterator iterTilesX=mMpTilesTableName.begin();
-            while(iterTilesX!=mMpTilesTableName.end())
+            OGRLinearRing* ptrRing=NULL;
+            if(nr==0) ptrRing=ptrPolygon->getExteriorRing();
+            else ptrRing=ptrPolygon->getInteriorRing(nr-1);
+            if(ptrRing==NULL) continue;
+            int numberOfPoints=ptrRing->getNumPoints();
+            if(numberOfPoints<3) continue;
+            QVector<double> ringCoordinates(2*numberOfPoints);
+            for(int np=0;np<numberOfPoints;np++)
+            {
+                ringCoordinates[2*np]=ptrRing->getX(np);
+                ringCoordinates[2*np+1]=ptrRing->getY(np);
+            }
+            // se asegura el cierre del anillo
+            if(ringCoordinates[0]!=ringCoordinates[2*numberOfPoints-2]
+                    ||ringCoordinates[1]!=ringCoordinates[2*numberOfPoints-1])
             {
-                 QMap<int, QString>::iterator iterTilesY=iterTilesX.value().begin();
-                 while(iterTilesY!=iterTilesX.value().end())
-                 {
-                     tilesTableName[iterTilesX.key()][iterTilesY.key()]=iterTilesY.value();
-                     iterTilesY++;
-                 }
-                 iterTilesX++;
+                ringCoordinates.push_back(ringCoordinates[0]);
+                ringCoordinates.push_back(ringCoordinates[1]);
             }
+            ringsCoordinates.push_back(ringCoordinates);
         }
+    }
+    return(true);
+}
+
+int PointCloudFile::getTileCoordinate(double value)
+{
+    return(qRound(floor(floor(value)/mGridSize)*mGridSize));
+}
+
+bool PointCloudFile::setTilesPolygonEdges(OGRGeometry *ptrGeometry,
+                                          QMap<int, QMap<int, bool> > &tilesOverlaps,
+                                          QMap<int, QMap<int, QVector<float> > > &tilesPolygonEdges,
+                                          QString &strError)
+{
+    // Recorte de la geometria a cada tile de borde, una sola vez por consulta,
+    // en coordenadas cuantizadas del tile (mismas unidades que ix, iy)
+    tilesPolygonEdges.clear();
+    QString strAuxError;
+    QMap<int,QMap<int,bool> >::const_iterator iterTileX=tilesOverlaps.begin();
+    while(iterTileX!=tilesOverlaps.end())
+    {
+        int tileX=iterTileX.key();
+        QMap<int,bool>::const_iterator iterTileY=iterTileX.value().begin();
+        while(iterTileY!=iterTileX.value().end())
         {
-            QMap<int, QMap<int, bool> >::iterator iterTilesX=mTilesOverlaps.begin();
-            while(iterTilesX!=mTilesOverlaps.end())
+            int tileY=iterTileY.key();
+            if(!iterTileY.value())
+            {
+                iterTileY++;
+                continue;
+            }
+            OGRGeometry* ptrClippedGeometry=NULL;
+            if(mTilesGeometry.contains(tileX))
+            {
+                if(mTilesGeometry[tileX].contains(tileY))
+                {
+                    ptrClippedGeometry=ptrGeometry->Intersection(mTilesGeometry[tileX][tileY]);
+                }
+            }
+            QVector<QVector<double> > ringsCoordinates;
+            bool validRings=false;
+            if(ptrClippedGeometry!=NULL)
+            {
+                validRings=getGeometryRingsCoordinates(ptrClippedGeometry,ringsCoordinates,strAuxError);
+                OGRGeometryFactory::destroyGeometry(ptrClippedGeometry);
+            }
+            if(!validRings)
+            {
+                // sin recorte se usa la geometria completa, el resultado es el mismo
+                if(!getGeometryRingsCoordinates(ptrGeometry,ringsCoordinates,strAuxError))
+                {
+                    strError=QObject::tr("PointCloudFile::setTilesPolygonEdges");
+                    strError+=QObject::tr("\nError recovering rings from geometry:\n%1").arg(strAuxError);
+                    return(false);
+                }
+            }
+            QVector<float> polygonEdges;
+            for(int nr=0;nr<ringsCoordinates.size();nr++)
             {
-                 QMap<int, bool>::iterator iterTilesY=iterTilesX.value().begin();
-                 while(iterTilesY!=iterTilesX.value().end())
-                 {
-                     tilesOverlaps[iterTilesX.key()][iterTilesY.key()]=iterTilesY.value();
-                     iterTilesY++;
-                 }
-                 iterTilesX++;
+                const QVector<double>& ringCoordinates=ringsCoordinates[nr];
+                int numberOfRingPoints=ringCoordinates.size()/2;
+                for(int np=0;np<numberOfRingPoints-1;np++)
+                {
+                    polygonEdges.push_back((float)((ringCoordinates[2*np]-tileX)*1000.));
+                    polygonEdges.push_back((float)((ringCoordinates[2*np+1]-tileY)*1000.));
+                    polygonEdges.push_back((float)((ringCoordinates[2*np+2]-tileX)*1000.));
+                    polygonEdges.push_back((float)((ringCoordinates[2*np+3]-tileY)*1000.));
+                }
             }
+            tilesPolygonEdges[tileX][tileY]=polygonEdges;
+            iterTileY++;
         }
-//        mMpTilesTableName.clear();
-//        mTilesOverlaps.clear();
-        mTilesXToProcess.clear();
-        mTilesYToProcess.clear();
+        iterTileX++;
+    }
+    return(true);
+}
+
+QVector<double> PointCloudFile::getEmptyTileStatistics()
+{
+    // minimo > maximo indica campo sin valores
+    QVector<double> tileStatistics(POINTCLOUDFILE_TILE_STATISTICS_SIZE);
+    for(int i=0;i<POINTCLOUDFILE_TILE_STATISTICS_SIZE;i+=2)
+    {
+        tileStatistics[i]=POINTCLOUDFILE_TILE_STATISTICS_EMPTY_MINIMUM;
+        tileStatistics[i+1]=POINTCLOUDFILE_TILE_STATISTICS_EMPTY_MAXIMUM;
+    }
+    return(tileStatistics);
+}
+
+QVector<double> PointCloudFile::getLevelsOfDetailSpacings()
+{
+    // del nivel mas grueso al mas fino
+    QVector<double> spacings(POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS);
+    double spacing=mGridSize/POINTCLOUDFILE_LOD_COARSEST_GRID_SIZE_DIVISOR;
+    for(int level=0;level<POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS;level++)
+    {
+        spacings[level]=spacing;
+        spacing/=2.;
     }
-    return(true);
+    return(spacings);
 }
 
 bool PointCloudFile::getTilesNamesFromWktGeometry(QString wktGeometry,
@@ -4472,25 +6329,22 @@ bool PointCloudFile::getTilesNamesFromWktGeometry(QString wktGeometry,
                                                   QMap<int, QMap<int, QString> > &tilesTableName,
                                                   QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
     tilesTableName.clear();
 //    QByteArray byteArrayWktGeometry = wktGeometry.toUtf8();
 //    char *charsWktGeometry = byteArrayWktGeometry.data();
-    if(mMpPtrGeometry!=NULL)
-    {
-        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-        mMpPtrGeometry=NULL;
-    }
+    OGRGeometry* ptrGeometry=NULL;
     bool validGeometry=false;
     QString strAuxError;
     wktGeometry=wktGeometry.toLower();
     if(wktGeometry.toLower().contains("multipolygon"))
     {
-        mMpPtrGeometry=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
+        ptrGeometry=OGRGeometryFactory::createGeometry(wkbMultiPolygon);
         validGeometry=true;
     }
     else if(wktGeometry.toLower().contains("polygon"))
     {
-        mMpPtrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
+        ptrGeometry=OGRGeometryFactory::createGeometry(wkbPolygon);
         validGeometry=true;
     }
     wktGeometry=wktGeometry.toUpper();
@@ -4502,194 +6356,45 @@ bool PointCloudFile::getTilesNamesFromWktGeometry(QString wktGeometry,
     }
     std::string stdStringWktGeometry=wktGeometry.toStdString();
     const char* constCharWktGeometry = stdStringWktGeometry.c_str();
-    if(OGRERR_NONE!=mMpPtrGeometry->importFromWkt(&constCharWktGeometry))
+    if(OGRERR_NONE!=ptrGeometry->importFromWkt(&constCharWktGeometry))
     {
         strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
         strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
-        OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-        mMpPtrGeometry=NULL;
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
         return(false);
     }
-    if(geometryCrsEpsgCode!=-1)
-    {
-        if(geometryCrsEpsgCode!=mSRID)
-        {
-            QString geometryCrsDescription;
-            if(!mPtrCrsTools->appendUserCrs(geometryCrsEpsgCode,
-                                            geometryCrsDescription,
-                                            strAuxError))
-            {
-                if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                                geometryCrsDescription,
-                                                strAuxError))
-                {
-                    strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
-                    strError+=QObject::tr("\nInvalid CRS From EPSG code: %1 and PROJ4:\n%2")
-                            .arg(QString::number(geometryCrsEpsgCode)).arg(geometryCrsProj4String);
-                    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                    mMpPtrGeometry=NULL;
-                    return(false);
-                }
-            }
-            if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                           mCrsDescription,
-                                           &mMpPtrGeometry,
-                                           strAuxError))
-            {
-                strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
-                strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-                OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-                mMpPtrGeometry=NULL;
-                return(false);
-            }
-        }
-    }
-    else
-    {
-        QString geometryCrsDescription;
-        if(!mPtrCrsTools->appendUserCrs(geometryCrsProj4String,//proj4
-                                        geometryCrsDescription,
-                                        strAuxError))
-        {
-            strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
-            strError+=QObject::tr("\nInvalid CRS From PROJ4:\n%1").arg(geometryCrsProj4String);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
-        }
-        if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
-                                       mCrsDescription,
-                                       &mMpPtrGeometry,
-                                       strAuxError))
-        {
-            strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
-            strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
-        }
-    }
-    bool useMultiProcess=mPtrPCFManager->getMultiProcess();
-    if(!useMultiProcess)
+    if(!transformGeometryToProjectCrs(&ptrGeometry,
+                                      geometryCrsEpsgCode,
+                                      geometryCrsProj4String,
+                                      strAuxError))
     {
-        OGRwkbGeometryType geometryType=mMpPtrGeometry->getGeometryType();
-        QMap<int,QMap<int,OGRGeometry*> >::const_iterator iter1=mTilesGeometry.begin();
-        while(iter1!=mTilesGeometry.end())
-        {
-            int tileX=iter1.key();
-            QMap<int,OGRGeometry*>::const_iterator iter2=iter1.value().begin();
-            while(iter2!=iter1.value().end())
-            {
-                if(geometryType==wkbPolygon
-                        ||geometryType==wkbMultiPolygon
-                        ||geometryType==wkbPolygon25D
-                        ||geometryType==wkbMultiPolygon25D
-                        ||geometryType==wkbPolygonM
-                        ||geometryType==wkbMultiPolygonM
-                        ||geometryType==wkbPolygonZM
-                        ||geometryType==wkbMultiPolygonZM)
-                {
-                    int tileY=iter2.key();
-                    QString tileTableName=mTilesName[tileX][tileY];
-                    if(mMpPtrGeometry->Overlaps(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                    }
-                    else if(mMpPtrGeometry->Contains(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                    }
-                    else if(mMpPtrGeometry->Within(iter2.value()))
-                    {
-                        tilesTableName[tileX][tileY]=tileTableName;
-                    }
-                }
-                iter2++;
-            }
-            iter1++;
-        }
+        strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
     }
-    else
+    QVector<QString> ignoreTilesTableName;
+    QMap<int,QMap<int,bool> > tilesOverlaps;
+    if(!getTilesFromGeometryByGrid(ptrGeometry,
+                                   ignoreTilesTableName,
+                                   tilesTableName,
+                                   tilesOverlaps,
+                                   strAuxError))
     {
-        QWidget* ptrWidget=new QWidget();
-        mMpTilesTableName.clear();
-        mTilesXToProcess.clear();
-        mTilesYToProcess.clear();
-        QVector<int> tilesPosition;
-        QMap<int,QMap<int,OGRGeometry*> >::const_iterator  iterTilesX=mTilesGeometry.begin();
-        while(iterTilesX!=mTilesGeometry.end())
-        {
-            int tileX=iterTilesX.key();
-            QMap<int,OGRGeometry*>::const_iterator iterTilesY=iterTilesX.value().begin();
-            while(iterTilesY!=iterTilesX.value().end())
-            {
-                int tileY=iterTilesY.key();
-                mTilesXToProcess.push_back(tileX);
-                mTilesYToProcess.push_back(tileY);
-                tilesPosition.push_back(tilesPosition.size());
-                iterTilesY++;
-            }
-            iterTilesX++;
-        }
-        if(mPtrMpProgressDialog!=NULL)
-        {
-            delete(mPtrMpProgressDialog);
-        }
-        if(ptrWidget!=NULL)
-            mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-        else
-            mPtrMpProgressDialog=new QProgressDialog();
-        QString dialogText=QObject::tr("Getting tiles from WKT geometry");
-        dialogText+=QObject::tr("\nNumber of tiles to process:%1").arg(tilesPosition.size());
-        dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-        mPtrMpProgressDialog->setLabelText(dialogText);
-        mPtrMpProgressDialog->setModal(true);
-        QFutureWatcher<void> futureWatcher;
-        QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-        QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-        QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-        QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-        //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-        futureWatcher.setFuture(QtConcurrent::map(tilesPosition,
-                                                  [this](int& data)
-        {mpGetTilesFromWktGeometry(data);}));
-        mStrErrorMpProgressDialog="";
-        mPtrMpProgressDialog->exec();
-        futureWatcher.waitForFinished();
-        delete(mPtrMpProgressDialog);
-        mPtrMpProgressDialog=NULL;
-        if(!mStrErrorMpProgressDialog.isEmpty())
-        {
-            strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
-            strError+=QObject::tr("\nError adding tiles geometry");
-            strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
-            OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-            mMpPtrGeometry=NULL;
-            return(false);
-        }
-        {
-            QMap<int, QMap<int, QString> >::iterator iterTilesX=mMpTilesTableName.begin();
-            while(iterTilesX!=mMpTilesTableName.end())
-            {
-                 QMap<int, QString>::iterator iterTilesY=iterTilesX.value().begin();
-                 while(iterTilesY!=iterTilesX.value().end())
-                 {
-                     tilesTableName[iterTilesX.key()][iterTilesY.key()]=iterTilesY.value();
-                     iterTilesY++;
-                 }
-                 iterTilesX++;
-            }
-        }
-        mMpTilesTableName.clear();
+        strError=QObject::tr("PointCloudFile::getTilesNamesFromWktGeometry");
+        strError+=QObject::tr("\nError recovering tiles from geometry:\n%1").arg(strAuxError);
+        OGRGeometryFactory::destroyGeometry(ptrGeometry);
+        return(false);
     }
-    OGRGeometryFactory::destroyGeometry(mMpPtrGeometry);
-    mMpPtrGeometry=NULL;
+    OGRGeometryFactory::destroyGeometry(ptrGeometry);
     return(true);
 }
 
 bool PointCloudFile::getTilesWktGeometry(QMap<QString, QString> &values,
                                          QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
+    QMutexLocker tilesWktLocker(&mTilesWktMutex);
     values.clear();
     bool useMultiProcess=mPtrPCFManager->getMultiProcess();
     if(!useMultiProcess)
@@ -4740,7 +6445,6 @@ bool PointCloudFile::getTilesWktGeometry(QMap<QString, QString> &values,
     }
     else
     {
-        QWidget* ptrWidget=new QWidget();
         mTilesXToProcess.clear();
         mTilesYToProcess.clear();
         QVector<int> tilesPosition;
@@ -4777,38 +6481,31 @@ bool PointCloudFile::getTilesWktGeometry(QMap<QString, QString> &values,
             }
             iterTilesX++;
         }
-        if(mPtrMpProgressDialog!=NULL)
+        if(mPtrMpProgress!=NULL)
         {
-            delete(mPtrMpProgressDialog);
+            delete(mPtrMpProgress);
         }
-        if(ptrWidget!=NULL)
-            mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-        else
-            mPtrMpProgressDialog=new QProgressDialog();
         QString dialogText=QObject::tr("Getting tiles WKT geometry");
         dialogText+=QObject::tr("\nNumber of tiles to process:%1").arg(tilesPosition.size());
         dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-        mPtrMpProgressDialog->setLabelText(dialogText);
-        mPtrMpProgressDialog->setModal(true);
-        QFutureWatcher<void> futureWatcher;
-        QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-        QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-        QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-        QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-        //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-        futureWatcher.setFuture(QtConcurrent::map(tilesPosition,
-                                                  [this](int& data)
-        {mpGetTilesWktGeometry(data);}));
-        mStrErrorMpProgressDialog="";
-        mPtrMpProgressDialog->exec();
-        futureWatcher.waitForFinished();
-        delete(mPtrMpProgressDialog);
-        mPtrMpProgressDialog=NULL;
-        if(!mStrErrorMpProgressDialog.isEmpty())
+        mPtrMpProgress=mPtrPCFManager->getProgressCallback()->createProgress(QObject::tr("Getting tiles WKT geometry"),
+                                                                             dialogText,tilesPosition.size());
+        QFuture<void> future=QtConcurrent::map(tilesPosition,
+                                               [this](int& data)
+        {mpGetTilesWktGeometry(data);});
+        bool finished=mPtrMpProgress->waitForFinished(future);
+        QString strMpError=mPtrMpProgress->getError();
+        if(!finished&&strMpError.isEmpty())
+        {
+            strMpError=QObject::tr("Process canceled by user");
+        }
+        delete(mPtrMpProgress);
+        mPtrMpProgress=NULL;
+        if(!finished)
         {
             strError=QObject::tr("PointCloudFile::getTilesWktGeometry");
             strError+=QObject::tr("\nError adding tiles geometry");
-            strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
+            strError+=QObject::tr("\nError:\n%1").arg(strMpError);
             return(false);
         }
     }
@@ -4820,6 +6517,7 @@ bool PointCloudFile::processReclassificationConfusionMatrixReport(QString &fileN
                                                                   QVector<int> &classes,
                                                                   QString &strError)
 {
+    QReadLocker dataLocker(&mDataLock);
     QFile file(fileName);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
@@ -4861,22 +6559,18 @@ bool PointCloudFile::processReclassificationConfusionMatrixReport(QString &fileN
         }
         iterFiles++;
     }
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
     QString strAuxError;
-    QProgressDialog* ptrProgress=NULL;
+    Progress* ptrProgress=NULL;
     int numberOfFiles=mFilesIndex.size();
-    if(ptrWidget!=NULL)
+    if(ptrProgressCallback!=NULL)
     {
         QString title=QObject::tr("Reporting reclassification confusion matrix for point cloud: ");
         QString msgGlobal=mPath;
         msgGlobal+="\n";
         msgGlobal+=QString::number(numberOfFiles,10);
         msgGlobal+=" number of files";
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfFiles, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfFiles);
     }
     iterFiles=mFilesIndex.begin();
     int nf=0;
@@ -4885,36 +6579,25 @@ bool PointCloudFile::processReclassificationConfusionMatrixReport(QString &fileN
         nf++;
         int fileId=iterFiles.value();
         QString pointCloudFileName=iterFiles.key();
-        if(ptrWidget!=NULL)
+        if(ptrProgress!=NULL)
         {
             ptrProgress->setValue(nf);
-            qApp->processEvents();
         }
         QString classesFileName=mClassesFileByIndex[fileId];
-        QFile pointsClassFile(classesFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
+        PointsClassesFile classesFile;
+        if(!readClassesFile(fileId,classesFile,strAuxError))
         {
             strError=QObject::tr("PointCloudFile::processReclassificationConfusionMatrixReport");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(classesFileName);
-            if(ptrWidget!=NULL)
+            strError+=QObject::tr("\nError reading classes file:\n%1\nError:\n%2").arg(classesFileName).arg(strAuxError);
+            if(ptrProgress!=NULL)
             {
                 ptrProgress->setValue(numberOfFiles);
-                qApp->processEvents();
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
         }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        QMap<int,QMap<int,QVector<quint8> > > tilesPointsClass;
-        QMap<int,QMap<int,QMap<int,quint8> > > tilesPointsClassNewByPos; // se guarda vacío
-        QMap<int,QMap<int,int> > tilesNop;
-        inPointsClass>>tilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>tilesPointsClass;
-        inPointsClass>>tilesPointsClassNewByPos;
-        pointsClassFile.close();
+        QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
         QMap<int,QMap<int,QVector<quint8> > >::const_iterator iterTileX=tilesPointsClass.begin(); // se guarda vacío
         while(iterTileX!=tilesPointsClass.end())
         {
@@ -4969,11 +6652,9 @@ bool PointCloudFile::processReclassificationConfusionMatrixReport(QString &fileN
         }
         iterFiles++;
     }
-    if(ptrWidget!=NULL)
+    if(ptrProgress!=NULL)
     {
         ptrProgress->setValue(numberOfFiles);
-        qApp->processEvents();
-        ptrProgress->close();
         delete(ptrProgress);
     }
     iterFiles=mFilesIndex.begin();
@@ -5233,9 +6914,88 @@ bool PointCloudFile::processReclassificationConfusionMatrixReport(QString &fileN
     return(true);
 }
 
+bool PointCloudFile::redo(QString &strError)
+{
+    QString strAuxError;
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditLogMutex);
+    if(mEditLog.getNumberOfRedoOperations()==0)
+    {
+        strError=QObject::tr("PointCloudFile::redo");
+        strError+=QObject::tr("\nThere are no operations to redo");
+        return(false);
+    }
+    if(!applyEditOperation(mEditLog.getRedoOperation(),
+                           false,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::redo");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    mEditLog.redo();
+    return(true);
+}
+
+bool PointCloudFile::restoreEditLogCheckpoint(QString name,
+                                              QString &strError)
+{
+    QString strAuxError;
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditLogMutex);
+    int numberOfMovements;
+    if(!mEditLog.getCheckpointMovements(name,numberOfMovements,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::restoreEditLogCheckpoint");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    // si falla queda en el estado de la ultima operacion aplicada
+    bool undo=(numberOfMovements<0);
+    for(int nm=0;nm<qAbs(numberOfMovements);nm++)
+    {
+        const PointsEditOperation& operation=undo?mEditLog.getUndoOperation():mEditLog.getRedoOperation();
+        if(!applyEditOperation(operation,
+                               undo,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::restoreEditLogCheckpoint");
+            strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+            return(false);
+        }
+        if(undo) mEditLog.undo();
+        else mEditLog.redo();
+    }
+    return(true);
+}
+
+bool PointCloudFile::rollback(QString &strError)
+{
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
+    QMutexLocker locker(&mEditSessionMutex);
+    if(!mEditSession)
+    {
+        strError=QObject::tr("PointCloudFile::rollback");
+        strError+=QObject::tr("\nThere is not an edit session in progress");
+        return(false);
+    }
+    // los cambios ya escritos en un checkpoint se conservan, el historial de deshacer
+    // ya no corresponde con las clases y se descarta
+    mEditSessionClassesFileByIndex.clear();
+    mEditSessionModifiedFileByIndex.clear();
+    mEditSession=false;
+    locker.unlock();
+    dataLocker.unlock();
+    clearEditLog();
+    return(true);
+}
+
 bool PointCloudFile::setFromPath(QString path,
                                  QString &strError)
 {
+    QMutexLocker writeLocker(&mWriteMutex);
+    QWriteLocker dataLocker(&mDataLock);
     clear();
     QDir currentDir=QDir::currentPath();
     if(!currentDir.exists(path))
@@ -5246,16 +7006,367 @@ bool PointCloudFile::setFromPath(QString path,
         clear();
         return(false);
     }
-    mPath=path;
-    QString strAuxError;
-    if(!readHeader(strAuxError))
+    mPath=path;
+    QString strAuxError;
+    if(!readHeader(strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::setFromPath");
+        strError+=QObject::tr("\nError setting from path:\n%1\nError:\n%2")
+                .arg(path).arg(strAuxError);
+        clear();
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::readLevelsOfDetailFile(int fileIndex,
+                                            QMap<int, QMap<int, QVector<int> > > &tilesLevelsNumberOfPoints,
+                                            QString &strError)
+{
+    tilesLevelsNumberOfPoints.clear();
+    QString strAuxError;
+    QString levelsOfDetailFileName=mLevelsOfDetailFileByIndex.value(fileIndex);
+    if(levelsOfDetailFileName.isEmpty()
+            ||!QFile::exists(levelsOfDetailFileName))
+    {
+        strError=QObject::tr("PointCloudFile::readLevelsOfDetailFile");
+        strError+=QObject::tr("\nThere are no levels of detail for file:\n%1")
+                .arg(mZipFilePointsByIndex.value(fileIndex));
+        return(false);
+    }
+    QuaZip zipFileLevels(levelsOfDetailFileName);
+    if(!zipFileLevels.open(QuaZip::mdUnzip)
+            ||!zipFileLevels.setCurrentFile(POINTCLOUDFILE_LOD_LEVELS_ENTRY_NAME))
+    {
+        strError=QObject::tr("PointCloudFile::readLevelsOfDetailFile");
+        strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
+                .arg(levelsOfDetailFileName)
+                .arg(QString::number(zipFileLevels.getZipError()));
+        return(false);
+    }
+    QuaZipFile levelsFile(&zipFileLevels);
+    if(!levelsFile.open(QIODevice::ReadOnly))
+    {
+        zipFileLevels.close();
+        strError=QObject::tr("PointCloudFile::readLevelsOfDetailFile");
+        strError+=QObject::tr("\nError opening: %1 in file:\n%2")
+                .arg(POINTCLOUDFILE_LOD_LEVELS_ENTRY_NAME).arg(levelsOfDetailFileName);
+        return(false);
+    }
+    QByteArray levelsData=levelsFile.readAll();
+    levelsFile.close();
+    zipFileLevels.close();
+    QVector<double> spacings;
+    QDataStream in(&levelsData,QIODevice::ReadOnly);
+    in>>spacings;
+    in>>tilesLevelsNumberOfPoints;
+    // niveles creados con otros parametros: hay que reconstruirlos
+    if(in.status()!=QDataStream::Ok
+            ||spacings!=getLevelsOfDetailSpacings())
+    {
+        tilesLevelsNumberOfPoints.clear();
+        strError=QObject::tr("PointCloudFile::readLevelsOfDetailFile");
+        strError+=QObject::tr("\nInvalid levels of detail in file:\n%1")
+                .arg(levelsOfDetailFileName);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::readOriginalIndexFile(int fileIndex,
+                                           QMap<int, QMap<int, QVector<qint64> > > &tilesOriginalIndexRanges,
+                                           QString &strError)
+{
+    tilesOriginalIndexRanges.clear();
+    QString originalIndexFileName=mOriginalIndexFileByIndex.value(fileIndex);
+    if(originalIndexFileName.isEmpty()
+            ||!QFile::exists(originalIndexFileName))
+    {
+        return(true);
+    }
+    QFile originalIndexFile(originalIndexFileName);
+    if(!originalIndexFile.open(QIODevice::ReadOnly))
+    {
+        strError=QObject::tr("PointCloudFile::readOriginalIndexFile");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(originalIndexFileName);
+        return(false);
+    }
+    // sin cabecera o con otra version se ignora y se exporta buscando por coordenadas
+    QDataStream in(&originalIndexFile);
+    quint32 magic=0;
+    qint32 version=0;
+    in>>magic>>version;
+    if(in.status()!=QDataStream::Ok
+            ||magic!=POINTCLOUDFILE_PCO_MAGIC
+            ||version!=POINTCLOUDFILE_PCO_VERSION)
+    {
+        originalIndexFile.close();
+        return(true);
+    }
+    in>>tilesOriginalIndexRanges;
+    originalIndexFile.close();
+    if(in.status()!=QDataStream::Ok)
+    {
+        tilesOriginalIndexRanges.clear();
+        strError=QObject::tr("PointCloudFile::readOriginalIndexFile");
+        strError+=QObject::tr("\nError reading file:\n%1").arg(originalIndexFileName);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::readPointsIndexFile(int fileIndex,
+                                         QMap<int, QMap<int, QVector<int> > > &tilesPositions,
+                                         QString &strError)
+{
+    tilesPositions.clear();
+    QMutexLocker locker(&mPointsIndexFileMutex);
+    QString pointsIndexFileName=mPointsIndexFileByIndex.value(fileIndex);
+    if(pointsIndexFileName.isEmpty()
+            ||!QFile::exists(pointsIndexFileName))
+    {
+        return(true);
+    }
+    QFile pointsIndexFile(pointsIndexFileName);
+    if(!pointsIndexFile.open(QIODevice::ReadOnly))
+    {
+        strError=QObject::tr("PointCloudFile::readPointsIndexFile");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(pointsIndexFileName);
+        return(false);
+    }
+    QDataStream in(&pointsIndexFile);
+    in>>tilesPositions;
+    pointsIndexFile.close();
+    if(in.status()!=QDataStream::Ok)
+    {
+        tilesPositions.clear();
+        strError=QObject::tr("PointCloudFile::readPointsIndexFile");
+        strError+=QObject::tr("\nError reading file:\n%1").arg(pointsIndexFileName);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::readClassesFile(int fileIndex,
+                                     PointsClassesFile &classesFile,
+                                     QString &strError)
+{
+    QString strAuxError;
+    {
+        QMutexLocker locker(&mEditSessionMutex);
+        if(mEditSessionClassesFileByIndex.contains(fileIndex))
+        {
+            classesFile=mEditSessionClassesFileByIndex[fileIndex];
+            return(true);
+        }
+    }
+    if(!classesFile.read(mClassesFileByIndex.value(fileIndex),strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::readClassesFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::readQueryClassesFile(PointsQuery &pointsQuery,
+                                          int fileIndex,
+                                          const QMap<int, QVector<int> > &tiles,
+                                          QMap<QString, bool> &existsFields,
+                                          QString &strError)
+{
+    QString strAuxError;
+    QString classesFileName=mClassesFileByIndex.value(fileIndex);
+    {
+        QMutexLocker locker(&mEditSessionMutex);
+        if(mEditSessionClassesFileByIndex.contains(fileIndex))
+        {
+            if(!pointsQuery.setClassesFile(fileIndex,
+                                           classesFileName,
+                                           mEditSessionClassesFileByIndex[fileIndex],
+                                           tiles,
+                                           existsFields,
+                                           strAuxError))
+            {
+                strError=QObject::tr("PointCloudFile::readQueryClassesFile");
+                strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+                return(false);
+            }
+            return(true);
+        }
+    }
+    if(!pointsQuery.readClassesFile(fileIndex,
+                                    classesFileName,
+                                    tiles,
+                                    existsFields,
+                                    strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::readQueryClassesFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::prepareQueryThinning(PointsQuery &pointsQuery,
+                                          const QMap<int, QMap<int, QVector<int> > > &tilesByFileIndex,
+                                          QString &strError)
+{
+    // Una tarea por tile con todos sus ficheros: los voxeles se comparten entre pasadas
+    // y la muestra aleatoria se calcula sobre los candidatos tras recortes y filtro
+    if(!pointsQuery.isThinning())
+    {
+        return(true);
+    }
+    QMap<int,QMap<int,QVector<int> > > filesByTile;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
+    while(iterFiles!=tilesByFileIndex.end())
+    {
+        QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
+        while(iterTileX!=iterFiles.value().end())
+        {
+            for(int i=0;i<iterTileX.value().size();i++)
+            {
+                filesByTile[iterTileX.key()][iterTileX.value()[i]].push_back(iterFiles.key());
+            }
+            iterTileX++;
+        }
+        iterFiles++;
+    }
+    QVector<int> tasksTileX;
+    QVector<int> tasksTileY;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterTileX=filesByTile.begin();
+    while(iterTileX!=filesByTile.end())
+    {
+        QMap<int,QVector<int> >::const_iterator iterTileY=iterTileX.value().begin();
+        while(iterTileY!=iterTileX.value().end())
+        {
+            tasksTileX.push_back(iterTileX.key());
+            tasksTileY.push_back(iterTileY.key());
+            iterTileY++;
+        }
+        iterTileX++;
+    }
+    int numberOfTasks=tasksTileX.size();
+    QVector<QMap<int,QVector<int> > > tasksSelectedPositions(numberOfTasks);
+    QVector<qint64> tasksNumberOfCandidates(numberOfTasks,0);
+    QVector<QString> tasksError(numberOfTasks);
+    QAtomicInt nextTask(0);
+    QAtomicInt numberOfProcessedTasks(0);
+    QAtomicInt canceled(0);
+    Progress* ptrProgress=NULL;
+    if(numberOfTasks>1)
+    {
+        QString title=QObject::tr("PointCloudFile::prepareQueryThinning");
+        QString msgGlobal=QObject::tr("Thinning points in %1 tiles")
+                .arg(QString::number(numberOfTasks));
+        ptrProgress=mPtrPCFManager->getProgressCallback()->createProgress(title,msgGlobal,numberOfTasks);
+    }
+    auto processTasks=[&](bool isCallerThread)
+    {
+        QMap<int,QuaZip*> ptrZipFilesByFileIndex;
+        while(canceled.loadAcquire()==0)
+        {
+            int task=nextTask.fetchAndAddOrdered(1);
+            if(task>=numberOfTasks) break;
+            int tileX=tasksTileX[task];
+            int tileY=tasksTileY[task];
+            const QVector<int> fileIndexes=filesByTile.value(tileX).value(tileY);
+            QMap<int,QuaZip*> ptrTileZipFilesByFileIndex;
+            for(int nf=0;nf<fileIndexes.size();nf++)
+            {
+                int fileIndex=fileIndexes[nf];
+                if(!ptrZipFilesByFileIndex.contains(fileIndex))
+                {
+                    QuaZip* ptrZipFile=new QuaZip(mZipFilePointsByIndex.value(fileIndex));
+                    ptrZipFilesByFileIndex[fileIndex]=ptrZipFile;
+                    if(!ptrZipFile->open(QuaZip::mdUnzip))
+                    {
+                        tasksError[task]=QObject::tr("Error opening file:\n%1\nError:\n%2")
+                                .arg(mZipFilePointsByIndex.value(fileIndex))
+                                .arg(QString::number(ptrZipFile->getZipError()));
+                        canceled.storeRelease(1);
+                        break;
+                    }
+                }
+                ptrTileZipFilesByFileIndex[fileIndex]=ptrZipFilesByFileIndex[fileIndex];
+            }
+            if(!tasksError[task].isEmpty()) break;
+            QString strTaskError;
+            if(!pointsQuery.getTileThinning(ptrTileZipFilesByFileIndex,
+                                            tileX,
+                                            tileY,
+                                            tasksSelectedPositions[task],
+                                            tasksNumberOfCandidates[task],
+                                            strTaskError))
+            {
+                tasksError[task]=strTaskError;
+                canceled.storeRelease(1);
+                break;
+            }
+            int numberOfProcessed=numberOfProcessedTasks.fetchAndAddOrdered(1)+1;
+            if(ptrProgress!=NULL)
+            {
+                if(isCallerThread)
+                {
+                    ptrProgress->setValue(numberOfProcessed);
+                }
+                if(ptrProgress->wasCanceled())
+                {
+                    tasksError[task]=QObject::tr("Process canceled by user");
+                    canceled.storeRelease(1);
+                }
+            }
+        }
+        QMap<int,QuaZip*>::iterator iterZipFiles=ptrZipFilesByFileIndex.begin();
+        while(iterZipFiles!=ptrZipFilesByFileIndex.end())
+        {
+            if(iterZipFiles.value()->isOpen()) iterZipFiles.value()->close();
+            delete(iterZipFiles.value());
+            iterZipFiles++;
+        }
+    };
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMax(1,qMin(QThread::idealThreadCount(),numberOfTasks));
+    }
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
+    {
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks(false);}));
+    }
+    processTasks(true);
+    for(int nt=0;nt<futures.size();nt++)
     {
-        strError=QObject::tr("PointCloudFile::setFromPath");
-        strError+=QObject::tr("\nError setting from path:\n%1\nError:\n%2")
-                .arg(path).arg(strAuxError);
-        clear();
-        return(false);
+        futures[nt].waitForFinished();
+    }
+    if(ptrProgress!=NULL)
+    {
+        delete(ptrProgress);
+    }
+    QMap<int,QMap<int,QMap<int,QVector<int> > > > selectedPositionsByFileIndex;
+    qint64 numberOfCandidates=0;
+    for(int task=0;task<numberOfTasks;task++)
+    {
+        if(!tasksError[task].isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::prepareQueryThinning");
+            strError+=QObject::tr("\nError thinning points in tile X: %1 tile Y: %2\nError:\n%3")
+                    .arg(QString::number(tasksTileX[task]))
+                    .arg(QString::number(tasksTileY[task]))
+                    .arg(tasksError[task]);
+            return(false);
+        }
+        numberOfCandidates+=tasksNumberOfCandidates[task];
+        QMap<int,QVector<int> >::const_iterator iterSelected=tasksSelectedPositions[task].begin();
+        while(iterSelected!=tasksSelectedPositions[task].end())
+        {
+            selectedPositionsByFileIndex[iterSelected.key()][tasksTileX[task]][tasksTileY[task]]=iterSelected.value();
+            iterSelected++;
+        }
     }
+    pointsQuery.setThinningSelection(selectedPositionsByFileIndex,numberOfCandidates);
     return(true);
 }
 
@@ -5446,7 +7557,6 @@ bool PointCloudFile::readHeader(QString &strError)
     }
     else
     {
-        QWidget* ptrWidget=new QWidget();
         mTilesXToProcess.clear();
         mTilesYToProcess.clear();
         QVector<int> tilesPosition;
@@ -5467,39 +7577,31 @@ bool PointCloudFile::readHeader(QString &strError)
             }
             iterTilesX++;
         }
-        if(mPtrMpProgressDialog!=NULL)
+        if(mPtrMpProgress!=NULL)
         {
-            delete(mPtrMpProgressDialog);
+            delete(mPtrMpProgress);
         }
-        if(ptrWidget!=NULL)
-            mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-        else
-            mPtrMpProgressDialog=new QProgressDialog();
-
         QString dialogText=QObject::tr("Adding tiles geometry");
         dialogText+=QObject::tr("\nNumber of tiles to process:%1").arg(tilesPosition.size());
         dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-        mPtrMpProgressDialog->setLabelText(dialogText);
-        mPtrMpProgressDialog->setModal(true);
-        QFutureWatcher<void> futureWatcher;
-        QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-        QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-        QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-        QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-        //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-        futureWatcher.setFuture(QtConcurrent::map(tilesPosition,
-                                                  [this](int& data)
-        {mpAddTilesGeometry(data);}));
-        mStrErrorMpProgressDialog="";
-        mPtrMpProgressDialog->exec();
-        futureWatcher.waitForFinished();
-        delete(mPtrMpProgressDialog);
-        mPtrMpProgressDialog=NULL;
-        if(!mStrErrorMpProgressDialog.isEmpty())
+        mPtrMpProgress=mPtrPCFManager->getProgressCallback()->createProgress(QObject::tr("Adding tiles geometry"),
+                                                                             dialogText,tilesPosition.size());
+        QFuture<void> future=QtConcurrent::map(tilesPosition,
+                                               [this](int& data)
+        {mpAddTilesGeometry(data);});
+        bool finished=mPtrMpProgress->waitForFinished(future);
+        QString strMpError=mPtrMpProgress->getError();
+        if(!finished&&strMpError.isEmpty())
+        {
+            strMpError=QObject::tr("Process canceled by user");
+        }
+        delete(mPtrMpProgress);
+        mPtrMpProgress=NULL;
+        if(!finished)
         {
             strError=QObject::tr("PointCloudFile::readHeader");
             strError+=QObject::tr("\nError adding tiles geometry");
-            strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
+            strError+=QObject::tr("\nError:\n%1").arg(strMpError);
             return(false);
         }
     }
@@ -5533,10 +7635,16 @@ bool PointCloudFile::readHeader(QString &strError)
                     .arg(pointsClassFileName);
             return(false);
         }
+        QString pointsIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCI_SUFFIX;
+        QString levelsOfDetailFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCL_SUFFIX;
+        QString originalIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCO_SUFFIX;
         QString tilesPointsFileZipFilePath=mPath+"/"+inputFileBaseName;
         mZipFilePathPointsByIndex[fileIndex]=tilesPointsFileZipFilePath;
         mZipFilePointsByIndex[fileIndex]=tilesPointsFileZipFileName;
         mClassesFileByIndex[fileIndex]=pointsClassFileName;
+        mPointsIndexFileByIndex[fileIndex]=pointsIndexFileName;
+        mLevelsOfDetailFileByIndex[fileIndex]=levelsOfDetailFileName;
+        mOriginalIndexFileByIndex[fileIndex]=originalIndexFileName;
         iterFiles++;
     }
 
@@ -5720,114 +7828,640 @@ void PointCloudFile::clear()
     QMap<QString,OGRGeometry*>::iterator iterROIs=mPtrROIs.begin();
     while(iterROIs!=mPtrROIs.end())
     {
-        OGRGeometry* ptrGeometry=iterROIs.value();
-        if(ptrGeometry!=NULL)
+        OGRGeometry* ptrGeometry=iterROIs.value();
+        if(ptrGeometry!=NULL)
+        {
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
+            mPtrROIs[iterROIs.key()]=NULL;
+        }
+        iterROIs++;
+    }
+    mROIsWkt.clear();
+    mTilessWkt.clear();
+    QMap<int,QMap<int,OGRGeometry*> >::iterator iterTilesColumn=mTilesGeometry.begin();
+    while(iterTilesColumn!=mTilesGeometry.end())
+    {
+        QMap<int,OGRGeometry*>::iterator iterTilesRow=iterTilesColumn.value().begin();
+        while(iterTilesRow!=iterTilesColumn.value().end())
+        {
+            OGRGeometry* ptrGeometry=iterTilesRow.value();
+            if(ptrGeometry!=NULL)
+            {
+                OGRGeometryFactory::destroyGeometry(ptrGeometry);
+                mTilesGeometry[iterTilesColumn.key()][iterTilesRow.key()]=NULL;
+            }
+            iterTilesRow++;
+        }
+        iterTilesColumn++;
+    }
+    /*
+    QMap<int,OGRGeometry*>::iterator iterFiles=mFilePtrGeometryByIndex.begin();
+    while(iterFiles!=mFilePtrGeometryByIndex.end())
+    {
+        OGRGeometry* ptrGeometry=iterFiles.value();
+        if(ptrGeometry!=NULL)
+        {
+            OGRGeometryFactory::destroyGeometry(ptrGeometry);
+            mFilePtrGeometryByIndex[iterFiles.key()]=NULL;
+        }
+        iterFiles++;
+    }
+    */
+    mFilesIndex.clear();
+    mFileByIndex.clear();
+    mZipFilePointsByIndex.clear();
+    mZipFilePathPointsByIndex.clear();
+    mClassesFileByIndex.clear();
+    mPointsIndexFileByIndex.clear();
+    mLevelsOfDetailFileByIndex.clear();
+    mOriginalIndexFileByIndex.clear();
+}
+
+bool PointCloudFile::writeEditSessionClassesFiles(QString &strError)
+{
+    QString strAuxError;
+    QMap<int,bool>::iterator iterFiles=mEditSessionModifiedFileByIndex.begin();
+    while(iterFiles!=mEditSessionModifiedFileByIndex.end())
+    {
+        int fileIndex=iterFiles.key();
+        if(!mEditSessionClassesFileByIndex[fileIndex].write(mClassesFileByIndex.value(fileIndex),
+                                                            strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::writeEditSessionClassesFiles");
+            strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+            return(false);
+        }
+        iterFiles=mEditSessionModifiedFileByIndex.erase(iterFiles);
+    }
+    return(true);
+}
+
+bool PointCloudFile::writeHeader(QString &strError)
+{
+//    QuaZipFile headerFile(mPtrZipFile);
+//    QString headerFileName=POINTCLOUDFILE_HEADER_FILE_NAME;
+//    headerFile.open(QIODevice::WriteOnly, QuaZipNewInfo(headerFileName));
+    mHeaderFileName=mPath+"/"+POINTCLOUDFILE_MANAGER_FILE_NAME;
+    QFile headerFile(mHeaderFileName);
+    headerFile.open(QIODevice::WriteOnly);
+    QDataStream headerOut(&headerFile);
+    headerOut<<mSRID;
+    headerOut<<mCrsDescription;
+    headerOut<<mCrsProj4String;
+    headerOut<<mHeightType;//string vertical crs epsg code
+    headerOut<<mGridSize;
+    headerOut<<mProjectType;
+    headerOut<<mParameterValueByCode;
+
+    headerOut<<mMinimumFc;
+    headerOut<<mMinimumSc;
+    headerOut<<mMinimumTc;
+    headerOut<<mMaximumDensity;
+    headerOut<<mFilesIndex;
+    headerOut<<mFileByIndex;
+    headerOut<<mNewFilesIndex;
+    headerOut<<mTilesName;
+    headerOut<<mTilesNumberOfPoints;
+    headerOut<<mTilesContainedInROIs;
+    headerOut<<mTilesOverlapsWithROIs;
+    headerOut<<mTilesByFileIndex;
+
+    quint16 numberOfROIs=mPtrROIs.size();
+    headerOut<<numberOfROIs;
+    if(numberOfROIs>0)
+    {
+        QMap<QString,OGRGeometry*>::const_iterator iterPtrRois=mPtrROIs.begin();
+        while(iterPtrRois!=mPtrROIs.end())
+        {
+            QString roiId=iterPtrRois.key();
+            OGRGeometry* ptrGeometry=iterPtrRois.value();
+            char* ptrWKT;
+            if(OGRERR_NONE!=ptrGeometry->exportToWkt(&ptrWKT))
+            {
+                strError=QObject::tr("PointCloudFile::writeHeader");
+                strError+=QObject::tr("\nError exporting geometry to wkt for ROI id:\n%1").arg(roiId);
+                return(false);
+            }
+            QString roiWkt=QString::fromLatin1(ptrWKT);
+            headerOut<<roiId<<roiWkt;
+            iterPtrRois++;
+        }
+        char* ptrUnionWKT;
+        if(OGRERR_NONE!=mPtrROIsUnion->exportToWkt(&ptrUnionWKT))
+        {
+            strError=QObject::tr("PointCloudFile::writeHeader");
+            strError+=QObject::tr("\nError exporting geometry to wkt for ROI union");
+            return(false);
+        }
+        QString roiUnionWkt=QString::fromLatin1(ptrUnionWKT);
+        QString roiUnionId=POINTCLOUDFILE_PROCESS_ROI_UNION_ID;
+        headerOut<<roiUnionId<<roiUnionWkt;
+    }
+    headerFile.close();
+    return(true);
+}
+
+bool PointCloudFile::linkOrCopyFile(QString inputFileName,
+                                    QString outputFileName,
+                                    bool allowHardLink,
+                                    QString &strError)
+{
+    // el enlace comparte los datos con el original, el reflink no
+#ifdef Q_OS_LINUX
+#ifdef FICLONE
+    {
+        int inputFd=open(QFile::encodeName(inputFileName).constData(),O_RDONLY);
+        if(inputFd>=0)
+        {
+            int outputFd=open(QFile::encodeName(outputFileName).constData(),O_WRONLY|O_CREAT|O_EXCL,0644);
+            if(outputFd>=0)
+            {
+                bool success=(ioctl(outputFd,FICLONE,inputFd)==0);
+                close(outputFd);
+                close(inputFd);
+                if(success)
+                {
+                    return(true);
+                }
+                QFile::remove(outputFileName);
+            }
+            else
+            {
+                close(inputFd);
+            }
+        }
+    }
+#endif
+#endif
+#if defined(Q_OS_WIN)
+    if(allowHardLink
+            &&CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(outputFileName).utf16(),
+                       (LPCWSTR)QDir::toNativeSeparators(inputFileName).utf16(),
+                       NULL))
+    {
+        return(true);
+    }
+#elif defined(Q_OS_UNIX)
+    if(allowHardLink
+            &&link(QFile::encodeName(inputFileName).constData(),
+                   QFile::encodeName(outputFileName).constData())==0)
+    {
+        return(true);
+    }
+#endif
+    if(!QFile::copy(inputFileName,outputFileName))
+    {
+        strError=QObject::tr("PointCloudFile::linkOrCopyFile");
+        strError+=QObject::tr("\nError copying file:\n%1\nto file:\n%2")
+                .arg(inputFileName).arg(outputFileName);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::patchLasFileClasses(QString inputFileName,
+                                         QString outputFileName,
+                                         const QVector<QPair<qint64, quint8> > &pointsClassNewByIndex,
+                                         bool removedPointsAsWithheld,
+                                         Progress *ptrProgress,
+                                         QString &strError)
+{
+    QString strAuxError;
+    // sin enlace, la salida no puede compartir datos con el original
+    if(!linkOrCopyFile(inputFileName,outputFileName,false,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    QFile file(outputFileName);
+    if(!file.open(QIODevice::ReadWrite))
+    {
+        strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(outputFileName);
+        QFile::remove(outputFileName);
+        return(false);
+    }
+    QByteArray header=file.read(POINTCLOUDFILE_LAS_HEADER_14_SIZE);
+    if(header.size()<POINTCLOUDFILE_LAS_HEADER_MINIMUM_SIZE
+            ||!header.startsWith(POINTCLOUDFILE_LAS_HEADER_SIGNATURE))
+    {
+        strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+        strError+=QObject::tr("\nInvalid las header in file:\n%1").arg(outputFileName);
+        file.close();
+        QFile::remove(outputFileName);
+        return(false);
+    }
+    const uchar* ptrHeader=reinterpret_cast<const uchar*>(header.constData());
+    quint8 versionMinor=ptrHeader[POINTCLOUDFILE_LAS_HEADER_VERSION_MINOR_POSITION];
+    qint64 offsetToPointData=qFromLittleEndian<quint32>(ptrHeader+POINTCLOUDFILE_LAS_HEADER_OFFSET_TO_POINT_DATA_POSITION);
+    quint8 pointDataFormat=ptrHeader[POINTCLOUDFILE_LAS_HEADER_POINT_DATA_FORMAT_POSITION];
+    qint64 pointDataRecordLength=qFromLittleEndian<quint16>(ptrHeader+POINTCLOUDFILE_LAS_HEADER_POINT_DATA_RECORD_LENGTH_POSITION);
+    qint64 numberOfPoints=qFromLittleEndian<quint32>(ptrHeader+POINTCLOUDFILE_LAS_HEADER_NUMBER_OF_POINTS_POSITION);
+    if(versionMinor>=4
+            &&header.size()>=POINTCLOUDFILE_LAS_HEADER_EXTENDED_NUMBER_OF_POINTS_POSITION+8)
+    {
+        numberOfPoints=qFromLittleEndian<quint64>(ptrHeader+POINTCLOUDFILE_LAS_HEADER_EXTENDED_NUMBER_OF_POINTS_POSITION);
+    }
+    if((pointDataFormat&POINTCLOUDFILE_LAS_POINT_COMPRESSED_FORMAT_MASK)!=0
+            ||pointDataRecordLength<POINTCLOUDFILE_LAS_POINT_FLAGS_POSITION+2)
+    {
+        strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+        strError+=QObject::tr("\nNot supported point data format: %1 in file:\n%2")
+                .arg(QString::number(pointDataFormat)).arg(outputFileName);
+        file.close();
+        QFile::remove(outputFileName);
+        return(false);
+    }
+    bool extendedFormat=(pointDataFormat>=POINTCLOUDFILE_LAS_POINT_EXTENDED_FORMAT_MINIMUM);
+    int numberOfChanges=pointsClassNewByIndex.size();
+    for(int nc=0;nc<numberOfChanges;nc++)
+    {
+        qint64 pointIndex=pointsClassNewByIndex[nc].first;
+        quint8 classNew=pointsClassNewByIndex[nc].second;
+        if(pointIndex>=numberOfPoints)
+        {
+            strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+            strError+=QObject::tr("\nNot exists point: %1 in file:\n%2")
+                    .arg(QString::number(pointIndex)).arg(outputFileName);
+            file.close();
+            QFile::remove(outputFileName);
+            return(false);
+        }
+        // byte de flags y clasificacion, los dos bytes cubren los formatos 0-5 y 6-10
+        qint64 position=offsetToPointData+pointIndex*pointDataRecordLength+POINTCLOUDFILE_LAS_POINT_FLAGS_POSITION;
+        char record[2];
+        if(!file.seek(position)
+                ||file.read(record,2)!=2)
+        {
+            strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+            strError+=QObject::tr("\nError reading point: %1 in file:\n%2")
+                    .arg(QString::number(pointIndex)).arg(outputFileName);
+            file.close();
+            QFile::remove(outputFileName);
+            return(false);
+        }
+        if(classNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE)
+        {
+            if(!removedPointsAsWithheld) continue;
+            if(extendedFormat)
+            {
+                record[0]=record[0]|POINTCLOUDFILE_LAS_POINT_EXTENDED_WITHHELD_MASK;
+            }
+            else
+            {
+                record[0]=record[0]|POINTCLOUDFILE_LAS_POINT_WITHHELD_MASK;
+            }
+        }
+        else if(extendedFormat)
+        {
+            record[1]=classNew;
+        }
+        else
+        {
+            if(classNew>POINTCLOUDFILE_LAS_POINT_CLASS_MAXIMUM) continue;
+            record[0]=(record[0]&~POINTCLOUDFILE_LAS_POINT_CLASS_MASK)|classNew;
+        }
+        if(!file.seek(position)
+                ||file.write(record,2)!=2)
+        {
+            strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+            strError+=QObject::tr("\nError writing point: %1 in file:\n%2")
+                    .arg(QString::number(pointIndex)).arg(outputFileName);
+            file.close();
+            QFile::remove(outputFileName);
+            return(false);
+        }
+        if(ptrProgress!=NULL
+                &&(nc+1)%POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP==0
+                &&ptrProgress->wasCanceled())
+        {
+            strError=QObject::tr("PointCloudFile::patchLasFileClasses");
+            strError+=QObject::tr("\nProcess canceled by user");
+            file.close();
+            QFile::remove(outputFileName);
+            return(false);
+        }
+    }
+    file.close();
+    return(true);
+}
+
+bool PointCloudFile::patchLazFileChunks(QString inputFileName,
+                                        QString outputFileName,
+                                        const QVector<QPair<qint64, quint8> > &pointsClassNewByIndex,
+                                        bool removedPointsAsWithheld,
+                                        Progress *ptrProgress,
+                                        bool &patched,
+                                        QString &strError)
+{
+    patched=false;
+    std::string stdInputFileName=inputFileName.toStdString();
+    const char* charInputFileName=stdInputFileName.c_str();
+    LASreadOpener lasreadopener;
+    lasreadopener.set_file_name(charInputFileName);
+    LASreader* lasreader=lasreadopener.open();
+    if(lasreader==NULL)
+    {
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
+        return(false);
+    }
+    // solo ficheros laz por chunks y sin evlrs tras los puntos, el resto se reescriben
+    LASheader* lasheader=&lasreader->header;
+    LASzip* ptrLaszip=lasheader->laszip;
+    if(ptrLaszip==NULL
+            ||ptrLaszip->chunk_size==0
+            ||(ptrLaszip->number_of_special_evlrs!=-1&&ptrLaszip->number_of_special_evlrs!=0)
+            ||lasheader->number_of_extended_variable_length_records>0)
+    {
+        lasreader->close();
+        delete lasreader;
+        return(true);
+    }
+    bool variableChunks=(ptrLaszip->chunk_size==U32_MAX);
+    bool extendedFormat=(lasheader->point_data_format>=POINTCLOUDFILE_LAS_POINT_EXTENDED_FORMAT_MINIMUM);
+    qint64 numberOfPoints=lasreader->npoints;
+    qint64 pointDataPosition=lasheader->offset_to_point_data;
+    // tabla de chunks: puntos (solo si son variables) y bytes de cada uno
+    QVector<qint64> chunksNumberOfPoints;
+    QVector<qint64> chunksNumberOfBytes;
+    FILE* ptrInputFile=fopen(charInputFileName,"rb");
+    if(ptrInputFile==NULL)
+    {
+        lasreader->close();
+        delete lasreader;
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
+        return(false);
+    }
+    bool validChunkTable=true;
+    try
+    {
+        ByteStreamInFileLE chunkTableStream(ptrInputFile);
+        I64 chunkTablePosition=-1;
+        chunkTableStream.seek(pointDataPosition);
+        chunkTableStream.get64bitsLE((U8*)&chunkTablePosition);
+        if(chunkTablePosition==-1)
+        {
+            chunkTableStream.seekEnd(8);
+            chunkTableStream.get64bitsLE((U8*)&chunkTablePosition);
+        }
+        U32 chunkTableVersion=0;
+        U32 numberOfChunks=0;
+        chunkTableStream.seek(chunkTablePosition);
+        chunkTableStream.get32bitsLE((U8*)&chunkTableVersion);
+        chunkTableStream.get32bitsLE((U8*)&numberOfChunks);
+        if(chunkTableVersion!=0)
+        {
+            validChunkTable=false;
+        }
+        else if(numberOfChunks>0)
+        {
+            ArithmeticDecoder decoder;
+            decoder.init(&chunkTableStream);
+            IntegerCompressor integerDecompressor(&decoder,32,2);
+            integerDecompressor.initDecompressor();
+            I32 chunkNumberOfPoints=0;
+            I32 chunkNumberOfBytes=0;
+            for(U32 nch=0;nch<numberOfChunks;nch++)
+            {
+                if(variableChunks)
+                {
+                    chunkNumberOfPoints=integerDecompressor.decompress(chunkNumberOfPoints,0);
+                }
+                else
+                {
+                    chunkNumberOfPoints=qMin((qint64)ptrLaszip->chunk_size,
+                                             numberOfPoints-(qint64)nch*ptrLaszip->chunk_size);
+                }
+                chunkNumberOfBytes=integerDecompressor.decompress(chunkNumberOfBytes,1);
+                chunksNumberOfPoints.push_back(chunkNumberOfPoints);
+                chunksNumberOfBytes.push_back(chunkNumberOfBytes);
+            }
+            decoder.done();
+        }
+    }
+    catch(...)
+    {
+        validChunkTable=false;
+    }
+    fclose(ptrInputFile);
+    qint64 numberOfPointsInChunks=0;
+    for(int nch=0;nch<chunksNumberOfPoints.size();nch++)
+    {
+        if(chunksNumberOfPoints[nch]<=0)
+        {
+            validChunkTable=false;
+        }
+        numberOfPointsInChunks+=chunksNumberOfPoints[nch];
+    }
+    if(!validChunkTable
+            ||numberOfPointsInChunks!=numberOfPoints)
+    {
+        lasreader->close();
+        delete lasreader;
+        return(true);
+    }
+    // primer cambio de cada chunk, -1 si no tiene cambios
+    int numberOfChunks=chunksNumberOfPoints.size();
+    int numberOfChanges=pointsClassNewByIndex.size();
+    QVector<int> chunksFirstChange(numberOfChunks,-1);
+    int nc=0;
+    qint64 chunkFirstPoint=0;
+    for(int nch=0;nch<numberOfChunks&&nc<numberOfChanges;nch++)
+    {
+        qint64 chunkEndPoint=chunkFirstPoint+chunksNumberOfPoints[nch];
+        if(pointsClassNewByIndex[nc].first<chunkEndPoint)
         {
-            OGRGeometryFactory::destroyGeometry(ptrGeometry);
-            mPtrROIs[iterROIs.key()]=NULL;
+            chunksFirstChange[nch]=nc;
         }
-        iterROIs++;
+        while(nc<numberOfChanges
+              &&pointsClassNewByIndex[nc].first<chunkEndPoint)
+        {
+            nc++;
+        }
+        chunkFirstPoint=chunkEndPoint;
     }
-    mROIsWkt.clear();
-    mTilessWkt.clear();
-    QMap<int,QMap<int,OGRGeometry*> >::iterator iterTilesColumn=mTilesGeometry.begin();
-    while(iterTilesColumn!=mTilesGeometry.end())
+    if(nc<numberOfChanges)
     {
-        QMap<int,OGRGeometry*>::iterator iterTilesRow=iterTilesColumn.value().begin();
-        while(iterTilesRow!=iterTilesColumn.value().end())
+        lasreader->close();
+        delete lasreader;
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nNot exists point: %1 in file:\n%2")
+                .arg(QString::number(pointsClassNewByIndex[nc].first)).arg(inputFileName);
+        return(false);
+    }
+    QFile inputFile(inputFileName);
+    if(!inputFile.open(QIODevice::ReadOnly))
+    {
+        lasreader->close();
+        delete lasreader;
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
+        return(false);
+    }
+    QFile outputFile(outputFileName);
+    if(!outputFile.open(QIODevice::WriteOnly))
+    {
+        inputFile.close();
+        lasreader->close();
+        delete lasreader;
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(outputFileName);
+        return(false);
+    }
+    auto closeFiles=[&]()
+    {
+        inputFile.close();
+        outputFile.close();
+        QFile::remove(outputFileName);
+        lasreader->close();
+        delete lasreader;
+    };
+    // cabecera, vlrs y posicion de la tabla de chunks, que se actualiza al final
+    qint64 chunksStartPosition=pointDataPosition+8;
+    QByteArray headerBytes=inputFile.read(chunksStartPosition);
+    if(headerBytes.size()!=chunksStartPosition
+            ||outputFile.write(headerBytes)!=chunksStartPosition)
+    {
+        closeFiles();
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError copying header from file:\n%1").arg(inputFileName);
+        return(false);
+    }
+    QVector<qint64> outputChunksNumberOfBytes(numberOfChunks);
+    qint64 chunkPosition=chunksStartPosition;
+    chunkFirstPoint=0;
+    for(int nch=0;nch<numberOfChunks;nch++)
+    {
+        if(ptrProgress!=NULL
+                &&ptrProgress->wasCanceled())
         {
-            OGRGeometry* ptrGeometry=iterTilesRow.value();
-            if(ptrGeometry!=NULL)
+            closeFiles();
+            strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+            strError+=QObject::tr("\nProcess canceled by user");
+            return(false);
+        }
+        if(chunksFirstChange[nch]==-1)
+        {
+            // sin cambios se copian los bytes comprimidos
+            QByteArray chunkBytes;
+            if(!inputFile.seek(chunkPosition)
+                    ||(chunkBytes=inputFile.read(chunksNumberOfBytes[nch])).size()!=chunksNumberOfBytes[nch]
+                    ||outputFile.write(chunkBytes)!=chunksNumberOfBytes[nch])
             {
-                OGRGeometryFactory::destroyGeometry(ptrGeometry);
-                mTilesGeometry[iterTilesColumn.key()][iterTilesRow.key()]=NULL;
+                closeFiles();
+                strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+                strError+=QObject::tr("\nError copying chunk: %1 from file:\n%2")
+                        .arg(QString::number(nch)).arg(inputFileName);
+                return(false);
             }
-            iterTilesRow++;
+            outputChunksNumberOfBytes[nch]=chunksNumberOfBytes[nch];
         }
-        iterTilesColumn++;
-    }
-    /*
-    QMap<int,OGRGeometry*>::iterator iterFiles=mFilePtrGeometryByIndex.begin();
-    while(iterFiles!=mFilePtrGeometryByIndex.end())
-    {
-        OGRGeometry* ptrGeometry=iterFiles.value();
-        if(ptrGeometry!=NULL)
+        else
         {
-            OGRGeometryFactory::destroyGeometry(ptrGeometry);
-            mFilePtrGeometryByIndex[iterFiles.key()]=NULL;
+            // se descomprime y se comprime de nuevo como un fichero de un solo chunk
+            LASwritePoint chunkWriter;
+            ByteStreamOutArrayLE chunkStream;
+            bool success=(lasreader->seek(chunkFirstPoint)
+                          &&chunkWriter.setup(ptrLaszip->num_items,ptrLaszip->items,ptrLaszip)
+                          &&chunkWriter.init(&chunkStream));
+            int nextChange=chunksFirstChange[nch];
+            for(qint64 np=0;success&&np<chunksNumberOfPoints[nch];np++)
+            {
+                if(!lasreader->read_point())
+                {
+                    success=false;
+                    break;
+                }
+                qint64 pointIndex=chunkFirstPoint+np;
+                if(nextChange<numberOfChanges
+                        &&pointsClassNewByIndex[nextChange].first==pointIndex)
+                {
+                    quint8 classNew=pointsClassNewByIndex[nextChange].second;
+                    if(classNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE)
+                    {
+                        if(removedPointsAsWithheld)
+                        {
+                            lasreader->point.set_withheld_flag(1);
+                        }
+                    }
+                    else if(extendedFormat)
+                    {
+                        lasreader->point.set_extended_classification(classNew);
+                    }
+                    else if(classNew<=POINTCLOUDFILE_LAS_POINT_CLASS_MAXIMUM)
+                    {
+                        lasreader->point.set_classification(classNew);
+                    }
+                    nextChange++;
+                }
+                success=chunkWriter.write(lasreader->point.point);
+            }
+            success=(success&&chunkWriter.done());
+            // el flujo empieza con la posicion de su tabla de chunks, que sigue al chunk
+            qint64 chunkNumberOfBytes=0;
+            if(success
+                    &&chunkStream.getSize()>=8)
+            {
+                chunkNumberOfBytes=qFromLittleEndian<qint64>(chunkStream.getData())-8;
+            }
+            if(!success
+                    ||chunkNumberOfBytes<=0
+                    ||chunkNumberOfBytes+8>chunkStream.getSize()
+                    ||outputFile.write((const char*)chunkStream.getData()+8,chunkNumberOfBytes)!=chunkNumberOfBytes)
+            {
+                closeFiles();
+                strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+                strError+=QObject::tr("\nError compressing chunk: %1 from file:\n%2")
+                        .arg(QString::number(nch)).arg(inputFileName);
+                return(false);
+            }
+            outputChunksNumberOfBytes[nch]=chunkNumberOfBytes;
         }
-        iterFiles++;
+        chunkPosition+=chunksNumberOfBytes[nch];
+        chunkFirstPoint+=chunksNumberOfPoints[nch];
     }
-    */
-    mFilesIndex.clear();
-    mFileByIndex.clear();
-    mZipFilePointsByIndex.clear();
-    mZipFilePathPointsByIndex.clear();
-    mClassesFileByIndex.clear();
-}
-
-bool PointCloudFile::writeHeader(QString &strError)
-{
-//    QuaZipFile headerFile(mPtrZipFile);
-//    QString headerFileName=POINTCLOUDFILE_HEADER_FILE_NAME;
-//    headerFile.open(QIODevice::WriteOnly, QuaZipNewInfo(headerFileName));
-    mHeaderFileName=mPath+"/"+POINTCLOUDFILE_MANAGER_FILE_NAME;
-    QFile headerFile(mHeaderFileName);
-    headerFile.open(QIODevice::WriteOnly);
-    QDataStream headerOut(&headerFile);
-    headerOut<<mSRID;
-    headerOut<<mCrsDescription;
-    headerOut<<mCrsProj4String;
-    headerOut<<mHeightType;//string vertical crs epsg code
-    headerOut<<mGridSize;
-    headerOut<<mProjectType;
-    headerOut<<mParameterValueByCode;
-
-    headerOut<<mMinimumFc;
-    headerOut<<mMinimumSc;
-    headerOut<<mMinimumTc;
-    headerOut<<mMaximumDensity;
-    headerOut<<mFilesIndex;
-    headerOut<<mFileByIndex;
-    headerOut<<mNewFilesIndex;
-    headerOut<<mTilesName;
-    headerOut<<mTilesNumberOfPoints;
-    headerOut<<mTilesContainedInROIs;
-    headerOut<<mTilesOverlapsWithROIs;
-    headerOut<<mTilesByFileIndex;
-
-    quint16 numberOfROIs=mPtrROIs.size();
-    headerOut<<numberOfROIs;
-    if(numberOfROIs>0)
+    // nueva tabla de chunks con los bytes de los chunks recomprimidos
+    qint64 chunkTablePosition=outputFile.pos();
+    ByteStreamOutArrayLE chunkTableStream;
+    U32 chunkTableVersion=0;
+    U32 outputNumberOfChunks=numberOfChunks;
+    chunkTableStream.put32bitsLE((U8*)&chunkTableVersion);
+    chunkTableStream.put32bitsLE((U8*)&outputNumberOfChunks);
+    if(numberOfChunks>0)
     {
-        QMap<QString,OGRGeometry*>::const_iterator iterPtrRois=mPtrROIs.begin();
-        while(iterPtrRois!=mPtrROIs.end())
+        ArithmeticEncoder encoder;
+        encoder.init(&chunkTableStream);
+        IntegerCompressor integerCompressor(&encoder,32,2);
+        integerCompressor.initCompressor();
+        for(int nch=0;nch<numberOfChunks;nch++)
         {
-            QString roiId=iterPtrRois.key();
-            OGRGeometry* ptrGeometry=iterPtrRois.value();
-            char* ptrWKT;
-            if(OGRERR_NONE!=ptrGeometry->exportToWkt(&ptrWKT))
+            if(variableChunks)
             {
-                strError=QObject::tr("PointCloudFile::writeHeader");
-                strError+=QObject::tr("\nError exporting geometry to wkt for ROI id:\n%1").arg(roiId);
-                return(false);
+                integerCompressor.compress((nch?chunksNumberOfPoints[nch-1]:0),chunksNumberOfPoints[nch],0);
             }
-            QString roiWkt=QString::fromLatin1(ptrWKT);
-            headerOut<<roiId<<roiWkt;
-            iterPtrRois++;
+            integerCompressor.compress((nch?outputChunksNumberOfBytes[nch-1]:0),outputChunksNumberOfBytes[nch],1);
         }
-        char* ptrUnionWKT;
-        if(OGRERR_NONE!=mPtrROIsUnion->exportToWkt(&ptrUnionWKT))
-        {
-            strError=QObject::tr("PointCloudFile::writeHeader");
-            strError+=QObject::tr("\nError exporting geometry to wkt for ROI union");
-            return(false);
-        }
-        QString roiUnionWkt=QString::fromLatin1(ptrUnionWKT);
-        QString roiUnionId=POINTCLOUDFILE_PROCESS_ROI_UNION_ID;
-        headerOut<<roiUnionId<<roiUnionWkt;
+        encoder.done();
     }
-    headerFile.close();
+    uchar chunkTablePositionBytes[8];
+    qToLittleEndian<qint64>(chunkTablePosition,chunkTablePositionBytes);
+    if(outputFile.write((const char*)chunkTableStream.getData(),chunkTableStream.getSize())!=chunkTableStream.getSize()
+            ||!outputFile.seek(pointDataPosition)
+            ||outputFile.write((const char*)chunkTablePositionBytes,8)!=8)
+    {
+        closeFiles();
+        strError=QObject::tr("PointCloudFile::patchLazFileChunks");
+        strError+=QObject::tr("\nError writing chunk table in file:\n%1").arg(outputFileName);
+        return(false);
+    }
+    inputFile.close();
+    outputFile.close();
+    lasreader->close();
+    delete lasreader;
+    patched=true;
     return(true);
 }
 
@@ -5856,8 +8490,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError removing existing file:\n%1")
                     .arg(tilesPointsFileZipFileName);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
     }
@@ -5871,8 +8504,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError removing existing dir:\n%1")
                     .arg(tilesPointsFileZipFilePath);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
     }
@@ -5881,8 +8513,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
         strError+=QObject::tr("\nError making dir:\n%1")
                 .arg(tilesPointsFileZipFilePath);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
 
@@ -5894,8 +8525,44 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError removing existing file:\n%1")
                     .arg(pointsClassFileName);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
+            return;
+        }
+    }
+    // el indice de vecinos y los niveles de detalle de la version anterior del fichero dejan de ser validos
+    QString pointsIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCI_SUFFIX;
+    if(QFile::exists(pointsIndexFileName))
+    {
+        if(!QFile::remove(pointsIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::mpAddPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(pointsIndexFileName);
+            mPtrMpProgress->setError(strError);
+            return;
+        }
+    }
+    QString levelsOfDetailFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCL_SUFFIX;
+    if(QFile::exists(levelsOfDetailFileName))
+    {
+        if(!QFile::remove(levelsOfDetailFileName))
+        {
+            strError=QObject::tr("PointCloudFile::mpAddPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(levelsOfDetailFileName);
+            mPtrMpProgress->setError(strError);
+            return;
+        }
+    }
+    QString originalIndexFileName=mPath+"/"+inputFileBaseName+"."+POINTCLOUDFILE_PCO_SUFFIX;
+    if(QFile::exists(originalIndexFileName))
+    {
+        if(!QFile::remove(originalIndexFileName))
+        {
+            strError=QObject::tr("PointCloudFile::mpAddPointCloudFile");
+            strError+=QObject::tr("\nError removing existing file:\n%1")
+                    .arg(originalIndexFileName);
+            mPtrMpProgress->setError(strError);
             return;
         }
     }
@@ -5937,8 +8604,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         {
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
         LASreader* lasreader = lasreadopener.open();
@@ -6030,8 +8696,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
     {
         strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
         strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
 
@@ -6046,7 +8711,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
     double fileMaxZ=lasheader->max_z;
 
     int pointsByStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_PROCESS_BY_STEP;
-    int pointPosition=-1;
+    qint64 pointPosition=-1;
     int step=0;
     int numberOfProcessedPoints=0;
     int numberOfProcessedPointsInStep=0;
@@ -6058,6 +8723,8 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
     QMap<int,QMap<int,QFile*> > tilesPtrPointsFiles;
     QMap<int,QMap<int,QDataStream*> > tilesPtrPointsDataStreams;
     QMap<int,QMap<int,int> > tilesNop;
+    QMap<int,QMap<int,QVector<double> > > tilesStatistics;
+    QMap<int,QMap<int,QVector<qint64> > > tilesOriginalIndexRanges; // por tramo, primer indice en el fichero y numero de puntos
     while(lasreader->read_point())
     {
         double x=lasreader->point.get_X()*lasheader->x_scale_factor+lasheader->x_offset;
@@ -6075,7 +8742,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             QString dialogText=QObject::tr("Adding point cloud files");
             dialogText+=QObject::tr("\nNumber of point cloud files to process:%1").arg(mNumberOfFilesToProcess);
             dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-    //                mPtrMpProgressDialog->setWindowTitle(title);
+    //                mPtrMpProgress->setWindowTitle(title);
             QMap<QString,int>::iterator iter=mNumberOfPointsToProcessByFileName.begin();
             while(iter!=mNumberOfPointsToProcessByFileName.end())
             {
@@ -6090,7 +8757,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
                         .arg(strNumberOfPointsToProcess).arg(auxInputFileName);
                 iter++;
             }
-            mPtrMpProgressDialog->setLabelText(dialogText);
+            mPtrMpProgress->setLabelText(dialogText);
             mMutex.unlock();
             */
             numberOfProcessedPointsInStep=0;
@@ -6147,8 +8814,8 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
 //                    .arg(QString::number(z,'f',3))
 //                    .arg(QString::number(POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE,'f',3))
 //                    .arg(QString::number(POINTCLOUDFILE_HEIGHT_MAXIMUM_VALID_VALUE,'f',3));
-//            mStrErrorMpProgressDialog=strError;
-//            emit(mPtrMpProgressDialog->canceled());
+//            mStrErrorMpProgress=strError;
+//            mPtrMpProgress->cancel();
 //            return;
             continue;
         }
@@ -6188,8 +8855,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
                 strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
                 strError+=QObject::tr("\nError creating file:\n%1")
                         .arg(tilePointsFileName);
-                mStrErrorMpProgressDialog=strError;
-                emit(mPtrMpProgressDialog->canceled());
+                mPtrMpProgress->setError(strError);
                 return;
             }
             tilePtrPointsDataStream=new QDataStream(ptrTilePointsFile);
@@ -6199,12 +8865,16 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             QVector<quint8> auxClasses;
             tilesPointsClass[tileX][tileY]=auxClasses;
             tilesNop[tileX][tileY]=0;
+            tilesStatistics[tileX][tileY]=getEmptyTileStatistics();
         }
         else
         {
             tilePtrPointsDataStream=tilesPtrPointsDataStreams[tileX][tileY];
         }
         (*tilePtrPointsDataStream)<<ix<<iy<<z_pa<<z_pb<<z_pc;
+        QVector<double>& tileStatistics=tilesStatistics[tileX][tileY];
+        updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_Z_MIN,
+                             (z_pa*256+z_pb)*100+z_pc);
         if(existsColor)
         {
             quint16 color_r=lasreader->point.get_R();
@@ -6249,6 +8919,8 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             (*tilePtrPointsDataStream)<<msb1;
             (*tilePtrPointsDataStream)<<msb2;
             (*tilePtrPointsDataStream)<<msb3;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MIN,
+                                 Point::getGpsTime(gpsDowHourPackit,msb1,msb2,msb3));
         }
         if(existsUserData)
         {
@@ -6259,6 +8931,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         {
             quint16 intensity=lasreader->point.get_intensity();
             (*tilePtrPointsDataStream)<<intensity;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MIN,intensity);
         }
         if(existsSourceId)
         {
@@ -6283,6 +8956,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         {
             quint8 returnNumber=lasreader->point.get_return_number();
             (*tilePtrPointsDataStream)<<returnNumber;
+            updateTileStatistics(tileStatistics,POINTCLOUDFILE_TILE_STATISTICS_RETURN_MIN,returnNumber);
         }
         if(existsReturns)
         {
@@ -6293,6 +8967,18 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         double minY=floor(y);
         double minZ=floor(z);
         tilesPointsClass[tileX][tileY].push_back(pointClass);
+        QVector<qint64>& tileOriginalIndexRanges=tilesOriginalIndexRanges[tileX][tileY];
+        int numberOfRangesValues=tileOriginalIndexRanges.size();
+        if(numberOfRangesValues>0
+                &&tileOriginalIndexRanges[numberOfRangesValues-2]+tileOriginalIndexRanges[numberOfRangesValues-1]==pointPosition)
+        {
+            tileOriginalIndexRanges[numberOfRangesValues-1]++;
+        }
+        else
+        {
+            tileOriginalIndexRanges.push_back(pointPosition);
+            tileOriginalIndexRanges.push_back(1);
+        }
         tilesNumberOfPoints[tileX][tileY]=tilesNumberOfPoints[tileX][tileY]+1;
         tilesNop[tileX][tileY]=tilesNop[tileX][tileY]+1;
         mMutex.lock();
@@ -6313,8 +8999,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError removing directory:\n%1")
                     .arg(tilesPointsFileZipFilePath);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
         return;
@@ -6408,8 +9093,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
         strError+=QObject::tr("\nError compressing directory:\n%1")
                 .arg(tilesPointsFileZipFilePath);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
     if(!removeDir(tilesPointsFileZipFilePath))
@@ -6417,8 +9101,7 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
         strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
         strError+=QObject::tr("\nError removing directory:\n%1")
                 .arg(tilesPointsFileZipFilePath);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
 //    ptrTilesPointsFileZip->close();
@@ -6446,7 +9129,17 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
     outPointsClass<<exitsFields;
     outPointsClass<<tilesPointsClass;
     outPointsClass<<tilesPointsClassNewByPos;
+    outPointsClass<<tilesStatistics;
     pointsClassFile.close();
+    if(!writeOriginalIndexFile(originalIndexFileName,
+                               tilesOriginalIndexRanges,
+                               strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::mpAddPointCloudFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        mPtrMpProgress->setError(strError);
+        return;
+    }
     mMutex.lock();
     QMap<int,QMap<int,int> >::const_iterator iterTileX=tilesNumberOfPoints.begin();
     while(iterTileX!=tilesNumberOfPoints.end())
@@ -6500,15 +9193,17 @@ void PointCloudFile::mpAddPointCloudFile(QString inputFileName)
     mZipFilePathPointsByIndex[fileIndex]=tilesPointsFileZipFilePath;
     mZipFilePointsByIndex[fileIndex]=tilesPointsFileZipFileName;
     mClassesFileByIndex[fileIndex]=pointsClassFileName;
+    mPointsIndexFileByIndex[fileIndex]=pointsIndexFileName;
+    mLevelsOfDetailFileByIndex[fileIndex]=levelsOfDetailFileName;
+    mOriginalIndexFileByIndex[fileIndex]=originalIndexFileName;
     if(mUpdateHeader)
     {
         if(!writeHeader(strAuxError))
         {
             strError=QObject::tr("\PointCloudFile::mpAddPointCloudFile");
             strError+=QObject::tr("\nError writing header after add file:\n%1").arg(inputFileName);
-            mStrErrorMpProgressDialog=strError;
             mMutex.unlock();
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
     }
@@ -6552,8 +9247,7 @@ void PointCloudFile::mpAddTilesGeometry(int tilePos)
     {
         strError=QObject::tr("PointCloudFile::mpAddTilesGeometry");
         strError+=QObject::tr("\nError making geometry from WKT: %1").arg(wktGeometry);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
     mMutex.lock();
@@ -6577,8 +9271,7 @@ void PointCloudFile::mpGetTilesWktGeometry(int tilePos)
             strError=QObject::tr("PointCloudFile::mpGetTilesXWktGeometry");
             strError+=QObject::tr("\nNot exists geometry for tile:(%1,%2)")
                     .arg(QString::number(tileX)).arg(QString::number(tileY));
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
         if(!mTilesGeometry[tileX].contains(tileY))
@@ -6586,8 +9279,7 @@ void PointCloudFile::mpGetTilesWktGeometry(int tilePos)
             strError=QObject::tr("PointCloudFile::mpGetTilesXWktGeometry");
             strError+=QObject::tr("\nNot exists geometry for tile:(%1,%2)")
                     .arg(QString::number(tileX)).arg(QString::number(tileY));
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
         mMutex.lock();
@@ -6598,9 +9290,8 @@ void PointCloudFile::mpGetTilesWktGeometry(int tilePos)
             strError=QObject::tr("PointCloudFile::mpGetTilesXWktGeometry");
             strError+=QObject::tr("\nError exporting to WKT geometry for tile:(%1,%2)")
                     .arg(QString::number(tileX)).arg(QString::number(tileY));
-            mStrErrorMpProgressDialog=strError;
             mMutex.unlock();
-            emit(mPtrMpProgressDialog->canceled());
+            mPtrMpProgress->setError(strError);
             return;
         }
         QString tileWkt=QString::fromLatin1(ptrWKT);
@@ -6610,303 +9301,264 @@ void PointCloudFile::mpGetTilesWktGeometry(int tilePos)
     return;
 }
 
-void PointCloudFile::mpGetTilesFromWktGeometry(int tilePos)
+bool PointCloudFile::setOutputPath(QString value,
+                                   QString &strError)
 {
-    QString strError;
-    int tileX=mTilesXToProcess[tilePos];
-    int tileY=mTilesYToProcess[tilePos];
-    if(!mTilesGeometry.contains(tileX)) return;
-    if(!mTilesGeometry[tileX].contains(tileY)) return;
-    OGRwkbGeometryType geometryType=mMpPtrGeometry->getGeometryType();
-    if(geometryType==wkbPolygon
-            ||geometryType==wkbMultiPolygon
-            ||geometryType==wkbPolygon25D
-            ||geometryType==wkbMultiPolygon25D
-            ||geometryType==wkbPolygonM
-            ||geometryType==wkbMultiPolygonM
-            ||geometryType==wkbPolygonZM
-            ||geometryType==wkbMultiPolygonZM)
-    {
-        QString tileTableName=mTilesName[tileX][tileY];
-        OGRGeometry* ptrTileGeometry=mTilesGeometry[tileX][tileY];
-        mMutex.lock();
-        if(mMpPtrGeometry->Overlaps(ptrTileGeometry))
-        {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
-        }
-        else if(mMpPtrGeometry->Contains(ptrTileGeometry))
-        {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
-        }
-        else if(mMpPtrGeometry->Within(ptrTileGeometry))
+    QDir currentDir=QDir::currentPath();
+    if(!currentDir.exists(value))
+    {
+        if(!currentDir.mkpath(value))
         {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
+            strError=QObject::tr("PointCloudFile::setOutputPath");
+            strError+=QObject::tr("\nError making path:\n%1").arg(value);
+            return(false);
         }
-        mMutex.unlock();
     }
-    return;
+    mOutputPath=value;
+    return(true);
 }
 
-void PointCloudFile::mpGetTilesNamesFromWktGeometry(int tilePos)
+bool PointCloudFile::setTempPath(QString value,
+                                 QString &strError)
 {
-    QString strError;
-    int tileX=mTilesXToProcess[tilePos];
-    int tileY=mTilesYToProcess[tilePos];
-    if(!mTilesGeometry.contains(tileX)) return;
-    if(!mTilesGeometry[tileX].contains(tileY)) return;
-    OGRwkbGeometryType geometryType=mMpPtrGeometry->getGeometryType();
-    if(geometryType==wkbPolygon
-            ||geometryType==wkbMultiPolygon
-            ||geometryType==wkbPolygon25D
-            ||geometryType==wkbMultiPolygon25D
-            ||geometryType==wkbPolygonM
-            ||geometryType==wkbMultiPolygonM
-            ||geometryType==wkbPolygonZM
-            ||geometryType==wkbMultiPolygonZM)
-    {
-        QString tileTableName=mTilesName[tileX][tileY];
-        OGRGeometry* ptrTileGeometry=mTilesGeometry[tileX][tileY];
-        mMutex.lock();
-        if(mMpPtrGeometry->Overlaps(ptrTileGeometry))
-        {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
-            mTilesOverlaps[tileX][tileY]=true;
-        }
-        else if(mMpPtrGeometry->Contains(ptrTileGeometry))
-        {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
-            mTilesOverlaps[tileX][tileY]=false;
-        }
-        else if(mMpPtrGeometry->Within(ptrTileGeometry))
+    QDir currentDir=QDir::currentPath();
+    if(!currentDir.exists(value))
+    {
+        if(!currentDir.mkpath(value))
         {
-            mMpTilesTableName[tileX][tileY]=tileTableName;
-            mTilesOverlaps[tileX][tileY]=false;
+            strError=QObject::tr("PointCloudFile::setTempPath");
+            strError+=QObject::tr("\nError making path:\n%1").arg(value);
+            return(false);
         }
-        mMutex.unlock();
     }
-    return;
+    mTempPath=value;
+    return(true);
 }
 
-void PointCloudFile::mpGetPointsFromWktGeometryByTilePosition(int tilePos)
+bool PointCloudFile::updateClassesFiles(QString title,
+                                        const QVector<int> &filesIndex,
+                                        std::function<bool (int, PointsClassesFile &, PointsEditOperation &, bool &, QString &)> updateFile,
+                                        PointsEditOperation &editOperation,
+                                        QString &strError)
 {
-    QString strError;
-    int tileX=mTilesXToProcess[tilePos];
-    int tileY=mTilesYToProcess[tilePos];
-    int numberOfPoints=mTilesNop[tileX][tileY];
-    QString tileTableName=mTilesName[tileX][tileY];
-    QuaZip zipFilePointsTile;
-    zipFilePointsTile.setZipName(mZipFileNamePoints);
-//        QuaZip mZipFilePoints(zipFileNamePoints);
-    if(!zipFilePointsTile.open(QuaZip::mdUnzip))
-    {
-        strError=QObject::tr("PointCloudFile::mpGetPointsFromWktGeometryByTilePosition");
-        strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
-                .arg(mZipFileNamePoints).arg(QString::number(zipFilePointsTile.getZipError()));
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
-        return;
+    // Un fichero de clases por tarea, con un numero de hilos limitado porque cada tarea lee
+    // y escribe un .pcs completo. Sin sesion de edicion los modificados se escriben a temporales
+    // que sustituyen a los originales solo si todas las tareas terminan bien, guardando los
+    // originales como copia hasta que se han sustituido todos; si falla una sustitucion se
+    // restauran las copias. Con sesion se modifican copias de los residentes que los reemplazan
+    // al final. Un error o la cancelacion no modifican ningun fichero. Las consultas siguen con
+    // la version anterior hasta la publicacion, que se hace con mDataLock en escritura
+    editOperation.clear();
+    QMutexLocker writeLocker(&mWriteMutex);
+    int numberOfFiles=filesIndex.size();
+    for(int nf=0;nf<numberOfFiles;nf++)
+    {
+        if(!mClassesFileByIndex.contains(filesIndex[nf]))
+        {
+            strError=QObject::tr("PointCloudFile::updateClassesFiles");
+            strError+=QObject::tr("\nThere is no classes file for index: %1")
+                    .arg(QString::number(filesIndex[nf]));
+            return(false);
+        }
     }
-    if(!zipFilePointsTile.setCurrentFile(tileTableName))
-    {
-        strError=QObject::tr("PointCloudFile::mpGetPointsFromWktGeometryByTilePosition");
-        strError+=QObject::tr("\nNot exists: %1 in file:\n%2\nError:\n%3")
-                .arg(tileTableName).arg(mZipFileNamePoints)
-                .arg(QString::number(zipFilePointsTile.getZipError()));
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
-        return;
+    QString strAuxError;
+    QVector<PointsClassesFile> filesClassesFile(numberOfFiles);
+    QVector<bool> filesTemporaryWritten(numberOfFiles,false);
+    QVector<PointsEditOperation> filesEditOperation(numberOfFiles);
+    QVector<bool> filesExistsChanges(numberOfFiles,false);
+    QVector<QString> filesError(numberOfFiles);
+    QMutexLocker editSessionLocker(&mEditSessionMutex);
+    bool editSession=mEditSession;
+    if(editSession)
+    {
+        for(int nf=0;nf<numberOfFiles;nf++)
+        {
+            PointsClassesFile* ptrClassesFile=NULL;
+            if(!getEditSessionClassesFile(filesIndex[nf],&ptrClassesFile,strAuxError))
+            {
+                strError=QObject::tr("PointCloudFile::updateClassesFiles");
+                strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+                return(false);
+            }
+            filesClassesFile[nf]=*ptrClassesFile; // comparte los datos hasta que se modifican
+        }
     }
-    QuaZipFile inPointsFile(&zipFilePointsTile);
-    if (!inPointsFile.open(QIODevice::ReadOnly))
+    editSessionLocker.unlock();
+    QAtomicInt nextTask(0);
+    QAtomicInt numberOfProcessedTasks(0);
+    QAtomicInt canceled(0);
+    Progress* ptrProgress=NULL;
+    if(numberOfFiles>0)
     {
-        strError=QObject::tr("PointCloudFile::mpGetPointsFromWktGeometryByTilePosition");
-        strError+=QObject::tr("\nError opening: %1 in file:\n%2\nError:\n%3")
-                .arg(tileTableName).arg(mZipFileNamePoints)
-                .arg(QString::number(mZipFilePoints.getZipError()));
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
-        return;
+        QString msgGlobal=QObject::tr("Updating points from %1 files and tiles")
+                .arg(QString::number(numberOfFiles));
+        ptrProgress=mPtrPCFManager->getProgressCallback()->createProgress(title,msgGlobal,numberOfFiles);
     }
-    QDataStream inPoints(&inPointsFile);
-    int pos=0;
-    QVector<PCFile::Point> pointsInTile(numberOfPoints);
-    int numberOfRealPoints=0; // porque puede haber puntos fuera del wkt
-    while(!inPoints.atEnd())
-    {
-        quint16 ix,iy;
-        quint8 z_pc,z_pa,z_pb;
-        inPoints>>ix>>iy>>z_pa>>z_pb>>z_pc;
-        PCFile::Point pto;
-        pto.setPositionInTile(pos);
-        if(pos>mTilesPointsClass[tileX][tileY].size())
-        {
-            strError=QObject::tr("PointCloudFile::mpGetPointsFromWktGeometryByTilePosition");
-            strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes file:\n%4")
-                    .arg(QString::number(pos)).arg(QString::number(tileX))
-                    .arg(QString::number(tileY)).arg(mClassesFileName);
-            mStrErrorMpProgressDialog=strError;
-            emit(mPtrMpProgressDialog->canceled());
-            return;
-        }
-        quint8 ptoClass=mTilesPointsClass[tileX][tileY][pos];
-        pto.setClass(ptoClass);
-        quint8 ptoClassNew=ptoClass;
-        if(mTilesPointsClassNewByPos.contains(tileX))
+    auto processTasks=[&](bool isCallerThread)
+    {
+        while(canceled.loadAcquire()==0)
         {
-            if(mTilesPointsClassNewByPos[tileX].contains(tileY))
+            int nf=nextTask.fetchAndAddOrdered(1);
+            if(nf>=numberOfFiles) break;
+            int fileIndex=filesIndex[nf];
+            QString classesFileName=mClassesFileByIndex.value(fileIndex);
+            QString strTaskError;
+            if(!editSession)
             {
-                if(mTilesPointsClassNewByPos[tileX][tileY].contains(pos))
+                if(!filesClassesFile[nf].read(classesFileName,strTaskError))
                 {
-                    ptoClassNew=mTilesPointsClassNewByPos[tileX][tileY][pos];
+                    filesError[nf]=strTaskError;
+                    canceled.storeRelease(1);
+                    break;
                 }
-            }
-        }
-        pto.setClassNew(ptoClassNew);
-        pto.setCoordinates(ix,iy,z_pa,z_pb,z_pc);
-        if(mExistsColor)
-        {
-            if(mNumberOfColorBytes==1)
-            {
-                quint8 color_r,color_g,color_b;
-                inPoints>>color_r>>color_g>>color_b;
-                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,color_r);
-                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,color_g);
-                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,color_b);
-            }
-            else
-            {
-                quint16 color_r,color_g,color_b;
-                inPoints>>color_r>>color_g>>color_b;
-                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,color_r);
-                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,color_g);
-                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,color_b);
-            }
-        }
-        if(mExistsGpsTime)
-        {
-            quint8 gpsDowHourPackit;
-            quint8 msb1,msb2,msb3;
-            inPoints>>gpsDowHourPackit>>msb1>>msb2>>msb3;
-            pto.setGpsTime(gpsDowHourPackit,msb1,msb2,msb3);
-        }
-        if(mExistsUserData)
-        {
-            quint8 userData;
-            inPoints>>userData;
-            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_USER_DATA,userData);
-        }
-        if(mExistsIntensity)
-        {
-            quint16 intensity;
-            inPoints>>intensity;
-            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_INTENSITY,intensity);
-        }
-        if(mExistsSourceId)
-        {
-            quint16 sourceId;
-            inPoints>>sourceId;
-            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_SOURCE_ID,sourceId);
-        }
-        if(mExistsNir)
-        {
-            if(mNumberOfColorBytes==1)
+            }
+            bool existsChanges=false;
+            if(!updateFile(fileIndex,
+                           filesClassesFile[nf],
+                           filesEditOperation[nf],
+                           existsChanges,
+                           strTaskError))
             {
-                quint8 nir;
-                inPoints>>nir;
-                pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_NIR,nir);
+                filesError[nf]=strTaskError;
+                canceled.storeRelease(1);
+                break;
             }
-            else
+            filesExistsChanges[nf]=existsChanges;
+            if(!editSession)
             {
-                quint16 nir;
-                inPoints>>nir;
-                pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_NIR,nir);
+                if(existsChanges)
+                {
+                    if(!filesClassesFile[nf].write(classesFileName+POINTCLOUDFILE_PCS_TEMPORARY_SUFFIX,strTaskError))
+                    {
+                        filesError[nf]=strTaskError;
+                        canceled.storeRelease(1);
+                        break;
+                    }
+                    filesTemporaryWritten[nf]=true;
+                }
+                filesClassesFile[nf].clear();
             }
-        }
-        if(mExistsReturn)
-        {
-            quint8 returnNumber;
-            inPoints>>returnNumber;
-            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURN,returnNumber);
-        }
-        if(mExistsReturns)
-        {
-            quint8 numberOfReturns;
-            inPoints>>numberOfReturns;
-            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURNS,numberOfReturns);
-        }
-        pos++;
-        if(!mTilesFullGeometry)
-        {
-            if(mTilesOverlaps[tileX][tileY])
+            int numberOfProcessed=numberOfProcessedTasks.fetchAndAddOrdered(1)+1;
+            if(ptrProgress!=NULL)
             {
-                OGRGeometry* ptrPoint=NULL;
-                ptrPoint=OGRGeometryFactory::createGeometry(wkbPoint);
-                double x=tileX+ix/1000.;
-                double y=tileY+iy/1000.;
-                ((OGRPoint*)ptrPoint)->setX(x);
-                ((OGRPoint*)ptrPoint)->setY(y);
-                if(!mMpPtrGeometry->Contains(ptrPoint))
+                if(isCallerThread)
                 {
-                    OGRGeometryFactory::destroyGeometry(ptrPoint);
-                    continue;
+                    ptrProgress->setValue(numberOfProcessed);
+                }
+                if(ptrProgress->wasCanceled())
+                {
+                    filesError[nf]=QObject::tr("Process canceled by user");
+                    canceled.storeRelease(1);
                 }
-                OGRGeometryFactory::destroyGeometry(ptrPoint);
             }
         }
-        pointsInTile[numberOfRealPoints]=pto;
-        numberOfRealPoints++;
+    };
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMin(QThread::idealThreadCount(),numberOfFiles);
+        numberOfThreads=qMin(numberOfThreads,POINTCLOUDFILE_CLASSES_FILES_MAXIMUM_NUMBER_OF_THREADS);
     }
-    inPointsFile.close();
-    if(numberOfRealPoints<numberOfPoints)
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
     {
-        pointsInTile.resize(numberOfRealPoints);
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks(false);}));
     }
-    zipFilePointsTile.close();
-    mMutex.lock();
-    if(pointsInTile.size()>0)
+    processTasks(true);
+    for(int nt=0;nt<futures.size();nt++)
     {
-        mPointsByTile[tileX][tileY]=pointsInTile;
+        futures[nt].waitForFinished();
     }
-    if(numberOfRealPoints>0)
+    if(ptrProgress!=NULL)
     {
-        mMpTilesNumberOfPointsInFile[tileX][tileY]=mMpTilesNumberOfPointsInFile[tileX][tileY]+numberOfRealPoints;
+        delete(ptrProgress);
     }
-    mMutex.unlock();
-    return;
-}
-
-bool PointCloudFile::setOutputPath(QString value,
-                                   QString &strError)
-{
-    QDir currentDir=QDir::currentPath();
-    if(!currentDir.exists(value))
+    for(int nf=0;nf<numberOfFiles;nf++)
     {
-        if(!currentDir.mkpath(value))
+        if(!filesError[nf].isEmpty())
         {
-            strError=QObject::tr("PointCloudFile::setOutputPath");
-            strError+=QObject::tr("\nError making path:\n%1").arg(value);
+            strError=QObject::tr("PointCloudFile::updateClassesFiles");
+            strError+=QObject::tr("\nError updating classes file:\n%1\nError:\n%2")
+                    .arg(mClassesFileByIndex.value(filesIndex[nf]))
+                    .arg(filesError[nf]);
+            for(int i=0;i<numberOfFiles;i++)
+            {
+                if(filesTemporaryWritten[i])
+                {
+                    QFile::remove(mClassesFileByIndex.value(filesIndex[i])+POINTCLOUDFILE_PCS_TEMPORARY_SUFFIX);
+                }
+            }
             return(false);
         }
     }
-    mOutputPath=value;
-    return(true);
-}
-
-bool PointCloudFile::setTempPath(QString value,
-                                 QString &strError)
-{
-    QDir currentDir=QDir::currentPath();
-    if(!currentDir.exists(value))
+    QWriteLocker dataLocker(&mDataLock);
+    if(editSession)
     {
-        if(!currentDir.mkpath(value))
+        editSessionLocker.relock();
+        for(int nf=0;nf<numberOfFiles;nf++)
         {
-            strError=QObject::tr("PointCloudFile::setTempPath");
-            strError+=QObject::tr("\nError making path:\n%1").arg(value);
-            return(false);
+            if(!filesExistsChanges[nf]) continue;
+            int fileIndex=filesIndex[nf];
+            mEditSessionClassesFileByIndex[fileIndex]=filesClassesFile[nf];
+            mEditSessionModifiedFileByIndex[fileIndex]=true;
+            editOperation.append(filesEditOperation[nf]);
         }
+        return(true);
     }
-    mTempPath=value;
-    return(true);
+    // el original pasa a copia y el temporal ocupa su lugar; con un fallo se deshace
+    // lo hecho en todos los ficheros y el historial no recibe la operacion
+    QVector<bool> filesBackedUp(numberOfFiles,false);
+    QVector<bool> filesReplaced(numberOfFiles,false);
+    bool success=true;
+    for(int nf=0;nf<numberOfFiles&&success;nf++)
+    {
+        if(!filesExistsChanges[nf]) continue;
+        QString classesFileName=mClassesFileByIndex.value(filesIndex[nf]);
+        QString backupFileName=classesFileName+POINTCLOUDFILE_PCS_BACKUP_SUFFIX;
+        if(QFile::exists(backupFileName)) QFile::remove(backupFileName);
+        if(!QFile::rename(classesFileName,backupFileName))
+        {
+            strError=QObject::tr("PointCloudFile::updateClassesFiles");
+            strError+=QObject::tr("\nError renaming classes file:\n%1\nto file:\n%2")
+                    .arg(classesFileName).arg(backupFileName);
+            success=false;
+            break;
+        }
+        filesBackedUp[nf]=true;
+        if(!QFile::rename(classesFileName+POINTCLOUDFILE_PCS_TEMPORARY_SUFFIX,classesFileName))
+        {
+            strError=QObject::tr("PointCloudFile::updateClassesFiles");
+            strError+=QObject::tr("\nError writing classes file:\n%1")
+                    .arg(classesFileName);
+            success=false;
+            break;
+        }
+        filesReplaced[nf]=true;
+    }
+    for(int nf=0;nf<numberOfFiles;nf++)
+    {
+        if(!filesExistsChanges[nf]) continue;
+        QString classesFileName=mClassesFileByIndex.value(filesIndex[nf]);
+        QString backupFileName=classesFileName+POINTCLOUDFILE_PCS_BACKUP_SUFFIX;
+        if(success)
+        {
+            QFile::remove(backupFileName);
+            editOperation.append(filesEditOperation[nf]);
+            continue;
+        }
+        if(filesReplaced[nf])
+        {
+            QFile::remove(classesFileName);
+        }
+        if(filesBackedUp[nf]
+                &&!QFile::rename(backupFileName,classesFileName))
+        {
+            strError+=QObject::tr("\nError restoring classes file:\n%1\nfrom file:\n%2")
+                    .arg(classesFileName).arg(backupFileName);
+        }
+        QFile::remove(classesFileName+POINTCLOUDFILE_PCS_TEMPORARY_SUFFIX);
+    }
+    return(success);
 }
 
 bool PointCloudFile::updateNotEdited2dToolsPoints(QString pcfPath,
@@ -6916,8 +9568,6 @@ bool PointCloudFile::updateNotEdited2dToolsPoints(QString pcfPath,
                                                   QMap<int, QMap<int, QVector<quint8> > > &pointClassByTile,
                                                   QString &strError)
 {
-    QWidget* ptrWidget=new QWidget();
-    QProgressDialog* ptrProgress=NULL;
     QMap<int,QMap<int,QMap<int,QVector<int> > > > pointsIndexByTilesByFileIndex;
     QMap<int, QMap<int, QVector<int> > >::const_iterator iterTileX=pointFileIdByTile.begin();
     while(iterTileX!=pointFileIdByTile.end())
@@ -6947,68 +9597,22 @@ bool PointCloudFile::updateNotEdited2dToolsPoints(QString pcfPath,
         }
         iterTileX++;
     }
-    int numberOfSteps=pointsIndexByTilesByFileIndex.size();
-    QDir auxDir=QDir::currentPath();
-    if(ptrWidget!=NULL)
-    {
-        QString title=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
-        QString msgGlobal=QObject::tr("Updating points from %1 files and tiles")
-                .arg(QString::number(numberOfSteps));
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
-    }
-    int step=0;
-    QMap<int,QMap<int,QMap<int,QVector<int> > > >::const_iterator iterFiles=pointsIndexByTilesByFileIndex.begin();
-    while(iterFiles!=pointsIndexByTilesByFileIndex.end())
-    {
-        step++;
-        if(ptrWidget!=NULL)
-        {
-            ptrProgress->setValue(step);
-            qApp->processEvents();
-        }
-        int fileIndex=iterFiles.key();
-        if(!mClassesFileByIndex.contains(fileIndex))
-        {
-            strError=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
-            strError+=QObject::tr("\nThere is no classes file for index: %1")
-                    .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(step);
-                qApp->processEvents();
-            }
-            return(false);
-        }
-        QString pointsClassFileName=mClassesFileByIndex[fileIndex];
-        QFile pointsClassFile(pointsClassFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
-        {
-            strError=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(pointsClassFileName);
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(step);
-                qApp->processEvents();
-            }
-            return(false);
-        }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        QMap<int,QMap<int,QVector<quint8> > > tilesPointsClass;
-        QMap<int,QMap<int,QMap<int,quint8> > > tilesPointsClassNewByPos; // se guarda vacío
-        QMap<int,QMap<int,int> > tilesNop;
-        inPointsClass>>tilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>tilesPointsClass;
-        inPointsClass>>tilesPointsClassNewByPos;
-        pointsClassFile.close();
-        QMap<int,QMap<int,QVector<int> > > pointsIndexByTiles=iterFiles.value();
+    // cada fichero en una tarea de updateClassesFiles, los datos de entrada solo se leen
+    QVector<int> filesIndex=pointsIndexByTilesByFileIndex.keys().toVector();
+    const QMap<int, QMap<int, QVector<int> > >& constPointPositionByTile=pointPositionByTile;
+    const QMap<int, QMap<int, QVector<quint8> > >& constPointClassNewByTile=pointClassNewByTile;
+    const QMap<int, QMap<int, QVector<quint8> > >& constPointClassByTile=pointClassByTile;
+    auto updateFile=[&](int fileIndex,
+                        PointsClassesFile& classesFile,
+                        PointsEditOperation& editOperation,
+                        bool& existsChanges,
+                        QString& strFileError)->bool
+    {
+        QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+        const QMap<int,QMap<int,QVector<int> > > pointsIndexByTiles=pointsIndexByTilesByFileIndex.value(fileIndex);
         QMap<int,QMap<int,QVector<int> > >::const_iterator iterTileX=pointsIndexByTiles.begin();
-        bool existsChanges=false;
+        existsChanges=false;
         while(iterTileX!=pointsIndexByTiles.end())
         {
             int tileX=iterTileX.key();
@@ -7023,147 +9627,98 @@ bool PointCloudFile::updateNotEdited2dToolsPoints(QString pcfPath,
 //                    if(!pointClassByTile.contains(tileX)
 //                            ||!pointPositionByTile.contains(tileX)
 //                            ||!pointClassNewByTile.contains(tileX))
-                    if(!pointPositionByTile.contains(tileX)
+                    if(!constPointPositionByTile.contains(tileX)
                             ||!tilesPointsClass.contains(tileX))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(!pointClassNewByTile.contains(tileX)
-                            ||!pointClassNewByTile.contains(tileX))
+                    if(!constPointClassNewByTile.contains(tileX)
+                            ||!constPointClassNewByTile.contains(tileX))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(!pointClassByTile.contains(tileX)
-                            ||!pointClassByTile.contains(tileX))
+                    if(!constPointClassByTile.contains(tileX)
+                            ||!constPointClassByTile.contains(tileX))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(!pointPositionByTile[tileX].contains(tileY)
+                    if(!constPointPositionByTile[tileX].contains(tileY)
                             ||!tilesPointsClass[tileX].contains(tileY))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(!pointClassNewByTile[tileX].contains(tileY)
-                            ||!pointClassNewByTile[tileX].contains(tileY))
+                    if(!constPointClassNewByTile[tileX].contains(tileY)
+                            ||!constPointClassNewByTile[tileX].contains(tileY))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(!pointClassByTile[tileX].contains(tileY)
-                            ||!pointClassByTile[tileX].contains(tileY))
+                    if(!constPointClassByTile[tileX].contains(tileY)
+                            ||!constPointClassByTile[tileX].contains(tileY))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(pointIndex>(pointPositionByTile[tileX][tileY].size()-1))
+                    if(pointIndex>(constPointPositionByTile[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(pointIndex>(pointClassNewByTile[tileX][tileY].size()-1))
+                    if(pointIndex>(constPointClassNewByTile[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class new: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    if(pointIndex>(pointClassByTile[tileX][tileY].size()-1))
+                    if(pointIndex>(constPointClassByTile[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point class: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    int pointPositionInTile=pointPositionByTile[tileX][tileY][pointIndex];
+                    int pointPositionInTile=constPointPositionByTile[tileX][tileY][pointIndex];
                     if(pointPositionInTile>(tilesPointsClass[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    quint8 pointClassNewChanged=pointClassNewByTile[tileX][tileY][pointIndex];
-                    quint8 pointClassChanged=pointClassByTile[tileX][tileY][pointIndex];
+                    quint8 pointClassNewChanged=constPointClassNewByTile[tileX][tileY][pointIndex];
+                    quint8 pointClassChanged=constPointClassByTile[tileX][tileY][pointIndex];
                     quint8 pointClass=tilesPointsClass[tileX][tileY][pointPositionInTile];
                     quint8 pointClassNew=pointClass;
+                    bool existsPointClassNew=false;
                     if(tilesPointsClassNewByPos.contains(tileX))
                     {
                         if(tilesPointsClassNewByPos[tileX].contains(tileY))
@@ -7171,35 +9726,490 @@ bool PointCloudFile::updateNotEdited2dToolsPoints(QString pcfPath,
                             if(tilesPointsClassNewByPos[tileX][tileY].contains(pointPositionInTile))
                             {
                                 pointClassNew=tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile];
+                                existsPointClassNew=true;
                             }
                         }
                     }
                     if(pointClassNewChanged!=pointClassNew)
                     {
                         tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile]=pointClassNewChanged;
+                        editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,pointClassNewChanged,existsPointClassNew);
                         if(!existsChanges) existsChanges=true;
                     }
                 }
-                iterTileY++;
+                iterTileY++;
+            }
+            iterTileX++;
+        }
+        return(true);
+    };
+    QString strAuxError;
+    PointsEditOperation editOperation;
+    QMutexLocker writeLocker(&mWriteMutex);
+    if(!updateClassesFiles(QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints"),
+                           filesIndex,
+                           updateFile,
+                           editOperation,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updateNotEdited2dToolsPoints");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    addEditOperation(editOperation);
+    return(true);
+}
+
+bool PointCloudFile::updatePointsByPredicate(QString strAction,
+                                             quint8 classValue,
+                                             PointsFilter &pointsFilter,
+                                             QMap<quint8, bool> &lockedClasses,
+                                             qint64 &numberOfUpdatedPoints,
+                                             QString &strError)
+{
+    numberOfUpdatedPoints=0;
+    QString strAuxError;
+    QMap<int,QMap<int,QString> > tilesTableName=mTilesName;
+    PointsQuery pointsQuery;
+    pointsQuery.setPointsFilter(pointsFilter);
+    if(!updatePointsFromTiles(strAction,
+                              classValue,
+                              tilesTableName,
+                              pointsQuery,
+                              lockedClasses,
+                              numberOfUpdatedPoints,
+                              strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsByPredicate");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::updatePointsFromTiles(QString strAction,
+                                           quint8 classValue,
+                                           QMap<int, QMap<int, QString> > &tilesTableName,
+                                           PointsQuery &pointsQuery,
+                                           QMap<quint8, bool> &lockedClasses,
+                                           qint64 &numberOfUpdatedPoints,
+                                           QString &strError)
+{
+    // Se decodifican en paralelo solo las posiciones de los puntos que cumplen la consulta,
+    // como en getPointsFromTiles pero sin construir Point. Los cambios se aplican despues
+    // con updateClassesFiles, sobre los ficheros de clases o las copias de la sesion de edicion
+    numberOfUpdatedPoints=0;
+    if(strAction.compare(POINTCLOUDFILE_ACTION_CHANGE_CLASS,Qt::CaseInsensitive)!=0
+            &&strAction.compare(POINTCLOUDFILE_ACTION_RECOVER_ORIGINAL_CLASS,Qt::CaseInsensitive)!=0
+            &&strAction.compare(POINTCLOUDFILE_ACTION_DELETE,Qt::CaseInsensitive)!=0
+            &&strAction.compare(POINTCLOUDFILE_ACTION_RECOVER_DELETED,Qt::CaseInsensitive)!=0)
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+        strError+=QObject::tr("\nInvalid action: %1").arg(strAction);
+        return(false);
+    }
+    bool changeClass=(strAction.compare(POINTCLOUDFILE_ACTION_CHANGE_CLASS,Qt::CaseInsensitive)==0);
+    bool recoverOriginalClass=(strAction.compare(POINTCLOUDFILE_ACTION_RECOVER_ORIGINAL_CLASS,Qt::CaseInsensitive)==0);
+    bool deletePoints=(strAction.compare(POINTCLOUDFILE_ACTION_DELETE,Qt::CaseInsensitive)==0);
+    if(changeClass
+        &&classValue==POINTCLOUDFILE_ACTION_ALL_CLASSES_VALUE)
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+        strError+=QObject::tr("\nInvalid action: %1 for All Classes").arg(strAction);
+        return(false);
+    }
+    // la seleccion y la aplicacion ven la misma version de las clases
+    QMutexLocker writeLocker(&mWriteMutex);
+    QString strAuxError;
+    QMap<int,QMap<int,QVector<int> > > tilesByFileIndex;
+    QMap<int,QMap<int,QString> >::const_iterator iterX=tilesTableName.begin();
+    while(iterX!=tilesTableName.end())
+    {
+        int tileX=iterX.key();
+        QMap<int,QString>::const_iterator iterY=iterX.value().begin();
+        while(iterY!=iterX.value().end())
+        {
+            int tileY=iterY.key();
+            QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=mTilesByFileIndex.begin();
+            while(iterFiles!=mTilesByFileIndex.end())
+            {
+                int fileIndex=iterFiles.key();
+                const QMap<int,QVector<int> >& tilesInFile=iterFiles.value();
+                if(tilesInFile.contains(tileX))
+                {
+                    if(tilesInFile[tileX].indexOf(tileY)!=-1)
+                    {
+                        tilesByFileIndex[fileIndex][tileX].push_back(tileY);
+                    }
+                }
+                iterFiles++;
+            }
+            iterY++;
+        }
+        iterX++;
+    }
+    pointsQuery.setNumberOfColorBytes(mNumberOfColorBytes);
+    QVector<int> tasksFileIndex;
+    QVector<int> tasksTileX;
+    QVector<int> tasksTileY;
+    QVector<int> tasksNumberOfPoints;
+    QMap<int,QVector<int> > tasksByFileIndex;
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterFiles=tilesByFileIndex.begin();
+    while(iterFiles!=tilesByFileIndex.end())
+    {
+        int fileIndex=iterFiles.key();
+        if(!mClassesFileByIndex.contains(fileIndex))
+        {
+            strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+            strError+=QObject::tr("\nThere is no classes file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        if(!mZipFilePointsByIndex.contains(fileIndex))
+        {
+            strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+            strError+=QObject::tr("\nThere is no points file for index: %1")
+                    .arg(QString::number(fileIndex));
+            return(false);
+        }
+        QMap<QString,bool> existsFields;
+        if(!readQueryClassesFile(pointsQuery,
+                                 fileIndex,
+                                 iterFiles.value(),
+                                 existsFields,
+                                 strAuxError))
+        {
+            strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+            strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+            return(false);
+        }
+        QMap<int,QVector<int> >::const_iterator iterTileX=iterFiles.value().begin();
+        while(iterTileX!=iterFiles.value().end())
+        {
+            int tileX=iterTileX.key();
+            for(int i=0;i<iterTileX.value().size();i++)
+            {
+                int tileY=iterTileX.value()[i];
+                tasksByFileIndex[fileIndex].push_back(tasksFileIndex.size());
+                tasksFileIndex.push_back(fileIndex);
+                tasksTileX.push_back(tileX);
+                tasksTileY.push_back(tileY);
+                tasksNumberOfPoints.push_back(pointsQuery.getTileNumberOfPoints(fileIndex,tileX,tileY));
+            }
+            iterTileX++;
+        }
+        iterFiles++;
+    }
+    if(!prepareQueryThinning(pointsQuery,tilesByFileIndex,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    int numberOfTasks=tasksFileIndex.size();
+    QVector<int> tasksOrder(numberOfTasks);
+    for(int i=0;i<numberOfTasks;i++) tasksOrder[i]=i;
+    std::stable_sort(tasksOrder.begin(),tasksOrder.end(),
+                     [&tasksNumberOfPoints](int a,int b)
+    {return(tasksNumberOfPoints[a]>tasksNumberOfPoints[b]);});
+    QVector<QVector<int> > tasksPositions(numberOfTasks);
+    QVector<QString> tasksError(numberOfTasks);
+    QAtomicInt nextTask(0);
+    QAtomicInt numberOfProcessedTasks(0);
+    QAtomicInt canceled(0);
+    Progress* ptrProgress=NULL;
+    if(numberOfTasks>1)
+    {
+        QString title=QObject::tr("PointCloudFile::updatePointsFromTiles");
+        QString msgGlobal=QObject::tr("Selecting points to update from %1 files and tiles")
+                .arg(QString::number(numberOfTasks));
+        ptrProgress=mPtrPCFManager->getProgressCallback()->createProgress(title,msgGlobal,numberOfTasks);
+    }
+    auto processTasks=[&](bool isCallerThread)
+    {
+        QMap<int,QuaZip*> ptrZipFilesByFileIndex;
+        while(canceled.loadAcquire()==0)
+        {
+            int taskPos=nextTask.fetchAndAddOrdered(1);
+            if(taskPos>=numberOfTasks) break;
+            int task=tasksOrder[taskPos];
+            int fileIndex=tasksFileIndex[task];
+            if(!ptrZipFilesByFileIndex.contains(fileIndex))
+            {
+                QuaZip* ptrZipFile=new QuaZip(mZipFilePointsByIndex.value(fileIndex));
+                ptrZipFilesByFileIndex[fileIndex]=ptrZipFile;
+                if(!ptrZipFile->open(QuaZip::mdUnzip))
+                {
+                    tasksError[task]=QObject::tr("Error opening file:\n%1\nError:\n%2")
+                            .arg(mZipFilePointsByIndex.value(fileIndex))
+                            .arg(QString::number(ptrZipFile->getZipError()));
+                    canceled.storeRelease(1);
+                    break;
+                }
+            }
+            QString strTaskError;
+            if(!pointsQuery.readTilePointsPositions(*ptrZipFilesByFileIndex[fileIndex],
+                                                    fileIndex,
+                                                    tasksTileX[task],
+                                                    tasksTileY[task],
+                                                    tasksPositions[task],
+                                                    strTaskError))
+            {
+                tasksError[task]=strTaskError;
+                canceled.storeRelease(1);
+                break;
+            }
+            int numberOfProcessed=numberOfProcessedTasks.fetchAndAddOrdered(1)+1;
+            if(ptrProgress!=NULL)
+            {
+                if(isCallerThread)
+                {
+                    ptrProgress->setValue(numberOfProcessed);
+                }
+                if(ptrProgress->wasCanceled())
+                {
+                    tasksError[task]=QObject::tr("Process canceled by user");
+                    canceled.storeRelease(1);
+                }
+            }
+        }
+        QMap<int,QuaZip*>::iterator iterZipFiles=ptrZipFilesByFileIndex.begin();
+        while(iterZipFiles!=ptrZipFilesByFileIndex.end())
+        {
+            if(iterZipFiles.value()->isOpen()) iterZipFiles.value()->close();
+            delete(iterZipFiles.value());
+            iterZipFiles++;
+        }
+    };
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMin(QThread::idealThreadCount(),numberOfTasks);
+    }
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
+    {
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks(false);}));
+    }
+    processTasks(true);
+    for(int nt=0;nt<futures.size();nt++)
+    {
+        futures[nt].waitForFinished();
+    }
+    if(ptrProgress!=NULL)
+    {
+        delete(ptrProgress);
+    }
+    // si falla o se cancela la seleccion no se modifica ningun fichero
+    for(int task=0;task<numberOfTasks;task++)
+    {
+        if(!tasksError[task].isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+            strError+=QObject::tr("\nError selecting points from tile X: %1 tile Y: %2 in file:\n%3\nError:\n%4")
+                    .arg(QString::number(tasksTileX[task]))
+                    .arg(QString::number(tasksTileY[task]))
+                    .arg(mZipFilePointsByIndex.value(tasksFileIndex[task]))
+                    .arg(tasksError[task]);
+            return(false);
+        }
+    }
+    QVector<int> filesIndex;
+    QMap<int,QVector<int> >::const_iterator iterTasksFiles=tasksByFileIndex.begin();
+    while(iterTasksFiles!=tasksByFileIndex.end())
+    {
+        const QVector<int>& tasksInFile=iterTasksFiles.value();
+        for(int i=0;i<tasksInFile.size();i++)
+        {
+            if(!tasksPositions[tasksInFile[i]].isEmpty())
+            {
+                filesIndex.push_back(iterTasksFiles.key());
+                break;
+            }
+        }
+        iterTasksFiles++;
+    }
+    const QMap<int,QVector<int> >& constTasksByFileIndex=tasksByFileIndex;
+    const QMap<quint8,bool>& constLockedClasses=lockedClasses;
+    auto updateFile=[&](int fileIndex,
+                        PointsClassesFile& classesFile,
+                        PointsEditOperation& editOperation,
+                        bool& existsChanges,
+                        QString& strFileError)->bool
+    {
+        const QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+        const QVector<int> tasksInFile=constTasksByFileIndex.value(fileIndex);
+        existsChanges=false;
+        for(int i=0;i<tasksInFile.size();i++)
+        {
+            int task=tasksInFile[i];
+            const QVector<int>& positions=tasksPositions.at(task);
+            if(positions.isEmpty()) continue;
+            int tileX=tasksTileX.at(task);
+            int tileY=tasksTileY.at(task);
+            QVector<quint8> tilePointsClass=tilesPointsClass.value(tileX).value(tileY);
+            QMap<int,quint8>& tilePointsClassNewByPos=tilesPointsClassNewByPos[tileX][tileY];
+            for(int np=0;np<positions.size();np++)
+            {
+                int pointPositionInTile=positions[np];
+                if(pointPositionInTile>(tilePointsClass.size()-1))
+                {
+                    strFileError=QObject::tr("For file index: %1, not exists tile X: %2 tile Y: %3 position: %4")
+                            .arg(QString::number(fileIndex)).arg(QString::number(tileX))
+                            .arg(QString::number(tileY)).arg(QString::number(pointPositionInTile));
+                    return(false);
+                }
+                quint8 pointClass=tilePointsClass[pointPositionInTile];
+                quint8 pointClassNew=tilePointsClassNewByPos.value(pointPositionInTile,pointClass);
+                bool existsPointClassNew=tilePointsClassNewByPos.contains(pointPositionInTile);
+                if(constLockedClasses.value(pointClassNew,false)) continue;
+                quint8 updatedPointClass;
+                if(changeClass)
+                {
+                    if(pointClassNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE) continue;
+                    if(pointClassNew==classValue) continue;
+                    updatedPointClass=classValue;
+                }
+                else if(recoverOriginalClass)
+                {
+                    if(pointClassNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE) continue;
+                    if(classValue!=POINTCLOUDFILE_ACTION_ALL_CLASSES_VALUE
+                            &&classValue!=pointClassNew) continue;
+                    if(pointClassNew==pointClass) continue;
+                    updatedPointClass=pointClass;
+                }
+                else if(deletePoints)
+                {
+                    if(pointClassNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE) continue;
+                    if(classValue!=POINTCLOUDFILE_ACTION_ALL_CLASSES_VALUE
+                            &&classValue!=pointClassNew) continue;
+                    updatedPointClass=POINTCLOUDFILE_CLASS_NUMBER_REMOVE;
+                }
+                else // recuperar borrados
+                {
+                    if(pointClassNew!=POINTCLOUDFILE_CLASS_NUMBER_REMOVE) continue;
+                    if(classValue!=POINTCLOUDFILE_ACTION_ALL_CLASSES_VALUE
+                            &&classValue!=pointClass) continue;
+                    updatedPointClass=pointClass;
+                }
+                tilePointsClassNewByPos[pointPositionInTile]=updatedPointClass;
+                editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,updatedPointClass,existsPointClassNew);
+                if(!existsChanges) existsChanges=true;
             }
-            iterTileX++;
-        }
-        if(existsChanges)
-        {
-            pointsClassFile.open(QIODevice::WriteOnly);
-            QDataStream outPointsClass(&pointsClassFile);   // we will serialize the data into the file
-            outPointsClass<<tilesNop;
-            outPointsClass<<existsFields;
-            outPointsClass<<tilesPointsClass;
-            outPointsClass<<tilesPointsClassNewByPos;
-            pointsClassFile.close();
         }
-        iterFiles++;
+        return(true);
+    };
+    PointsEditOperation editOperation;
+    if(!updateClassesFiles(QObject::tr("PointCloudFile::updatePointsFromTiles"),
+                           filesIndex,
+                           updateFile,
+                           editOperation,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsFromTiles");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
-    if(ptrWidget!=NULL)
+    for(int run=0;run<editOperation.getNumberOfRuns();run++)
     {
-        ptrProgress->close();
-        delete(ptrProgress);
+        numberOfUpdatedPoints+=editOperation.getRunNumberOfPoints(run);
+    }
+    addEditOperation(editOperation);
+    return(true);
+}
+
+bool PointCloudFile::updatePointsInBox(QString strAction,
+                                       quint8 classValue,
+                                       double minX,
+                                       double minY,
+                                       double maxX,
+                                       double maxY,
+                                       double minZ,
+                                       double maxZ,
+                                       PointsFilter &pointsFilter,
+                                       QMap<quint8, bool> &lockedClasses,
+                                       qint64 &numberOfUpdatedPoints,
+                                       QString &strError)
+{
+    numberOfUpdatedPoints=0;
+    QString strAuxError;
+    QMap<int,QMap<int,QString> > tilesTableName;
+    QMap<int,QMap<int,QVector<int> > > tilesBoxBounds;
+    if(!getTilesBoxBounds(minX,
+                          minY,
+                          maxX,
+                          maxY,
+                          minZ,
+                          maxZ,
+                          tilesTableName,
+                          tilesBoxBounds,
+                          strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsInBox");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    PointsQuery pointsQuery;
+    pointsQuery.setPointsFilter(pointsFilter);
+    pointsQuery.setTilesBoxBounds(tilesBoxBounds);
+    if(!updatePointsFromTiles(strAction,
+                              classValue,
+                              tilesTableName,
+                              pointsQuery,
+                              lockedClasses,
+                              numberOfUpdatedPoints,
+                              strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsInBox");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::updatePointsInGeometry(QString strAction,
+                                            quint8 classValue,
+                                            QString wktGeometry,
+                                            int geometryCrsEpsgCode,
+                                            QString geometryCrsProj4String,
+                                            PointsFilter &pointsFilter,
+                                            QMap<quint8, bool> &lockedClasses,
+                                            qint64 &numberOfUpdatedPoints,
+                                            QString &strError)
+{
+    numberOfUpdatedPoints=0;
+    QString strAuxError;
+    QMap<int,QMap<int,QString> > tilesTableName;
+    QMap<int,QMap<int,QVector<float> > > tilesPolygonEdges;
+    QVector<QString> ignoreTilesTableName;
+    if(!getTilesPolygonEdgesFromWktGeometry(wktGeometry,
+                                            geometryCrsEpsgCode,
+                                            geometryCrsProj4String,
+                                            ignoreTilesTableName,
+                                            false,
+                                            tilesTableName,
+                                            tilesPolygonEdges,
+                                            strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsInGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    PointsQuery pointsQuery;
+    pointsQuery.setPointsFilter(pointsFilter);
+    pointsQuery.setTilesPolygonEdges(tilesPolygonEdges);
+    if(!updatePointsFromTiles(strAction,
+                              classValue,
+                              tilesTableName,
+                              pointsQuery,
+                              lockedClasses,
+                              numberOfUpdatedPoints,
+                              strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePointsInGeometry");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
     return(true);
 }
@@ -7229,8 +10239,6 @@ bool PointCloudFile::updatePoints(QString strAction,
         strError+=QObject::tr("\nInvalid action: %1 for All Classes").arg(strAction);
         return(false);
     }
-    QWidget* ptrWidget=new QWidget();
-    QProgressDialog* ptrProgress=NULL;
     QMap<int,QMap<int,QMap<int,QVector<int> > > > pointsIndexByTilesByFileIndex;
     QMap<int, QMap<int, QVector<int> > >::const_iterator iterTileX=pointFileIdByTile.begin();
     while(iterTileX!=pointFileIdByTile.end())
@@ -7260,68 +10268,21 @@ bool PointCloudFile::updatePoints(QString strAction,
         }
         iterTileX++;
     }
-    int numberOfSteps=pointsIndexByTilesByFileIndex.size();
-    QDir auxDir=QDir::currentPath();
-    if(ptrWidget!=NULL)
-    {
-        QString title=QObject::tr("PointCloudFile::updatePoints");
-        QString msgGlobal=QObject::tr("Updating points from %1 files and tiles")
-                .arg(QString::number(numberOfSteps));
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
-    }
-    int step=0;
-    QMap<int,QMap<int,QMap<int,QVector<int> > > >::const_iterator iterFiles=pointsIndexByTilesByFileIndex.begin();
-    while(iterFiles!=pointsIndexByTilesByFileIndex.end())
-    {
-        step++;
-        if(ptrWidget!=NULL)
-        {
-            ptrProgress->setValue(step);
-            qApp->processEvents();
-        }
-        int fileIndex=iterFiles.key();
-        if(!mClassesFileByIndex.contains(fileIndex))
-        {
-            strError=QObject::tr("PointCloudFile::updatePoints");
-            strError+=QObject::tr("\nThere is no classes file for index: %1")
-                    .arg(QString::number(fileIndex));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(step);
-                qApp->processEvents();
-            }
-            return(false);
-        }
-        QString pointsClassFileName=mClassesFileByIndex[fileIndex];
-        QFile pointsClassFile(pointsClassFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
-        {
-            strError=QObject::tr("PointCloudFile::updatePoints");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(pointsClassFileName);
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(step);
-                qApp->processEvents();
-            }
-            return(false);
-        }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        QMap<int,QMap<int,QVector<quint8> > > tilesPointsClass;
-        QMap<int,QMap<int,QMap<int,quint8> > > tilesPointsClassNewByPos; // se guarda vacío
-        QMap<int,QMap<int,int> > tilesNop;
-        inPointsClass>>tilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>tilesPointsClass;
-        inPointsClass>>tilesPointsClassNewByPos;
-        pointsClassFile.close();
-        QMap<int,QMap<int,QVector<int> > > pointsIndexByTiles=iterFiles.value();
+    // cada fichero en una tarea de updateClassesFiles, los datos de entrada solo se leen
+    QVector<int> filesIndex=pointsIndexByTilesByFileIndex.keys().toVector();
+    const QMap<int, QMap<int, QVector<int> > >& constPointPositionByTile=pointPositionByTile;
+    const QMap<quint8, bool>& constLockedClasses=lockedClasses;
+    auto updateFile=[&](int fileIndex,
+                        PointsClassesFile& classesFile,
+                        PointsEditOperation& editOperation,
+                        bool& existsChanges,
+                        QString& strFileError)->bool
+    {
+        QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+        QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+        const QMap<int,QMap<int,QVector<int> > > pointsIndexByTiles=pointsIndexByTilesByFileIndex.value(fileIndex);
         QMap<int,QMap<int,QVector<int> > >::const_iterator iterTileX=pointsIndexByTiles.begin();
-        bool existsChanges=false;
+        existsChanges=false;
         while(iterTileX!=pointsIndexByTiles.end())
         {
             int tileX=iterTileX.key();
@@ -7336,70 +10297,51 @@ bool PointCloudFile::updatePoints(QString strAction,
 //                    if(!pointClassByTile.contains(tileX)
 //                            ||!pointPositionByTile.contains(tileX)
 //                            ||!pointClassNewByTile.contains(tileX))
-                    if(!pointPositionByTile.contains(tileX)
+                    if(!constPointPositionByTile.contains(tileX)
                             ||!tilesPointsClass.contains(tileX))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
 //                    if(!pointClassByTile[tileX].contains(tileY)
 //                            ||!pointPositionByTile[tileX].contains(tileY)
 //                            ||!pointClassNewByTile[tileX].contains(tileY))
-                    if(!pointPositionByTile[tileX].contains(tileY)
+                    if(!constPointPositionByTile[tileX].contains(tileY)
                             ||!tilesPointsClass[tileX].contains(tileY))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
 //                    if(pointClassByTile[tileX][tileY].size()<(pointIndex+1)
 //                            ||!pointPositionByTile[tileX][tileY].size()<(pointIndex+1)
 //                            ||!pointClassNewByTile[tileX][tileY].size()<(pointIndex+1))
-                    if(pointIndex>(pointPositionByTile[tileX][tileY].size()-1))
+                    if(pointIndex>(constPointPositionByTile[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
-                    int pointPositionInTile=pointPositionByTile[tileX][tileY][pointIndex];
+                    int pointPositionInTile=constPointPositionByTile[tileX][tileY][pointIndex];
                     if(pointPositionInTile>(tilesPointsClass[tileX][tileY].size()-1))
                     {
-                        strError=QObject::tr("PointCloudFile::updatePoints");
-                        strError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
+                        strFileError=QObject::tr("PointCloudFile::updatePoints");
+                        strFileError+=QObject::tr("\nFor file index: %1, not exists tile X: %2 tile Y: %3 point index: %4")
                                 .arg(QString::number(fileIndex)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY).arg(QString::number(pointIndex)));
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->setValue(step);
-                            qApp->processEvents();
-                        }
                         return(false);
                     }
 //                    quint8 pointClass=pointClassByTile[tileX][tileY][pointIndex];
                     quint8 pointClass=tilesPointsClass[tileX][tileY][pointPositionInTile];
                     quint8 pointClassNew=pointClass;
+                    bool existsPointClassNew=false;
                     if(tilesPointsClassNewByPos.contains(tileX))
                     {
                         if(tilesPointsClassNewByPos[tileX].contains(tileY))
@@ -7407,12 +10349,13 @@ bool PointCloudFile::updatePoints(QString strAction,
                             if(tilesPointsClassNewByPos[tileX][tileY].contains(pointPositionInTile))
                             {
                                 pointClassNew=tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile];
+                                existsPointClassNew=true;
                             }
                         }
                     }
-                    if(lockedClasses.contains(pointClassNew))
+                    if(constLockedClasses.contains(pointClassNew))
                     {
-                        if(lockedClasses[pointClassNew]) continue;
+                        if(constLockedClasses[pointClassNew]) continue;
                     }
 //                    quint8 pointClassNew=pointClassNewByTile[tileX][tileY][pointIndex];
                     if(strAction.compare(POINTCLOUDFILE_ACTION_CHANGE_CLASS,Qt::CaseInsensitive)==0)
@@ -7421,6 +10364,7 @@ bool PointCloudFile::updatePoints(QString strAction,
                         if(pointClassNew!=classValue)
                         {
                             tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile]=classValue;
+                            editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,classValue,existsPointClassNew);
                             if(!existsChanges) existsChanges=true;
                         }
                     }
@@ -7434,6 +10378,7 @@ bool PointCloudFile::updatePoints(QString strAction,
                         if(pointClassNew!=pointClass)
                         {
                             tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile]=pointClass;
+                            editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,pointClass,existsPointClassNew);
                             if(!existsChanges) existsChanges=true;
                         }
                     }
@@ -7445,6 +10390,7 @@ bool PointCloudFile::updatePoints(QString strAction,
                             if(classValue!=pointClassNew) continue;
                         }
                         tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile]=POINTCLOUDFILE_CLASS_NUMBER_REMOVE;
+                        editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,POINTCLOUDFILE_CLASS_NUMBER_REMOVE,existsPointClassNew);
                         if(!existsChanges) existsChanges=true;
                     }
                     else if(strAction.compare(POINTCLOUDFILE_ACTION_RECOVER_DELETED,Qt::CaseInsensitive)==0)
@@ -7455,6 +10401,7 @@ bool PointCloudFile::updatePoints(QString strAction,
                             if(classValue!=pointClass) continue;
                         }
                         tilesPointsClassNewByPos[tileX][tileY][pointPositionInTile]=pointClass;
+                        editOperation.addChange(fileIndex,tileX,tileY,pointPositionInTile,pointClassNew,pointClass,existsPointClassNew);
                         if(!existsChanges) existsChanges=true;
                     }
                 }
@@ -7462,253 +10409,353 @@ bool PointCloudFile::updatePoints(QString strAction,
             }
             iterTileX++;
         }
-        if(existsChanges)
-        {
-            pointsClassFile.open(QIODevice::WriteOnly);
-            QDataStream outPointsClass(&pointsClassFile);   // we will serialize the data into the file
-            outPointsClass<<tilesNop;
-            outPointsClass<<existsFields;
-            outPointsClass<<tilesPointsClass;
-            outPointsClass<<tilesPointsClassNewByPos;
-            pointsClassFile.close();
-        }
-        iterFiles++;
+        return(true);
+    };
+    QString strAuxError;
+    PointsEditOperation editOperation;
+    QMutexLocker writeLocker(&mWriteMutex);
+    if(!updateClassesFiles(QObject::tr("PointCloudFile::updatePoints"),
+                           filesIndex,
+                           updateFile,
+                           editOperation,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::updatePoints");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    addEditOperation(editOperation);
+    return(true);
+}
+
+bool PointCloudFile::undo(QString &strError)
+{
+    QString strAuxError;
+    QMutexLocker writeLocker(&mWriteMutex);
+    QMutexLocker locker(&mEditLogMutex);
+    if(mEditLog.getNumberOfUndoOperations()==0)
+    {
+        strError=QObject::tr("PointCloudFile::undo");
+        strError+=QObject::tr("\nThere are no operations to undo");
+        return(false);
     }
-    if(ptrWidget!=NULL)
+    if(!applyEditOperation(mEditLog.getUndoOperation(),
+                           true,
+                           strAuxError))
     {
-        ptrProgress->close();
-        delete(ptrProgress);
+        strError=QObject::tr("PointCloudFile::undo");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
     }
+    mEditLog.undo();
     return(true);
 }
 
-bool PointCloudFile::writePointCloudFiles(QString suffix,
-                                          QString outputPath,
-                                          QString &strError)
+bool PointCloudFile::transformGeometryToProjectCrs(OGRGeometry **ptrPtrGeometry,
+                                                   int geometryCrsEpsgCode,
+                                                   QString geometryCrsProj4String,
+                                                   QString &strError)
 {
-    if(suffix.isEmpty()&&outputPath.isEmpty())
+    QString strAuxError;
+    if(geometryCrsEpsgCode==mSRID)
     {
-        strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-        strError+=QObject::tr("\nSuffix and output path are empty");
+        return(true);
+    }
+    QString geometryCrsDescription;
+    if(!getUserCrsDescription(geometryCrsEpsgCode,
+                              geometryCrsProj4String,
+                              geometryCrsDescription,
+                              strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::transformGeometryToProjectCrs");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
         return(false);
     }
-    QDir currentDir=QDir::currentPath();
-    if(!outputPath.isEmpty())
+    if(geometryCrsDescription==mCrsDescription)
     {
-        if(!currentDir.exists(outputPath))
-        {
-            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-            strError+=QObject::tr("\nNot exists output path:\n").arg(outputPath);
-            return(false);
-        }
+        return(true);
     }
-    QWidget* ptrWidget=new QWidget();
+    QMutexLocker locker(&mCrsMutex);
+    if(!mPtrCrsTools->crsOperation(geometryCrsDescription,
+                                   mCrsDescription,
+                                   ptrPtrGeometry,
+                                   strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::transformGeometryToProjectCrs");
+        strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+bool PointCloudFile::transformPointsToProjectCrs(QVector<QVector<double> > &points,
+                                                 int pointCrsEpsgCode,
+                                                 QString pointCrsProj4String,
+                                                 QString &strError)
+{
     QString strAuxError;
-    int numberOfSqlsInTransaction=0;
-    numberOfSqlsInTransaction=0;
-    QProgressDialog* ptrProgress=NULL;
-    int filesByStep=POINTCLOUDFILE_NUMBER_OF_FILES_TO_WRITE_PROCESS_BY_STEP;
-    int numberOfFiles=mFilesIndex.size();
-    int numberOfSteps=ceil(numberOfFiles/filesByStep);
-    if(ptrWidget!=NULL)
+    if(pointCrsEpsgCode==mSRID)
     {
-        QString title=QObject::tr("Writting files for point cloud: ");
-        QString msgGlobal=mPath;
-        msgGlobal+="\n";
-        msgGlobal+=QString::number(numberOfFiles,10);
-        msgGlobal+=" number of files";
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        return(true);
     }
-    int step=0;
-    int numberOfProcessedFiless=0;
-    int numberOfProcessedFilesInStep=0;
-    QMap<QString,int>::const_iterator iterFiles=mFilesIndex.begin();
-    while(iterFiles!=mFilesIndex.end())
+    QString pointCrsDescription;
+    if(!getUserCrsDescription(pointCrsEpsgCode,
+                              pointCrsProj4String,
+                              pointCrsDescription,
+                              strAuxError))
     {
-        int fileIndex=iterFiles.value();
-        QString inputPointCloudFileName=iterFiles.key();
-        if(!QFile::exists(inputPointCloudFileName))
-        {
-            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-            strError+=QObject::tr("\nNot exists point cloud file:\n%1").arg(inputPointCloudFileName);
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(numberOfSteps);
-                qApp->processEvents();
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            return(false);
-        }
-        QFileInfo inputPointCloudFileInfo(inputPointCloudFileName);
-        QString outputPointCloudFileName;
-        if(!outputPath.isEmpty())
-        {
-            outputPointCloudFileName=outputPath;
-        }
-        else
-        {
-            outputPointCloudFileName=inputPointCloudFileInfo.absolutePath();
-        }
-        outputPointCloudFileName+="/";
-        if(suffix.isEmpty())
-        {
-            outputPointCloudFileName+=inputPointCloudFileInfo.fileName();
-        }
-        else
-        {
-            outputPointCloudFileName+=inputPointCloudFileInfo.baseName();
-            outputPointCloudFileName+=suffix;
-            outputPointCloudFileName+=".";
-            outputPointCloudFileName+=inputPointCloudFileInfo.completeSuffix();
-        }
-        if(QFile::exists(outputPointCloudFileName))
-        {
-            if(!QFile::remove(outputPointCloudFileName))
-            {
-                strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-                strError+=QObject::tr("Error removing existing output file:\n%1").arg(outputPointCloudFileName);
-                if(ptrWidget!=NULL)
-                {
-                    ptrProgress->setValue(numberOfSteps);
-                    qApp->processEvents();
-                    ptrProgress->close();
-                    delete(ptrProgress);
-                }
-                return(false);
-            }
-        }
-        numberOfProcessedFilesInStep++;
-        numberOfProcessedFiless++;
-        if(numberOfProcessedFilesInStep==POINTCLOUDFILE_NUMBER_OF_FILES_TO_WRITE_PROCESS_BY_STEP)
+        strError=QObject::tr("PointCloudFile::transformPointsToProjectCrs");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(pointCrsDescription==mCrsDescription)
+    {
+        return(true);
+    }
+    // todas las coordenadas en una operacion; CRSTools no es reentrante
+    QMutexLocker locker(&mCrsMutex);
+    if(!mPtrCrsTools->crsOperation(pointCrsDescription,
+                                   mCrsDescription,
+                                   points,
+                                   strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::transformPointsToProjectCrs");
+        strError+=QObject::tr("\nError in CRS operation:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(true);
+}
+
+void PointCloudFile::updateTileStatistics(QVector<double> &tileStatistics,
+                                          int minimumPosition,
+                                          double value)
+{
+    if(value<tileStatistics[minimumPosition]) tileStatistics[minimumPosition]=value;
+    if(value>tileStatistics[minimumPosition+1]) tileStatistics[minimumPosition+1]=value;
+}
+
+bool PointCloudFile::writeOriginalIndexFile(QString fileName,
+                                            const QMap<int, QMap<int, QVector<qint64> > > &tilesOriginalIndexRanges,
+                                            QString &strError)
+{
+    QFile originalIndexFile(fileName);
+    if(!originalIndexFile.open(QIODevice::WriteOnly))
+    {
+        strError=QObject::tr("PointCloudFile::writeOriginalIndexFile");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(fileName);
+        return(false);
+    }
+    QDataStream out(&originalIndexFile);
+    out<<(quint32)POINTCLOUDFILE_PCO_MAGIC;
+    out<<(qint32)POINTCLOUDFILE_PCO_VERSION;
+    out<<tilesOriginalIndexRanges;
+    originalIndexFile.close();
+    return(true);
+}
+
+bool PointCloudFile::writePointsIndexFile(int fileIndex,
+                                          const QMap<int, QMap<int, QVector<int> > > &tilesPositions,
+                                          QString &strError)
+{
+    // se anaden los tiles nuevos a los ya guardados
+    QMutexLocker locker(&mPointsIndexFileMutex);
+    QString pointsIndexFileName=mPointsIndexFileByIndex.value(fileIndex);
+    if(pointsIndexFileName.isEmpty())
+    {
+        strError=QObject::tr("PointCloudFile::writePointsIndexFile");
+        strError+=QObject::tr("\nThere is no points index file for index: %1")
+                .arg(QString::number(fileIndex));
+        return(false);
+    }
+    QMap<int,QMap<int,QVector<int> > > allTilesPositions;
+    QFile pointsIndexFile(pointsIndexFileName);
+    if(pointsIndexFile.exists())
+    {
+        if(pointsIndexFile.open(QIODevice::ReadOnly))
         {
-            step++;
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(step);
-                qApp->processEvents();
-            }
-            numberOfProcessedFilesInStep=0;
+            QDataStream in(&pointsIndexFile);
+            in>>allTilesPositions;
+            if(in.status()!=QDataStream::Ok) allTilesPositions.clear();
+            pointsIndexFile.close();
         }
-        QString classesFileName=mClassesFileByIndex[fileIndex];
-        QFile pointsClassFile(classesFileName);
-        if (!pointsClassFile.open(QIODevice::ReadOnly))
+    }
+    QMap<int,QMap<int,QVector<int> > >::const_iterator iterX=tilesPositions.begin();
+    while(iterX!=tilesPositions.end())
+    {
+        QMap<int,QVector<int> >::const_iterator iterY=iterX.value().begin();
+        while(iterY!=iterX.value().end())
         {
-            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-            strError+=QObject::tr("\nError opening file:\n%1").arg(classesFileName);
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->setValue(numberOfSteps);
-                qApp->processEvents();
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
-            return(false);
+            allTilesPositions[iterX.key()][iterY.key()]=iterY.value();
+            iterY++;
         }
-        QDataStream inPointsClass(&pointsClassFile);
-        QMap<QString,bool> existsFields;
-        QMap<int,QMap<int,QVector<quint8> > > tilesPointsClass;
-        QMap<int,QMap<int,QMap<int,quint8> > > tilesPointsClassNewByPos; // se guarda vacío
-        QMap<int,QMap<int,int> > tilesNop;
-        inPointsClass>>tilesNop;
-        inPointsClass>>existsFields;
-        inPointsClass>>tilesPointsClass;
-        inPointsClass>>tilesPointsClassNewByPos;
-        pointsClassFile.close();
-        bool existsColor=existsFields[POINTCLOUDFILE_PARAMETER_COLOR];
-        bool existsGpsTime=existsFields[POINTCLOUDFILE_PARAMETER_GPS_TIME];
-        bool existsUserData=existsFields[POINTCLOUDFILE_PARAMETER_USER_DATA];
-        bool existsIntensity=existsFields[POINTCLOUDFILE_PARAMETER_INTENSITY];
-        bool existsSourceId=existsFields[POINTCLOUDFILE_PARAMETER_SOURCE_ID];
-        bool existsNir=existsFields[POINTCLOUDFILE_PARAMETER_NIR];
-        bool existsReturn=existsFields[POINTCLOUDFILE_PARAMETER_RETURN];
-        bool existsReturns=existsFields[POINTCLOUDFILE_PARAMETER_RETURNS];
-        bool existsChanges=false;
-        QMap<int,QMap<int,QMap<int,quint8> > > pointsClassNewByPosInTileByTile;
-        QMap<int,QMap<int,QMap<int,quint8> > >::const_iterator iterTileXPointsClassNew=tilesPointsClassNewByPos.begin();
-        while(iterTileXPointsClassNew!=tilesPointsClassNewByPos.end())
-        {
-            int tileX=iterTileXPointsClassNew.key();
-            QMap<int,QMap<int,quint8> >::const_iterator iterTileYPointsClassNew=iterTileXPointsClassNew.value().begin();
-            while(iterTileYPointsClassNew!=iterTileXPointsClassNew.value().end())
-            {
-                int tileY=iterTileYPointsClassNew.key();
-                QMap<int,quint8>::const_iterator iterPositionPointsClassNew=iterTileYPointsClassNew.value().begin();
-                while(iterPositionPointsClassNew!=iterTileYPointsClassNew.value().end())
+        iterX++;
+    }
+    if(!pointsIndexFile.open(QIODevice::WriteOnly))
+    {
+        strError=QObject::tr("PointCloudFile::writePointsIndexFile");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(pointsIndexFileName);
+        return(false);
+    }
+    QDataStream out(&pointsIndexFile);
+    out<<allTilesPositions;
+    pointsIndexFile.close();
+    return(true);
+}
+
+bool PointCloudFile::writePointCloudFile(int fileIndex,
+                                         QString inputPointCloudFileName,
+                                         QString outputPointCloudFileName,
+                                         bool copyWithoutChanges,
+                                         bool removedPointsAsWithheld,
+                                         Progress *ptrProgress,
+                                         QString &strError)
+{
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
+    QString strAuxError;
+    QString classesFileName=mClassesFileByIndex.value(fileIndex);
+    PointsClassesFile classesFile;
+    if(!readClassesFile(fileIndex,classesFile,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("\nError reading classes file:\n%1\nError:\n%2").arg(classesFileName).arg(strAuxError);
+        return(false);
+    }
+    QMap<QString,bool>& existsFields=classesFile.getExistsFields();
+    QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+    QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+    bool existsColor=existsFields[POINTCLOUDFILE_PARAMETER_COLOR];
+    bool existsGpsTime=existsFields[POINTCLOUDFILE_PARAMETER_GPS_TIME];
+    bool existsUserData=existsFields[POINTCLOUDFILE_PARAMETER_USER_DATA];
+    bool existsIntensity=existsFields[POINTCLOUDFILE_PARAMETER_INTENSITY];
+    bool existsSourceId=existsFields[POINTCLOUDFILE_PARAMETER_SOURCE_ID];
+    bool existsNir=existsFields[POINTCLOUDFILE_PARAMETER_NIR];
+    bool existsReturn=existsFields[POINTCLOUDFILE_PARAMETER_RETURN];
+    bool existsReturns=existsFields[POINTCLOUDFILE_PARAMETER_RETURNS];
+    bool existsChanges=false;
+    QMap<int,QMap<int,QMap<int,quint8> > > pointsClassNewByPosInTileByTile;
+    QMap<int,QMap<int,QMap<int,quint8> > >::const_iterator iterTileXPointsClassNew=tilesPointsClassNewByPos.begin();
+    while(iterTileXPointsClassNew!=tilesPointsClassNewByPos.end())
+    {
+        int tileX=iterTileXPointsClassNew.key();
+        QMap<int,QMap<int,quint8> >::const_iterator iterTileYPointsClassNew=iterTileXPointsClassNew.value().begin();
+        while(iterTileYPointsClassNew!=iterTileXPointsClassNew.value().end())
+        {
+            int tileY=iterTileYPointsClassNew.key();
+            QMap<int,quint8>::const_iterator iterPositionPointsClassNew=iterTileYPointsClassNew.value().begin();
+            while(iterPositionPointsClassNew!=iterTileYPointsClassNew.value().end())
+            {
+                int posInTile=iterPositionPointsClassNew.key();
+                if(!tilesPointsClass.contains(tileX))
                 {
-                    int posInTile=iterPositionPointsClassNew.key();
-                    if(!tilesPointsClass.contains(tileX))
-                    {
-                        iterPositionPointsClassNew++;
-                        continue;
-                    }
-                    if(!tilesPointsClass[tileX].contains(tileY))
-                    {
-                        iterPositionPointsClassNew++;
-                        continue;
-                    }
-                    if(posInTile>(tilesPointsClass[tileX][tileY].size()-1))
-                    {
-                        iterPositionPointsClassNew++;
-                        continue;
-                    }
-                    quint8 classOriginal=tilesPointsClass[tileX][tileY][posInTile];
-                    quint8 classNew=iterPositionPointsClassNew.value();
-                    if(classNew!=classOriginal)
-                    {
-                        pointsClassNewByPosInTileByTile[tileX][tileY][posInTile]=classNew;
-                        if(!existsChanges) existsChanges=true;
-                    }
                     iterPositionPointsClassNew++;
+                    continue;
+                }
+                if(!tilesPointsClass[tileX].contains(tileY))
+                {
+                    iterPositionPointsClassNew++;
+                    continue;
+                }
+                if(posInTile>(tilesPointsClass[tileX][tileY].size()-1))
+                {
+                    iterPositionPointsClassNew++;
+                    continue;
+                }
+                quint8 classOriginal=tilesPointsClass[tileX][tileY][posInTile];
+                quint8 classNew=iterPositionPointsClassNew.value();
+                if(classNew!=classOriginal)
+                {
+                    pointsClassNewByPosInTileByTile[tileX][tileY][posInTile]=classNew;
+                    if(!existsChanges) existsChanges=true;
                 }
-                iterTileYPointsClassNew++;
+                iterPositionPointsClassNew++;
+            }
+            iterTileYPointsClassNew++;
+        }
+        iterTileXPointsClassNew++;
+    }
+    if(!existsChanges)
+    {
+        if(copyWithoutChanges)
+        {
+            if(!linkOrCopyFile(inputPointCloudFileName,
+                               outputPointCloudFileName,
+                               true,
+                               strAuxError))
+            {
+                strError=QObject::tr("PointCloudFile::writePointCloudFile");
+                strError+=QObject::tr("Error copying witout changes input file:\n%1").arg(inputPointCloudFileName);
+                strError+=QObject::tr("\nto output file:\n%1\nError:\n%2").arg(outputPointCloudFileName).arg(strAuxError);
+                return(false);
             }
-            iterTileXPointsClassNew++;
         }
-        if(!existsChanges)
+        return(true);
+    }
+    // con el indice de cada punto en el fichero original los cambios se aplican en una pasada
+    // ordenada; en proyectos anteriores, sin fichero .pco, se buscan por coordenadas
+    QMap<int,QMap<int,QVector<qint64> > > tilesOriginalIndexRanges;
+    if(!readOriginalIndexFile(fileIndex,tilesOriginalIndexRanges,strAuxError))
+    {
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    bool useOriginalIndex=!tilesOriginalIndexRanges.isEmpty();
+    QVector<QPair<qint64,quint8> > pointsClassNewByOriginalIndex;
+    QMap<int,QMap<int,QMap<int,QMap<int,QVector<quint8> > > > > pointsClassesNewByCoorInTileByTile;
+    QMap<int,QMap<int,QMap<int,QMap<int,QVector<double> > > > > pointsAltitudesByCoorInTileByTile;
+    if(useOriginalIndex)
+    {
+        QMap<int,QMap<int,QMap<int,quint8> > >::const_iterator iterTileX2=pointsClassNewByPosInTileByTile.begin();
+        while(iterTileX2!=pointsClassNewByPosInTileByTile.end())
         {
-            if(!outputPath.isEmpty())
+            int tileX=iterTileX2.key();
+            QMap<int,QMap<int,quint8> >::const_iterator iterTileY2=iterTileX2.value().begin();
+            while(iterTileY2!=iterTileX2.value().end())
             {
-                if(!QFile::copy(inputPointCloudFileName,
-                                outputPointCloudFileName))
+                int tileY=iterTileY2.key();
+                const QVector<qint64> tileOriginalIndexRanges=tilesOriginalIndexRanges.value(tileX).value(tileY);
+                int rangeValue=0;
+                qint64 rangeFirstPosition=0;
+                QMap<int,quint8>::const_iterator iterPosition=iterTileY2.value().begin();
+                while(iterPosition!=iterTileY2.value().end())
                 {
-                    strError=QObject::tr("PointCloudFile::writePointCloudFiles");
-                    strError+=QObject::tr("Error copying witout changes input file:\n%1").arg(inputPointCloudFileName);
-                    strError+=QObject::tr("\nto output file:\n%1").arg(outputPointCloudFileName);
-                    if(ptrWidget!=NULL)
+                    int posInTile=iterPosition.key();
+                    while(rangeValue<tileOriginalIndexRanges.size()
+                          &&posInTile>=rangeFirstPosition+tileOriginalIndexRanges[rangeValue+1])
                     {
-                        ptrProgress->setValue(numberOfSteps);
-                        qApp->processEvents();
-                        ptrProgress->close();
-                        delete(ptrProgress);
+                        rangeFirstPosition+=tileOriginalIndexRanges[rangeValue+1];
+                        rangeValue+=2;
                     }
-                    return(false);
+                    if(rangeValue>=tileOriginalIndexRanges.size())
+                    {
+                        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+                        strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in original index file for:\n%4")
+                                .arg(QString::number(posInTile)).arg(QString::number(tileX))
+                                .arg(QString::number(tileY)).arg(inputPointCloudFileName);
+                        return(false);
+                    }
+                    qint64 originalIndex=tileOriginalIndexRanges[rangeValue]+posInTile-rangeFirstPosition;
+                    pointsClassNewByOriginalIndex.push_back(qMakePair(originalIndex,iterPosition.value()));
+                    iterPosition++;
                 }
+                iterTileY2++;
             }
-            iterFiles++;
-            continue;
+            iterTileX2++;
         }
-        QString zipFileNamePoints=mZipFilePointsByIndex[fileIndex];
-        QString zipFilePointsPath=mZipFilePathPointsByIndex[fileIndex];
+        std::sort(pointsClassNewByOriginalIndex.begin(),pointsClassNewByOriginalIndex.end());
+    }
+    else
+    {
+        QString zipFileNamePoints=mZipFilePointsByIndex.value(fileIndex);
+        QString zipFilePointsPath=mZipFilePathPointsByIndex.value(fileIndex);
         QuaZip zipFilePoints(zipFileNamePoints);
         if(!zipFilePoints.open(QuaZip::mdUnzip))
         {
-            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+            strError=QObject::tr("PointCloudFile::writePointCloudFile");
             strError+=QObject::tr("\nError opening file:\n%1\nError:\n%2")
                     .arg(zipFileNamePoints).arg(QString::number(zipFilePoints.getZipError()));
-            if(ptrWidget!=NULL)
-            {
-                ptrProgress->close();
-                delete(ptrProgress);
-            }
             return(false);
         }
-        QMap<int,QMap<int,QMap<int,QMap<int,QVector<quint8> > > > > pointsClassesNewByCoorInTileByTile;
-        QMap<int,QMap<int,QMap<int,QMap<int,QVector<double> > > > > pointsAltitudesByCoorInTileByTile;
         QMap<int,QMap<int,QMap<int,quint8> > >::const_iterator iterTileX2=pointsClassNewByPosInTileByTile.begin();
         while(iterTileX2!=pointsClassNewByPosInTileByTile.end())
         {
@@ -7718,32 +10765,29 @@ bool PointCloudFile::writePointCloudFiles(QString suffix,
             {
                 int tileY=iterTileY2.key();
                 QMap<int,quint8> pointsClassNewByPosInTile=iterTileY2.value();
-                QString tileTableName=mTilesName[tileX][tileY];
+                QString tileTableName=mTilesName.value(tileX).value(tileY);
+                if(ptrProgress!=NULL
+                        &&ptrProgress->wasCanceled())
+                {
+                    strError=QObject::tr("PointCloudFile::writePointCloudFile");
+                    strError+=QObject::tr("\nProcess canceled by user");
+                    return(false);
+                }
                 if(!zipFilePoints.setCurrentFile(tileTableName))
                 {
-                    strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+                    strError=QObject::tr("PointCloudFile::writePointCloudFile");
                     strError+=QObject::tr("\nNot exists: %1 in file:\n%2\nError:\n%3")
                             .arg(tileTableName).arg(zipFileNamePoints)
                             .arg(QString::number(zipFilePoints.getZipError()));
-                    if(ptrWidget!=NULL)
-                    {
-                        ptrProgress->close();
-                        delete(ptrProgress);
-                    }
                     return(false);
                 }
                 QuaZipFile inPointsFile(&zipFilePoints);
                 if (!inPointsFile.open(QIODevice::ReadOnly))
                 {
-                    strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+                    strError=QObject::tr("PointCloudFile::writePointCloudFile");
                     strError+=QObject::tr("\nError opening: %1 in file:\n%2\nError:\n%3")
                             .arg(tileTableName).arg(zipFileNamePoints)
                             .arg(QString::number(zipFilePoints.getZipError()));
-                    if(ptrWidget!=NULL)
-                    {
-                        ptrProgress->close();
-                        delete(ptrProgress);
-                    }
                     return(false);
                 }
                 QDataStream inPoints(&inPointsFile);
@@ -7757,15 +10801,10 @@ bool PointCloudFile::writePointCloudFiles(QString suffix,
                     pto.setPositionInTile(pos);
                     if(pos>tilesPointsClass[tileX][tileY].size())
                     {
-                        strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+                        strError=QObject::tr("PointCloudFile::writePointCloudFile");
                         strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes  file:\n%4")
                                 .arg(QString::number(pos)).arg(QString::number(tileX))
                                 .arg(QString::number(tileY)).arg(classesFileName);
-                        if(ptrWidget!=NULL)
-                        {
-                            ptrProgress->close();
-                            delete(ptrProgress);
-                        }
                         return(false);
                     }
                     quint8 ptoClass=tilesPointsClass[tileX][tileY][pos];
@@ -7883,64 +10922,158 @@ bool PointCloudFile::writePointCloudFiles(QString suffix,
             }
             iterTileX2++;
         }
+    }
+    // en ficheros las sin comprimir solo se modifican los registros cambiados de una copia y en
+    // ficheros laz solo se recomprimen los chunks con cambios; si hay puntos eliminados que no se
+    // marcan como withheld se reescribe el fichero
+    if(useOriginalIndex)
+    {
+        bool existsRemovedPoints=false;
+        for(int nc=0;nc<pointsClassNewByOriginalIndex.size();nc++)
+        {
+            if(pointsClassNewByOriginalIndex[nc].second==POINTCLOUDFILE_CLASS_NUMBER_REMOVE)
+            {
+                existsRemovedPoints=true;
+                break;
+            }
+        }
+        QString inputSuffix=QFileInfo(inputPointCloudFileName).suffix();
+        if(!existsRemovedPoints||removedPointsAsWithheld)
+        {
+            if(inputSuffix.compare(POINTCLOUDFILE_LAS_SUFFIX,Qt::CaseInsensitive)==0)
+            {
+                if(!patchLasFileClasses(inputPointCloudFileName,
+                                        outputPointCloudFileName,
+                                        pointsClassNewByOriginalIndex,
+                                        removedPointsAsWithheld,
+                                        ptrProgress,
+                                        strAuxError))
+                {
+                    strError=QObject::tr("PointCloudFile::writePointCloudFile");
+                    strError+=QObject::tr("\nError patching file:\n%1\nError:\n%2")
+                            .arg(outputPointCloudFileName).arg(strAuxError);
+                    return(false);
+                }
+                return(true);
+            }
+            if(inputSuffix.compare(POINTCLOUDFILE_LAZ_SUFFIX,Qt::CaseInsensitive)==0)
+            {
+                bool patched=false;
+                if(!patchLazFileChunks(inputPointCloudFileName,
+                                       outputPointCloudFileName,
+                                       pointsClassNewByOriginalIndex,
+                                       removedPointsAsWithheld,
+                                       ptrProgress,
+                                       patched,
+                                       strAuxError))
+                {
+                    strError=QObject::tr("PointCloudFile::writePointCloudFile");
+                    strError+=QObject::tr("\nError patching file:\n%1\nError:\n%2")
+                            .arg(outputPointCloudFileName).arg(strAuxError);
+                    return(false);
+                }
+                if(patched)
+                {
+                    return(true);
+                }
+            }
+        }
+    }
 
-        std::string stdInputFileName=inputPointCloudFileName.toStdString();
-        const char* charInputFileName=stdInputFileName.c_str();
+    std::string stdInputFileName=inputPointCloudFileName.toStdString();
+    const char* charInputFileName=stdInputFileName.c_str();
 
-        std::string stdOutputFileName=outputPointCloudFileName.toStdString();
-        const char* charOutputFileName=stdOutputFileName.c_str();
+    std::string stdOutputFileName=outputPointCloudFileName.toStdString();
+    const char* charOutputFileName=stdOutputFileName.c_str();
 
-        int numberOfPoints;
-        LASreadOpener lasreadopener;
-        lasreadopener.set_file_name(charInputFileName);
-        if (!lasreadopener.active())
+    int numberOfPoints;
+    LASreadOpener lasreadopener;
+    lasreadopener.set_file_name(charInputFileName);
+    if (!lasreadopener.active())
+    {
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("Error opening file:\n%1").arg(inputPointCloudFileName);
+        return(false);
+    }
+    LASreader* lasreader = lasreadopener.open();
+    if(lasreader==NULL)
+    {
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("Error opening file:\n%1").arg(inputPointCloudFileName);
+        return(false);
+    }
+    LASheader* lasheader = &lasreader->header;
+    LASwriteOpener laswriteopener;
+    laswriteopener.set_file_name(charOutputFileName);
+    LASheader outputLasheader=lasreader->header;
+    LASwriter* laswriter = laswriteopener.open(&outputLasheader);
+    bool extendedFormat=(lasheader->point_data_format>=POINTCLOUDFILE_LAS_POINT_EXTENDED_FORMAT_MINIMUM);
+    if(laswriter==NULL)
+    {
+        lasreader->close();
+        delete lasreader;
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("Error opening output file:\n%1").arg(outputPointCloudFileName);
+        return(false);
+    }
+    numberOfPoints=lasreader->npoints;
+    Progress* ptrWritePointCloudFileProgress=NULL;
+    int pointsStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
+    int wPclNumberOfSteps=ceil((double)numberOfPoints/(double)pointsStep);
+    if(ptrProgressCallback!=NULL)
+    {
+        QString title=QObject::tr("Point Cloud File write operation");
+        QString msgGlobal=inputPointCloudFileName;
+        msgGlobal+="\n ... writting points ";
+        msgGlobal+=QString::number(numberOfPoints,10);
+        msgGlobal+=" points";
+        ptrWritePointCloudFileProgress=ptrProgressCallback->createProgress(title,msgGlobal,wPclNumberOfSteps);
+    }
+    int wPclStep=0;
+    int numberOfProcessedPoints=0;
+    int numberOfProcessedPointsInStep=0;
+    int numberOfPointsToProcessInStep=numberOfPoints;
+    if(POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP<numberOfPointsToProcessInStep)
+    {
+        numberOfPointsToProcessInStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
+    }
+    qint64 pointIndex=-1;
+    int nextChange=0;
+    bool canceled=false;
+    while(lasreader->read_point()&&numberOfPointsToProcessInStep>0)
+    {
+        pointIndex++;
+        bool writePoint=true;
+        if(useOriginalIndex)
         {
-            strError=QObject::tr("PointCloudSpatialiteDb::writePointCloudFiles");
-            strError+=QObject::tr("Error opening file:\n%1").arg(inputPointCloudFileName);
-            if(ptrWidget!=NULL)
+            if(nextChange<pointsClassNewByOriginalIndex.size()
+                    &&pointsClassNewByOriginalIndex[nextChange].first==pointIndex)
             {
-                ptrProgress->setValue(numberOfSteps);
-                qApp->processEvents();
-                ptrProgress->close();
-                delete(ptrProgress);
+                quint8 classNew=pointsClassNewByOriginalIndex[nextChange].second;
+                if(classNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE)
+                {
+                    if(removedPointsAsWithheld)
+                    {
+                        lasreader->point.set_withheld_flag(1);
+                    }
+                    else
+                    {
+                        writePoint=false;
+                    }
+                }
+                else if(extendedFormat)
+                {
+                    lasreader->point.set_extended_classification(classNew);
+                }
+                else if(classNew<=POINTCLOUDFILE_LAS_POINT_CLASS_MAXIMUM)
+                {
+                    lasreader->point.set_classification(classNew);
+                }
+                nextChange++;
             }
-            return(false);
         }
-        LASreader* lasreader = lasreadopener.open();
-        LASheader* lasheader = &lasreader->header;
-        LASwriteOpener laswriteopener;
-        laswriteopener.set_file_name(charOutputFileName);
-        LASheader outputLasheader=lasreader->header;
-        LASwriter* laswriter = laswriteopener.open(&outputLasheader);
-        numberOfPoints=lasreader->npoints;
-        QProgressDialog* ptrWritePointCloudFileProgress=NULL;
-        int pointsStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
-        int wPclNumberOfSteps=ceil((double)numberOfPoints/(double)pointsStep);
-        if(ptrWidget!=NULL)
-        {
-            QString title=QObject::tr("Point Cloud File write operation");
-            QString msgGlobal=" ... writting points ";
-            msgGlobal+=QString::number(numberOfPoints,10);
-            msgGlobal+=" points";
-            ptrWritePointCloudFileProgress=new QProgressDialog(title, "Abort",0,wPclNumberOfSteps, ptrWidget);
-            ptrWritePointCloudFileProgress->setWindowModality(Qt::WindowModal);
-            ptrWritePointCloudFileProgress->setLabelText(msgGlobal);
-            ptrWritePointCloudFileProgress->show();
-            qApp->processEvents();
-        }
-        int wPclStep=0;
-        int numberOfProcessedPoints=0;
-        int numberOfProcessedPointsInStep=0;
-        int numberOfPointsToProcessInStep=numberOfPoints;
-        if(POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP<numberOfPointsToProcessInStep)
-        {
-            numberOfPointsToProcessInStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
-        }
-        int pointIndex=-1;
-        while(lasreader->read_point()&&numberOfPointsToProcessInStep>0)
-        {
-            pointIndex++;
-            bool writePoint=true;
+        else
+        {
             double x=lasreader->point.get_X()*lasheader->x_scale_factor+lasheader->x_offset;
             double y=lasreader->point.get_Y()*lasheader->y_scale_factor+lasheader->y_offset;
             int tileX=qRound(floor(floor(x)/mGridSize)*mGridSize);
@@ -7966,9 +11099,20 @@ bool PointCloudFile::writePointCloudFiles(QString suffix,
                                     int classNew=pointsClassesNewByCoorInTileByTile[tileX][tileY][ix][iy][npz];
                                     if(classNew==POINTCLOUDFILE_CLASS_NUMBER_REMOVE)
                                     {
-                                        writePoint=false;
+                                        if(removedPointsAsWithheld)
+                                        {
+                                            lasreader->point.set_withheld_flag(1);
+                                        }
+                                        else
+                                        {
+                                            writePoint=false;
+                                        }
+                                    }
+                                    else if(extendedFormat)
+                                    {
+                                        lasreader->point.set_extended_classification(classNew);
                                     }
-                                    else
+                                    else if(classNew<=POINTCLOUDFILE_LAS_POINT_CLASS_MAXIMUM)
                                     {
                                         lasreader->point.set_classification(classNew);
                                     }
@@ -7979,48 +11123,234 @@ bool PointCloudFile::writePointCloudFiles(QString suffix,
                     }
                 }
             }
-            if(writePoint)
+        }
+        if(writePoint)
+        {
+            laswriter->write_point(&lasreader->point);
+            laswriter->update_inventory(&lasreader->point);
+        }
+        numberOfProcessedPoints++;
+        numberOfProcessedPointsInStep++;
+        if(numberOfProcessedPointsInStep==numberOfPointsToProcessInStep)
+        {
+            wPclStep++;
+            numberOfPointsToProcessInStep=numberOfPoints-numberOfProcessedPoints;
+            if(POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP<numberOfPointsToProcessInStep)
             {
-                laswriter->write_point(&lasreader->point);
-                laswriter->update_inventory(&lasreader->point);
+                numberOfPointsToProcessInStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
             }
-            numberOfProcessedPoints++;
-            numberOfProcessedPointsInStep++;
-            if(numberOfProcessedPointsInStep==numberOfPointsToProcessInStep)
+            numberOfProcessedPointsInStep=0;
+            if(ptrWritePointCloudFileProgress!=NULL)
             {
-                wPclStep++;
-                numberOfPointsToProcessInStep=numberOfPoints-numberOfProcessedPoints;
-                if(POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP<numberOfPointsToProcessInStep)
-                {
-                    numberOfPointsToProcessInStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP;
-                }
-                numberOfProcessedPointsInStep=0;
-                if(ptrWidget!=NULL)
-                {
-                    ptrWritePointCloudFileProgress->setValue(wPclStep);
-                    qApp->processEvents();
-                }
+                ptrWritePointCloudFileProgress->setValue(wPclStep);
+            }
+            if(ptrProgress!=NULL
+                    &&ptrProgress->wasCanceled())
+            {
+                canceled=true;
+                break;
             }
         }
-        laswriter->update_header(&outputLasheader, TRUE);
+    }
+    if(canceled)
+    {
         laswriter->close();
+        delete laswriter;
         lasreader->close();
-//            delete lasreader;
-        if(ptrWidget!=NULL)
+        delete lasreader;
+        if(ptrWritePointCloudFileProgress!=NULL)
         {
-            ptrWritePointCloudFileProgress->setValue(wPclNumberOfSteps);
-            qApp->processEvents();
-            ptrWritePointCloudFileProgress->close();
             delete(ptrWritePointCloudFileProgress);
         }
+        QFile::remove(outputPointCloudFileName);
+        strError=QObject::tr("PointCloudFile::writePointCloudFile");
+        strError+=QObject::tr("\nProcess canceled by user");
+        return(false);
+    }
+    laswriter->update_header(&outputLasheader, TRUE);
+    laswriter->close();
+    delete laswriter;
+    lasreader->close();
+    delete lasreader;
+    if(ptrWritePointCloudFileProgress!=NULL)
+    {
+        ptrWritePointCloudFileProgress->setValue(wPclNumberOfSteps);
+        delete(ptrWritePointCloudFileProgress);
+    }
+    return(true);
+}
+
+bool PointCloudFile::writePointCloudFiles(QString suffix,
+                                          QString outputPath,
+                                          QString &strError)
+{
+    QReadLocker dataLocker(&mDataLock);
+    if(suffix.isEmpty()&&outputPath.isEmpty())
+    {
+        strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+        strError+=QObject::tr("\nSuffix and output path are empty");
+        return(false);
+    }
+    QDir currentDir=QDir::currentPath();
+    if(!outputPath.isEmpty())
+    {
+        if(!currentDir.exists(outputPath))
+        {
+            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+            strError+=QObject::tr("\nNot exists output path:\n").arg(outputPath);
+            return(false);
+        }
+    }
+    // los ficheros sin cambios solo se copian si se escriben en otra carpeta
+    bool copyWithoutChanges=!outputPath.isEmpty();
+    bool removedPointsAsWithheld=mPtrPCFManager->getRemovedPointsAsWithheld();
+    QVector<int> filesIndex;
+    QVector<QString> inputFilesNames;
+    QVector<QString> outputFilesNames;
+    QVector<qint64> inputFilesSizes;
+    QMap<QString,int>::const_iterator iterFiles=mFilesIndex.begin();
+    while(iterFiles!=mFilesIndex.end())
+    {
+        int fileIndex=iterFiles.value();
+        QString inputPointCloudFileName=iterFiles.key();
+        if(!QFile::exists(inputPointCloudFileName))
+        {
+            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+            strError+=QObject::tr("\nNot exists point cloud file:\n%1").arg(inputPointCloudFileName);
+            return(false);
+        }
+        QFileInfo inputPointCloudFileInfo(inputPointCloudFileName);
+        QString outputPointCloudFileName;
+        if(!outputPath.isEmpty())
+        {
+            outputPointCloudFileName=outputPath;
+        }
+        else
+        {
+            outputPointCloudFileName=inputPointCloudFileInfo.absolutePath();
+        }
+        outputPointCloudFileName+="/";
+        if(suffix.isEmpty())
+        {
+            outputPointCloudFileName+=inputPointCloudFileInfo.fileName();
+        }
+        else
+        {
+            outputPointCloudFileName+=inputPointCloudFileInfo.baseName();
+            outputPointCloudFileName+=suffix;
+            outputPointCloudFileName+=".";
+            outputPointCloudFileName+=inputPointCloudFileInfo.completeSuffix();
+        }
+        if(QFile::exists(outputPointCloudFileName))
+        {
+            if(!QFile::remove(outputPointCloudFileName))
+            {
+                strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+                strError+=QObject::tr("Error removing existing output file:\n%1").arg(outputPointCloudFileName);
+                return(false);
+            }
+        }
+        filesIndex.push_back(fileIndex);
+        inputFilesNames.push_back(inputPointCloudFileName);
+        outputFilesNames.push_back(outputPointCloudFileName);
+        inputFilesSizes.push_back(inputPointCloudFileInfo.size());
         iterFiles++;
     }
-    if(ptrWidget!=NULL)
+    int numberOfFiles=filesIndex.size();
+    // primero los ficheros mayores, para que el ultimo en terminar no alargue el proceso
+    QVector<int> tasksOrder(numberOfFiles);
+    for(int nf=0;nf<numberOfFiles;nf++)
     {
-        ptrProgress->setValue(numberOfSteps);
-        qApp->processEvents();
-        ptrProgress->close();
+        tasksOrder[nf]=nf;
+    }
+    std::stable_sort(tasksOrder.begin(),tasksOrder.end(),
+                     [&inputFilesSizes](int first,int second)
+    {
+        return(inputFilesSizes[first]>inputFilesSizes[second]);
+    });
+    QVector<QString> filesError(numberOfFiles);
+    QAtomicInt nextTask(0);
+    QAtomicInt numberOfProcessedTasks(0);
+    QAtomicInt canceled(0);
+    Progress* ptrProgress=NULL;
+    ProgressCallback* ptrProgressCallback=mPtrPCFManager->getProgressCallback();
+    if(ptrProgressCallback!=NULL)
+    {
+        QString title=QObject::tr("Writting files for point cloud: ");
+        QString msgGlobal=mPath;
+        msgGlobal+="\n";
+        msgGlobal+=QString::number(numberOfFiles,10);
+        msgGlobal+=" number of files";
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfFiles);
+    }
+    auto processTasks=[&](bool isCallerThread)
+    {
+        while(canceled.loadAcquire()==0)
+        {
+            int taskPos=nextTask.fetchAndAddOrdered(1);
+            if(taskPos>=numberOfFiles) break;
+            int nf=tasksOrder[taskPos];
+            if(ptrProgress!=NULL
+                    &&ptrProgress->wasCanceled())
+            {
+                filesError[nf]=QObject::tr("Process canceled by user");
+                canceled.storeRelease(1);
+                break;
+            }
+            QString strTaskError;
+            if(!writePointCloudFile(filesIndex[nf],
+                                    inputFilesNames[nf],
+                                    outputFilesNames[nf],
+                                    copyWithoutChanges,
+                                    removedPointsAsWithheld,
+                                    ptrProgress,
+                                    strTaskError))
+            {
+                filesError[nf]=strTaskError;
+                canceled.storeRelease(1);
+                break;
+            }
+            int numberOfProcessed=numberOfProcessedTasks.fetchAndAddOrdered(1)+1;
+            if(ptrProgress!=NULL
+                    &&isCallerThread)
+            {
+                ptrProgress->setValue(numberOfProcessed);
+            }
+        }
+    };
+    // limitado por la lectura y escritura en disco ademas de por los nucleos
+    int numberOfThreads=1;
+    if(mPtrPCFManager->getMultiProcess())
+    {
+        numberOfThreads=qMin(QThread::idealThreadCount(),numberOfFiles);
+        numberOfThreads=qMin(numberOfThreads,POINTCLOUDFILE_WRITE_FILES_MAXIMUM_NUMBER_OF_THREADS);
+    }
+    QVector<QFuture<void> > futures;
+    for(int nt=1;nt<numberOfThreads;nt++)
+    {
+        futures.push_back(QtConcurrent::run([&processTasks](){processTasks(false);}));
+    }
+    processTasks(true);
+    for(int nt=0;nt<futures.size();nt++)
+    {
+        futures[nt].waitForFinished();
+    }
+    if(ptrProgress!=NULL)
+    {
+        ptrProgress->setValue(numberOfFiles);
         delete(ptrProgress);
     }
+    // el primer error en el orden de proceso, los cancelados por este no se informan
+    for(int taskPos=0;taskPos<numberOfFiles;taskPos++)
+    {
+        int nf=tasksOrder[taskPos];
+        if(!filesError[nf].isEmpty())
+        {
+            strError=QObject::tr("PointCloudFile::writePointCloudFiles");
+            strError+=QObject::tr("\nError writing point cloud file:\n%1\nError:\n%2")
+                    .arg(inputFilesNames[nf]).arg(filesError[nf]);
+            return(false);
+        }
+    }
     return(true);
 }
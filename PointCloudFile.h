@@ -11,6 +11,8 @@
 
 //#include <QWaitCondition>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <functional>
 //#include <QtConcurrentRun>
 
 #include <ogrsf_frmts.h>
@@ -20,7 +22,9 @@
 #include <quazip.h>
 #include <JlCompress.h>
 
-class QProgressDialog;
+#include "PointsClassesFile.h"
+#include "PointsEditLog.h"
+#include "PointsFilter.h"
 
 class OGRGeometry;
 //class QuaZip;
@@ -32,6 +36,9 @@ namespace libCRS{
 namespace PCFile{
 class Point;
 class PointCloudFileManager;
+class PointsQuery;
+class Progress;
+class ProgressCallback;
 class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT PointCloudFile
 {
 public:
@@ -63,8 +70,24 @@ public:
                             int pointCloudCrsEpsgCode,
                             bool updateHeader,
                             QString& strError);
+    bool addEditLogCheckpoint(QString name, // estado actual del historial de deshacer
+                              QString& strError);
     bool addROIs(QMap<QString,OGRGeometry*> ptrROIsGeometryByRoiId,
                  QString& strError);
+    bool beginEdit(QString& strError); // updatePoints trabaja en memoria hasta commit o rollback
+    bool buildLevelsOfDetail(bool rebuild, // si no, solo los ficheros que no los tienen
+                             QString& strError);
+    bool buildPointsIndex(bool rebuild, // si no, solo los ficheros que no lo tienen
+                          QString& strError);
+    bool checkpoint(QString& strError); // escribe los cambios pendientes sin cerrar la sesion
+    void clearEditLog();
+    bool commit(QString& strError);
+    bool countPointsInGeometry(QString wktGeometry, // exacto, en los tiles de borde solo se decodifica x,y
+                               int geometryCrsEpsgCode,
+                               QString geometryCrsProj4String,
+                               QVector<QString>& ignoreTilesTableName,
+                               qint64& numberOfPoints,
+                               QString& strError);
     bool create(QString path,
                 int crsEpsgCode,
                 int verticalCrsEpsgCode,
@@ -81,6 +104,12 @@ public:
                 QString projectType,
                 QString projectParametersString,
                 QString& strError);
+    bool estimatePointsInGeometry(QString wktGeometry, // sin leer tiles, por fraccion de area en los de borde
+                                  int geometryCrsEpsgCode,
+                                  QString geometryCrsProj4String,
+                                  QVector<QString>& ignoreTilesTableName,
+                                  qint64& numberOfPoints,
+                                  QString& strError);
     bool exportLasFileFromWktGeometry(QString outputFileName,//las or laz
                                       QString wktGeometry,
                                       int geometryCrsEpsgCode,
@@ -99,6 +128,9 @@ public:
     double getMinimumFc(){return(mMinimumFc);};
     double getMinimumSc(){return(mMinimumSc);};
     double getMinimumTc(){return(mMinimumTc);};
+    void getEditLogCheckpoints(QVector<QString>& checkpoints);
+    void getEditLogNumberOfOperations(int& numberOfUndoOperations,
+                                      int& numberOfRedoOperations);
     bool getNeighbors(QVector<double> point, // 2d o 3d
                       int pointCrsEpsgCode,
                       QString pointCrsProj4String,
@@ -111,6 +143,18 @@ public:
                       QVector<int>& fileIdPoints,
                       QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
                       QString& strError);
+    bool getNeighbors(QVector<QVector<double> > pointsToSearch, // 2d o 3d, todos iguales
+                      int pointCrsEpsgCode,
+                      QString pointCrsProj4String,
+                      double searchRadius2d, // <=0 se usa 100 por la distancia para densidad media
+                      int numberOfNeighbors, // <=0 se devuelven todos
+                      QVector<QVector<PCFile::Point> >& pointsByPointToSearch, // ordenado de cercano a lejano
+                      QVector<QVector<int> >& tilesXByPointToSearch,
+                      QVector<QVector<int> >& tilesYByPointToSearch,
+                      QVector<QVector<double> >& distancesByPointToSearch, // ordenado de cercano a lejano
+                      QVector<QVector<int> >& fileIdPointsByPointToSearch,
+                      QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                      QString& strError);
     bool getPointsFromWktGeometry(QString wktGeometry,
                                   int geometryCrsEpsgCode,
                                   QString geometryCrsProj4String,
@@ -120,6 +164,95 @@ public:
                                   QVector<QString>& ignoreTilesTableName,
                                   bool tilesFullGeometry,
                                   QString& strError);
+    bool getPointsFromWktGeometry(QString wktGeometry,
+                                  int geometryCrsEpsgCode,
+                                  QString geometryCrsProj4String,
+                                  QMap<int,QMap<int,QString> >& tilesTableName,
+                                  QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                                  QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                                  QVector<QString>& ignoreTilesTableName,
+                                  bool tilesFullGeometry,
+                                  PCFile::PointsFilter& pointsFilter,
+                                  QString& strError);
+    bool getPointsFromWktGeometryByLevelOfDetail(QString wktGeometry,
+                                                 int geometryCrsEpsgCode,
+                                                 QString geometryCrsProj4String,
+                                                 qint64 pointsBudget, // <=0 sin limite
+                                                 double spacing, // <=0 sin espaciado objetivo
+                                                 QMap<int,QMap<int,QString> >& tilesTableName,
+                                                 QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                                                 QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                                                 QVector<QString>& ignoreTilesTableName,
+                                                 int& level, // POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS es la resolucion completa
+                                                 QString& strError);
+    bool getPointsInBox(double minX,
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        QString& strError);
+    bool getPointsInBox(double minX,
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        double minZ,
+                        double maxZ,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        QString& strError);
+    bool getPointsInBox(double minX,
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        double minZ,
+                        double maxZ,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        PCFile::PointsFilter& pointsFilter,
+                        QString& strError);
+    bool getPointsInCapsule(QVector<double> firstPoint, // 3d, eje del segmento
+                            QVector<double> secondPoint,
+                            int pointCrsEpsgCode,
+                            QString pointCrsProj4String,
+                            double radius,
+                            int numberOfPoints, // <=0 se devuelven todos
+                            QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                            QVector<int>& tilesX,
+                            QVector<int>& tilesY,
+                            QVector<double>& distances, // ordenado de cercano a lejano
+                            QVector<int>& fileIdPoints,
+                            QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                            QString& strError);
+    bool getPointsInCylinder(QVector<double> center, // 2d
+                             int pointCrsEpsgCode,
+                             QString pointCrsProj4String,
+                             double radius,
+                             double minZ,
+                             double maxZ,
+                             int numberOfPoints, // <=0 se devuelven todos
+                             QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                             QVector<int>& tilesX,
+                             QVector<int>& tilesY,
+                             QVector<double>& distances, // ordenado de cercano a lejano
+                             QVector<int>& fileIdPoints,
+                             QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                             QString& strError);
+    bool getPointsInSphere(QVector<double> center, // 3d
+                           int pointCrsEpsgCode,
+                           QString pointCrsProj4String,
+                           double radius,
+                           int numberOfPoints, // <=0 se devuelven todos
+                           QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                           QVector<int>& tilesX,
+                           QVector<int>& tilesY,
+                           QVector<double>& distances, // ordenado de cercano a lejano
+                           QVector<int>& fileIdPoints,
+                           QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                           QString& strError);
     QString getProjectType(){return(mProjectType);};
     bool getReachedMaximumNumberOfPoints(bool& reachedMaximumNumberOfPoints,
                                          QString& strError);
@@ -146,15 +279,21 @@ public:
                                            QString& strError);
     bool getTilesWktGeometry(QMap<QString, QString> &values,
                              QString& strError);
+    bool isEditing(){return(mEditSession);};
     bool processReclassificationConfusionMatrixReport(QString& fileName,
                                                       QVector<int>& classes,
                                                       QString& strError);
+    bool redo(QString& strError);
+    bool restoreEditLogCheckpoint(QString name,
+                                  QString& strError);
+    bool rollback(QString& strError);
     bool setFromPath(QString path,
                      QString& strError);
     bool setOutputPath(QString value,
                        QString& strError);
     bool setTempPath(QString value,
                      QString& strError);
+    bool undo(QString& strError);
     bool updateNotEdited2dToolsPoints(QString pcfPath,
                                       QMap<int, QMap<int, QVector<int> > > &pointFileIdByTile,
                                       QMap<int, QMap<int, QVector<int> > > &pointPositionByTile,
@@ -169,24 +308,157 @@ public:
 //                      QMap<int, QMap<int, QVector<quint8> > > &pointClassByTile,
                       QMap<quint8,bool>& lockedClasses,
                       QString& strError);
+    bool updatePointsByPredicate(QString strAction, // en todos los tiles
+                                 quint8 classValue,
+                                 PCFile::PointsFilter& pointsFilter, // clases de origen, alturas...
+                                 QMap<quint8,bool>& lockedClasses,
+                                 qint64& numberOfUpdatedPoints,
+                                 QString& strError);
+    bool updatePointsInBox(QString strAction,
+                           quint8 classValue,
+                           double minX,
+                           double minY,
+                           double maxX,
+                           double maxY,
+                           double minZ,
+                           double maxZ,
+                           PCFile::PointsFilter& pointsFilter,
+                           QMap<quint8,bool>& lockedClasses,
+                           qint64& numberOfUpdatedPoints,
+                           QString& strError);
+    bool updatePointsInGeometry(QString strAction,
+                                quint8 classValue,
+                                QString wktGeometry,
+                                int geometryCrsEpsgCode,
+                                QString geometryCrsProj4String,
+                                PCFile::PointsFilter& pointsFilter,
+                                QMap<quint8,bool>& lockedClasses,
+                                qint64& numberOfUpdatedPoints,
+                                QString& strError);
     bool writePointCloudFiles(QString suffix,
                               QString outputPath,
                               QString& strError);
 private:
+    void addEditOperation(PCFile::PointsEditOperation& editOperation);
     bool addTilesFromBoundingBox(int minX,
                                  int minY,
                                  int maxX,
                                  int maxY,
 //                                 QString inputFileName,
                                  QMap<int, QMap<int, int> > &tilesNumberOfPoints,
-                                 QWidget *ptrWidget,
+                                 ProgressCallback* ptrProgressCallback,
                                  QString &strError);
     bool addTileTable(int tileX,
                       int tileY,
                       bool& added,
                       QString &strError);
+    bool applyEditOperation(const PCFile::PointsEditOperation& editOperation, // con mWriteMutex bloqueado
+                            bool undo, // si no, rehacer
+                            QString& strError);
+    bool buildFileLevelsOfDetail(int fileIndex,
+                                 const QVector<double>& spacings,
+                                 QString& strError);
+    bool buildFilePointsIndex(int fileIndex,
+                              QString& strError);
     void clear();
+    bool getEditSessionClassesFile(int fileIndex, // con mEditSessionMutex bloqueado
+                                   PCFile::PointsClassesFile** ptrPtrClassesFile,
+                                   QString& strError);
+    bool getGeometryRingsCoordinates(OGRGeometry* ptrGeometry,
+                                     QVector<QVector<double> >& ringsCoordinates,
+                                     QString& strError);
+    double getGeometryArea(OGRGeometry* ptrGeometry);
+    QVector<double> getEmptyTileStatistics();
+    QVector<double> getLevelsOfDetailSpacings();
+    bool getNumberOfPointsInGeometry(QString wktGeometry,
+                                     int geometryCrsEpsgCode,
+                                     QString geometryCrsProj4String,
+                                     QVector<QString>& ignoreTilesTableName,
+                                     bool exactCount,
+                                     qint64& numberOfPoints,
+                                     QString& strError);
+    bool getPointsFromTiles(QMap<int,QMap<int,QString> >& tilesTableName,
+                            PCFile::PointsQuery& pointsQuery,
+                            QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId,
+                            QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                            QString& strError);
+    bool getPointsInShape(QVector<double> firstPoint, // en el CRS del proyecto
+                          QVector<double> secondPoint,
+                          double radius,
+                          bool verticalCylinder,
+                          int numberOfPoints,
+                          QVector<PCFile::Point>& points,
+                          QVector<int>& tilesX,
+                          QVector<int>& tilesY,
+                          QVector<double>& distances,
+                          QVector<int>& fileIdPoints,
+                          QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                          QString& strError);
+    int getTileCoordinate(double value);
+    bool getTilesBoxBounds(double minX,
+                           double minY,
+                           double maxX,
+                           double maxY,
+                           double minZ,
+                           double maxZ,
+                           QMap<int,QMap<int,QString> >& tilesTableName,
+                           QMap<int,QMap<int,QVector<int> > >& tilesBoxBounds, // tiles sin recorte no se incluyen
+                           QString& strError);
+    bool getTilesPolygonEdgesFromWktGeometry(QString wktGeometry,
+                                             int geometryCrsEpsgCode,
+                                             QString geometryCrsProj4String,
+                                             QVector<QString>& ignoreTilesTableName,
+                                             bool tilesFullGeometry,
+                                             QMap<int,QMap<int,QString> >& tilesTableName,
+                                             QMap<int,QMap<int,QVector<float> > >& tilesPolygonEdges,
+                                             QString& strError);
+    bool getUserCrsDescription(int crsEpsgCode,
+                               QString crsProj4String,
+                               QString& crsDescription,
+                               QString& strError);
+    bool getTilesFromGeometryByGrid(OGRGeometry* ptrGeometry,
+                                    QVector<QString> &ignoreTilesTableName,
+                                    QMap<int, QMap<int, QString> > &tilesTableName,
+                                    QMap<int, QMap<int, bool> > &tilesOverlaps,
+                                    QString &strError);
+    bool linkOrCopyFile(QString inputFileName, // reflink o enlace si es posible, copia si no
+                        QString outputFileName,
+                        bool allowHardLink, // false si la salida se va a modificar
+                        QString& strError);
+    bool patchLasFileClasses(QString inputFileName, // copia y modifica solo los registros cambiados
+                             QString outputFileName,
+                             const QVector<QPair<qint64,quint8> >& pointsClassNewByIndex, // ordenado por indice
+                             bool removedPointsAsWithheld,
+                             PCFile::Progress* ptrProgress,
+                             QString& strError);
+    bool patchLazFileChunks(QString inputFileName, // copia los chunks sin cambios y recomprime el resto
+                            QString outputFileName,
+                            const QVector<QPair<qint64,quint8> >& pointsClassNewByIndex, // ordenado por indice
+                            bool removedPointsAsWithheld,
+                            PCFile::Progress* ptrProgress,
+                            bool& patched, // false si el fichero no lo permite y hay que reescribirlo
+                            QString& strError);
+    bool prepareQueryThinning(PCFile::PointsQuery& pointsQuery, // con los ficheros de clases ya leidos
+                              const QMap<int,QMap<int,QVector<int> > >& tilesByFileIndex,
+                              QString& strError);
     bool readHeader(QString& strError);
+    bool readLevelsOfDetailFile(int fileIndex,
+                                QMap<int,QMap<int,QVector<int> > >& tilesLevelsNumberOfPoints,
+                                QString& strError);
+    bool readOriginalIndexFile(int fileIndex, // vacio si el fichero no existe o es de otra version
+                               QMap<int,QMap<int,QVector<qint64> > >& tilesOriginalIndexRanges,
+                               QString& strError);
+    bool readPointsIndexFile(int fileIndex,
+                             QMap<int,QMap<int,QVector<int> > >& tilesPositions,
+                             QString& strError);
+    bool readClassesFile(int fileIndex, // la copia de la sesion de edicion si existe
+                         PCFile::PointsClassesFile& classesFile,
+                         QString& strError);
+    bool readQueryClassesFile(PCFile::PointsQuery& pointsQuery,
+                              int fileIndex,
+                              const QMap<int,QVector<int> >& tiles,
+                              QMap<QString,bool>& existsFields,
+                              QString& strError);
     bool removeDir(QString dirName,
                    bool onlyContent=false);
     bool removeTile(int tileX,
@@ -196,14 +468,56 @@ private:
                     int tileY,
                     int fileIndex,
                     QString& strError);
+    bool setTilesPolygonEdges(OGRGeometry* ptrGeometry,
+                              QMap<int, QMap<int, bool> > &tilesOverlaps,
+                              QMap<int, QMap<int, QVector<float> > > &tilesPolygonEdges,
+                              QString& strError);
+    bool transformGeometryToProjectCrs(OGRGeometry** ptrPtrGeometry,
+                                       int geometryCrsEpsgCode,
+                                       QString geometryCrsProj4String,
+                                       QString& strError);
+    bool transformPointsToProjectCrs(QVector<QVector<double> >& points,
+                                     int pointCrsEpsgCode,
+                                     QString pointCrsProj4String,
+                                     QString& strError);
+    bool updateClassesFiles(QString title,
+                            const QVector<int>& filesIndex,
+                            std::function<bool(int fileIndex,
+                                               PCFile::PointsClassesFile& classesFile,
+                                               PCFile::PointsEditOperation& editOperation,
+                                               bool& existsChanges,
+                                               QString& strError)> updateFile,
+                            PCFile::PointsEditOperation& editOperation, // cambios publicados
+                            QString& strError);
+    bool updatePointsFromTiles(QString strAction,
+                               quint8 classValue,
+                               QMap<int,QMap<int,QString> >& tilesTableName,
+                               PCFile::PointsQuery& pointsQuery,
+                               QMap<quint8,bool>& lockedClasses,
+                               qint64& numberOfUpdatedPoints,
+                               QString& strError);
+    void updateTileStatistics(QVector<double>& tileStatistics,
+                              int minimumPosition,
+                              double value);
+    bool writeEditSessionClassesFiles(QString& strError);
     bool writeHeader(QString& strError);
+    bool writeOriginalIndexFile(QString fileName,
+                                const QMap<int,QMap<int,QVector<qint64> > >& tilesOriginalIndexRanges,
+                                QString& strError);
+    bool writePointCloudFile(int fileIndex,
+                             QString inputPointCloudFileName,
+                             QString outputPointCloudFileName,
+                             bool copyWithoutChanges,
+                             bool removedPointsAsWithheld,
+                             PCFile::Progress* ptrProgress, // solo para la cancelacion
+                             QString& strError);
+    bool writePointsIndexFile(int fileIndex,
+                              const QMap<int,QMap<int,QVector<int> > >& tilesPositions,
+                              QString& strError);
 
     void mpAddPointCloudFile(QString inputFileName);
     void mpAddTilesGeometry(int tilePos);
     void mpGetTilesWktGeometry(int tilePos);
-    void mpGetTilesFromWktGeometry(int tilePos);
-    void mpGetTilesNamesFromWktGeometry(int tilePos);
-    void mpGetPointsFromWktGeometryByTilePosition(int tilePos);
 
     QString mTempPath;
     QString mOutputPath;
@@ -233,6 +547,9 @@ private:
     QMap<int,QString> mZipFilePathPointsByIndex; // ruta para descomprimir el fichero comprimido
     QMap<int,QString> mZipFilePointsByIndex; // fichero comprimido
     QMap<int,QString> mClassesFileByIndex; // fichero de clases
+    QMap<int,QString> mPointsIndexFileByIndex; // fichero de indice de vecinos, .pci
+    QMap<int,QString> mLevelsOfDetailFileByIndex; // fichero de niveles de detalle, .pcl
+    QMap<int,QString> mOriginalIndexFileByIndex; // fichero de indices en el fichero original, .pco
     int mNewFilesIndex;
 //    QMap<int,OGRGeometry*> mFilePtrGeometryByIndex;
     QMap<int,QMap<int,QString> > mTilesName;
@@ -251,32 +568,27 @@ private:
 //    QuaZip* mPtrZipFile;
 
 //    bool mUseMultiProcess;
-    QProgressDialog* mPtrMpProgressDialog;
-    QString mStrErrorMpProgressDialog;
+    Progress* mPtrMpProgress;
     QMutex mMutex;
-    OGRGeometry* mMpPtrGeometry;
-    QMap<int, QMap<int, QString> > mMpTilesTableName;
-    QMap<int, QMap<int, bool> > mTilesOverlaps;
-    QVector<QString> mMpIgnoreTilesTableName;
+    QMutex mPointsIndexFileMutex;
+    // Las consultas trabajan con mDataLock en lectura. Hay un unico escritor (mWriteMutex) que
+    // prepara los cambios sin bloquear a los lectores y los publica con mDataLock en escritura,
+    // sustituyendo todos los .pcs o, si falla uno, restaurando todos antes de liberarlo;
+    // solo la incorporacion de ficheros y la reconstruccion de metadatos escriben bloqueando.
+    // Orden: mWriteMutex, mEditLogMutex, mDataLock, mEditSessionMutex
+    QReadWriteLock mDataLock;
+    QMutex mWriteMutex;
+    QMutex mTilesWktMutex; // cache de mTilessWkt en getTilesWktGeometry
+    bool mEditSession;
+    QMap<int,PCFile::PointsClassesFile> mEditSessionClassesFileByIndex; // ficheros de clases leidos en la sesion
+    QMap<int,bool> mEditSessionModifiedFileByIndex;
+    QMutex mEditSessionMutex;
+    PointsEditLog mEditLog;
+    QMutex mEditLogMutex; // se toma antes que mEditSessionMutex
+    QMutex mCrsMutex; // cache de CRS de usuario y operaciones con mPtrCrsTools en las consultas
+    QMap<QString,QString> mCrsDescriptionByUserCrs; // epsg#proj4
     QVector<int> mTilesXToProcess;
     QVector<int> mTilesYToProcess;
-    QuaZip mZipFilePoints;
-    QMap<int,QMap<int,int> > mMpTilesNumberOfPointsInFile;
-    QMap<int,QMap<int,QVector<PCFile::Point> > > mPointsByTile;
-    QMap<int,QMap<int,QVector<quint8> > > mTilesPointsClass;
-    QMap<int,QMap<int,QMap<int,quint8> > > mTilesPointsClassNewByPos; // se guarda vacío
-    QMap<int,QMap<int,int> > mTilesNop;
-    bool mTilesFullGeometry;
-    bool mExistsColor;
-    bool mExistsGpsTime;
-    bool mExistsUserData;
-    bool mExistsIntensity;
-    bool mExistsSourceId;
-    bool mExistsNir;
-    bool mExistsReturn;
-    bool mExistsReturns;
-    QString mClassesFileName;
-    QString mZipFileNamePoints;
 
     int mNumberOfFilesToProcess;
     QMap<QString,int> mNumberOfPointsToProcessByFileName;
@@ -4,8 +4,6 @@
 #include <QDateTime>
 #include <QProcessEnvironment>
 #include <QMessageBox>
-#include <QProgressDialog>
-#include <QApplication>
 #include <QtConcurrent>
 #include <qtconcurrentmap.h>
 
@@ -31,6 +29,9 @@ using namespace PCFile;
 
 PointCloudFileManager * PointCloudFileManager::mInstance = 0;
 
+// ProgressCallback de la operacion asincrona que ejecuta cada hilo, NULL fuera de ellas
+static thread_local CancellableProgressCallback* ptrThreadProgressCallback=NULL;
+
 bool PointCloudFileManager::checkInitialize(QString &strError)
 {
     if(mPtrCrsTools==NULL)
@@ -216,6 +217,188 @@ bool PointCloudFileManager::addPointCloudFilesToPointCloudFile(QString pcfPath,
     return(true);
 }
 
+QFuture<OperationResult> PointCloudFileManager::addPointCloudFilesToPointCloudFileAsync(QString pcfPath,
+                                                                                        int crsEpsgCode,
+                                                                                        int verticalCrsEpsgCode,
+                                                                                        QVector<QString> pointCloudFiles,
+                                                                                        CancellationToken cancellationToken)
+{
+    return(QtConcurrent::run([=]() mutable
+    {
+        QMutexLocker locker(&mAsyncWriteMutex);
+        CancellableProgressCallback progressCallback(getProgressCallback(),cancellationToken);
+        ptrThreadProgressCallback=&progressCallback;
+        QString strError;
+        bool success=addPointCloudFilesToPointCloudFile(pcfPath,crsEpsgCode,verticalCrsEpsgCode,
+                                                        pointCloudFiles,strError);
+        ptrThreadProgressCallback=NULL;
+        OperationResult result;
+        setOperationResult(success,strError,cancellationToken,result);
+        return(result);
+    }));
+}
+
+bool PointCloudFileManager::addEditLogCheckpoint(QString pcfPath,
+                                                 QString name,
+                                                 QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::addEditLogCheckpoint");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->addEditLogCheckpoint(name,
+                                                      strError));
+}
+
+bool PointCloudFileManager::beginEdit(QString pcfPath,
+                                      QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::beginEdit");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->beginEdit(strError));
+}
+
+bool PointCloudFileManager::buildLevelsOfDetail(QString pcfPath,
+                                                bool rebuild,
+                                                QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::buildLevelsOfDetail");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->buildLevelsOfDetail(rebuild,
+                                                     strError));
+}
+
+bool PointCloudFileManager::buildPointsIndex(QString pcfPath,
+                                             bool rebuild,
+                                             QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::buildPointsIndex");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->buildPointsIndex(rebuild,
+                                                  strError));
+}
+
+bool PointCloudFileManager::checkpoint(QString pcfPath,
+                                       QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::checkpoint");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->checkpoint(strError));
+}
+
+bool PointCloudFileManager::clearEditLog(QString pcfPath,
+                                         QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::clearEditLog");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    mPtrPcFiles[pcfPath]->clearEditLog();
+    return(true);
+}
+
+bool PointCloudFileManager::commit(QString pcfPath,
+                                   QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::commit");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->commit(strError));
+}
+
+bool PointCloudFileManager::countPointsInGeometry(QString pcfPath,
+                                                  QString wktGeometry,
+                                                  int geometryCrsEpsgCode,
+                                                  QString geometryCrsProj4String,
+                                                  QVector<QString> &ignoreTilesTableName,
+                                                  qint64 &numberOfPoints,
+                                                  QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::countPointsInGeometry");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->countPointsInGeometry(wktGeometry,
+                                                       geometryCrsEpsgCode,
+                                                       geometryCrsProj4String,
+                                                       ignoreTilesTableName,
+                                                       numberOfPoints,
+                                                       strError));
+}
+
 bool PointCloudFileManager::createPointCloudFile(QString pcfPath,
                                                  QString projectType,
                                                  double gridSize,
@@ -501,6 +684,34 @@ bool PointCloudFileManager::createPointCloudFile(QString pcfPath,
     return(true);
 }
 
+bool PointCloudFileManager::estimatePointsInGeometry(QString pcfPath,
+                                                     QString wktGeometry,
+                                                     int geometryCrsEpsgCode,
+                                                     QString geometryCrsProj4String,
+                                                     QVector<QString> &ignoreTilesTableName,
+                                                     qint64 &numberOfPoints,
+                                                     QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::estimatePointsInGeometry");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->estimatePointsInGeometry(wktGeometry,
+                                                          geometryCrsEpsgCode,
+                                                          geometryCrsProj4String,
+                                                          ignoreTilesTableName,
+                                                          numberOfPoints,
+                                                          strError));
+}
+
 bool PointCloudFileManager::exportProcessedPointCloudFiles(QString pcfPath,
                                                            QString suffix,
                                                            QString outputPath,
@@ -564,6 +775,34 @@ bool PointCloudFileManager::exportProcessedPointCloudFiles(QString pcfPath,
     return(true);
 }
 
+QFuture<OperationResult> PointCloudFileManager::exportProcessedPointCloudFilesAsync(QString pcfPath,
+                                                                                    QString suffix,
+                                                                                    QString outputPath,
+                                                                                    CancellationToken cancellationToken)
+{
+    return(QtConcurrent::run([=]() mutable
+    {
+        QMutexLocker locker(&mAsyncWriteMutex);
+        CancellableProgressCallback progressCallback(getProgressCallback(),cancellationToken);
+        ptrThreadProgressCallback=&progressCallback;
+        QString strError;
+        bool success=exportProcessedPointCloudFiles(pcfPath,suffix,outputPath,strError);
+        ptrThreadProgressCallback=NULL;
+        OperationResult result;
+        setOperationResult(success,strError,cancellationToken,result);
+        return(result);
+    }));
+}
+
+CancellationToken PointCloudFileManager::getCancellationToken()
+{
+    if(ptrThreadProgressCallback!=NULL)
+    {
+        return(ptrThreadProgressCallback->getCancellationToken());
+    }
+    return(CancellationToken());
+}
+
 bool PointCloudFileManager::getColorNumberOfBytes(QString pcfPath,
                                                   int &numberOfBytes,
                                                   QString &strError)
@@ -6037,6 +6276,48 @@ bool PointCloudFileManager::getLastoolsCommandStrings(QString &command,
     return(true);
 }
 
+bool PointCloudFileManager::getEditLogCheckpoints(QString pcfPath,
+                                                  QVector<QString> &checkpoints,
+                                                  QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getEditLogCheckpoints");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    mPtrPcFiles[pcfPath]->getEditLogCheckpoints(checkpoints);
+    return(true);
+}
+
+bool PointCloudFileManager::getEditLogNumberOfOperations(QString pcfPath,
+                                                         int &numberOfUndoOperations,
+                                                         int &numberOfRedoOperations,
+                                                         QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getEditLogNumberOfOperations");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    mPtrPcFiles[pcfPath]->getEditLogNumberOfOperations(numberOfUndoOperations,
+                                                       numberOfRedoOperations);
+    return(true);
+}
+
 bool PointCloudFileManager::getMaximumDensity(QString pcfPath,
                                               double &maximumDensity,
                                               QString &strError)
@@ -6122,6 +6403,46 @@ bool PointCloudFileManager::getNeighbors(QString pcfPath,
     return(true);
 }
 
+bool PointCloudFileManager::getNeighbors(QString pcfPath,
+                                         QVector<QVector<double> > pointsToSearch,
+                                         int pointCrsEpsgCode,
+                                         QString pointCrsProj4String,
+                                         double searchRadius2d,
+                                         int numberOfNeighbors,
+                                         QVector<QVector<Point> > &pointsByPointToSearch,
+                                         QVector<QVector<int> > &tilesXByPointToSearch,
+                                         QVector<QVector<int> > &tilesYByPointToSearch,
+                                         QVector<QVector<double> > &distancesByPointToSearch,
+                                         QVector<QVector<int> > &fileIdPointsByPointToSearch,
+                                         QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                         QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getNeighbors");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getNeighbors(pointsToSearch,
+                                              pointCrsEpsgCode,
+                                              pointCrsProj4String,
+                                              searchRadius2d,
+                                              numberOfNeighbors,
+                                              pointsByPointToSearch,
+                                              tilesXByPointToSearch,
+                                              tilesYByPointToSearch,
+                                              distancesByPointToSearch,
+                                              fileIdPointsByPointToSearch,
+                                              existsFieldsByFileId,
+                                              strError));
+}
+
 bool PointCloudFileManager::getPointCloudFile(QString pcfPath,
                                               PointCloudFile** ptrPCFile,
                                               QString& strError)
@@ -6178,6 +6499,366 @@ bool PointCloudFileManager::getPointsFromWktGeometry(QString pcfPath,
     return(true);
 }
 
+bool PointCloudFileManager::getPointsFromWktGeometry(QString pcfPath,
+                                                     QString wktGeometry,
+                                                     int geometryCrsEpsgCode,
+                                                     QString geometryCrsProj4String,
+                                                     QMap<int, QMap<int, QString> > &tilesTableName,
+                                                     QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                                     QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                                     QVector<QString> &ignoreTilesTableName,
+                                                     bool tilesFullGeometry,
+                                                     PointsFilter &pointsFilter,
+                                                     QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsFromWktGeometry");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsFromWktGeometry(wktGeometry,
+                                                          geometryCrsEpsgCode,
+                                                          geometryCrsProj4String,
+                                                          tilesTableName,
+                                                          pointsByTileByFileId,
+                                                          existsFieldsByFileId,
+                                                          ignoreTilesTableName,
+                                                          tilesFullGeometry,
+                                                          pointsFilter,
+                                                          strError));
+}
+
+QFuture<PointsResult> PointCloudFileManager::getPointsFromWktGeometryAsync(QString pcfPath,
+                                                                          QString wktGeometry,
+                                                                          int geometryCrsEpsgCode,
+                                                                          QString geometryCrsProj4String,
+                                                                          QVector<QString> ignoreTilesTableName,
+                                                                          bool tilesFullGeometry,
+                                                                          PointsFilter pointsFilter,
+                                                                          CancellationToken cancellationToken)
+{
+    return(QtConcurrent::run([=]() mutable
+    {
+        PointsResult result;
+        QString strError;
+        {
+            QMutexLocker locker(&mAsyncOpenMutex);
+            if(!mPtrPcFiles.contains(pcfPath))
+            {
+                QString strAuxError;
+                if(!openPointCloudFile(pcfPath,
+                                       strAuxError))
+                {
+                    strError=QObject::tr("PointCloudFileManager::getPointsFromWktGeometryAsync");
+                    strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                            .arg(pcfPath).arg(strAuxError);
+                    result.setFailed(strError);
+                    return(result);
+                }
+            }
+        }
+        CancellableProgressCallback progressCallback(getProgressCallback(),cancellationToken);
+        ptrThreadProgressCallback=&progressCallback;
+        bool success=getPointsFromWktGeometry(pcfPath,wktGeometry,geometryCrsEpsgCode,geometryCrsProj4String,
+                                              result.getTilesTableName(),result.getPointsByTileByFileId(),
+                                              result.getExistsFieldsByFileId(),ignoreTilesTableName,
+                                              tilesFullGeometry,pointsFilter,strError);
+        ptrThreadProgressCallback=NULL;
+        setOperationResult(success,strError,cancellationToken,result);
+        return(result);
+    }));
+}
+
+bool PointCloudFileManager::getPointsFromWktGeometryByLevelOfDetail(QString pcfPath,
+                                                                    QString wktGeometry,
+                                                                    int geometryCrsEpsgCode,
+                                                                    QString geometryCrsProj4String,
+                                                                    qint64 pointsBudget,
+                                                                    double spacing,
+                                                                    QMap<int, QMap<int, QString> > &tilesTableName,
+                                                                    QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                                                    QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                                                    QVector<QString> &ignoreTilesTableName,
+                                                                    int &level,
+                                                                    QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsFromWktGeometryByLevelOfDetail");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsFromWktGeometryByLevelOfDetail(wktGeometry,
+                                                                         geometryCrsEpsgCode,
+                                                                         geometryCrsProj4String,
+                                                                         pointsBudget,
+                                                                         spacing,
+                                                                         tilesTableName,
+                                                                         pointsByTileByFileId,
+                                                                         existsFieldsByFileId,
+                                                                         ignoreTilesTableName,
+                                                                         level,
+                                                                         strError));
+}
+
+bool PointCloudFileManager::getPointsInBox(QString pcfPath,
+                                           double minX,
+                                           double minY,
+                                           double maxX,
+                                           double maxY,
+                                           QMap<int, QMap<int, QString> > &tilesTableName,
+                                           QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                           QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                           QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInBox");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInBox(minX,
+                                                minY,
+                                                maxX,
+                                                maxY,
+                                                tilesTableName,
+                                                pointsByTileByFileId,
+                                                existsFieldsByFileId,
+                                                strError));
+}
+
+bool PointCloudFileManager::getPointsInBox(QString pcfPath,
+                                           double minX,
+                                           double minY,
+                                           double maxX,
+                                           double maxY,
+                                           double minZ,
+                                           double maxZ,
+                                           QMap<int, QMap<int, QString> > &tilesTableName,
+                                           QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                           QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                           QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInBox");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInBox(minX,
+                                                minY,
+                                                maxX,
+                                                maxY,
+                                                minZ,
+                                                maxZ,
+                                                tilesTableName,
+                                                pointsByTileByFileId,
+                                                existsFieldsByFileId,
+                                                strError));
+}
+
+bool PointCloudFileManager::getPointsInBox(QString pcfPath,
+                                           double minX,
+                                           double minY,
+                                           double maxX,
+                                           double maxY,
+                                           double minZ,
+                                           double maxZ,
+                                           QMap<int, QMap<int, QString> > &tilesTableName,
+                                           QMap<int, QMap<int, QMap<int, QVector<Point> > > > &pointsByTileByFileId,
+                                           QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                           PointsFilter &pointsFilter,
+                                           QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInBox");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInBox(minX,
+                                                minY,
+                                                maxX,
+                                                maxY,
+                                                minZ,
+                                                maxZ,
+                                                tilesTableName,
+                                                pointsByTileByFileId,
+                                                existsFieldsByFileId,
+                                                pointsFilter,
+                                                strError));
+}
+
+bool PointCloudFileManager::getPointsInCapsule(QString pcfPath,
+                                               QVector<double> firstPoint,
+                                               QVector<double> secondPoint,
+                                               int pointCrsEpsgCode,
+                                               QString pointCrsProj4String,
+                                               double radius,
+                                               int numberOfPoints,
+                                               QVector<Point> &points,
+                                               QVector<int> &tilesX,
+                                               QVector<int> &tilesY,
+                                               QVector<double> &distances,
+                                               QVector<int> &fileIdPoints,
+                                               QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                               QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInCapsule");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInCapsule(firstPoint,
+                                                    secondPoint,
+                                                    pointCrsEpsgCode,
+                                                    pointCrsProj4String,
+                                                    radius,
+                                                    numberOfPoints,
+                                                    points,
+                                                    tilesX,
+                                                    tilesY,
+                                                    distances,
+                                                    fileIdPoints,
+                                                    existsFieldsByFileId,
+                                                    strError));
+}
+
+bool PointCloudFileManager::getPointsInCylinder(QString pcfPath,
+                                                QVector<double> center,
+                                                int pointCrsEpsgCode,
+                                                QString pointCrsProj4String,
+                                                double radius,
+                                                double minZ,
+                                                double maxZ,
+                                                int numberOfPoints,
+                                                QVector<Point> &points,
+                                                QVector<int> &tilesX,
+                                                QVector<int> &tilesY,
+                                                QVector<double> &distances,
+                                                QVector<int> &fileIdPoints,
+                                                QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                                QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInCylinder");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInCylinder(center,
+                                                     pointCrsEpsgCode,
+                                                     pointCrsProj4String,
+                                                     radius,
+                                                     minZ,
+                                                     maxZ,
+                                                     numberOfPoints,
+                                                     points,
+                                                     tilesX,
+                                                     tilesY,
+                                                     distances,
+                                                     fileIdPoints,
+                                                     existsFieldsByFileId,
+                                                     strError));
+}
+
+bool PointCloudFileManager::getPointsInSphere(QString pcfPath,
+                                              QVector<double> center,
+                                              int pointCrsEpsgCode,
+                                              QString pointCrsProj4String,
+                                              double radius,
+                                              int numberOfPoints,
+                                              QVector<Point> &points,
+                                              QVector<int> &tilesX,
+                                              QVector<int> &tilesY,
+                                              QVector<double> &distances,
+                                              QVector<int> &fileIdPoints,
+                                              QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                                              QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::getPointsInSphere");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->getPointsInSphere(center,
+                                                   pointCrsEpsgCode,
+                                                   pointCrsProj4String,
+                                                   radius,
+                                                   numberOfPoints,
+                                                   points,
+                                                   tilesX,
+                                                   tilesY,
+                                                   distances,
+                                                   fileIdPoints,
+                                                   existsFieldsByFileId,
+                                                   strError));
+}
+
+ProgressCallback *PointCloudFileManager::getProgressCallback()
+{
+    if(ptrThreadProgressCallback!=NULL)
+    {
+        return(ptrThreadProgressCallback);
+    }
+    if(mPtrProgressCallback!=NULL)
+    {
+        return(mPtrProgressCallback);
+    }
+    return(&mDefaultProgressCallback);
+}
+
 bool PointCloudFileManager::getProjectTypes(QVector<QString> &projectTypes,
                                             QString &strError)
 {
@@ -6278,6 +6959,26 @@ bool PointCloudFileManager::getVerticalCRSs(int epsgCode,
     return(true);
 }
 
+bool PointCloudFileManager::isEditing(QString pcfPath,
+                                      bool &editing,
+                                      QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::isEditing");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    editing=mPtrPcFiles[pcfPath]->isEditing();
+    return(true);
+}
+
 bool PointCloudFileManager::initializeCrsTools(QString& strError)
 {
     if(mPtrCrsTools!=NULL)
@@ -6396,7 +7097,7 @@ bool PointCloudFileManager::processInternalCommandVegetationGrowthEstimate(QStri
 {
     outputFileName=outputFileName.trimmed();
     outputPath=outputPath.trimmed();
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=getProgressCallback();
     QString strAuxError;
     if(mInternalCommandsParametersFileName.isEmpty())
     {
@@ -6673,25 +7374,20 @@ bool PointCloudFileManager::processInternalCommandVegetationGrowthEstimate(QStri
     mPICVGEMaxHeightsByTileXYByFilePos.clear();
     if(!useMultiProcess)
     {
-        QProgressDialog* ptrProgress=NULL;
-        if(ptrWidget!=NULL)
+        Progress* ptrProgress=NULL;
+        if(ptrProgressCallback!=NULL)
         {
             QString title=QObject::tr("PointCloudFileManager::processInternalCommandVegetationGrowthEstimate");
             QString msgGlobal=QObject::tr("Reading point cloud files");
             msgGlobal+=QObject::tr("\nNumber of files to read: %1").arg(QString::number(numberOfProcesses));
-            ptrProgress=new QProgressDialog(title, "Abort",0,numberOfProcesses, ptrWidget);
-            ptrProgress->setWindowModality(Qt::WindowModal);
-            ptrProgress->setLabelText(msgGlobal);
-            ptrProgress->show();
-            qApp->processEvents();
+            ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfProcesses);
         }
         for(int nf=0;nf<inputFiles.size();nf++)
         {
             QString inputFileName=inputFiles.at(nf);
-            if(ptrWidget!=NULL)
+            if(ptrProgress!=NULL)
             {
                 ptrProgress->setValue(nf+1);
-                qApp->processEvents();
             }
             std::string stdFileName=inputFileName.toStdString();
             const char* charFileName=stdFileName.c_str();
@@ -6718,21 +7414,17 @@ bool PointCloudFileManager::processInternalCommandVegetationGrowthEstimate(QStri
             boundingBox[2]=fileMaxX;
             boundingBox[3]=fileMaxY;
             mPICVGEBoundingBoxesByFilePos[nf]=boundingBox;
-            QProgressDialog* ptrFileProgress=NULL;
+            Progress* ptrFileProgress=NULL;
             int pointsStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_PROCESS_BY_STEP;
             int numberOfSteps=ceil((double)numberOfPoints/(double)pointsStep);
-            if(ptrWidget!=NULL)
+            if(ptrProgressCallback!=NULL)
             {
                 QString title=QObject::tr("Adding Point Cloud File:");
                 QString msgGlobal=inputFileName;
                 msgGlobal+="\n";
                 msgGlobal+=QString::number(numberOfPoints,10);
                 msgGlobal+=" points";
-                ptrFileProgress=new QProgressDialog(title, "Abort",0,numberOfSteps, ptrWidget);
-                ptrFileProgress->setWindowModality(Qt::WindowModal);
-                ptrFileProgress->setLabelText(msgGlobal);
-                ptrFileProgress->show();
-                qApp->processEvents();
+                ptrFileProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfSteps);
             }
             int pointPosition=-1;
             int step=0;
@@ -6793,48 +7485,39 @@ bool PointCloudFileManager::processInternalCommandVegetationGrowthEstimate(QStri
                         numberOfPointsToProcessInStep=POINTCLOUDFILE_NUMBER_OF_POINTS_TO_PROCESS_BY_STEP;
                     }
                     numberOfProcessedPointsInStep=0;
-                    if(ptrWidget!=NULL)
+                    if(ptrFileProgress!=NULL)
                     {
                         ptrFileProgress->setValue(step);
-                        qApp->processEvents();
                     }
                 }
             }
-            if(ptrWidget!=NULL)
+            if(ptrFileProgress!=NULL)
             {
                 ptrFileProgress->setValue(numberOfProcesses);
-                qApp->processEvents();
-                ptrFileProgress->close();
                 delete(ptrFileProgress);
             }
             lasreader->close();
             delete lasreader;
         }
-        if(ptrWidget!=NULL)
+        if(ptrProgress!=NULL)
         {
             ptrProgress->setValue(numberOfProcesses);
-            qApp->processEvents();
-            ptrProgress->close();
             delete(ptrProgress);
         }
     }
     else
     {
         mInputFiles=inputFiles;
-        if(mPtrMpProgressDialog!=NULL)
+        if(mPtrMpProgress!=NULL)
         {
-            delete(mPtrMpProgressDialog);
+            delete(mPtrMpProgress);
         }
-        if(ptrWidget!=NULL)
-            mPtrMpProgressDialog=new QProgressDialog(ptrWidget);
-        else
-            mPtrMpProgressDialog=new QProgressDialog();
         //        mNumberOfSqlsInTransaction=0;
         mNumberOfFilesToProcess=mInputFiles.size();
         QString dialogText=QObject::tr("Reading point cloud files");
         dialogText+=QObject::tr("\nNumber of point cloud files to read:%1").arg(mNumberOfFilesToProcess);
         dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-        //                mPtrMpProgressDialog->setWindowTitle(title);
+        //                mPtrMpProgress->setWindowTitle(title);
         QVector<int> posFiles;
         mNumberOfPointsToProcessByFileName.clear();
         for(int nf=0;nf<mNumberOfFilesToProcess;nf++)
@@ -6845,28 +7528,24 @@ bool PointCloudFileManager::processInternalCommandVegetationGrowthEstimate(QStri
             mNumberOfPointsToProcessByFileName[inputFileName]=-1;
             posFiles.push_back(nf);
         }
-        mPtrMpProgressDialog->setLabelText(dialogText);
-        mPtrMpProgressDialog->setModal(true);
-        QFutureWatcher<void> futureWatcher;
-        QObject::connect(&futureWatcher, SIGNAL(finished()), mPtrMpProgressDialog, SLOT(reset()));
-        QObject::connect(mPtrMpProgressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-        QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int,int)), mPtrMpProgressDialog, SLOT(setRange(int,int)));
-        QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), mPtrMpProgressDialog, SLOT(setValue(int)));
-        //                futureWatcher.setFuture(QtConcurrent::map(fieldsValuesToRetrieve, mpLoadPhotovoltaicPanelsFromDb));
-        futureWatcher.setFuture(QtConcurrent::map(posFiles,
-                                                  [this](int& data)
-        {mpProcessInternalCommandVegetationGrowthEstimate(data);}));
-        // Display the dialog and start the event loop.
-        mStrErrorMpProgressDialog="";
-        mPtrMpProgressDialog->exec();
-        futureWatcher.waitForFinished();
-        delete(mPtrMpProgressDialog);
-        mPtrMpProgressDialog=NULL;
-        if(!mStrErrorMpProgressDialog.isEmpty())
+        mPtrMpProgress=getProgressCallback()->createProgress(QObject::tr("Reading point cloud files"),
+                                                             dialogText,posFiles.size());
+        QFuture<void> future=QtConcurrent::map(posFiles,
+                                               [this](int& data)
+        {mpProcessInternalCommandVegetationGrowthEstimate(data);});
+        bool finished=mPtrMpProgress->waitForFinished(future);
+        QString strMpError=mPtrMpProgress->getError();
+        if(!finished&&strMpError.isEmpty())
+        {
+            strMpError=QObject::tr("Process canceled by user");
+        }
+        delete(mPtrMpProgress);
+        mPtrMpProgress=NULL;
+        if(!finished)
         {
             strError=QObject::tr("PointCloudFileManager::processInternalCommandVegetationGrowthEstimate");
             strError+=QObject::tr("\nError reading point cloud files");
-            strError+=QObject::tr("\nError:\n%1").arg(mStrErrorMpProgressDialog);
+            strError+=QObject::tr("\nError:\n%1").arg(strMpError);
             reportFile.close();
             return(false);
         }
@@ -7174,6 +7853,62 @@ bool PointCloudFileManager::processReclassificationConfusionMatrixReport(QString
     return(true);
 }
 
+bool PointCloudFileManager::redo(QString pcfPath,
+                                 QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::redo");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->redo(strError));
+}
+
+bool PointCloudFileManager::restoreEditLogCheckpoint(QString pcfPath,
+                                                     QString name,
+                                                     QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::restoreEditLogCheckpoint");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->restoreEditLogCheckpoint(name,
+                                                          strError));
+}
+
+bool PointCloudFileManager::rollback(QString pcfPath,
+                                     QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::rollback");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->rollback(strError));
+}
+
 void PointCloudFileManager::on_ProgressExternalProcessDialog_closed()
 {
     mPtrProgressExternalProcessDialog->setAutoCloseWhenFinish(false);
@@ -8616,7 +9351,7 @@ bool PointCloudFileManager::selectInternalCommandParameters(QString internalComm
 bool PointCloudFileManager::processProjectFile(QString &fileName,
                                              QString &strError)
 {
-    QWidget* ptrWidget=new QWidget();
+    ProgressCallback* ptrProgressCallback=getProgressCallback();
     QString strAuxError;
     if(!checkInitialize(strAuxError))
     {
@@ -8687,16 +9422,12 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
         fileInput.close();
         return(false);
     }
-    QProgressDialog* ptrProgress=NULL;
-    if(ptrWidget!=NULL)
+    Progress* ptrProgress=NULL;
+    if(ptrProgressCallback!=NULL)
     {
         QString title=QObject::tr("PointCloudFileManager::processProjectFile");
         QString msgGlobal=QObject::tr("Number of processes: %1").arg(QString::number(numberOfProcesses));
-        ptrProgress=new QProgressDialog(title, "Abort",0,numberOfProcesses, ptrWidget);
-        ptrProgress->setWindowModality(Qt::WindowModal);
-        ptrProgress->setLabelText(msgGlobal);
-        ptrProgress->show();
-        qApp->processEvents();
+        ptrProgress=ptrProgressCallback->createProgress(title,msgGlobal,numberOfProcesses);
     }
     for(int np=0;np<numberOfProcesses;np++)
     {
@@ -8712,20 +9443,17 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
             strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
             strError+=QObject::tr("\nThere are not two fields separated by %1").arg(POINTCLOUDFILE_PROJECT_STRING_SEPARATOR);
             fileInput.close();
-            if(ptrWidget!=NULL)
+            if(ptrProgress!=NULL)
             {
                 ptrProgress->setValue(numberOfProcesses);
-                qApp->processEvents();
-                ptrProgress->close();
                 delete(ptrProgress);
             }
             return(false);
         }
         QString processType=strList.at(1).trimmed();
-        if(ptrWidget!=NULL)
+        if(ptrProgress!=NULL)
         {
             ptrProgress->setValue(np+1);
-            qApp->processEvents();
         }
         if(processType.compare(POINTCLOUDFILE_PROCESS_CREATE_POINT_CLOUD_FILE_TAG)==0)
         {
@@ -8736,11 +9464,9 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
                 strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
                 strError+=QObject::tr("\nError in process create point cloud file:\n%1").arg(strAuxError);
                 fileInput.close();
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(numberOfProcesses);
-                    qApp->processEvents();
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
@@ -8755,7 +9481,7 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
 //                strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
 //                strError+=QObject::tr("\nError adding point cloud file:\n%1").arg(strAuxError);
 //                fileInput.close();
-//                if(ptrWidget!=NULL)
+//                if(ptrProgress!=NULL)
 //                {
 //                    ptrProgress->setValue(numberOfProcesses);
 //                    qApp->processEvents();
@@ -8774,11 +9500,9 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
                 strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
                 strError+=QObject::tr("\nError adding point cloud file:\n%1").arg(strAuxError);
                 fileInput.close();
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(numberOfProcesses);
-                    qApp->processEvents();
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
@@ -8793,11 +9517,9 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
                 strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
                 strError+=QObject::tr("\nError adding ROI:\n%1").arg(strAuxError);
                 fileInput.close();
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(numberOfProcesses);
-                    qApp->processEvents();
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
@@ -8812,11 +9534,9 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
                 strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
                 strError+=QObject::tr("\nError in process create database:\n%1").arg(strAuxError);
                 fileInput.close();
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(numberOfProcesses);
-                    qApp->processEvents();
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
@@ -8831,22 +9551,18 @@ bool PointCloudFileManager::processProjectFile(QString &fileName,
                 strError+=QObject::tr("\nError reading line: %1").arg(QString::number(nline));
                 strError+=QObject::tr("\nError in process create database:\n%1").arg(strAuxError);
                 fileInput.close();
-                if(ptrWidget!=NULL)
+                if(ptrProgress!=NULL)
                 {
                     ptrProgress->setValue(numberOfProcesses);
-                    qApp->processEvents();
-                    ptrProgress->close();
                     delete(ptrProgress);
                 }
                 return(false);
             }
         }
     }
-    if(ptrWidget!=NULL)
+    if(ptrProgress!=NULL)
     {
         ptrProgress->setValue(numberOfProcesses);
-        qApp->processEvents();
-        ptrProgress->close();
         delete(ptrProgress);
     }
     fileInput.close();
@@ -9543,6 +10259,25 @@ bool PointCloudFileManager::setOutputPath(QString value,
     return(true);
 }
 
+void PointCloudFileManager::setOperationResult(bool success,
+                                               QString strError,
+                                               const CancellationToken &cancellationToken,
+                                               OperationResult &result)
+{
+    if(success)
+    {
+        result.setSuccess();
+    }
+    else if(cancellationToken.isCanceled())
+    {
+        result.setCanceled(strError);
+    }
+    else
+    {
+        result.setFailed(strError);
+    }
+}
+
 bool PointCloudFileManager::setProjectsParametersManager(QString projectType,
                                                        QString &strError)
 {
@@ -9654,6 +10389,24 @@ bool PointCloudFileManager::updateNotEdited2dToolsPoints(QString pcfPath,
                                               strError));
 }
 
+bool PointCloudFileManager::undo(QString pcfPath,
+                                 QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::undo");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->undo(strError));
+}
+
 bool PointCloudFileManager::updatePoints(QString pcfPath,
                                          QString strAction,
                                          quint8 classValue,
@@ -9686,6 +10439,131 @@ bool PointCloudFileManager::updatePoints(QString pcfPath,
                                               strError));
 }
 
+QFuture<OperationResult> PointCloudFileManager::updatePointsAsync(QString pcfPath,
+                                                                  QString strAction,
+                                                                  quint8 classValue,
+                                                                  QMap<int, QMap<int, QVector<int> > > pointFileIdByTile,
+                                                                  QMap<int, QMap<int, QVector<int> > > pointPositionByTile,
+                                                                  QMap<quint8, bool> lockedClasses,
+                                                                  CancellationToken cancellationToken)
+{
+    return(QtConcurrent::run([=]() mutable
+    {
+        QMutexLocker locker(&mAsyncWriteMutex);
+        CancellableProgressCallback progressCallback(getProgressCallback(),cancellationToken);
+        ptrThreadProgressCallback=&progressCallback;
+        QString strError;
+        bool success=updatePoints(pcfPath,strAction,classValue,pointFileIdByTile,
+                                  pointPositionByTile,lockedClasses,strError);
+        ptrThreadProgressCallback=NULL;
+        OperationResult result;
+        setOperationResult(success,strError,cancellationToken,result);
+        return(result);
+    }));
+}
+
+bool PointCloudFileManager::updatePointsByPredicate(QString pcfPath,
+                                                    QString strAction,
+                                                    quint8 classValue,
+                                                    PointsFilter &pointsFilter,
+                                                    QMap<quint8, bool> &lockedClasses,
+                                                    qint64 &numberOfUpdatedPoints,
+                                                    QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::updatePointsByPredicate");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->updatePointsByPredicate(strAction,
+                                                         classValue,
+                                                         pointsFilter,
+                                                         lockedClasses,
+                                                         numberOfUpdatedPoints,
+                                                         strError));
+}
+
+bool PointCloudFileManager::updatePointsInBox(QString pcfPath,
+                                              QString strAction,
+                                              quint8 classValue,
+                                              double minX,
+                                              double minY,
+                                              double maxX,
+                                              double maxY,
+                                              double minZ,
+                                              double maxZ,
+                                              PointsFilter &pointsFilter,
+                                              QMap<quint8, bool> &lockedClasses,
+                                              qint64 &numberOfUpdatedPoints,
+                                              QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::updatePointsInBox");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->updatePointsInBox(strAction,
+                                                   classValue,
+                                                   minX,
+                                                   minY,
+                                                   maxX,
+                                                   maxY,
+                                                   minZ,
+                                                   maxZ,
+                                                   pointsFilter,
+                                                   lockedClasses,
+                                                   numberOfUpdatedPoints,
+                                                   strError));
+}
+
+bool PointCloudFileManager::updatePointsInGeometry(QString pcfPath,
+                                                   QString strAction,
+                                                   quint8 classValue,
+                                                   QString wktGeometry,
+                                                   int geometryCrsEpsgCode,
+                                                   QString geometryCrsProj4String,
+                                                   PointsFilter &pointsFilter,
+                                                   QMap<quint8, bool> &lockedClasses,
+                                                   qint64 &numberOfUpdatedPoints,
+                                                   QString &strError)
+{
+    QString strAuxError;
+    if(!mPtrPcFiles.contains(pcfPath))
+    {
+        if(!openPointCloudFile(pcfPath,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointCloudFileManager::updatePointsInGeometry");
+            strError+=QObject::tr("\nError openning spatialite:\n%1\nError:\n%2")
+                    .arg(pcfPath).arg(strAuxError);
+            return(false);
+        }
+    }
+    return(mPtrPcFiles[pcfPath]->updatePointsInGeometry(strAction,
+                                                        classValue,
+                                                        wktGeometry,
+                                                        geometryCrsEpsgCode,
+                                                        geometryCrsProj4String,
+                                                        pointsFilter,
+                                                        lockedClasses,
+                                                        numberOfUpdatedPoints,
+                                                        strError));
+}
+
 bool PointCloudFileManager::validateProjectParametersString(QString projectType,
                                                             QString projectParametersString,
                                                             QString &strError)
@@ -9875,8 +10753,7 @@ void PointCloudFileManager::mpProcessInternalCommandVegetationGrowthEstimate(int
     {
         strError=QObject::tr("PointCloudFileManager::mpProcessInternalCommandVegetationGrowthEstimate");
         strError+=QObject::tr("\nError opening file:\n%1").arg(inputFileName);
-        mStrErrorMpProgressDialog=strError;
-        emit(mPtrMpProgressDialog->canceled());
+        mPtrMpProgress->setError(strError);
         return;
     }
 
@@ -9923,8 +10800,7 @@ void PointCloudFileManager::mpProcessInternalCommandVegetationGrowthEstimate(int
                 strError+=QObject::tr("\ncoordinates increments out of 16 bits domain for point: (%1,%2)")
                         .arg(QString::number(x,'f',3)).arg(QString::number(y,'f',3));
                 lasreader->close();
-                mStrErrorMpProgressDialog=strError;
-                emit(mPtrMpProgressDialog->canceled());
+                mPtrMpProgress->setError(strError);
                 return;
             }
             mMutex.lock();
@@ -9962,7 +10838,7 @@ void PointCloudFileManager::mpProcessInternalCommandVegetationGrowthEstimate(int
 //            QString dialogText=QObject::tr("Reading point cloud files");
 //            dialogText+=QObject::tr("\nNumber of point cloud files to read:%1").arg(mNumberOfFilesToProcess);
 //            dialogText+=QObject::tr("\n... progressing using %1 threads").arg(QThread::idealThreadCount());
-//    //                mPtrMpProgressDialog->setWindowTitle(title);
+//    //                mPtrMpProgress->setWindowTitle(title);
 //            QMap<QString,int>::iterator iter=mNumberOfPointsToProcessByFileName.begin();
 //            while(iter!=mNumberOfPointsToProcessByFileName.end())
 //            {
@@ -9977,7 +10853,7 @@ void PointCloudFileManager::mpProcessInternalCommandVegetationGrowthEstimate(int
 //                        .arg(strNumberOfPointsToProcess).arg(auxInputFileName);
 //                iter++;
 //            }
-//            mPtrMpProgressDialog->setLabelText(dialogText);
+//            mPtrMpProgress->setLabelText(dialogText);
             mMutex.unlock();
         }
     }
@@ -7,10 +7,13 @@
 #include <QTextStream>
 #include <QDateTime>
 #include <QMutex>
-#include <QProgressDialog>
+#include <QFuture>
 
 #include "PointCloudFileDefinitions.h"
+#include "OperationResult.h"
 #include "Point.h"
+#include "PointsFilter.h"
+#include "ProgressCallback.h"
 
 #include "libPointCloudFileManager_global.h"
 
@@ -38,7 +41,8 @@ public:
         mPtrLastoolsCommandsParameters=NULL;
         mPtrInternalCommandsParameters=NULL;
         mPtrProgressExternalProcessDialog=NULL;
-        mPtrMpProgressDialog=NULL;
+        mPtrMpProgress=NULL;
+        mPtrProgressCallback=NULL;
         mPtrControlROIs=NULL;
 //        mGridSizes.push_back(POINTCLOUDFILE_PROJECT_GRID_SIZE_1);
         mGridSizes.push_back(POINTCLOUDFILE_PROJECT_GRID_SIZE_5);
@@ -49,6 +53,7 @@ public:
 //        mGridSizes.push_back(POINTCLOUDFILE_PROJECT_GRID_SIZE_200);
         mMaxGridSize=mGridSizes[mGridSizes.size()-1];
         mUseMultiProcess=false;
+        mRemovedPointsAsWithheld=false;
         mMaximumNumberOfPoints=POINTCLOUDFILE_WITHOUT_MAXIMUM_NUMBER_OF_POINTS_LIMITS;
         setProjectTypes();
     };
@@ -67,6 +72,46 @@ public:
                                             bool altitudeIsMsl,
                                             QVector<QString> &pointCloudFiles,
                                             QString& strError);
+    // Las variantes Async ejecutan la operacion en el pool de hilos de Qt. El token se consulta
+    // entre ficheros y tiles; add, update y export asincronos se ejecutan de uno en uno.
+    // Las consultas de un proyecto pueden ejecutarse a la vez que una edicion, ven las clases
+    // anteriores o posteriores a cada actualizacion completa
+    QFuture<OperationResult> addPointCloudFilesToPointCloudFileAsync(QString pcfPath,
+                                                                     int crsEpsgCode,
+                                                                     int verticalCrsEpsgCode,
+                                                                     QVector<QString> pointCloudFiles,
+                                                                     CancellationToken cancellationToken=CancellationToken());
+    // Historial de deshacer/rehacer de las ediciones de clases del proyecto, en memoria y con
+    // puntos de control con nombre. Se descarta con rollback de una sesion de edicion
+    bool addEditLogCheckpoint(QString pcfPath,
+                              QString name,
+                              QString& strError);
+    // Sesion de edicion: updatePoints modifica las clases en memoria, checkpoint y commit las escriben
+    // en los ficheros .pcs, rollback descarta lo no escrito. Las consultas ven los cambios pendientes
+    bool beginEdit(QString pcfPath,
+                   QString& strError);
+    // Niveles de detalle por tile para consultas de visualizacion, fichero .pcl por fichero de puntos
+    bool buildLevelsOfDetail(QString pcfPath,
+                             bool rebuild,
+                             QString& strError);
+    // Indice de vecinos por tile para getNeighbors, fichero .pci por fichero de puntos
+    bool buildPointsIndex(QString pcfPath,
+                          bool rebuild,
+                          QString& strError);
+    bool checkpoint(QString pcfPath,
+                    QString& strError);
+    bool clearEditLog(QString pcfPath,
+                      QString& strError);
+    bool commit(QString pcfPath,
+                QString& strError);
+    // Numero de puntos sin recuperarlos: count exacto, estimate solo con la informacion de los tiles
+    bool countPointsInGeometry(QString pcfPath,
+                               QString wktGeometry,
+                               int geometryCrsEpsgCode,
+                               QString geometryCrsProj4String,
+                               QVector<QString>& ignoreTilesTableName,
+                               qint64& numberOfPoints,
+                               QString& strError);
     bool createPointCloudFile(QString pcfPath,
                               QString projectType,
                               double gridSize,
@@ -81,11 +126,23 @@ public:
                               bool altitudeIsMsl,
                               QVector<QString> &roisShapefiles,
                               QString& strError);
+    bool estimatePointsInGeometry(QString pcfPath,
+                                  QString wktGeometry,
+                                  int geometryCrsEpsgCode,
+                                  QString geometryCrsProj4String,
+                                  QVector<QString>& ignoreTilesTableName,
+                                  qint64& numberOfPoints,
+                                  QString& strError);
     bool exportProcessedPointCloudFiles(QString pcfPath,
                                         QString suffix,
                                         QString outputPath,
                                         QString& strError);
+    QFuture<OperationResult> exportProcessedPointCloudFilesAsync(QString pcfPath,
+                                                                 QString suffix,
+                                                                 QString outputPath,
+                                                                 CancellationToken cancellationToken=CancellationToken());
     QString getBasePath(){return(mBasePath);};
+    CancellationToken getCancellationToken(); // de la operacion asincrona que ejecuta el hilo llamante
     bool getColorNumberOfBytes(QString pcfPath,
                                int& numberOfBytes,
                                QString& strError);
@@ -122,6 +179,13 @@ public:
                                    QString& prefix,
                                    QVector<QString> &lastoolsCommandStrings,
                                    QString& strError);
+    bool getEditLogCheckpoints(QString pcfPath,
+                               QVector<QString>& checkpoints,
+                               QString& strError);
+    bool getEditLogNumberOfOperations(QString pcfPath,
+                                      int& numberOfUndoOperations,
+                                      int& numberOfRedoOperations,
+                                      QString& strError);
     bool getMaximumDensity(QString pcfPath,
                            double &maximumDensity,
                            QString& strError);
@@ -144,6 +208,19 @@ public:
                       QVector<int> &fileIdPoints,
                       QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
                       QString& strError);
+    bool getNeighbors(QString pcfPath,
+                      QVector<QVector<double> > pointsToSearch, // 2d o 3d, todos iguales
+                      int pointCrsEpsgCode,
+                      QString pointCrsProj4String,
+                      double searchRadius2d, // <=0 se usa 100 por la distancia para densidad media
+                      int numberOfNeighbors, // <=0 se devuelven todos
+                      QVector<QVector<PCFile::Point> >& pointsByPointToSearch, // ordenado de cercano a lejano
+                      QVector<QVector<int> > &tilesXByPointToSearch,
+                      QVector<QVector<int> > &tilesYByPointToSearch,
+                      QVector<QVector<double> >& distancesByPointToSearch, // ordenado de cercano a lejano
+                      QVector<QVector<int> > &fileIdPointsByPointToSearch,
+                      QMap<int, QMap<QString, bool> > &existsFieldsByFileId,
+                      QString& strError);
     bool getPointCloudFile(QString pcfPath,
                            PointCloudFile** ptrPCFile,
                            QString& strError);
@@ -157,8 +234,115 @@ public:
                                   QVector<QString>& ignoreTilesTableName,
                                   bool tilesFullGeometry,
                                   QString& strError);
+    bool getPointsFromWktGeometry(QString pcfPath,
+                                  QString wktGeometry,
+                                  int geometryCrsEpsgCode,
+                                  QString geometryCrsProj4String,
+                                  QMap<int,QMap<int,QString> >& tilesTableName,
+                                  QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                                  QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                                  QVector<QString>& ignoreTilesTableName,
+                                  bool tilesFullGeometry,
+                                  PCFile::PointsFilter& pointsFilter,
+                                  QString& strError);
+    QFuture<PointsResult> getPointsFromWktGeometryAsync(QString pcfPath,
+                                                        QString wktGeometry,
+                                                        int geometryCrsEpsgCode,
+                                                        QString geometryCrsProj4String,
+                                                        QVector<QString> ignoreTilesTableName,
+                                                        bool tilesFullGeometry,
+                                                        PCFile::PointsFilter pointsFilter,
+                                                        CancellationToken cancellationToken=CancellationToken());
+    bool getPointsFromWktGeometryByLevelOfDetail(QString pcfPath,
+                                                 QString wktGeometry,
+                                                 int geometryCrsEpsgCode,
+                                                 QString geometryCrsProj4String,
+                                                 qint64 pointsBudget, // <=0 sin limite
+                                                 double spacing, // <=0 sin espaciado objetivo
+                                                 QMap<int,QMap<int,QString> >& tilesTableName,
+                                                 QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                                                 QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                                                 QVector<QString>& ignoreTilesTableName,
+                                                 int& level,
+                                                 QString& strError);
+    bool getPointsInBox(QString pcfPath,
+                        double minX, // coordenadas en el CRS del proyecto
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        QString& strError);
+    bool getPointsInBox(QString pcfPath,
+                        double minX, // coordenadas en el CRS del proyecto
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        double minZ,
+                        double maxZ,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        QString& strError);
+    bool getPointsInBox(QString pcfPath,
+                        double minX, // coordenadas en el CRS del proyecto
+                        double minY,
+                        double maxX,
+                        double maxY,
+                        double minZ,
+                        double maxZ,
+                        QMap<int,QMap<int,QString> >& tilesTableName,
+                        QMap<int, QMap<int, QMap<int, QVector<PCFile::Point> > > > &pointsByTileByFileId, //[fileId][tileX][tileY]
+                        QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                        PCFile::PointsFilter& pointsFilter,
+                        QString& strError);
+    bool getPointsInCapsule(QString pcfPath,
+                            QVector<double> firstPoint, // 3d, eje del segmento
+                            QVector<double> secondPoint,
+                            int pointCrsEpsgCode,
+                            QString pointCrsProj4String,
+                            double radius,
+                            int numberOfPoints, // <=0 se devuelven todos
+                            QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                            QVector<int>& tilesX,
+                            QVector<int>& tilesY,
+                            QVector<double>& distances, // ordenado de cercano a lejano
+                            QVector<int>& fileIdPoints,
+                            QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                            QString& strError);
+    bool getPointsInCylinder(QString pcfPath,
+                             QVector<double> center, // 2d
+                             int pointCrsEpsgCode,
+                             QString pointCrsProj4String,
+                             double radius,
+                             double minZ,
+                             double maxZ,
+                             int numberOfPoints, // <=0 se devuelven todos
+                             QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                             QVector<int>& tilesX,
+                             QVector<int>& tilesY,
+                             QVector<double>& distances, // ordenado de cercano a lejano
+                             QVector<int>& fileIdPoints,
+                             QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                             QString& strError);
+    bool getPointsInSphere(QString pcfPath,
+                           QVector<double> center, // 3d
+                           int pointCrsEpsgCode,
+                           QString pointCrsProj4String,
+                           double radius,
+                           int numberOfPoints, // <=0 se devuelven todos
+                           QVector<PCFile::Point>& points, // ordenado de cercano a lejano
+                           QVector<int>& tilesX,
+                           QVector<int>& tilesY,
+                           QVector<double>& distances, // ordenado de cercano a lejano
+                           QVector<int>& fileIdPoints,
+                           QMap<int,QMap<QString,bool> >& existsFieldsByFileId,
+                           QString& strError);
+    ProgressCallback* getProgressCallback();
     bool getProjectTypes(QVector<QString>& projectTypes,
                          QString& strError);
+    bool getRemovedPointsAsWithheld(){return(mRemovedPointsAsWithheld);};
     bool getReachedMaximumNumberOfPoints(QString pcfPath,
                                          bool& reachedMaximumNumberOfPoints,
                                          QString& strError);
@@ -178,6 +362,9 @@ public:
                          QVector<int>& verticalCRSs,
                          QString& strError);
     bool initializeCrsTools(QString &strError);
+    bool isEditing(QString pcfPath,
+                   bool& editing,
+                   QString& strError);
     bool openPointCloudFile(QString pcPath,
                             QString& strError);
     bool processInternalCommand(QString& command,
@@ -200,6 +387,13 @@ public:
                                                       QString& strError);
     bool processProjectFile(QString& fileName,
                             QString& strError);
+    bool redo(QString pcfPath,
+              QString& strError);
+    bool restoreEditLogCheckpoint(QString pcfPath,
+                                  QString name,
+                                  QString& strError);
+    bool rollback(QString pcfPath,
+                  QString& strError);
     bool runProcessList(QVector<QString>& processList,
                         QString title,
                         QString& strError,
@@ -212,6 +406,7 @@ public:
                           QString& strError);
     bool setBasePath(QString basePath, QString &strError);
     void setCrsTools(libCRS::CRSTools* ptrCrsTools){mPtrCrsTools=ptrCrsTools;}
+    void setProgressCallback(ProgressCallback* ptrProgressCallback){mPtrProgressCallback=ptrProgressCallback;}; // no se libera, NULL recupera el de defecto
     bool setGeoidFilesLastoolsPath(QString value,
                                QString& strError);
     bool setControlROIs(ControlROIs* ptrILicenseManager,
@@ -222,8 +417,11 @@ public:
                          QString& strError);
     bool setOutputPath(QString value,
                        QString& strError);
+    void setRemovedPointsAsWithheld(bool value){mRemovedPointsAsWithheld=value;}; // al exportar, los puntos eliminados se marcan como withheld en lugar de suprimirse
     bool setTempPath(QString value,
                      QString& strError);
+    bool undo(QString pcfPath,
+              QString& strError);
     bool updateNotEdited2dToolsPoints(QString pcfPath,
                                       QMap<int, QMap<int, QVector<int> > > &pointFileIdByTile,
                                       QMap<int, QMap<int, QVector<int> > > &pointPositionByTile,
@@ -239,6 +437,45 @@ public:
 //                      QMap<int, QMap<int, QVector<quint8> > > &pointClassByTile,
                       QMap<quint8,bool>& lockedClasses,
                       QString& strError);
+    QFuture<OperationResult> updatePointsAsync(QString pcfPath,
+                                               QString strAction,
+                                               quint8 classValue,
+                                               QMap<int, QMap<int, QVector<int> > > pointFileIdByTile,
+                                               QMap<int, QMap<int, QVector<int> > > pointPositionByTile,
+                                               QMap<quint8,bool> lockedClasses,
+                                               CancellationToken cancellationToken=CancellationToken());
+    // Reclasificacion en la libreria, sin recuperar los puntos: accion de updatePoints sobre los
+    // que cumplen el filtro (clases de origen, rango de alturas...) en una geometria, caja o en todo
+    bool updatePointsByPredicate(QString pcfPath,
+                                 QString strAction,
+                                 quint8 classValue,
+                                 PCFile::PointsFilter& pointsFilter,
+                                 QMap<quint8,bool>& lockedClasses,
+                                 qint64& numberOfUpdatedPoints,
+                                 QString& strError);
+    bool updatePointsInBox(QString pcfPath,
+                           QString strAction,
+                           quint8 classValue,
+                           double minX,
+                           double minY,
+                           double maxX,
+                           double maxY,
+                           double minZ,
+                           double maxZ,
+                           PCFile::PointsFilter& pointsFilter,
+                           QMap<quint8,bool>& lockedClasses,
+                           qint64& numberOfUpdatedPoints,
+                           QString& strError);
+    bool updatePointsInGeometry(QString pcfPath,
+                                QString strAction,
+                                quint8 classValue,
+                                QString wktGeometry,
+                                int geometryCrsEpsgCode,
+                                QString geometryCrsProj4String,
+                                PCFile::PointsFilter& pointsFilter,
+                                QMap<quint8,bool>& lockedClasses,
+                                qint64& numberOfUpdatedPoints,
+                                QString& strError);
     int getMaximumNumberOfPoints(){return(mMaximumNumberOfPoints);};
     void setMaximumNumberOfPoints(int maximumNumberOfPoints){mMaximumNumberOfPoints=maximumNumberOfPoints;};
 
@@ -270,6 +507,10 @@ private:
                                    QString& strError);
     bool removeDir(QString dirName,
                    bool onlyContent=false);
+    void setOperationResult(bool success,
+                            QString strError,
+                            const CancellationToken& cancellationToken,
+                            OperationResult& result);
     bool setProjectsParametersManager(QString projectType,
                                       QString& strError);
     void setProjectTypes();
@@ -309,13 +550,17 @@ private:
     QVector<int> mGridSizes;
     int mMaxGridSize;
     bool mUseMultiProcess;
+    bool mRemovedPointsAsWithheld;
 
     QMutex mMutex;
     int mNumberOfFilesToProcess;
     QMap<QString,int> mNumberOfPointsToProcessByFileName;
     QVector<QString> mInputFiles;
-    QProgressDialog* mPtrMpProgressDialog;
-    QString mStrErrorMpProgressDialog;
+    Progress* mPtrMpProgress;
+    ProgressCallback* mPtrProgressCallback;
+    ProgressDialogCallback mDefaultProgressCallback;
+    QMutex mAsyncOpenMutex;  // apertura de ficheros desde operaciones asincronas
+    QMutex mAsyncWriteMutex; // add, update y export asincronos
 
     int mPICVGESpatialResolution;
     QMap<int,QVector<double> > mPICVGEBoundingBoxesByFilePos;
@@ -0,0 +1,72 @@
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QObject>
+
+#include "PointsClassesFile.h"
+
+using namespace PCFile;
+
+PointsClassesFile::PointsClassesFile()
+{
+
+}
+
+void PointsClassesFile::clear()
+{
+    mExistsFields.clear();
+    mTilesNop.clear();
+    mTilesPointsClass.clear();
+    mTilesPointsClassNewByPos.clear();
+    mTilesStatistics.clear();
+}
+
+bool PointsClassesFile::read(QString fileName,
+                             QString &strError)
+{
+    clear();
+    QFile pointsClassFile(fileName);
+    if (!pointsClassFile.open(QIODevice::ReadOnly))
+    {
+        strError=QObject::tr("PointsClassesFile::read");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(fileName);
+        return(false);
+    }
+    QDataStream inPointsClass(&pointsClassFile);
+    inPointsClass>>mTilesNop;
+    inPointsClass>>mExistsFields;
+    inPointsClass>>mTilesPointsClass;
+    inPointsClass>>mTilesPointsClassNewByPos;
+    if(!inPointsClass.atEnd()) // ficheros anteriores sin estadisticas
+    {
+        inPointsClass>>mTilesStatistics;
+    }
+    pointsClassFile.close();
+    return(true);
+}
+
+bool PointsClassesFile::write(QString fileName,
+                              QString &strError) const
+{
+    // se escribe a un temporal que sustituye al fichero solo si todo ha ido bien
+    QSaveFile pointsClassFile(fileName);
+    if (!pointsClassFile.open(QIODevice::WriteOnly))
+    {
+        strError=QObject::tr("PointsClassesFile::write");
+        strError+=QObject::tr("\nError opening file:\n%1").arg(fileName);
+        return(false);
+    }
+    QDataStream outPointsClass(&pointsClassFile);
+    outPointsClass<<mTilesNop;
+    outPointsClass<<mExistsFields;
+    outPointsClass<<mTilesPointsClass;
+    outPointsClass<<mTilesPointsClassNewByPos;
+    outPointsClass<<mTilesStatistics;
+    if(!pointsClassFile.commit())
+    {
+        strError=QObject::tr("PointsClassesFile::write");
+        strError+=QObject::tr("\nError writing file:\n%1").arg(fileName);
+        return(false);
+    }
+    return(true);
+}
@@ -0,0 +1,40 @@
+#ifndef POINTSCLASSESFILE_H
+#define POINTSCLASSESFILE_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+
+namespace PCFile{
+
+// Contenido de un fichero de clases (.pcs): numero de puntos por tile, campos existentes,
+// clase original por posicion, clase editada solo de las posiciones modificadas y
+// estadisticas por tile. Los metodos get devuelven referencias para editar sin copias.
+class PointsClassesFile
+{
+public:
+    PointsClassesFile();
+    void clear();
+    const QMap<QString,bool>& getExistsFields() const{return(mExistsFields);};
+    QMap<QString,bool>& getExistsFields(){return(mExistsFields);};
+    const QMap<int,QMap<int,int> >& getTilesNop() const{return(mTilesNop);};
+    QMap<int,QMap<int,int> >& getTilesNop(){return(mTilesNop);};
+    const QMap<int,QMap<int,QVector<quint8> > >& getTilesPointsClass() const{return(mTilesPointsClass);};
+    QMap<int,QMap<int,QVector<quint8> > >& getTilesPointsClass(){return(mTilesPointsClass);};
+    const QMap<int,QMap<int,QMap<int,quint8> > >& getTilesPointsClassNewByPos() const{return(mTilesPointsClassNewByPos);};
+    QMap<int,QMap<int,QMap<int,quint8> > >& getTilesPointsClassNewByPos(){return(mTilesPointsClassNewByPos);};
+    const QMap<int,QMap<int,QVector<double> > >& getTilesStatistics() const{return(mTilesStatistics);};
+    QMap<int,QMap<int,QVector<double> > >& getTilesStatistics(){return(mTilesStatistics);};
+    bool read(QString fileName,
+              QString& strError);
+    bool write(QString fileName,
+               QString& strError) const;
+private:
+    QMap<QString,bool> mExistsFields;
+    QMap<int,QMap<int,int> > mTilesNop;
+    QMap<int,QMap<int,QVector<quint8> > > mTilesPointsClass;
+    QMap<int,QMap<int,QMap<int,quint8> > > mTilesPointsClassNewByPos;
+    QMap<int,QMap<int,QVector<double> > > mTilesStatistics;
+};
+}
+#endif // POINTSCLASSESFILE_H
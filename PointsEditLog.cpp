@@ -0,0 +1,232 @@
+#include <QObject>
+
+#include "PointCloudFileDefinitions.h"
+#include "PointsEditLog.h"
+
+using namespace PCFile;
+
+PointsEditOperation::PointsEditOperation()
+{
+    mId=0;
+}
+
+void PointsEditOperation::addChange(int fileIndex,
+                                    int tileX,
+                                    int tileY,
+                                    int position,
+                                    quint8 oldClass,
+                                    quint8 newClass,
+                                    bool existsOldClassNew,
+                                    bool existsNewClassNew)
+{
+    int lastRun=mRunsFileIndex.size()-1;
+    if(lastRun>=0
+            &&mRunsFileIndex[lastRun]==fileIndex
+            &&mRunsTileX[lastRun]==tileX
+            &&mRunsTileY[lastRun]==tileY
+            &&mRunsOldClass[lastRun]==oldClass
+            &&mRunsNewClass[lastRun]==newClass
+            &&mRunsExistsOldClassNew[lastRun]==existsOldClassNew
+            &&mRunsExistsNewClassNew[lastRun]==existsNewClassNew
+            &&mRunsFirstPosition[lastRun]+mRunsNumberOfPoints[lastRun]==position)
+    {
+        mRunsNumberOfPoints[lastRun]++;
+        return;
+    }
+    mRunsFileIndex.push_back(fileIndex);
+    mRunsTileX.push_back(tileX);
+    mRunsTileY.push_back(tileY);
+    mRunsFirstPosition.push_back(position);
+    mRunsNumberOfPoints.push_back(1);
+    mRunsOldClass.push_back(oldClass);
+    mRunsNewClass.push_back(newClass);
+    mRunsExistsOldClassNew.push_back(existsOldClassNew);
+    mRunsExistsNewClassNew.push_back(existsNewClassNew);
+}
+
+void PointsEditOperation::append(const PointsEditOperation &operation)
+{
+    mRunsFileIndex+=operation.mRunsFileIndex;
+    mRunsTileX+=operation.mRunsTileX;
+    mRunsTileY+=operation.mRunsTileY;
+    mRunsFirstPosition+=operation.mRunsFirstPosition;
+    mRunsNumberOfPoints+=operation.mRunsNumberOfPoints;
+    mRunsOldClass+=operation.mRunsOldClass;
+    mRunsNewClass+=operation.mRunsNewClass;
+    mRunsExistsOldClassNew+=operation.mRunsExistsOldClassNew;
+    mRunsExistsNewClassNew+=operation.mRunsExistsNewClassNew;
+}
+
+void PointsEditOperation::clear()
+{
+    mId=0;
+    mRunsFileIndex.clear();
+    mRunsTileX.clear();
+    mRunsTileY.clear();
+    mRunsFirstPosition.clear();
+    mRunsNumberOfPoints.clear();
+    mRunsOldClass.clear();
+    mRunsNewClass.clear();
+    mRunsExistsOldClassNew.clear();
+    mRunsExistsNewClassNew.clear();
+}
+
+PointsEditLog::PointsEditLog()
+{
+    mBaseId=0;
+    mLastId=0;
+    mMaximumNumberOfRuns=POINTCLOUDFILE_EDIT_LOG_MAXIMUM_NUMBER_OF_RUNS;
+    mNumberOfRuns=0;
+}
+
+bool PointsEditLog::addCheckpoint(QString name,
+                                  QString &strError)
+{
+    if(name.trimmed().isEmpty())
+    {
+        strError=QObject::tr("PointsEditLog::addCheckpoint");
+        strError+=QObject::tr("\nCheckpoint name is empty");
+        return(false);
+    }
+    mCheckpoints[name]=getCurrentId();
+    return(true);
+}
+
+void PointsEditLog::addOperation(PointsEditOperation &operation)
+{
+    if(operation.isEmpty())
+    {
+        return;
+    }
+    qint64 currentId=getCurrentId();
+    for(int i=0;i<mRedoOperations.size();i++)
+    {
+        mNumberOfRuns-=mRedoOperations[i].getNumberOfRuns();
+    }
+    mRedoOperations.clear();
+    // los puntos de control sobre lo que se podia rehacer dejan de existir
+    QMap<QString,qint64>::iterator iterCheckpoints=mCheckpoints.begin();
+    while(iterCheckpoints!=mCheckpoints.end())
+    {
+        if(iterCheckpoints.value()>currentId)
+        {
+            iterCheckpoints=mCheckpoints.erase(iterCheckpoints);
+        }
+        else
+        {
+            iterCheckpoints++;
+        }
+    }
+    mLastId++;
+    operation.setId(mLastId);
+    mNumberOfRuns+=operation.getNumberOfRuns();
+    mUndoOperations.push_back(operation);
+    removeOldestOperations();
+}
+
+void PointsEditLog::clear()
+{
+    mCheckpoints.clear();
+    mRedoOperations.clear();
+    mUndoOperations.clear();
+    mNumberOfRuns=0;
+    mBaseId=mLastId;
+}
+
+bool PointsEditLog::getCheckpointMovements(QString name,
+                                           int &numberOfMovements,
+                                           QString &strError) const
+{
+    numberOfMovements=0;
+    if(!mCheckpoints.contains(name))
+    {
+        strError=QObject::tr("PointsEditLog::getCheckpointMovements");
+        strError+=QObject::tr("\nNot exists checkpoint: %1").arg(name);
+        return(false);
+    }
+    qint64 checkpointId=mCheckpoints[name];
+    if(checkpointId==getCurrentId())
+    {
+        return(true);
+    }
+    if(checkpointId==mBaseId)
+    {
+        numberOfMovements=-mUndoOperations.size();
+        return(true);
+    }
+    for(int i=0;i<mUndoOperations.size();i++)
+    {
+        if(mUndoOperations[i].getId()==checkpointId)
+        {
+            numberOfMovements=-(mUndoOperations.size()-1-i);
+            return(true);
+        }
+    }
+    for(int i=0;i<mRedoOperations.size();i++)
+    {
+        if(mRedoOperations[i].getId()==checkpointId)
+        {
+            numberOfMovements=mRedoOperations.size()-i;
+            return(true);
+        }
+    }
+    strError=QObject::tr("PointsEditLog::getCheckpointMovements");
+    strError+=QObject::tr("\nCheckpoint: %1 is not reachable").arg(name);
+    return(false);
+}
+
+qint64 PointsEditLog::getCurrentId() const
+{
+    if(mUndoOperations.isEmpty())
+    {
+        return(mBaseId);
+    }
+    return(mUndoOperations.last().getId());
+}
+
+void PointsEditLog::redo()
+{
+    mUndoOperations.push_back(mRedoOperations.last());
+    mRedoOperations.removeLast();
+}
+
+void PointsEditLog::removeOldestOperations()
+{
+    bool removed=false;
+    while(mNumberOfRuns>mMaximumNumberOfRuns
+          &&!mUndoOperations.isEmpty())
+    {
+        mNumberOfRuns-=mUndoOperations.first().getNumberOfRuns();
+        mBaseId=mUndoOperations.first().getId();
+        mUndoOperations.removeFirst();
+        removed=true;
+    }
+    if(!removed)
+    {
+        return;
+    }
+    QMap<QString,qint64>::iterator iterCheckpoints=mCheckpoints.begin();
+    while(iterCheckpoints!=mCheckpoints.end())
+    {
+        if(iterCheckpoints.value()<mBaseId)
+        {
+            iterCheckpoints=mCheckpoints.erase(iterCheckpoints);
+        }
+        else
+        {
+            iterCheckpoints++;
+        }
+    }
+}
+
+void PointsEditLog::setMaximumNumberOfRuns(qint64 value)
+{
+    mMaximumNumberOfRuns=value;
+    removeOldestOperations();
+}
+
+void PointsEditLog::undo()
+{
+    mRedoOperations.push_back(mUndoOperations.last());
+    mUndoOperations.removeLast();
+}
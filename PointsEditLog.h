@@ -0,0 +1,87 @@
+#ifndef POINTSEDITLOG_H
+#define POINTSEDITLOG_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+
+namespace PCFile{
+
+// Cambios de clase editada de una llamada de edicion, en tramos de posiciones consecutivas
+// del mismo tile con la misma clase anterior y nueva
+class PointsEditOperation
+{
+public:
+    PointsEditOperation();
+    void addChange(int fileIndex,
+                   int tileX,
+                   int tileY,
+                   int position,
+                   quint8 oldClass,
+                   quint8 newClass,
+                   bool existsOldClassNew, // si no, deshacer elimina la clase editada
+                   bool existsNewClassNew=true); // si no, rehacer elimina la clase editada
+    void append(const PointsEditOperation& operation);
+    void clear();
+    qint64 getId() const{return(mId);};
+    int getNumberOfRuns() const{return(mRunsFileIndex.size());};
+    int getRunFileIndex(int run) const{return(mRunsFileIndex[run]);};
+    int getRunFirstPosition(int run) const{return(mRunsFirstPosition[run]);};
+    int getRunNumberOfPoints(int run) const{return(mRunsNumberOfPoints[run]);};
+    quint8 getRunNewClass(int run) const{return(mRunsNewClass[run]);};
+    quint8 getRunOldClass(int run) const{return(mRunsOldClass[run]);};
+    bool getRunExistsNewClassNew(int run) const{return(mRunsExistsNewClassNew[run]);};
+    bool getRunExistsOldClassNew(int run) const{return(mRunsExistsOldClassNew[run]);};
+    int getRunTileX(int run) const{return(mRunsTileX[run]);};
+    int getRunTileY(int run) const{return(mRunsTileY[run]);};
+    bool isEmpty() const{return(mRunsFileIndex.isEmpty());};
+    void setId(qint64 value){mId=value;};
+private:
+    qint64 mId;
+    QVector<int> mRunsFileIndex;
+    QVector<int> mRunsTileX;
+    QVector<int> mRunsTileY;
+    QVector<int> mRunsFirstPosition;
+    QVector<int> mRunsNumberOfPoints;
+    QVector<quint8> mRunsOldClass;
+    QVector<quint8> mRunsNewClass;
+    QVector<bool> mRunsExistsOldClassNew;
+    QVector<bool> mRunsExistsNewClassNew;
+};
+
+// Historial de deshacer/rehacer de un proyecto. Cada operacion guarda solo sus cambios,
+// deshacer y rehacer cuestan lo que la operacion. Al superar el maximo de tramos se
+// descartan las operaciones mas antiguas, y con ellas los puntos de control que apuntan
+// a estados ya no alcanzables. No es seguro entre hilos, lo protege PointCloudFile.
+class PointsEditLog
+{
+public:
+    PointsEditLog();
+    bool addCheckpoint(QString name,
+                       QString& strError);
+    void addOperation(PointsEditOperation& operation); // descarta lo que se podia rehacer
+    void clear();
+    QVector<QString> getCheckpoints() const{return(mCheckpoints.keys().toVector());};
+    bool getCheckpointMovements(QString name, // >0 rehacer, <0 deshacer
+                                int& numberOfMovements,
+                                QString& strError) const;
+    int getNumberOfRedoOperations() const{return(mRedoOperations.size());};
+    int getNumberOfUndoOperations() const{return(mUndoOperations.size());};
+    const PointsEditOperation& getRedoOperation() const{return(mRedoOperations.last());};
+    const PointsEditOperation& getUndoOperation() const{return(mUndoOperations.last());};
+    void redo(); // tras aplicar getRedoOperation()
+    void setMaximumNumberOfRuns(qint64 value);
+    void undo(); // tras aplicar getUndoOperation()
+private:
+    qint64 getCurrentId() const;
+    void removeOldestOperations();
+    QMap<QString,qint64> mCheckpoints; // id de la ultima operacion aplicada
+    qint64 mBaseId; // estado anterior a la primera operacion conservada
+    qint64 mLastId;
+    qint64 mMaximumNumberOfRuns;
+    qint64 mNumberOfRuns;
+    QVector<PointsEditOperation> mRedoOperations; // la ultima es la siguiente a rehacer
+    QVector<PointsEditOperation> mUndoOperations; // la ultima es la siguiente a deshacer
+};
+}
+#endif // POINTSEDITLOG_H
@@ -0,0 +1,92 @@
+#include "PointsFilter.h"
+
+using namespace PCFile;
+
+PointsFilter::PointsFilter()
+{
+    clear();
+}
+
+void PointsFilter::clear()
+{
+    mFilterByClass=false;
+    mFilterByClassNew=false;
+    mFilterByGpsTime=false;
+    mFilterByHeight=false;
+    mFilterByIntensity=false;
+    mFilterByReturn=false;
+    mClassesMask.fill(true,256);
+    mClassesNewMask.fill(true,256);
+    mReturnsMask.fill(true,256);
+    mMinGpsTime=0.;
+    mMaxGpsTime=0.;
+    mMinZ=0.;
+    mMaxZ=0.;
+    mMinIntensity=0;
+    mMaxIntensity=0;
+    mThinning.clear();
+}
+
+bool PointsFilter::isEmpty() const
+{
+    return(!mFilterByClass
+           &&!mFilterByClassNew
+           &&!mFilterByGpsTime
+           &&!mFilterByHeight
+           &&!mFilterByIntensity
+           &&!mFilterByReturn);
+}
+
+void PointsFilter::setClasses(const QVector<int> &classes)
+{
+    mFilterByClass=true;
+    mClassesMask.fill(false,256);
+    for(int i=0;i<classes.size();i++)
+    {
+        if(classes[i]>=0&&classes[i]<256) mClassesMask[classes[i]]=true;
+    }
+}
+
+void PointsFilter::setClassesNew(const QVector<int> &classes)
+{
+    mFilterByClassNew=true;
+    mClassesNewMask.fill(false,256);
+    for(int i=0;i<classes.size();i++)
+    {
+        if(classes[i]>=0&&classes[i]<256) mClassesNewMask[classes[i]]=true;
+    }
+}
+
+void PointsFilter::setGpsTimeRange(double minGpsTime,
+                                   double maxGpsTime)
+{
+    mFilterByGpsTime=true;
+    mMinGpsTime=minGpsTime;
+    mMaxGpsTime=maxGpsTime;
+}
+
+void PointsFilter::setHeightRange(double minZ,
+                                  double maxZ)
+{
+    mFilterByHeight=true;
+    mMinZ=minZ;
+    mMaxZ=maxZ;
+}
+
+void PointsFilter::setIntensityRange(int minIntensity,
+                                     int maxIntensity)
+{
+    mFilterByIntensity=true;
+    mMinIntensity=minIntensity;
+    mMaxIntensity=maxIntensity;
+}
+
+void PointsFilter::setReturns(const QVector<int> &returns)
+{
+    mFilterByReturn=true;
+    mReturnsMask.fill(false,256);
+    for(int i=0;i<returns.size();i++)
+    {
+        if(returns[i]>=0&&returns[i]<256) mReturnsMask[returns[i]]=true;
+    }
+}
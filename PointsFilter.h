@@ -0,0 +1,58 @@
+#ifndef POINTSFILTER_H
+#define POINTSFILTER_H
+
+
+#include "libPointCloudFileManager_global.h"
+
+#include <QVector>
+
+#include "PointsThinning.h"
+
+namespace PCFile{
+
+// Predicado sobre atributos de los puntos que se evalua en la decodificacion
+// de los tiles, antes de construir cada Point. Un criterio no definido no filtra.
+// Puede llevar un aclarado, que no forma parte del predicado: isEmpty() no lo considera.
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT PointsFilter
+{
+public:
+    PointsFilter();
+    void clear();
+    bool getFilterByClass() const{return(mFilterByClass);};
+    bool getFilterByClassNew() const{return(mFilterByClassNew);};
+    bool getFilterByGpsTime() const{return(mFilterByGpsTime);};
+    bool getFilterByHeight() const{return(mFilterByHeight);};
+    bool getFilterByIntensity() const{return(mFilterByIntensity);};
+    bool getFilterByReturn() const{return(mFilterByReturn);};
+    void getGpsTimeRange(double& minGpsTime,double& maxGpsTime) const{minGpsTime=mMinGpsTime;maxGpsTime=mMaxGpsTime;};
+    void getHeightRange(double& minZ,double& maxZ) const{minZ=mMinZ;maxZ=mMaxZ;};
+    void getIntensityRange(int& minIntensity,int& maxIntensity) const{minIntensity=mMinIntensity;maxIntensity=mMaxIntensity;};
+    const PointsThinning& getThinning() const{return(mThinning);};
+    bool isClassSelected(quint8 value) const{return(mClassesMask[value]);};
+    bool isClassNewSelected(quint8 value) const{return(mClassesNewMask[value]);};
+    bool isEmpty() const;
+    bool isReturnSelected(quint8 value) const{return(mReturnsMask[value]);};
+    void setClasses(const QVector<int>& classes);       // clase original
+    void setClassesNew(const QVector<int>& classes);    // clase tras la edicion
+    void setGpsTimeRange(double minGpsTime,double maxGpsTime);
+    void setHeightRange(double minZ,double maxZ);
+    void setIntensityRange(int minIntensity,int maxIntensity);
+    void setReturns(const QVector<int>& returns);       // numero de retorno
+    void setThinning(const PointsThinning& thinning){mThinning=thinning;};
+private:
+    bool mFilterByClass;
+    bool mFilterByClassNew;
+    bool mFilterByGpsTime;
+    bool mFilterByHeight;
+    bool mFilterByIntensity;
+    bool mFilterByReturn;
+    QVector<bool> mClassesMask;
+    QVector<bool> mClassesNewMask;
+    QVector<bool> mReturnsMask;
+    double mMinGpsTime,mMaxGpsTime;
+    double mMinZ,mMaxZ;
+    int mMinIntensity,mMaxIntensity;
+    PointsThinning mThinning;
+};
+}
+#endif // POINTSFILTER_H
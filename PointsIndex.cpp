@@ -0,0 +1,340 @@
+#include <QObject>
+#include <QtMath>
+
+#include <algorithm>
+
+#include "PointCloudFileDefinitions.h"
+#include "PointsIndex.h"
+
+using namespace PCFile;
+
+PointsIndex::PointsIndex()
+{
+    mDimension=2;
+}
+
+bool PointsIndex::build(const QVector<double> &coordinates,
+                        int dimension,
+                        QString &strError)
+{
+    clear();
+    if(dimension<2||dimension>3)
+    {
+        strError=QObject::tr("PointsIndex::build");
+        strError+=QObject::tr("\nInvalid dimension: %1").arg(QString::number(dimension));
+        return(false);
+    }
+    if(coordinates.size()%dimension!=0)
+    {
+        strError=QObject::tr("PointsIndex::build");
+        strError+=QObject::tr("\nNumber of coordinates: %1 is not multiple of dimension: %2")
+                .arg(QString::number(coordinates.size())).arg(QString::number(dimension));
+        return(false);
+    }
+    mDimension=dimension;
+    mCoordinates=coordinates;
+    int numberOfPoints=coordinates.size()/dimension;
+    mPositions.resize(numberOfPoints);
+    for(int i=0;i<numberOfPoints;i++) mPositions[i]=i;
+    build(0,numberOfPoints,0);
+    return(true);
+}
+
+bool PointsIndex::build(const QVector<double> &coordinates,
+                        int dimension,
+                        const QVector<int> &positions,
+                        QString &strError)
+{
+    // la permutacion ya ordenada evita las particiones, solo se comprueba que es valida
+    clear();
+    if(dimension<2||dimension>3)
+    {
+        strError=QObject::tr("PointsIndex::build");
+        strError+=QObject::tr("\nInvalid dimension: %1").arg(QString::number(dimension));
+        return(false);
+    }
+    int numberOfPoints=coordinates.size()/dimension;
+    if(coordinates.size()%dimension!=0
+            ||positions.size()!=numberOfPoints)
+    {
+        strError=QObject::tr("PointsIndex::build");
+        strError+=QObject::tr("\nNumber of positions: %1 is not equal to number of points: %2")
+                .arg(QString::number(positions.size())).arg(QString::number(numberOfPoints));
+        return(false);
+    }
+    QVector<bool> usedPositions(numberOfPoints,false);
+    for(int i=0;i<numberOfPoints;i++)
+    {
+        int position=positions[i];
+        if(position<0||position>=numberOfPoints||usedPositions[position])
+        {
+            strError=QObject::tr("PointsIndex::build");
+            strError+=QObject::tr("\nInvalid position: %1").arg(QString::number(position));
+            return(false);
+        }
+        usedPositions[position]=true;
+    }
+    mDimension=dimension;
+    mCoordinates=coordinates;
+    mPositions=positions;
+    return(true);
+}
+
+void PointsIndex::build(int begin,
+                        int end,
+                        int depth)
+{
+    while(end-begin>POINTCLOUDFILE_POINTS_INDEX_LEAF_SIZE)
+    {
+        int axis=depth%mDimension;
+        int middle=begin+(end-begin)/2;
+        const double* ptrCoordinates=mCoordinates.constData();
+        int dimension=mDimension;
+        std::nth_element(mPositions.begin()+begin,
+                         mPositions.begin()+middle,
+                         mPositions.begin()+end,
+                         [ptrCoordinates,dimension,axis](int a,int b)
+        {return(ptrCoordinates[a*dimension+axis]<ptrCoordinates[b*dimension+axis]);});
+        build(begin,middle,depth+1);
+        begin=middle+1;
+        depth++;
+    }
+}
+
+void PointsIndex::clear()
+{
+    mCoordinates.clear();
+    mPositions.clear();
+}
+
+void PointsIndex::getNearestNeighbors(const QVector<double> &point,
+                                      int numberOfNeighbors,
+                                      double maximumDistance,
+                                      QVector<int> &positions,
+                                      QVector<double> &distances) const
+{
+    positions.clear();
+    distances.clear();
+    if(mPositions.isEmpty()||point.size()<mDimension) return;
+    if(numberOfNeighbors<=0||numberOfNeighbors>mPositions.size())
+    {
+        numberOfNeighbors=mPositions.size();
+    }
+    double maximumSquaredDistance=-1.;
+    if(maximumDistance>0.) maximumSquaredDistance=maximumDistance*maximumDistance;
+    QVector<QPair<double,int> > heap;
+    heap.reserve(numberOfNeighbors+1);
+    searchNearestNeighbors(0,mPositions.size(),0,point.constData(),
+                           numberOfNeighbors,maximumSquaredDistance,heap);
+    std::sort_heap(heap.begin(),heap.end());
+    positions.resize(heap.size());
+    distances.resize(heap.size());
+    for(int i=0;i<heap.size();i++)
+    {
+        distances[i]=qSqrt(heap[i].first);
+        positions[i]=heap[i].second;
+    }
+}
+
+void PointsIndex::getPointsInBox(const QVector<double> &minimumCoordinates,
+                                 const QVector<double> &maximumCoordinates,
+                                 QVector<int> &positions) const
+{
+    positions.clear();
+    if(mPositions.isEmpty()
+            ||minimumCoordinates.size()<mDimension
+            ||maximumCoordinates.size()<mDimension) return;
+    searchPointsInBox(0,mPositions.size(),0,
+                      minimumCoordinates.constData(),
+                      maximumCoordinates.constData(),
+                      positions);
+}
+
+void PointsIndex::getPointsInRadius(const QVector<double> &point,
+                                    double radius,
+                                    QVector<int> &positions,
+                                    QVector<double> &distances) const
+{
+    positions.clear();
+    distances.clear();
+    if(mPositions.isEmpty()||point.size()<mDimension||radius<0.) return;
+    QVector<QPair<double,int> > found;
+    searchPointsInRadius(0,mPositions.size(),0,point.constData(),radius*radius,found);
+    std::sort(found.begin(),found.end());
+    positions.resize(found.size());
+    distances.resize(found.size());
+    for(int i=0;i<found.size();i++)
+    {
+        distances[i]=qSqrt(found[i].first);
+        positions[i]=found[i].second;
+    }
+}
+
+double PointsIndex::getSquaredDistance(const double *ptrPoint,
+                                       int position) const
+{
+    const double* ptrCoordinates=mCoordinates.constData()+position*mDimension;
+    double squaredDistance=0.;
+    for(int i=0;i<mDimension;i++)
+    {
+        double diff=ptrPoint[i]-ptrCoordinates[i];
+        squaredDistance+=diff*diff;
+    }
+    return(squaredDistance);
+}
+
+void PointsIndex::searchNearestNeighbors(int begin,
+                                         int end,
+                                         int depth,
+                                         const double *ptrPoint,
+                                         int numberOfNeighbors,
+                                         double &maximumSquaredDistance,
+                                         QVector<QPair<double, int> > &heap) const
+{
+    // maximumSquaredDistance<0 mientras no hay limite, tras llenar el heap es la del k-esimo
+    if(end-begin<=POINTCLOUDFILE_POINTS_INDEX_LEAF_SIZE)
+    {
+        for(int i=begin;i<end;i++)
+        {
+            int position=mPositions[i];
+            double squaredDistance=getSquaredDistance(ptrPoint,position);
+            if(maximumSquaredDistance>=0.&&squaredDistance>maximumSquaredDistance) continue;
+            heap.push_back(qMakePair(squaredDistance,position));
+            std::push_heap(heap.begin(),heap.end());
+            if(heap.size()>numberOfNeighbors)
+            {
+                std::pop_heap(heap.begin(),heap.end());
+                heap.pop_back();
+            }
+            if(heap.size()==numberOfNeighbors)
+            {
+                maximumSquaredDistance=heap.front().first;
+            }
+        }
+        return;
+    }
+    int axis=depth%mDimension;
+    int middle=begin+(end-begin)/2;
+    int position=mPositions[middle];
+    double diff=ptrPoint[axis]-mCoordinates[position*mDimension+axis];
+    int nearBegin=begin,nearEnd=middle,farBegin=middle+1,farEnd=end;
+    if(diff>0.)
+    {
+        nearBegin=middle+1;
+        nearEnd=end;
+        farBegin=begin;
+        farEnd=middle;
+    }
+    searchNearestNeighbors(nearBegin,nearEnd,depth+1,ptrPoint,numberOfNeighbors,maximumSquaredDistance,heap);
+    double squaredDistance=getSquaredDistance(ptrPoint,position);
+    if(maximumSquaredDistance<0.||squaredDistance<=maximumSquaredDistance)
+    {
+        heap.push_back(qMakePair(squaredDistance,position));
+        std::push_heap(heap.begin(),heap.end());
+        if(heap.size()>numberOfNeighbors)
+        {
+            std::pop_heap(heap.begin(),heap.end());
+            heap.pop_back();
+        }
+        if(heap.size()==numberOfNeighbors)
+        {
+            maximumSquaredDistance=heap.front().first;
+        }
+    }
+    if(maximumSquaredDistance<0.||diff*diff<=maximumSquaredDistance)
+    {
+        searchNearestNeighbors(farBegin,farEnd,depth+1,ptrPoint,numberOfNeighbors,maximumSquaredDistance,heap);
+    }
+}
+
+void PointsIndex::searchPointsInBox(int begin,
+                                    int end,
+                                    int depth,
+                                    const double *ptrMinimumCoordinates,
+                                    const double *ptrMaximumCoordinates,
+                                    QVector<int> &positions) const
+{
+    if(end-begin<=POINTCLOUDFILE_POINTS_INDEX_LEAF_SIZE)
+    {
+        for(int i=begin;i<end;i++)
+        {
+            int position=mPositions[i];
+            const double* ptrCoordinates=mCoordinates.constData()+position*mDimension;
+            bool inside=true;
+            for(int d=0;d<mDimension;d++)
+            {
+                if(ptrCoordinates[d]<ptrMinimumCoordinates[d]
+                        ||ptrCoordinates[d]>ptrMaximumCoordinates[d])
+                {
+                    inside=false;
+                    break;
+                }
+            }
+            if(inside) positions.push_back(position);
+        }
+        return;
+    }
+    int axis=depth%mDimension;
+    int middle=begin+(end-begin)/2;
+    int position=mPositions[middle];
+    double value=mCoordinates[position*mDimension+axis];
+    bool inside=true;
+    for(int d=0;d<mDimension;d++)
+    {
+        double coordinate=mCoordinates[position*mDimension+d];
+        if(coordinate<ptrMinimumCoordinates[d]
+                ||coordinate>ptrMaximumCoordinates[d])
+        {
+            inside=false;
+            break;
+        }
+    }
+    if(inside) positions.push_back(position);
+    if(ptrMinimumCoordinates[axis]<=value)
+    {
+        searchPointsInBox(begin,middle,depth+1,ptrMinimumCoordinates,ptrMaximumCoordinates,positions);
+    }
+    if(ptrMaximumCoordinates[axis]>=value)
+    {
+        searchPointsInBox(middle+1,end,depth+1,ptrMinimumCoordinates,ptrMaximumCoordinates,positions);
+    }
+}
+
+void PointsIndex::searchPointsInRadius(int begin,
+                                       int end,
+                                       int depth,
+                                       const double *ptrPoint,
+                                       double squaredRadius,
+                                       QVector<QPair<double, int> > &found) const
+{
+    if(end-begin<=POINTCLOUDFILE_POINTS_INDEX_LEAF_SIZE)
+    {
+        for(int i=begin;i<end;i++)
+        {
+            int position=mPositions[i];
+            double squaredDistance=getSquaredDistance(ptrPoint,position);
+            if(squaredDistance<=squaredRadius)
+            {
+                found.push_back(qMakePair(squaredDistance,position));
+            }
+        }
+        return;
+    }
+    int axis=depth%mDimension;
+    int middle=begin+(end-begin)/2;
+    int position=mPositions[middle];
+    double diff=ptrPoint[axis]-mCoordinates[position*mDimension+axis];
+    double squaredDistance=getSquaredDistance(ptrPoint,position);
+    if(squaredDistance<=squaredRadius)
+    {
+        found.push_back(qMakePair(squaredDistance,position));
+    }
+    if(diff<=0.||diff*diff<=squaredRadius)
+    {
+        searchPointsInRadius(begin,middle,depth+1,ptrPoint,squaredRadius,found);
+    }
+    if(diff>=0.||diff*diff<=squaredRadius)
+    {
+        searchPointsInRadius(middle+1,end,depth+1,ptrPoint,squaredRadius,found);
+    }
+}
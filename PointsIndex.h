@@ -0,0 +1,70 @@
+#ifndef POINTSINDEX_H
+#define POINTSINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+
+namespace PCFile{
+
+// kd-tree implicito sobre coordenadas 2D o 3D. Solo guarda la permutacion de los puntos:
+// cada nodo es el rango [begin,end) y divide por la mediana en el eje depth%dimension,
+// de modo que las busquedas devuelven directamente la posicion del punto en la entrada.
+class PointsIndex
+{
+public:
+    PointsIndex();
+    bool build(const QVector<double>& coordinates, // x1,y1[,z1],x2,y2[,z2],...
+               int dimension,
+               QString& strError);
+    bool build(const QVector<double>& coordinates,
+               int dimension,
+               const QVector<int>& positions, // de getPositions, p.ej. leidas de fichero
+               QString& strError);
+    void clear();
+    int getDimension() const{return(mDimension);};
+    void getNearestNeighbors(const QVector<double>& point,
+                             int numberOfNeighbors, // <=0 todos
+                             double maximumDistance, // <=0 sin limite
+                             QVector<int>& positions,
+                             QVector<double>& distances) const;
+    int getNumberOfPoints() const{return(mPositions.size());};
+    const QVector<int>& getPositions() const{return(mPositions);};
+    void getPointsInBox(const QVector<double>& minimumCoordinates,
+                        const QVector<double>& maximumCoordinates,
+                        QVector<int>& positions) const;
+    void getPointsInRadius(const QVector<double>& point,
+                           double radius,
+                           QVector<int>& positions,
+                           QVector<double>& distances) const;
+private:
+    void build(int begin,
+               int end,
+               int depth);
+    double getSquaredDistance(const double* ptrPoint,
+                              int position) const;
+    void searchNearestNeighbors(int begin,
+                                int end,
+                                int depth,
+                                const double* ptrPoint,
+                                int numberOfNeighbors,
+                                double& maximumSquaredDistance,
+                                QVector<QPair<double,int> >& heap) const;
+    void searchPointsInBox(int begin,
+                           int end,
+                           int depth,
+                           const double* ptrMinimumCoordinates,
+                           const double* ptrMaximumCoordinates,
+                           QVector<int>& positions) const;
+    void searchPointsInRadius(int begin,
+                              int end,
+                              int depth,
+                              const double* ptrPoint,
+                              double squaredRadius,
+                              QVector<QPair<double,int> >& found) const;
+    int mDimension;
+    QVector<double> mCoordinates;
+    QVector<int> mPositions;
+};
+}
+#endif // POINTSINDEX_H
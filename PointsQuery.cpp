@@ -0,0 +1,1220 @@
+#include <QFile>
+#include <QDataStream>
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QtEndian>
+#include <QtMath>
+
+#include <algorithm>
+#include <random>
+
+#include <quazip.h>
+#include <quazipfile.h>
+
+#include "PointCloudFileDefinitions.h"
+#include "Point.h"
+#include "PointsClassesFile.h"
+#include "PointsQuery.h"
+
+using namespace PCFile;
+
+PointsQuery::PointsQuery()
+{
+    mNumberOfColorBytes=1;
+    mNumberOfPointsInTiles=0;
+    mThinningSelected=false;
+    mNumberOfThinningCandidates=0;
+}
+
+void PointsQuery::clear()
+{
+    mPointsFilter.clear();
+    mTilesBoxBounds.clear();
+    mTilesPolygonEdges.clear();
+    mClassesFileByIndex.clear();
+    mExistsFieldsByFileIndex.clear();
+    mTilesPointsClassByFileIndex.clear();
+    mTilesPointsClassNewByPosByFileIndex.clear();
+    mTilesNopByFileIndex.clear();
+    mTilesStatisticsByFileIndex.clear();
+    mNumberOfPointsInTiles=0;
+    mThinningSelected=false;
+    mNumberOfThinningCandidates=0;
+    mThinningPositionsByFileIndex.clear();
+}
+
+bool PointsQuery::countTilePoints(QuaZip &zipFilePoints,
+                                  int fileIndex,
+                                  int tileX,
+                                  int tileY,
+                                  int &numberOfPoints,
+                                  QString &strError) const
+{
+    // Sin recorte por poligono basta el numero de puntos del fichero de clases,
+    // con recorte solo se decodifican ix, iy
+    numberOfPoints=0;
+    bool filterByPolygon=false;
+    if(mTilesPolygonEdges.contains(tileX))
+    {
+        filterByPolygon=mTilesPolygonEdges[tileX].contains(tileY);
+    }
+    if(!filterByPolygon)
+    {
+        numberOfPoints=getTileNumberOfPoints(fileIndex,tileX,tileY);
+        return(true);
+    }
+    QString strAuxError;
+    QByteArray tileData;
+    if(!readTileData(zipFilePoints,tileX,tileY,tileData,strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::countTilePoints");
+        strError+=QObject::tr("\nError reading tile data:\n%1").arg(strAuxError);
+        return(false);
+    }
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(mExistsFieldsByFileIndex.value(fileIndex),
+                          recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    int numberOfTilePoints=tileData.size()/recordSize;
+    const uchar* ptrTileData=(const uchar*)tileData.constData();
+    QVector<float> ixValues(numberOfTilePoints);
+    QVector<float> iyValues(numberOfTilePoints);
+    for(int pos=0;pos<numberOfTilePoints;pos++)
+    {
+        const uchar* ptrRecord=ptrTileData+pos*recordSize;
+        ixValues[pos]=(float)qFromBigEndian<quint16>(ptrRecord);
+        iyValues[pos]=(float)qFromBigEndian<quint16>(ptrRecord+2);
+    }
+    QVector<quint8> insideMask;
+    getPointsInPolygonMask(mTilesPolygonEdges[tileX][tileY],
+                           ixValues,
+                           iyValues,
+                           insideMask);
+    const quint8* ptrInside=insideMask.constData();
+    for(int pos=0;pos<numberOfTilePoints;pos++)
+    {
+        numberOfPoints+=ptrInside[pos];
+    }
+    return(true);
+}
+
+bool PointsQuery::getTileMayMatchPointsFilter(int fileIndex,
+                                              int tileX,
+                                              int tileY) const
+{
+    // false solo si se garantiza que ningun punto del tile cumple el filtro
+    if(mPointsFilter.isEmpty())
+    {
+        return(true);
+    }
+    if(mPointsFilter.getFilterByClass()
+            ||mPointsFilter.getFilterByClassNew())
+    {
+        QVector<quint8> tilePointsClass=mTilesPointsClassByFileIndex.value(fileIndex).value(tileX).value(tileY);
+        QMap<int,quint8> tilePointsClassNewByPos=mTilesPointsClassNewByPosByFileIndex.value(fileIndex).value(tileX).value(tileY);
+        QVector<bool> existsClass(256,false);
+        for(int pos=0;pos<tilePointsClass.size();pos++)
+        {
+            existsClass[tilePointsClass[pos]]=true;
+        }
+        QVector<bool> existsClassNew=existsClass;
+        QMap<int,quint8>::const_iterator iterPos=tilePointsClassNewByPos.begin();
+        while(iterPos!=tilePointsClassNewByPos.end())
+        {
+            existsClassNew[iterPos.value()]=true;
+            iterPos++;
+        }
+        bool existsClassSelected=!mPointsFilter.getFilterByClass();
+        bool existsClassNewSelected=!mPointsFilter.getFilterByClassNew();
+        for(int value=0;value<256;value++)
+        {
+            if(existsClass[value]&&mPointsFilter.isClassSelected(value)) existsClassSelected=true;
+            if(existsClassNew[value]&&mPointsFilter.isClassNewSelected(value)) existsClassNewSelected=true;
+        }
+        if(!existsClassSelected||!existsClassNewSelected)
+        {
+            return(false);
+        }
+    }
+    QVector<double> tileStatistics=mTilesStatisticsByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    if(tileStatistics.size()<POINTCLOUDFILE_TILE_STATISTICS_SIZE)
+    {
+        return(true);
+    }
+    QVector<double> filterRanges;
+    QVector<int> statisticsPositions;
+    if(mPointsFilter.getFilterByHeight())
+    {
+        double minZ,maxZ;
+        mPointsFilter.getHeightRange(minZ,maxZ);
+        filterRanges.push_back((minZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.-POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE);
+        filterRanges.push_back((maxZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.+POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE);
+        statisticsPositions.push_back(POINTCLOUDFILE_TILE_STATISTICS_Z_MIN);
+    }
+    if(mPointsFilter.getFilterByGpsTime())
+    {
+        double minGpsTime,maxGpsTime;
+        mPointsFilter.getGpsTimeRange(minGpsTime,maxGpsTime);
+        filterRanges.push_back(minGpsTime);
+        filterRanges.push_back(maxGpsTime);
+        statisticsPositions.push_back(POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MIN);
+    }
+    if(mPointsFilter.getFilterByIntensity())
+    {
+        int minIntensity,maxIntensity;
+        mPointsFilter.getIntensityRange(minIntensity,maxIntensity);
+        filterRanges.push_back(minIntensity);
+        filterRanges.push_back(maxIntensity);
+        statisticsPositions.push_back(POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MIN);
+    }
+    for(int i=0;i<statisticsPositions.size();i++)
+    {
+        double statisticsMin=tileStatistics[statisticsPositions[i]];
+        double statisticsMax=tileStatistics[statisticsPositions[i]+1];
+        if(statisticsMin>statisticsMax) continue; // sin valores registrados
+        if(statisticsMax<filterRanges[2*i]||statisticsMin>filterRanges[2*i+1])
+        {
+            return(false);
+        }
+    }
+    if(mPointsFilter.getFilterByReturn())
+    {
+        double statisticsMin=tileStatistics[POINTCLOUDFILE_TILE_STATISTICS_RETURN_MIN];
+        double statisticsMax=tileStatistics[POINTCLOUDFILE_TILE_STATISTICS_RETURN_MAX];
+        if(statisticsMin<=statisticsMax)
+        {
+            bool existsReturnSelected=false;
+            for(int value=qRound(statisticsMin);value<=qRound(statisticsMax);value++)
+            {
+                if(mPointsFilter.isReturnSelected(value))
+                {
+                    existsReturnSelected=true;
+                    break;
+                }
+            }
+            if(!existsReturnSelected)
+            {
+                return(false);
+            }
+        }
+    }
+    return(true);
+}
+
+bool PointsQuery::getTileLevelsOfDetail(QuaZip &zipFilePoints,
+                                        int fileIndex,
+                                        int tileX,
+                                        int tileY,
+                                        const QVector<int> &voxelSizes,
+                                        QVector<QByteArray> &levelsData,
+                                        QVector<int> &levelsNumberOfPoints,
+                                        QString &strError) const
+{
+    // Submuestreo por voxel en coordenadas cuantizadas del tile, se conserva el primer punto
+    // de cada voxel. Cada nivel guarda la posicion en el tile y el registro completo
+    levelsData.clear();
+    levelsNumberOfPoints.clear();
+    QString strAuxError;
+    QByteArray tileData;
+    if(!readTileData(zipFilePoints,tileX,tileY,tileData,strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::getTileLevelsOfDetail");
+        strError+=QObject::tr("\nError reading tile data:\n%1").arg(strAuxError);
+        return(false);
+    }
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(mExistsFieldsByFileIndex.value(fileIndex),
+                          recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    int numberOfPoints=tileData.size()/recordSize;
+    const uchar* ptrTileData=(const uchar*)tileData.constData();
+    for(int level=0;level<voxelSizes.size();level++)
+    {
+        qint64 voxelSize=qMax(1,voxelSizes[level]);
+        QSet<qint64> voxels;
+        QVector<int> positions;
+        QByteArray records;
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            const uchar* ptrRecord=ptrTileData+pos*recordSize;
+            qint64 vx=qFromBigEndian<quint16>(ptrRecord)/voxelSize;
+            qint64 vy=qFromBigEndian<quint16>(ptrRecord+2)/voxelSize;
+            qint64 vz=((ptrRecord[4]*256+ptrRecord[5])*100+ptrRecord[6])/voxelSize;
+            qint64 voxel=(vx<<43)|(vy<<23)|vz;
+            if(voxels.contains(voxel)) continue;
+            voxels.insert(voxel);
+            positions.push_back(pos);
+            records.append((const char*)ptrRecord,recordSize);
+        }
+        QByteArray levelData;
+        QDataStream out(&levelData,QIODevice::WriteOnly);
+        out<<positions;
+        out<<records;
+        levelsData.push_back(levelData);
+        levelsNumberOfPoints.push_back(positions.size());
+    }
+    return(true);
+}
+
+QString PointsQuery::getTileLevelOfDetailEntryName(int tileX,
+                                                   int tileY,
+                                                   int level)
+{
+    return("tile_"+QString::number(tileX)+"_"+QString::number(tileY)+"_"+QString::number(level));
+}
+
+int PointsQuery::getTileNumberOfPoints(int fileIndex,
+                                       int tileX,
+                                       int tileY) const
+{
+    return(mTilesNopByFileIndex.value(fileIndex).value(tileX).value(tileY,0));
+}
+
+bool PointsQuery::getTileThinning(const QMap<int, QuaZip *> &ptrZipFilesByFileIndex,
+                                  int tileX,
+                                  int tileY,
+                                  QMap<int, QVector<int> > &selectedPositionsByFileIndex,
+                                  qint64 &numberOfCandidates,
+                                  QString &strError) const
+{
+    // Candidatos tras recortes y filtro de todos los ficheros del tile, sin aclarado
+    selectedPositionsByFileIndex.clear();
+    numberOfCandidates=0;
+    QString strAuxError;
+    QVector<int> fileIndexes;
+    QVector<QByteArray> tilesData;
+    QVector<int> recordSizes;
+    QVector<QVector<quint8> > insideMasks;
+    QMap<int,QuaZip*>::const_iterator iterFiles=ptrZipFilesByFileIndex.begin();
+    while(iterFiles!=ptrZipFilesByFileIndex.end())
+    {
+        int fileIndex=iterFiles.key();
+        QByteArray tileData;
+        int numberOfPoints;
+        QVector<quint8> insideMask;
+        bool filterPoints;
+        if(!readTilePointsMask(*(iterFiles.value()),
+                               fileIndex,
+                               tileX,
+                               tileY,
+                               tileData,
+                               numberOfPoints,
+                               insideMask,
+                               filterPoints,
+                               false,
+                               strAuxError))
+        {
+            strError=QObject::tr("PointsQuery::getTileThinning");
+            strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+            return(false);
+        }
+        iterFiles++;
+        if(numberOfPoints==0) continue;
+        const quint8* ptrInside=insideMask.constData();
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            numberOfCandidates+=ptrInside[pos];
+        }
+        fileIndexes.push_back(fileIndex);
+        tilesData.push_back(tileData);
+        int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+        getPointRecordOffsets(mExistsFieldsByFileIndex.value(fileIndex),
+                              recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+        recordSizes.push_back(recordSize);
+        insideMasks.push_back(insideMask);
+    }
+    if(!mPointsFilter.getThinning().isVoxel()
+            ||fileIndexes.isEmpty())
+    {
+        return(true);
+    }
+    QVector<const uchar*> ptrTilesData;
+    for(int nt=0;nt<tilesData.size();nt++)
+    {
+        ptrTilesData.push_back((const uchar*)tilesData[nt].constData());
+    }
+    getPointsVoxelThinningMasks(ptrTilesData,recordSizes,insideMasks);
+    for(int nt=0;nt<fileIndexes.size();nt++)
+    {
+        QVector<int>& selectedPositions=selectedPositionsByFileIndex[fileIndexes[nt]];
+        const QVector<quint8>& insideMask=insideMasks[nt];
+        for(int pos=0;pos<insideMask.size();pos++)
+        {
+            if(insideMask[pos]) selectedPositions.push_back(pos);
+        }
+    }
+    return(true);
+}
+
+bool PointsQuery::readClassesFile(int fileIndex,
+                                  QString classesFileName,
+                                  const QMap<int, QVector<int> > &tiles,
+                                  QMap<QString, bool> &existsFields,
+                                  QString &strError)
+{
+    existsFields.clear();
+    QString strAuxError;
+    PointsClassesFile classesFile;
+    if(!classesFile.read(classesFileName,strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::readClassesFile");
+        strError+=QObject::tr("\nError reading classes file:\n%1").arg(strAuxError);
+        return(false);
+    }
+    return(setClassesFile(fileIndex,
+                          classesFileName,
+                          classesFile,
+                          tiles,
+                          existsFields,
+                          strError));
+}
+
+
+bool PointsQuery::readTileLevelOfDetailPoints(QuaZip &zipFileLevels,
+                                              int fileIndex,
+                                              int tileX,
+                                              int tileY,
+                                              int level,
+                                              QVector<Point> &pointsInTile,
+                                              QString &strError) const
+{
+    pointsInTile.clear();
+    QString strAuxError;
+    QByteArray levelData;
+    if(!readEntryData(zipFileLevels,
+                      getTileLevelOfDetailEntryName(tileX,tileY,level),
+                      levelData,
+                      strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::readTileLevelOfDetailPoints");
+        strError+=QObject::tr("\nError reading level of detail data:\n%1").arg(strAuxError);
+        return(false);
+    }
+    QVector<int> positions;
+    QByteArray records;
+    QDataStream in(&levelData,QIODevice::ReadOnly);
+    in>>positions;
+    in>>records;
+    QMap<QString,bool> existsFields=mExistsFieldsByFileIndex.value(fileIndex);
+    QVector<quint8> tilePointsClass=mTilesPointsClassByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    QMap<int,quint8> tilePointsClassNewByPos=mTilesPointsClassNewByPosByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(existsFields,recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    int numberOfPoints=positions.size();
+    if(in.status()!=QDataStream::Ok
+            ||records.size()!=numberOfPoints*recordSize)
+    {
+        strError=QObject::tr("PointsQuery::readTileLevelOfDetailPoints");
+        strError+=QObject::tr("\nInvalid level: %1 for tile X: %2 tile Y: %3")
+                .arg(QString::number(level)).arg(QString::number(tileX))
+                .arg(QString::number(tileY));
+        return(false);
+    }
+    const uchar* ptrRecords=(const uchar*)records.constData();
+    bool filterByPolygon=false;
+    if(mTilesPolygonEdges.contains(tileX))
+    {
+        filterByPolygon=mTilesPolygonEdges[tileX].contains(tileY);
+    }
+    QVector<quint8> insideMask;
+    if(filterByPolygon)
+    {
+        QVector<float> ixValues(numberOfPoints);
+        QVector<float> iyValues(numberOfPoints);
+        for(int i=0;i<numberOfPoints;i++)
+        {
+            const uchar* ptrRecord=ptrRecords+i*recordSize;
+            ixValues[i]=(float)qFromBigEndian<quint16>(ptrRecord);
+            iyValues[i]=(float)qFromBigEndian<quint16>(ptrRecord+2);
+        }
+        getPointsInPolygonMask(mTilesPolygonEdges[tileX][tileY],
+                               ixValues,
+                               iyValues,
+                               insideMask);
+    }
+    pointsInTile.resize(numberOfPoints);
+    int numberOfRealPoints=0;
+    for(int i=0;i<numberOfPoints;i++)
+    {
+        if(filterByPolygon)
+        {
+            if(!insideMask[i]) continue;
+        }
+        int pos=positions[i];
+        if(pos<0||pos>=tilePointsClass.size())
+        {
+            strError=QObject::tr("PointsQuery::readTileLevelOfDetailPoints");
+            strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes file:\n%4")
+                    .arg(QString::number(pos))
+                    .arg(QString::number(tileX))
+                    .arg(QString::number(tileY)).arg(mClassesFileByIndex.value(fileIndex));
+            pointsInTile.clear();
+            return(false);
+        }
+        PCFile::Point& pto=pointsInTile[numberOfRealPoints];
+        setPointFromRecord(ptrRecords+i*recordSize,existsFields,pto);
+        pto.setPositionInTile(pos);
+        quint8 ptoClass=tilePointsClass[pos];
+        pto.setClass(ptoClass);
+        pto.setClassNew(tilePointsClassNewByPos.value(pos,ptoClass));
+        numberOfRealPoints++;
+    }
+    if(numberOfRealPoints<numberOfPoints)
+    {
+        pointsInTile.resize(numberOfRealPoints);
+    }
+    return(true);
+}
+
+bool PointsQuery::readTilePoints(QuaZip &zipFilePoints,
+                                 int fileIndex,
+                                 int tileX,
+                                 int tileY,
+                                 QVector<Point> &pointsInTile,
+                                 QString &strError) const
+{
+    pointsInTile.clear();
+    QString strAuxError;
+    QByteArray tileData;
+    int numberOfPoints;
+    QVector<quint8> insideMask;
+    bool filterPoints;
+    if(!readTilePointsMask(zipFilePoints,
+                           fileIndex,
+                           tileX,
+                           tileY,
+                           tileData,
+                           numberOfPoints,
+                           insideMask,
+                           filterPoints,
+                           true,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::readTilePoints");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    if(numberOfPoints==0)
+    {
+        return(true);
+    }
+    QMap<QString,bool> existsFields=mExistsFieldsByFileIndex.value(fileIndex);
+    QVector<quint8> tilePointsClass=mTilesPointsClassByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    QMap<int,quint8> tilePointsClassNewByPos=mTilesPointsClassNewByPosByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(existsFields,recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    const uchar* ptrTileData=(const uchar*)tileData.constData();
+    pointsInTile.resize(numberOfPoints);
+    int numberOfRealPoints=0; // porque puede haber puntos fuera del wkt
+    for(int pos=0;pos<numberOfPoints;pos++)
+    {
+        if(filterPoints)
+        {
+            if(!insideMask[pos]) continue;
+        }
+        PCFile::Point& pto=pointsInTile[numberOfRealPoints];
+        setPointFromRecord(ptrTileData+pos*recordSize,existsFields,pto);
+        pto.setPositionInTile(pos);
+        quint8 ptoClass=tilePointsClass[pos];
+        pto.setClass(ptoClass);
+        pto.setClassNew(tilePointsClassNewByPos.value(pos,ptoClass));
+        numberOfRealPoints++;
+    }
+    if(numberOfRealPoints<numberOfPoints)
+    {
+        pointsInTile.resize(numberOfRealPoints);
+    }
+    return(true);
+}
+
+bool PointsQuery::readTilePointsPositions(QuaZip &zipFilePoints,
+                                          int fileIndex,
+                                          int tileX,
+                                          int tileY,
+                                          QVector<int> &positionsInTile,
+                                          QString &strError) const
+{
+    positionsInTile.clear();
+    QString strAuxError;
+    QByteArray tileData;
+    int numberOfPoints;
+    QVector<quint8> insideMask;
+    bool filterPoints;
+    if(!readTilePointsMask(zipFilePoints,
+                           fileIndex,
+                           tileX,
+                           tileY,
+                           tileData,
+                           numberOfPoints,
+                           insideMask,
+                           filterPoints,
+                           true,
+                           strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::readTilePointsPositions");
+        strError+=QObject::tr("\nError:\n%1").arg(strAuxError);
+        return(false);
+    }
+    positionsInTile.reserve(numberOfPoints);
+    for(int pos=0;pos<numberOfPoints;pos++)
+    {
+        if(filterPoints)
+        {
+            if(!insideMask[pos]) continue;
+        }
+        positionsInTile.push_back(pos);
+    }
+    return(true);
+}
+
+
+void PointsQuery::setThinningSelection(const QMap<int, QMap<int, QMap<int, QVector<int> > > > &selectedPositionsByFileIndex,
+                                       qint64 numberOfCandidates)
+{
+    mThinningPositionsByFileIndex=selectedPositionsByFileIndex;
+    mNumberOfThinningCandidates=numberOfCandidates;
+    mThinningSelected=true;
+}
+
+void PointsQuery::getPointRecordOffsets(const QMap<QString, bool> &existsFields,
+                                        int &recordSize,
+                                        int &gpsTimeOffset,
+                                        int &intensityOffset,
+                                        int &returnOffset) const
+{
+    // ix, iy, z_pa, z_pb, z_pc
+    recordSize=2*sizeof(quint16)+3*sizeof(quint8);
+    gpsTimeOffset=-1;
+    intensityOffset=-1;
+    returnOffset=-1;
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_COLOR,false))
+    {
+        if(mNumberOfColorBytes==1) recordSize+=3*sizeof(quint8);
+        else recordSize+=3*sizeof(quint16);
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_GPS_TIME,false))
+    {
+        gpsTimeOffset=recordSize;
+        recordSize+=4*sizeof(quint8);
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_USER_DATA,false)) recordSize+=sizeof(quint8);
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_INTENSITY,false))
+    {
+        intensityOffset=recordSize;
+        recordSize+=sizeof(quint16);
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_SOURCE_ID,false)) recordSize+=sizeof(quint16);
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_NIR,false))
+    {
+        if(mNumberOfColorBytes==1) recordSize+=sizeof(quint8);
+        else recordSize+=sizeof(quint16);
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_RETURN,false))
+    {
+        returnOffset=recordSize;
+        recordSize+=sizeof(quint8);
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_RETURNS,false)) recordSize+=sizeof(quint8);
+}
+
+void PointsQuery::getPointsFilterMask(const uchar *ptrTileData,
+                                      int numberOfPoints,
+                                      const QMap<QString, bool> &existsFields,
+                                      const QVector<quint8> &tilePointsClass,
+                                      const QMap<int, quint8> &tilePointsClassNewByPos,
+                                      QVector<quint8> &insideMask) const
+{
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(existsFields,recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    bool filterByClass=mPointsFilter.getFilterByClass();
+    bool filterByClassNew=mPointsFilter.getFilterByClassNew();
+    bool filterByHeight=mPointsFilter.getFilterByHeight();
+    bool filterByGpsTime=mPointsFilter.getFilterByGpsTime();
+    bool filterByIntensity=mPointsFilter.getFilterByIntensity();
+    bool filterByReturn=mPointsFilter.getFilterByReturn();
+    // un criterio sobre un campo que no existe en el fichero no lo cumple ningun punto
+    if((filterByGpsTime&&gpsTimeOffset<0)
+            ||(filterByIntensity&&intensityOffset<0)
+            ||(filterByReturn&&returnOffset<0))
+    {
+        insideMask.fill(0,numberOfPoints);
+        return;
+    }
+    int izMin=0;
+    int izMax=0;
+    if(filterByHeight)
+    {
+        double minZ,maxZ;
+        mPointsFilter.getHeightRange(minZ,maxZ);
+        izMin=qCeil((minZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.-POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE);
+        izMax=qFloor((maxZ-POINTCLOUDFILE_HEIGHT_MINIMUM_VALID_VALUE)*1000.+POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE);
+    }
+    double minGpsTime=0.,maxGpsTime=0.;
+    if(filterByGpsTime)
+    {
+        mPointsFilter.getGpsTimeRange(minGpsTime,maxGpsTime);
+    }
+    int minIntensity=0,maxIntensity=0;
+    if(filterByIntensity)
+    {
+        mPointsFilter.getIntensityRange(minIntensity,maxIntensity);
+    }
+    quint8* ptrInside=insideMask.data();
+    for(int pos=0;pos<numberOfPoints;pos++)
+    {
+        if(!ptrInside[pos]) continue;
+        if(filterByClass)
+        {
+            if(!mPointsFilter.isClassSelected(tilePointsClass[pos]))
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+        if(filterByClassNew)
+        {
+            quint8 classNew=tilePointsClassNewByPos.value(pos,tilePointsClass[pos]);
+            if(!mPointsFilter.isClassNewSelected(classNew))
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+        const uchar* ptrRecord=ptrTileData+pos*recordSize;
+        if(filterByHeight)
+        {
+            int iz=(ptrRecord[4]*256+ptrRecord[5])*100+ptrRecord[6];
+            if(iz<izMin||iz>izMax)
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+        if(filterByReturn)
+        {
+            if(!mPointsFilter.isReturnSelected(ptrRecord[returnOffset]))
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+        if(filterByIntensity)
+        {
+            int intensity=qFromBigEndian<quint16>(ptrRecord+intensityOffset);
+            if(intensity<minIntensity||intensity>maxIntensity)
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+        if(filterByGpsTime)
+        {
+            const uchar* ptrGpsTime=ptrRecord+gpsTimeOffset;
+            double gpsTime=Point::getGpsTime(ptrGpsTime[0],ptrGpsTime[1],ptrGpsTime[2],ptrGpsTime[3]);
+            if(gpsTime<minGpsTime||gpsTime>maxGpsTime)
+            {
+                ptrInside[pos]=0;
+                continue;
+            }
+        }
+    }
+}
+
+void PointsQuery::getPointsThinningMask(const uchar *ptrTileData,
+                                        int numberOfPoints,
+                                        int recordSize,
+                                        int fileIndex,
+                                        int tileX,
+                                        int tileY,
+                                        QVector<quint8> &insideMask) const
+{
+    // Se aplica sobre los puntos que ya cumplen recortes y filtro, en coordenadas cuantizadas
+    const PointsThinning& thinning=mPointsFilter.getThinning();
+    quint8* ptrInside=insideMask.data();
+    if(thinning.isVoxel())
+    {
+        // sin setThinningSelection: voxeles solo del fichero
+        QVector<const uchar*> tilesData(1,ptrTileData);
+        QVector<int> recordSizes(1,recordSize);
+        QVector<QVector<quint8> > insideMasks(1,insideMask);
+        getPointsVoxelThinningMasks(tilesData,recordSizes,insideMasks);
+        insideMask=insideMasks[0];
+    }
+    else if(thinning.isRandom())
+    {
+        // misma proporcion en todos los tiles y semilla por tile: resultado reproducible
+        // e independiente del reparto entre hilos
+        qint64 numberOfQueryCandidates=mThinningSelected?mNumberOfThinningCandidates:mNumberOfPointsInTiles;
+        if(numberOfQueryCandidates<=thinning.getRandomNumberOfPoints()) return;
+        double rate=(double)thinning.getRandomNumberOfPoints()/(double)numberOfQueryCandidates;
+        QVector<int> positions;
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            if(ptrInside[pos]) positions.push_back(pos);
+        }
+        int numberOfCandidates=positions.size();
+        int numberOfSelected=qMin(numberOfCandidates,qRound(rate*numberOfCandidates));
+        quint32 seed=thinning.getRandomSeed()
+                ^((quint32)fileIndex*73856093u)
+                ^((quint32)tileX*19349663u)
+                ^((quint32)tileY*83492791u);
+        std::mt19937 generator(seed);
+        for(int i=0;i<numberOfSelected;i++)
+        {
+            int j=i+(int)(generator()%(quint32)(numberOfCandidates-i));
+            std::swap(positions[i],positions[j]);
+        }
+        insideMask.fill(0,numberOfPoints);
+        ptrInside=insideMask.data();
+        for(int i=0;i<numberOfSelected;i++)
+        {
+            ptrInside[positions[i]]=1;
+        }
+    }
+}
+
+void PointsQuery::getPointsVoxelThinningMasks(const QVector<const uchar *> &tilesData,
+                                              const QVector<int> &recordSizes,
+                                              QVector<QVector<quint8> > &insideMasks) const
+{
+    // Los voxeles se alinean con el origen del tile y se comparten entre ficheros,
+    // un punto por voxel entre todas las pasadas que solapan
+    const PointsThinning& thinning=mPointsFilter.getThinning();
+    qint64 voxelSize=qMax(1,qRound(thinning.getVoxelSize()*1000.));
+    PointsThinning::VoxelSelection voxelSelection=thinning.getVoxelSelection();
+    int numberOfTiles=tilesData.size();
+    QHash<qint64,int> voxelsSlot;
+    QVector<int> slotsTile;
+    QVector<int> slotsPosition;
+    QVector<int> slotsZ;
+    QVector<double> slotsSums; // ix, iy, iz
+    QVector<int> slotsNumberOfPoints;
+    QVector<QVector<int> > pointsSlotByTile(numberOfTiles);
+    for(int nt=0;nt<numberOfTiles;nt++)
+    {
+        const uchar* ptrTileData=tilesData[nt];
+        int recordSize=recordSizes[nt];
+        int numberOfPoints=insideMasks[nt].size();
+        const quint8* ptrInside=insideMasks[nt].constData();
+        QVector<int>& pointsSlot=pointsSlotByTile[nt];
+        if(voxelSelection==PointsThinning::Centroid)
+        {
+            pointsSlot.fill(-1,numberOfPoints);
+        }
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            if(!ptrInside[pos]) continue;
+            const uchar* ptrRecord=ptrTileData+pos*recordSize;
+            int ix=qFromBigEndian<quint16>(ptrRecord);
+            int iy=qFromBigEndian<quint16>(ptrRecord+2);
+            int iz=(ptrRecord[4]*256+ptrRecord[5])*100+ptrRecord[6];
+            qint64 voxel=((ix/voxelSize)<<43)|((iy/voxelSize)<<23)|(iz/voxelSize);
+            int slot=voxelsSlot.value(voxel,-1);
+            if(slot==-1)
+            {
+                slot=slotsPosition.size();
+                voxelsSlot[voxel]=slot;
+                slotsTile.push_back(nt);
+                slotsPosition.push_back(pos);
+                slotsZ.push_back(iz);
+                slotsSums.push_back(0.);
+                slotsSums.push_back(0.);
+                slotsSums.push_back(0.);
+                slotsNumberOfPoints.push_back(0);
+            }
+            else if((voxelSelection==PointsThinning::Lowest&&iz<slotsZ[slot])
+                    ||(voxelSelection==PointsThinning::Highest&&iz>slotsZ[slot]))
+            {
+                slotsTile[slot]=nt;
+                slotsPosition[slot]=pos;
+                slotsZ[slot]=iz;
+            }
+            if(voxelSelection==PointsThinning::Centroid)
+            {
+                slotsSums[3*slot]+=ix;
+                slotsSums[3*slot+1]+=iy;
+                slotsSums[3*slot+2]+=iz;
+                slotsNumberOfPoints[slot]++;
+                pointsSlot[pos]=slot;
+            }
+        }
+    }
+    int numberOfSlots=slotsPosition.size();
+    if(voxelSelection==PointsThinning::Centroid)
+    {
+        QVector<double> slotsDistance(numberOfSlots,-1.);
+        for(int slot=0;slot<numberOfSlots;slot++)
+        {
+            for(int i=0;i<3;i++) slotsSums[3*slot+i]/=slotsNumberOfPoints[slot];
+        }
+        for(int nt=0;nt<numberOfTiles;nt++)
+        {
+            const uchar* ptrTileData=tilesData[nt];
+            int recordSize=recordSizes[nt];
+            const QVector<int>& pointsSlot=pointsSlotByTile[nt];
+            for(int pos=0;pos<pointsSlot.size();pos++)
+            {
+                int slot=pointsSlot[pos];
+                if(slot==-1) continue;
+                const uchar* ptrRecord=ptrTileData+pos*recordSize;
+                double dx=qFromBigEndian<quint16>(ptrRecord)-slotsSums[3*slot];
+                double dy=qFromBigEndian<quint16>(ptrRecord+2)-slotsSums[3*slot+1];
+                double dz=((ptrRecord[4]*256+ptrRecord[5])*100+ptrRecord[6])-slotsSums[3*slot+2];
+                double distance=dx*dx+dy*dy+dz*dz;
+                if(slotsDistance[slot]<0.||distance<slotsDistance[slot])
+                {
+                    slotsDistance[slot]=distance;
+                    slotsTile[slot]=nt;
+                    slotsPosition[slot]=pos;
+                }
+            }
+        }
+    }
+    for(int nt=0;nt<numberOfTiles;nt++)
+    {
+        insideMasks[nt].fill(0);
+    }
+    for(int slot=0;slot<numberOfSlots;slot++)
+    {
+        insideMasks[slotsTile[slot]][slotsPosition[slot]]=1;
+    }
+}
+
+void PointsQuery::getPointsInPolygonMask(const QVector<float> &polygonEdges,
+                                         const QVector<float> &ixValues,
+                                         const QVector<float> &iyValues,
+                                         QVector<quint8> &insideMask) const
+{
+    // Crossing number por lotes: bucle externo por lados y bucle interno sin saltos
+    // sobre las columnas ix/iy para que el compilador lo vectorice
+    int numberOfPoints=ixValues.size();
+    insideMask.fill(0,numberOfPoints);
+    const float* ptrX=ixValues.constData();
+    const float* ptrY=iyValues.constData();
+    quint8* ptrInside=insideMask.data();
+    int numberOfEdges=polygonEdges.size()/4;
+    const float* ptrEdges=polygonEdges.constData();
+    for(int batchStart=0;batchStart<numberOfPoints;batchStart+=POINTCLOUDFILE_POINT_IN_POLYGON_BATCH_SIZE)
+    {
+        int batchEnd=qMin(batchStart+POINTCLOUDFILE_POINT_IN_POLYGON_BATCH_SIZE,numberOfPoints);
+        for(int ne=0;ne<numberOfEdges;ne++)
+        {
+            float x1=ptrEdges[4*ne];
+            float y1=ptrEdges[4*ne+1];
+            float x2=ptrEdges[4*ne+2];
+            float y2=ptrEdges[4*ne+3];
+            if(y1==y2) continue;
+            float slope=(x2-x1)/(y2-y1);
+            for(int i=batchStart;i<batchEnd;i++)
+            {
+                float py=ptrY[i];
+                quint8 crossesY=(quint8)((y1>py)!=(y2>py));
+                quint8 leftOfEdge=(quint8)(ptrX[i]<(x1+(py-y1)*slope));
+                ptrInside[i]^=(crossesY&leftOfEdge);
+            }
+        }
+    }
+}
+
+bool PointsQuery::readEntryData(QuaZip &zipFile,
+                                QString entryName,
+                                QByteArray &entryData,
+                                QString &strError) const
+{
+    entryData.clear();
+    if(!zipFile.setCurrentFile(entryName))
+    {
+        strError=QObject::tr("PointsQuery::readEntryData");
+        strError+=QObject::tr("\nNot exists: %1 in file:\n%2\nError:\n%3")
+                .arg(entryName).arg(zipFile.getZipName())
+                .arg(QString::number(zipFile.getZipError()));
+        return(false);
+    }
+    QuaZipFile inFile(&zipFile);
+    if (!inFile.open(QIODevice::ReadOnly))
+    {
+        strError=QObject::tr("PointsQuery::readEntryData");
+        strError+=QObject::tr("\nError opening: %1 in file:\n%2\nError:\n%3")
+                .arg(entryName).arg(zipFile.getZipName())
+                .arg(QString::number(zipFile.getZipError()));
+        return(false);
+    }
+    entryData=inFile.readAll();
+    inFile.close();
+    return(true);
+}
+
+bool PointsQuery::readTilePointsMask(QuaZip &zipFilePoints,
+                                     int fileIndex,
+                                     int tileX,
+                                     int tileY,
+                                     QByteArray &tileData,
+                                     int &numberOfPoints,
+                                     QVector<quint8> &insideMask,
+                                     bool &filterPoints,
+                                     bool applyThinning,
+                                     QString &strError) const
+{
+    tileData.clear();
+    numberOfPoints=0;
+    insideMask.clear();
+    filterPoints=false;
+    QString strAuxError;
+    bool filterByAttributes=!mPointsFilter.isEmpty();
+    if(filterByAttributes)
+    {
+        if(!getTileMayMatchPointsFilter(fileIndex,tileX,tileY))
+        {
+            return(true);
+        }
+    }
+    if(!readTileData(zipFilePoints,tileX,tileY,tileData,strAuxError))
+    {
+        strError=QObject::tr("PointsQuery::readTilePointsMask");
+        strError+=QObject::tr("\nError reading tile data:\n%1").arg(strAuxError);
+        return(false);
+    }
+    QMap<QString,bool> existsFields=mExistsFieldsByFileIndex.value(fileIndex);
+    QVector<quint8> tilePointsClass=mTilesPointsClassByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    QMap<int,quint8> tilePointsClassNewByPos=mTilesPointsClassNewByPosByFileIndex.value(fileIndex).value(tileX).value(tileY);
+    int recordSize,gpsTimeOffset,intensityOffset,returnOffset;
+    getPointRecordOffsets(existsFields,recordSize,gpsTimeOffset,intensityOffset,returnOffset);
+    numberOfPoints=tileData.size()/recordSize;
+    if(numberOfPoints>tilePointsClass.size())
+    {
+        strError=QObject::tr("PointsQuery::readTilePointsMask");
+        strError+=QObject::tr("\nNot exists position: %1 in tile X: %2 tile Y: %3 in classes file:\n%4")
+                .arg(QString::number(tilePointsClass.size()))
+                .arg(QString::number(tileX))
+                .arg(QString::number(tileY)).arg(mClassesFileByIndex.value(fileIndex));
+        return(false);
+    }
+    const uchar* ptrTileData=(const uchar*)tileData.constData();
+    bool filterByThinning=(applyThinning&&!mPointsFilter.getThinning().isEmpty());
+    if(filterByThinning&&mThinningSelected&&mPointsFilter.getThinning().isVoxel())
+    {
+        // seleccion ya hecha con los puntos del tile de todos los ficheros
+        insideMask.fill(0,numberOfPoints);
+        const QVector<int> selectedPositions=mThinningPositionsByFileIndex.value(fileIndex).value(tileX).value(tileY);
+        for(int i=0;i<selectedPositions.size();i++)
+        {
+            int pos=selectedPositions[i];
+            if(pos<numberOfPoints) insideMask[pos]=1;
+        }
+        filterPoints=true;
+        return(true);
+    }
+    bool filterByPolygon=false;
+    if(mTilesPolygonEdges.contains(tileX))
+    {
+        filterByPolygon=mTilesPolygonEdges[tileX].contains(tileY);
+    }
+    bool filterByBox=false;
+    if(mTilesBoxBounds.contains(tileX))
+    {
+        filterByBox=mTilesBoxBounds[tileX].contains(tileY);
+    }
+    if(filterByPolygon)
+    {
+        QVector<float> ixValues(numberOfPoints);
+        QVector<float> iyValues(numberOfPoints);
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            const uchar* ptrRecord=ptrTileData+pos*recordSize;
+            ixValues[pos]=(float)qFromBigEndian<quint16>(ptrRecord);
+            iyValues[pos]=(float)qFromBigEndian<quint16>(ptrRecord+2);
+        }
+        getPointsInPolygonMask(mTilesPolygonEdges[tileX][tileY],
+                               ixValues,
+                               iyValues,
+                               insideMask);
+    }
+    else
+    {
+        insideMask.fill(1,numberOfPoints);
+    }
+    if(filterByBox)
+    {
+        // limites cuantizados: ix, iy en mm desde el origen del tile y z en mm desde la minima valida
+        const QVector<int> boxBounds=mTilesBoxBounds[tileX][tileY];
+        int ixMin=boxBounds[0];
+        int ixMax=boxBounds[1];
+        int iyMin=boxBounds[2];
+        int iyMax=boxBounds[3];
+        int izMin=boxBounds[4];
+        int izMax=boxBounds[5];
+        quint8* ptrInside=insideMask.data();
+        for(int pos=0;pos<numberOfPoints;pos++)
+        {
+            const uchar* ptrRecord=ptrTileData+pos*recordSize;
+            int ix=qFromBigEndian<quint16>(ptrRecord);
+            int iy=qFromBigEndian<quint16>(ptrRecord+2);
+            int iz=(ptrRecord[4]*256+ptrRecord[5])*100+ptrRecord[6];
+            quint8 inBox=(quint8)((ix>=ixMin)&(ix<=ixMax)&(iy>=iyMin)&(iy<=iyMax)&(iz>=izMin)&(iz<=izMax));
+            ptrInside[pos]&=inBox;
+        }
+    }
+    if(filterByAttributes)
+    {
+        getPointsFilterMask(ptrTileData,
+                            numberOfPoints,
+                            existsFields,
+                            tilePointsClass,
+                            tilePointsClassNewByPos,
+                            insideMask);
+    }
+    if(filterByThinning)
+    {
+        getPointsThinningMask(ptrTileData,
+                              numberOfPoints,
+                              recordSize,
+                              fileIndex,
+                              tileX,
+                              tileY,
+                              insideMask);
+    }
+    filterPoints=(filterByPolygon||filterByBox||filterByAttributes||filterByThinning);
+    return(true);
+}
+
+bool PointsQuery::readTileData(QuaZip &zipFilePoints,
+                               int tileX,
+                               int tileY,
+                               QByteArray &tileData,
+                               QString &strError) const
+{
+    QString tileTableName="tile_"+QString::number(tileX)+"_"+QString::number(tileY);
+    return(readEntryData(zipFilePoints,tileTableName,tileData,strError));
+}
+
+bool PointsQuery::setClassesFile(int fileIndex,
+                                 QString classesFileName,
+                                 const PointsClassesFile &classesFile,
+                                 const QMap<int, QVector<int> > &tiles,
+                                 QMap<QString, bool> &existsFields,
+                                 QString &strError)
+{
+    existsFields=classesFile.getExistsFields();
+    const QMap<int,QMap<int,QVector<quint8> > >& tilesPointsClass=classesFile.getTilesPointsClass();
+    const QMap<int,QMap<int,QMap<int,quint8> > >& tilesPointsClassNewByPos=classesFile.getTilesPointsClassNewByPos();
+    const QMap<int,QMap<int,int> >& tilesNop=classesFile.getTilesNop();
+    const QMap<int,QMap<int,QVector<double> > >& tilesStatistics=classesFile.getTilesStatistics();
+    // solo se conservan los tiles de la consulta
+    QMap<int,QVector<int> >::const_iterator iterTileX=tiles.begin();
+    while(iterTileX!=tiles.end())
+    {
+        int tileX=iterTileX.key();
+        if(!tilesPointsClass.contains(tileX))
+        {
+            strError=QObject::tr("PointsQuery::setClassesFile");
+            strError+=QObject::tr("\nNot exists tile x: %1 in classes  file:\n%2")
+                    .arg(QString::number(tileX)).arg(classesFileName);
+            return(false);
+        }
+        for(int i=0;i<iterTileX.value().size();i++)
+        {
+            int tileY=iterTileX.value()[i];
+            if(!tilesPointsClass[tileX].contains(tileY))
+            {
+                strError=QObject::tr("PointsQuery::setClassesFile");
+                strError+=QObject::tr("\nNot exists tile y: %1 for tile x: %2 in classes  file:\n%3")
+                        .arg(QString::number(tileY))
+                        .arg(QString::number(tileX)).arg(classesFileName);
+                return(false);
+            }
+            mTilesPointsClassByFileIndex[fileIndex][tileX][tileY]=tilesPointsClass[tileX][tileY];
+            mTilesNopByFileIndex[fileIndex][tileX][tileY]=tilesNop[tileX].value(tileY,tilesPointsClass[tileX][tileY].size());
+            mNumberOfPointsInTiles+=mTilesNopByFileIndex[fileIndex][tileX][tileY];
+            if(tilesPointsClassNewByPos.contains(tileX))
+            {
+                if(tilesPointsClassNewByPos[tileX].contains(tileY))
+                {
+                    mTilesPointsClassNewByPosByFileIndex[fileIndex][tileX][tileY]=tilesPointsClassNewByPos[tileX][tileY];
+                }
+            }
+            if(tilesStatistics.contains(tileX))
+            {
+                if(tilesStatistics[tileX].contains(tileY))
+                {
+                    mTilesStatisticsByFileIndex[fileIndex][tileX][tileY]=tilesStatistics[tileX][tileY];
+                }
+            }
+        }
+        iterTileX++;
+    }
+    mClassesFileByIndex[fileIndex]=classesFileName;
+    mExistsFieldsByFileIndex[fileIndex]=existsFields;
+    return(true);
+}
+
+void PointsQuery::setPointFromRecord(const uchar *ptrRecord,
+                                     const QMap<QString, bool> &existsFields,
+                                     Point &pto) const
+{
+    quint16 ix=qFromBigEndian<quint16>(ptrRecord);
+    quint16 iy=qFromBigEndian<quint16>(ptrRecord+2);
+    quint8 z_pa=ptrRecord[4];
+    quint8 z_pb=ptrRecord[5];
+    quint8 z_pc=ptrRecord[6];
+    pto.setCoordinates(ix,iy,z_pa,z_pb,z_pc);
+    int offset=7;
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_COLOR,false))
+    {
+        if(mNumberOfColorBytes==1)
+        {
+            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,ptrRecord[offset]);
+            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,ptrRecord[offset+1]);
+            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,ptrRecord[offset+2]);
+            offset+=3;
+        }
+        else
+        {
+            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_RED,qFromBigEndian<quint16>(ptrRecord+offset));
+            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_GREEN,qFromBigEndian<quint16>(ptrRecord+offset+2));
+            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_COLOR_BLUE,qFromBigEndian<quint16>(ptrRecord+offset+4));
+            offset+=6;
+        }
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_GPS_TIME,false))
+    {
+        pto.setGpsTime(ptrRecord[offset],ptrRecord[offset+1],ptrRecord[offset+2],ptrRecord[offset+3]);
+        offset+=4;
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_USER_DATA,false))
+    {
+        pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_USER_DATA,ptrRecord[offset]);
+        offset+=1;
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_INTENSITY,false))
+    {
+        pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_INTENSITY,qFromBigEndian<quint16>(ptrRecord+offset));
+        offset+=2;
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_SOURCE_ID,false))
+    {
+        pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_SOURCE_ID,qFromBigEndian<quint16>(ptrRecord+offset));
+        offset+=2;
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_NIR,false))
+    {
+        if(mNumberOfColorBytes==1)
+        {
+            pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_NIR,ptrRecord[offset]);
+            offset+=1;
+        }
+        else
+        {
+            pto.set16BitsValue(POINTCLOUDFILE_PARAMETER_NIR,qFromBigEndian<quint16>(ptrRecord+offset));
+            offset+=2;
+        }
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_RETURN,false))
+    {
+        pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURN,ptrRecord[offset]);
+        offset+=1;
+    }
+    if(existsFields.value(POINTCLOUDFILE_PARAMETER_RETURNS,false))
+    {
+        pto.set8BitsValue(POINTCLOUDFILE_PARAMETER_RETURNS,ptrRecord[offset]);
+        offset+=1;
+    }
+}
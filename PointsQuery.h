@@ -0,0 +1,155 @@
+#ifndef POINTSQUERY_H
+#define POINTSQUERY_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+
+#include "PointsFilter.h"
+
+class QuaZip;
+
+namespace PCFile{
+class Point;
+class PointsClassesFile;
+
+// Estado de una consulta de puntos sobre los tiles: recortes por tile (poligono o caja),
+// filtro de atributos y contenido de los ficheros de clases implicados.
+// Cada consulta tiene el suyo y la lectura de tiles es const, de modo que varios hilos
+// decodifican tiles de la misma consulta y varias consultas pueden ejecutarse a la vez.
+class PointsQuery
+{
+public:
+    PointsQuery();
+    void clear();
+    bool countTilePoints(QuaZip& zipFilePoints,
+                         int fileIndex,
+                         int tileX,
+                         int tileY,
+                         int& numberOfPoints,
+                         QString& strError) const;
+    bool getTileMayMatchPointsFilter(int fileIndex,
+                                     int tileX,
+                                     int tileY) const;
+    bool getTileLevelsOfDetail(QuaZip& zipFilePoints,
+                               int fileIndex,
+                               int tileX,
+                               int tileY,
+                               const QVector<int>& voxelSizes, // mm, del nivel mas grueso al mas fino
+                               QVector<QByteArray>& levelsData,
+                               QVector<int>& levelsNumberOfPoints,
+                               QString& strError) const;
+    static QString getTileLevelOfDetailEntryName(int tileX,
+                                                 int tileY,
+                                                 int level);
+    int getTileNumberOfPoints(int fileIndex,
+                              int tileX,
+                              int tileY) const;
+    bool getTileThinning(const QMap<int,QuaZip*>& ptrZipFilesByFileIndex, // ficheros con el tile, abiertos
+                         int tileX,
+                         int tileY,
+                         QMap<int,QVector<int> >& selectedPositionsByFileIndex, // solo con voxel
+                         qint64& numberOfCandidates, // tras recortes y filtro
+                         QString& strError) const;
+    bool isThinning() const{return(!mPointsFilter.getThinning().isEmpty());};
+    bool readClassesFile(int fileIndex,
+                         QString classesFileName,
+                         const QMap<int,QVector<int> >& tiles,
+                         QMap<QString,bool>& existsFields,
+                         QString& strError);
+    bool readTileLevelOfDetailPoints(QuaZip& zipFileLevels,
+                                     int fileIndex,
+                                     int tileX,
+                                     int tileY,
+                                     int level,
+                                     QVector<PCFile::Point>& pointsInTile,
+                                     QString& strError) const;
+    bool readTilePoints(QuaZip& zipFilePoints,
+                        int fileIndex,
+                        int tileX,
+                        int tileY,
+                        QVector<PCFile::Point>& pointsInTile,
+                        QString& strError) const;
+    bool readTilePointsPositions(QuaZip& zipFilePoints, // posiciones en el tile, sin construir los Point
+                                 int fileIndex,
+                                 int tileX,
+                                 int tileY,
+                                 QVector<int>& positionsInTile,
+                                 QString& strError) const;
+    bool setClassesFile(int fileIndex, // contenido ya leido, p.e. el de una sesion de edicion
+                        QString classesFileName,
+                        const PCFile::PointsClassesFile& classesFile,
+                        const QMap<int,QVector<int> >& tiles,
+                        QMap<QString,bool>& existsFields,
+                        QString& strError);
+    void setNumberOfColorBytes(int value){mNumberOfColorBytes=value;};
+    void setPointsFilter(const PointsFilter& pointsFilter){mPointsFilter=pointsFilter;};
+    void setTilesBoxBounds(const QMap<int,QMap<int,QVector<int> > >& tilesBoxBounds){mTilesBoxBounds=tilesBoxBounds;};
+    void setTilesPolygonEdges(const QMap<int,QMap<int,QVector<float> > >& tilesPolygonEdges){mTilesPolygonEdges=tilesPolygonEdges;};
+    void setThinningSelection(const QMap<int,QMap<int,QMap<int,QVector<int> > > >& selectedPositionsByFileIndex, // [fileIndex][tileX][tileY]
+                              qint64 numberOfCandidates);
+private:
+    void getPointRecordOffsets(const QMap<QString,bool>& existsFields,
+                               int& recordSize,
+                               int& gpsTimeOffset,
+                               int& intensityOffset,
+                               int& returnOffset) const;
+    void getPointsFilterMask(const uchar* ptrTileData,
+                             int numberOfPoints,
+                             const QMap<QString,bool>& existsFields,
+                             const QVector<quint8>& tilePointsClass,
+                             const QMap<int,quint8>& tilePointsClassNewByPos,
+                             QVector<quint8>& insideMask) const;
+    void getPointsVoxelThinningMasks(const QVector<const uchar*>& tilesData, // un tile de varios ficheros
+                                     const QVector<int>& recordSizes,
+                                     QVector<QVector<quint8> >& insideMasks) const;
+    void getPointsThinningMask(const uchar* ptrTileData,
+                               int numberOfPoints,
+                               int recordSize,
+                               int fileIndex,
+                               int tileX,
+                               int tileY,
+                               QVector<quint8>& insideMask) const;
+    void getPointsInPolygonMask(const QVector<float>& polygonEdges,
+                                const QVector<float>& ixValues,
+                                const QVector<float>& iyValues,
+                                QVector<quint8>& insideMask) const;
+    bool readEntryData(QuaZip& zipFile,
+                       QString entryName,
+                       QByteArray& entryData,
+                       QString& strError) const;
+    bool readTilePointsMask(QuaZip& zipFilePoints,
+                            int fileIndex,
+                            int tileX,
+                            int tileY,
+                            QByteArray& tileData,
+                            int& numberOfPoints, // 0 si el tile no puede cumplir el filtro
+                            QVector<quint8>& insideMask,
+                            bool& filterPoints, // si no, todos los puntos del tile
+                            bool applyThinning,
+                            QString& strError) const;
+    bool readTileData(QuaZip& zipFilePoints,
+                      int tileX,
+                      int tileY,
+                      QByteArray& tileData,
+                      QString& strError) const;
+    void setPointFromRecord(const uchar* ptrRecord,
+                            const QMap<QString,bool>& existsFields,
+                            PCFile::Point& pto) const;
+    int mNumberOfColorBytes;
+    qint64 mNumberOfPointsInTiles; // de todos los ficheros de clases leidos, muestra aleatoria sin setThinningSelection
+    bool mThinningSelected; // con setThinningSelection
+    qint64 mNumberOfThinningCandidates;
+    QMap<int,QMap<int,QMap<int,QVector<int> > > > mThinningPositionsByFileIndex;
+    PointsFilter mPointsFilter;
+    QMap<int,QMap<int,QVector<int> > > mTilesBoxBounds; // ixMin,ixMax,iyMin,iyMax,izMin,izMax
+    QMap<int,QMap<int,QVector<float> > > mTilesPolygonEdges; // x1,y1,x2,y2 en coordenadas del tile, x1000
+    QMap<int,QString> mClassesFileByIndex;
+    QMap<int,QMap<QString,bool> > mExistsFieldsByFileIndex;
+    QMap<int,QMap<int,QMap<int,QVector<quint8> > > > mTilesPointsClassByFileIndex;
+    QMap<int,QMap<int,QMap<int,QMap<int,quint8> > > > mTilesPointsClassNewByPosByFileIndex;
+    QMap<int,QMap<int,QMap<int,int> > > mTilesNopByFileIndex;
+    QMap<int,QMap<int,QMap<int,QVector<double> > > > mTilesStatisticsByFileIndex;
+};
+}
+#endif // POINTSQUERY_H
@@ -0,0 +1,32 @@
+#include "PointsThinning.h"
+
+using namespace PCFile;
+
+PointsThinning::PointsThinning()
+{
+    clear();
+}
+
+void PointsThinning::clear()
+{
+    mRandomNumberOfPoints=0;
+    mRandomSeed=0;
+    mVoxelSelection=First;
+    mVoxelSize=0.;
+}
+
+void PointsThinning::setRandomSample(qint64 numberOfPoints,
+                                     quint32 seed)
+{
+    clear();
+    mRandomNumberOfPoints=numberOfPoints;
+    mRandomSeed=seed;
+}
+
+void PointsThinning::setVoxel(double voxelSize,
+                              VoxelSelection voxelSelection)
+{
+    clear();
+    mVoxelSize=voxelSize;
+    mVoxelSelection=voxelSelection;
+}
@@ -0,0 +1,38 @@
+#ifndef POINTSTHINNING_H
+#define POINTSTHINNING_H
+
+#include "libPointCloudFileManager_global.h"
+
+#include <QtGlobal>
+
+namespace PCFile{
+
+// Aclarado de los puntos de una consulta. Se aplica por tile en la decodificacion, despues
+// de los recortes y del filtro de atributos, de modo que los puntos descartados no llegan
+// a construirse como Point. Voxel y muestra aleatoria son excluyentes.
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT PointsThinning
+{
+public:
+    enum VoxelSelection{First,Lowest,Highest,Centroid}; // Centroid: el punto mas cercano al centroide
+    PointsThinning();
+    void clear();
+    qint64 getRandomNumberOfPoints() const{return(mRandomNumberOfPoints);};
+    quint32 getRandomSeed() const{return(mRandomSeed);};
+    VoxelSelection getVoxelSelection() const{return(mVoxelSelection);};
+    double getVoxelSize() const{return(mVoxelSize);};
+    bool isEmpty() const{return(!isRandom()&&!isVoxel());};
+    bool isRandom() const{return(mRandomNumberOfPoints>0);};
+    bool isVoxel() const{return(mVoxelSize>0.);};
+    // aproximadamente numberOfPoints de los que cumplen recortes y filtro, repartidos entre los tiles
+    void setRandomSample(qint64 numberOfPoints,
+                         quint32 seed=0);
+    void setVoxel(double voxelSize, // metros, voxeles alineados con el origen de cada tile y comunes a todos los ficheros
+                  VoxelSelection voxelSelection=First);
+private:
+    qint64 mRandomNumberOfPoints;
+    quint32 mRandomSeed;
+    VoxelSelection mVoxelSelection;
+    double mVoxelSize;
+};
+}
+#endif // POINTSTHINNING_H
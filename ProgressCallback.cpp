@@ -0,0 +1,203 @@
+#include <QApplication>
+#include <QProgressDialog>
+#include <QThread>
+
+#include "PointCloudFileDefinitions.h"
+#include "ProgressCallback.h"
+
+using namespace PCFile;
+
+namespace PCFile{
+// Solo se crea en el hilo de QApplication; los metodos llamados desde otros hilos
+// se encolan en el del dialogo
+class ProgressDialog : public Progress
+{
+public:
+    ProgressDialog(QString title,
+                   QString labelText,
+                   int maximum);
+    ~ProgressDialog();
+    void setLabelText(QString text);
+    void setValue(int value);
+    bool wasCanceled();
+private:
+    bool isDialogThread();
+    QProgressDialog* mPtrDialog;
+};
+}
+
+CancellationToken::CancellationToken()
+{
+    mPtrCanceled=QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+}
+
+void CancellationToken::cancel()
+{
+    mPtrCanceled->storeRelease(1);
+}
+
+bool CancellationToken::isCanceled() const
+{
+    return(mPtrCanceled->loadAcquire()!=0);
+}
+
+Progress::Progress()
+{
+    mCanceled.storeRelease(0);
+}
+
+Progress::~Progress()
+{
+
+}
+
+void Progress::cancel()
+{
+    mCanceled.storeRelease(1);
+}
+
+QString Progress::getError()
+{
+    QMutexLocker locker(&mErrorMutex);
+    return(mStrError);
+}
+
+void Progress::setError(QString strError)
+{
+    {
+        QMutexLocker locker(&mErrorMutex);
+        if(mStrError.isEmpty())
+        {
+            mStrError=strError;
+        }
+    }
+    cancel();
+}
+
+void Progress::setLabelText(QString text)
+{
+    Q_UNUSED(text);
+}
+
+void Progress::setValue(int value)
+{
+    Q_UNUSED(value);
+}
+
+bool Progress::wasCanceled()
+{
+    return(mCanceled.loadAcquire()!=0
+           ||mCancellationToken.isCanceled());
+}
+
+bool Progress::waitForFinished(QFuture<void> &future)
+{
+    while(!future.isFinished())
+    {
+        if(wasCanceled()&&!future.isCanceled())
+        {
+            future.cancel();
+        }
+        setValue(future.progressValue());
+        QThread::msleep(POINTCLOUDFILE_PROGRESS_WAIT_INTERVAL);
+    }
+    future.waitForFinished();
+    return(!wasCanceled());
+}
+
+ProgressCallback::~ProgressCallback()
+{
+
+}
+
+Progress *ProgressCallback::createProgress(QString title,
+                                           QString labelText,
+                                           int maximum)
+{
+    Q_UNUSED(title);
+    Q_UNUSED(labelText);
+    Q_UNUSED(maximum);
+    return(new Progress());
+}
+
+CancellableProgressCallback::CancellableProgressCallback(ProgressCallback *ptrProgressCallback,
+                                                         const CancellationToken &cancellationToken)
+{
+    mPtrProgressCallback=ptrProgressCallback;
+    mCancellationToken=cancellationToken;
+}
+
+Progress *CancellableProgressCallback::createProgress(QString title,
+                                                      QString labelText,
+                                                      int maximum)
+{
+    Progress* ptrProgress=mPtrProgressCallback->createProgress(title,labelText,maximum);
+    ptrProgress->setCancellationToken(mCancellationToken);
+    return(ptrProgress);
+}
+
+Progress *ProgressDialogCallback::createProgress(QString title,
+                                                 QString labelText,
+                                                 int maximum)
+{
+    if(qobject_cast<QApplication*>(QCoreApplication::instance())==NULL
+            ||QThread::currentThread()!=QCoreApplication::instance()->thread())
+    {
+        return(ProgressCallback::createProgress(title,labelText,maximum));
+    }
+    return(new ProgressDialog(title,labelText,maximum));
+}
+
+ProgressDialog::ProgressDialog(QString title,
+                               QString labelText,
+                               int maximum)
+{
+    mPtrDialog=new QProgressDialog(labelText,"Abort",0,maximum);
+    mPtrDialog->setWindowTitle(title);
+    mPtrDialog->setWindowModality(Qt::WindowModal);
+    mPtrDialog->show();
+    qApp->processEvents();
+}
+
+ProgressDialog::~ProgressDialog()
+{
+    mPtrDialog->close();
+    delete(mPtrDialog);
+}
+
+bool ProgressDialog::isDialogThread()
+{
+    return(QThread::currentThread()==mPtrDialog->thread());
+}
+
+void ProgressDialog::setLabelText(QString text)
+{
+    if(!isDialogThread())
+    {
+        QMetaObject::invokeMethod(mPtrDialog,"setLabelText",Qt::QueuedConnection,Q_ARG(QString,text));
+        return;
+    }
+    mPtrDialog->setLabelText(text);
+    qApp->processEvents();
+}
+
+void ProgressDialog::setValue(int value)
+{
+    if(!isDialogThread())
+    {
+        QMetaObject::invokeMethod(mPtrDialog,"setValue",Qt::QueuedConnection,Q_ARG(int,value));
+        return;
+    }
+    mPtrDialog->setValue(value);
+    qApp->processEvents();
+}
+
+bool ProgressDialog::wasCanceled()
+{
+    if(isDialogThread()
+            &&mPtrDialog->wasCanceled())
+    {
+        cancel();
+    }
+    return(Progress::wasCanceled());
+}
@@ -0,0 +1,85 @@
+#ifndef PROGRESSCALLBACK_H
+#define PROGRESSCALLBACK_H
+
+#include "libPointCloudFileManager_global.h"
+
+#include <QString>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+#include <QSharedPointer>
+
+namespace PCFile{
+
+// Cancelacion cooperativa de una operacion asincrona. Las copias comparten el estado,
+// la operacion lo consulta entre tiles o ficheros
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT CancellationToken
+{
+public:
+    CancellationToken();
+    void cancel();
+    bool isCanceled() const;
+private:
+    QSharedPointer<QAtomicInt> mPtrCanceled;
+};
+
+// Progreso y cancelacion de una operacion larga. La implementacion base no muestra nada,
+// de modo que la libreria puede ejecutarse sin QApplication (demonios, procesos de trabajo).
+// cancel(), setError() y wasCanceled() pueden llamarse desde cualquier hilo.
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT Progress
+{
+public:
+    Progress();
+    virtual ~Progress();
+    virtual void cancel();
+    QString getError();
+    void setCancellationToken(const CancellationToken& cancellationToken){mCancellationToken=cancellationToken;};
+    void setError(QString strError); // se conserva el primero y se cancela
+    virtual void setLabelText(QString text);
+    virtual void setValue(int value);
+    virtual bool wasCanceled();
+    bool waitForFinished(QFuture<void>& future); // false si se ha cancelado o hay error
+protected:
+    QAtomicInt mCanceled;
+    CancellationToken mCancellationToken;
+    QMutex mErrorMutex;
+    QString mStrError;
+};
+
+// Crea un Progress por operacion. Las aplicaciones pueden derivarla para enlazar el progreso
+// con su propio interfaz o registro y asignarla con PointCloudFileManager::setProgressCallback
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT ProgressCallback
+{
+public:
+    virtual ~ProgressCallback();
+    virtual Progress* createProgress(QString title,
+                                     QString labelText,
+                                     int maximum);
+};
+
+// Dialogo de progreso de Qt si existe QApplication y se llama desde su hilo,
+// en otro caso igual que ProgressCallback
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT ProgressDialogCallback : public ProgressCallback
+{
+public:
+    virtual Progress* createProgress(QString title,
+                                     QString labelText,
+                                     int maximum);
+};
+
+// Asigna un token de cancelacion a los Progress de otro ProgressCallback, que no se libera
+class LIBPOINTCLOUDFILEMANAGERSHARED_EXPORT CancellableProgressCallback : public ProgressCallback
+{
+public:
+    CancellableProgressCallback(ProgressCallback* ptrProgressCallback,
+                                const CancellationToken& cancellationToken);
+    virtual Progress* createProgress(QString title,
+                                     QString labelText,
+                                     int maximum);
+    const CancellationToken& getCancellationToken() const{return(mCancellationToken);};
+private:
+    ProgressCallback* mPtrProgressCallback;
+    CancellationToken mCancellationToken;
+};
+}
+#endif // PROGRESSCALLBACK_H
@@ -42,27 +42,43 @@ CGAL_PATH= ./../../../depends/CGAL-5.3.1
 BOOST_PATH= ./../../../depends/boost_1_76_0_vs2014_x64
 
 SOURCES += \
+    OperationResult.cpp \
     PointCloudFileManager.cpp \
     PointCloudFile.cpp \
-    Point.cpp
+    Point.cpp \
+    PointsClassesFile.cpp \
+    PointsEditLog.cpp \
+    PointsFilter.cpp \
+    PointsIndex.cpp \
+    PointsQuery.cpp \
+    PointsThinning.cpp \
+    ProgressCallback.cpp
 
 HEADERS += \
     libPointCloudFileManager_global.h \
+    OperationResult.h \
     PointCloudFileManager.h \
     PointCloudFileDefinitions.h \
     PointCloudFile.h \
-    Point.h
+    Point.h \
+    PointsClassesFile.h \
+    PointsEditLog.h \
+    PointsFilter.h \
+    PointsIndex.h \
+    PointsQuery.h \
+    PointsThinning.h \
+    ProgressCallback.h
 
-INCLUDEPATH += \
-#        $$CGAL_PATH\install\include \
-        $$CGAL_PATH\include \
-        $$BOOST_PATH \
-        $$CGAL_PATH/auxiliary/gmp/include
+#INCLUDEPATH += \
+##        $$CGAL_PATH\install\include \
+#        $$CGAL_PATH\include \
+#        $$BOOST_PATH \
+#        $$CGAL_PATH/auxiliary/gmp/include
 
 #INCLUDEPATH += $$QT_3RDPARTY/zlib
 INCLUDEPATH += . $$QUAZIPLIB_PATH/include
 
-INCLUDEPATH += . ../libICGAL
+#INCLUDEPATH += . ../libICGAL
 INCLUDEPATH += . ../libProcessTools
 INCLUDEPATH += . ../libCRS
 INCLUDEPATH += . ../libIGDAL
@@ -93,7 +109,7 @@ debug{
 #    LIBS += -lquazip
 }
 
-LIBS += -llibICGAL
+#LIBS += -llibICGAL
 LIBS += -llibCRS
 LIBS += -llibIGDAL
 LIBS += -llibParameters
@@ -234,11 +234,61 @@
 
 #define POINTCLOUDFILE_NUMBER_OF_FILES_TO_WRITE_PROCESS_BY_STEP       1 // por transactions son 20000, https://www.gdal.org/drv_sqlite.html
 #define POINTCLOUDFILE_NUMBER_OF_POINTS_TO_WRITE_PROCESS_BY_STEP       100000 // por transactions son 20000, https://www.gdal.org/drv_sqlite.html
+#define POINTCLOUDFILE_POINT_IN_POLYGON_BATCH_SIZE                     1024 // puntos por lote en el filtro crossing number
+#define POINTCLOUDFILE_QUANTIZED_BOUNDS_TOLERANCE                      0.000001
+#define POINTCLOUDFILE_QUANTIZED_Z_MAXIMUM_VALUE                       6553599 // (z_pa*256+z_pb)*100+z_pc
+#define POINTCLOUDFILE_PROGRESS_WAIT_INTERVAL                          50 // ms entre consultas a una tarea concurrente
+#define POINTCLOUDFILE_POINTS_INDEX_LEAF_SIZE                          16 // puntos por hoja del kd-tree de vecinos
+#define POINTCLOUDFILE_LOD_NUMBER_OF_LEVELS                            5 // sin contar la resolucion completa
+#define POINTCLOUDFILE_LOD_COARSEST_GRID_SIZE_DIVISOR                  16 // voxel del nivel 0 = tile/16, cada nivel la mitad
+#define POINTCLOUDFILE_LOD_LEVELS_ENTRY_NAME                           "levels"
+#define POINTCLOUDFILE_CLASSES_FILES_MAXIMUM_NUMBER_OF_THREADS         4 // lectura y escritura de ficheros .pcs completos en paralelo
+#define POINTCLOUDFILE_WRITE_FILES_MAXIMUM_NUMBER_OF_THREADS           4 // ficheros de nubes de puntos escritos en paralelo, limitado por el disco
+#define POINTCLOUDFILE_EXPORT_QUEUED_TILES_BY_THREAD                   2 // tiles leidos por delante del que se escribe al exportar, por hilo
+#define POINTCLOUDFILE_EDIT_LOG_MAXIMUM_NUMBER_OF_RUNS                 4000000 // ~22 bytes por tramo, se descartan las operaciones mas antiguas
+
+// estadisticas por tile guardadas al final del fichero de clases, pares minimo/maximo
+#define POINTCLOUDFILE_TILE_STATISTICS_Z_MIN                           0 // z cuantizada, mm sobre la minima valida
+#define POINTCLOUDFILE_TILE_STATISTICS_Z_MAX                           1
+#define POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MIN                    2
+#define POINTCLOUDFILE_TILE_STATISTICS_GPS_TIME_MAX                    3
+#define POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MIN                   4
+#define POINTCLOUDFILE_TILE_STATISTICS_INTENSITY_MAX                   5
+#define POINTCLOUDFILE_TILE_STATISTICS_RETURN_MIN                      6
+#define POINTCLOUDFILE_TILE_STATISTICS_RETURN_MAX                      7
+#define POINTCLOUDFILE_TILE_STATISTICS_SIZE                            8
+#define POINTCLOUDFILE_TILE_STATISTICS_EMPTY_MINIMUM                   1.0e+38
+#define POINTCLOUDFILE_TILE_STATISTICS_EMPTY_MAXIMUM                   -1.0e+38
+
+// cabecera y registros de puntos de ficheros las, para modificar clases sin reescribir el fichero
+#define POINTCLOUDFILE_LAS_HEADER_SIGNATURE                            "LASF"
+#define POINTCLOUDFILE_LAS_HEADER_VERSION_MINOR_POSITION               25
+#define POINTCLOUDFILE_LAS_HEADER_OFFSET_TO_POINT_DATA_POSITION        96
+#define POINTCLOUDFILE_LAS_HEADER_POINT_DATA_FORMAT_POSITION           104
+#define POINTCLOUDFILE_LAS_HEADER_POINT_DATA_RECORD_LENGTH_POSITION    105
+#define POINTCLOUDFILE_LAS_HEADER_NUMBER_OF_POINTS_POSITION            107
+#define POINTCLOUDFILE_LAS_HEADER_EXTENDED_NUMBER_OF_POINTS_POSITION   247 // las 1.4
+#define POINTCLOUDFILE_LAS_HEADER_MINIMUM_SIZE                         227
+#define POINTCLOUDFILE_LAS_HEADER_14_SIZE                              375
+#define POINTCLOUDFILE_LAS_POINT_FLAGS_POSITION                        15 // clasificacion en formatos 0-5, flags en 6-10
+#define POINTCLOUDFILE_LAS_POINT_EXTENDED_FORMAT_MINIMUM               6
+#define POINTCLOUDFILE_LAS_POINT_CLASS_MASK                            0x1F // formatos 0-5
+#define POINTCLOUDFILE_LAS_POINT_CLASS_MAXIMUM                         31 // formatos 0-5, las clases mayores no se escriben
+#define POINTCLOUDFILE_LAS_POINT_WITHHELD_MASK                         0x80 // formatos 0-5
+#define POINTCLOUDFILE_LAS_POINT_EXTENDED_WITHHELD_MASK                0x04 // formatos 6-10
+#define POINTCLOUDFILE_LAS_POINT_COMPRESSED_FORMAT_MASK                0xC0 // bits que activa laszip
 
 #define POINTCLOUDFILE_NO_DOUBLE_VALUE                           -9999
 #define POINTCLOUDFILE_NO_DOUBLE_MINIMUM_VALUE                   100000000.
 #define POINTCLOUDFILE_DHL_SUFFIX                                "dhl"
 #define POINTCLOUDFILE_PCS_SUFFIX                                "pcs"
+#define POINTCLOUDFILE_PCS_TEMPORARY_SUFFIX                      ".tmp" // .pcs nuevo hasta sustituir a todos los de la actualizacion
+#define POINTCLOUDFILE_PCS_BACKUP_SUFFIX                         ".bak" // .pcs anterior hasta sustituir a todos los de la actualizacion
+#define POINTCLOUDFILE_PCI_SUFFIX                                "pci" // indice de vecinos por tile, se crea con buildPointsIndex
+#define POINTCLOUDFILE_PCL_SUFFIX                                "pcl" // niveles de detalle por tile, se crea con buildLevelsOfDetail
+#define POINTCLOUDFILE_PCO_SUFFIX                                "pco" // indice de los puntos en el fichero original por tile, se crea al incorporarlo
+#define POINTCLOUDFILE_PCO_MAGIC                                 0x50434F49 // "PCOI"
+#define POINTCLOUDFILE_PCO_VERSION                               2 // tramos qint64; sin cabecera o con otra version se ignora
 #define POINTCLOUDFILE_LAS_SUFFIX                                "las"
 #define POINTCLOUDFILE_LAZ_SUFFIX                                "laz"
 #define POINTCLOUDFILE_OUTPUT_SUBPATH_1                          "libs"